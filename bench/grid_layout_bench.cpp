@@ -0,0 +1,220 @@
+// Grid2D<SEOArray>の素子の並べ方（行優先・タイル・Z順序）ごとのsweepの速さとキャッシュミスの数を比べるベンチマーク
+// 使い方: GridLayoutBench [1辺のサイズ ...]（デフォルトは1024 2048 4096）
+// N×Nの4近傍の格子でJacobiのsweep（updateGridSurVn → updateGridVn）を繰り返し、1sweepあたりの時間を測る
+// Linuxでハードウェアのカウンタが使えれば、L1データキャッシュの読み込みミスとLLCのミスの数も数える（使えなければn/a）
+// カウンタが使えない環境（仮想マシンなど）でも比べられるように、sweepで隣のVnを読む順番を
+// 32KB・8way・64Bラインのキャッシュ（LRU）に通したときのミスの数も出す（Vnの読み込みだけのモデル）
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "seo_array.hpp"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+// 数えるキャッシュミス
+enum class Miss
+{
+    L1DataRead, // L1データキャッシュの読み込みミス
+    LastLevel   // LLCのミス
+};
+
+// ハードウェアのカウンタ（開けなければ値はn/a）
+class Counter
+{
+private:
+    int fd = -1;
+
+public:
+    explicit Counter(Miss kind)
+    {
+#ifdef __linux__
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        if (kind == Miss::L1DataRead)
+        {
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        }
+        else
+        {
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        }
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#else
+        (void)kind;
+#endif
+    }
+    ~Counter()
+    {
+#ifdef __linux__
+        if (fd >= 0)
+            close(fd);
+#endif
+    }
+    Counter(const Counter &) = delete;
+    Counter &operator=(const Counter &) = delete;
+
+    void start()
+    {
+#ifdef __linux__
+        if (fd >= 0)
+        {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    // 数えた値（開けなければ-1）
+    long long stop()
+    {
+#ifdef __linux__
+        long long value = 0;
+        if (fd >= 0)
+        {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(fd, &value, sizeof(value)) == sizeof(value))
+                return value;
+        }
+#endif
+        return -1;
+    }
+};
+
+// N×Nの4近傍の格子（市松模様にバイアスをかけ、電荷を少しずつ変えておく）
+Grid2D<SEOArray> makeGrid(int n, GridLayout layout, int tileSize)
+{
+    Grid2D<SEOArray> grid(n, n, false, layout, tileSize);
+    for (int y = 0; y < n; ++y)
+    {
+        for (int x = 0; x < n; ++x)
+        {
+            grid.setUp(y, x, 1.0, 0.05, 10.0, 2.0, ((x + y) % 2) ? 0.009 : -0.009, 4);
+            grid.getElements().setQ(grid.index(y, x), 1e-4 * ((x * 7 + y * 3) % 11));
+            std::vector<std::pair<int, int>> conns;
+            if (y > 0)
+                conns.push_back({y - 1, x});
+            if (x > 0)
+                conns.push_back({y, x - 1});
+            if (y < n - 1)
+                conns.push_back({y + 1, x});
+            if (x < n - 1)
+                conns.push_back({y, x + 1});
+            grid.setConnections(y, x, conns);
+        }
+    }
+    grid.getElements().buildConnections();
+    return grid;
+}
+
+// セットアソシアティブのキャッシュ（LRU）のモデル
+class CacheModel
+{
+private:
+    int ways;
+    std::vector<std::vector<std::uint64_t>> sets; // セットごとのライン（先頭ほど新しい）
+
+public:
+    CacheModel(int bytes, int wayCount, int lineBytes) : ways(wayCount), sets(bytes / lineBytes / wayCount) {}
+
+    // ラインを読む（ミスならtrue）
+    bool access(std::uint64_t line)
+    {
+        auto &set = sets[line % sets.size()];
+        auto it = std::find(set.begin(), set.end(), line);
+        bool miss = (it == set.end());
+        if (miss)
+        {
+            if (static_cast<int>(set.size()) == ways)
+                set.pop_back();
+            set.insert(set.begin(), line);
+        }
+        else
+        {
+            std::rotate(set.begin(), it, it + 1);
+        }
+        return miss;
+    }
+};
+
+// 1回のsweepで隣のVnを読むときのミスの数（配列の順に素子を計算し、接続の順に読む）
+long long gatherMisses(const Grid2D<SEOArray> &grid)
+{
+    const SEOArray &elements = grid.getElements();
+    CacheModel cache(32 * 1024, 8, 64);
+    long long misses = 0;
+    for (int i = 0; i < elements.size(); ++i)
+    {
+        for (int j : elements.getConnections(i))
+            misses += cache.access(static_cast<std::uint64_t>(j) * sizeof(double) / 64);
+    }
+    return misses;
+}
+
+std::string perSweep(long long count, int sweeps)
+{
+    if (count < 0)
+        return "n/a";
+    return std::to_string(count / sweeps);
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    std::vector<int> sizes;
+    for (int a = 1; a < argc; ++a)
+        sizes.push_back(std::atoi(argv[a]));
+    if (sizes.empty())
+        sizes = {1024, 2048, 4096};
+
+    const int tileSize = 32;
+    const std::pair<GridLayout, const char *> layouts[] = {
+        {GridLayout::RowMajor, "row-major"}, {GridLayout::Tiled, "tiled(32)"}, {GridLayout::Morton, "morton"}};
+
+    std::printf("%6s  %-10s  %10s  %15s  %15s  %15s  %s\n", "N", "layout", "ms/sweep", "L1D miss/sweep", "LLC miss/sweep",
+                "model miss/sweep", "Vn check");
+    for (int n : sizes)
+    {
+        // 合わせて約2億素子分のsweepになるように繰り返す
+        int sweeps = std::max(4, static_cast<int>(200LL * 1024 * 1024 / (static_cast<long long>(n) * n)));
+        for (const auto &[layout, name] : layouts)
+        {
+            auto grid = makeGrid(n, layout, tileSize);
+            grid.updateGridSurVn();
+            grid.updateGridVn();
+
+            Counter l1(Miss::L1DataRead), llc(Miss::LastLevel);
+            l1.start();
+            llc.start();
+            auto begin = std::chrono::steady_clock::now();
+            for (int s = 0; s < sweeps; ++s)
+            {
+                grid.updateGridSurVn();
+                grid.updateGridVn();
+            }
+            auto end = std::chrono::steady_clock::now();
+            long long l1miss = l1.stop(), llcmiss = llc.stop();
+
+            double ms = std::chrono::duration<double, std::milli>(end - begin).count() / sweeps;
+            // 並べ方によらず同じ値になることの確認用
+            std::printf("%6d  %-10s  %10.3f  %15s  %15s  %15lld  %.12e\n", n, name, ms, perSweep(l1miss, sweeps).c_str(),
+                        perSweep(llcmiss, sweeps).c_str(), gatherMisses(grid), grid.getVn(n / 2, n / 3));
+        }
+    }
+    return 0;
+}
@@ -2,9 +2,66 @@
 #define BASE_ELEMENT_HPP
 
 #include <string>
+#include <atomic>
 #include <map>
 #include <memory>
 #include <vector>
+#include <utility>
+#include <type_traits>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+
+// トンネルの方向
+enum class TunnelDirection : unsigned char
+{
+    None, // トンネルしない
+    Up,   // 電荷が-eされる方向
+    Down  // 電荷が+eされる方向
+};
+
+// トンネルの方向の名前（ログ出力用。"up", "down", "none"）
+inline const char *tunnelDirectionName(TunnelDirection direction)
+{
+    switch (direction)
+    {
+    case TunnelDirection::Up:
+        return "up";
+    case TunnelDirection::Down:
+        return "down";
+    default:
+        return "none";
+    }
+}
+
+// up・down方向それぞれの値（dEやwtを毎ステップmapを作らずに値渡しするための固定サイズの組）
+struct UpDown
+{
+    double up = 0.0;
+    double down = 0.0;
+};
+static_assert(std::is_trivially_copyable<UpDown>::value, "UpDown must be trivially copyable");
+
+// 電荷の更新方法
+enum class ChargeIntegrator : unsigned char
+{
+    Euler,      // Q += (Vd - Vn) * dt / R（従来の方法）
+    Exponential // V_sumをdtの間一定とみなし、Qが平衡値に指数関数的に近づく式で厳密に更新する
+};
+
+// 平衡値まであとdriveだけ残っている量が時定数tauで指数関数的に近づくとき、gapだけ進むまでの時間
+// （gapが0以下なら0、平衡値に着くまでにgapだけ進まなければ無限大）
+inline double exponentialCrossingTime(double gap, double drive, double tau)
+{
+    if (gap <= 0)
+        return 0.0;
+    if (drive <= gap)
+        return std::numeric_limits<double>::infinity();
+    return -tau * std::log1p(-gap / drive);
+}
+
+class CheckpointWriter;
+class CheckpointReader;
 
 //---------------------------------------------------------------------------------------------------
 // BaseElementではメソッドのインターフェースのみを実装しており、実際の処理内容は持たない
@@ -20,7 +77,14 @@ public:
     virtual double getVn() const = 0;
     virtual double getVd() const = 0;
     virtual double getSurroundingVsum() const = 0;
-    virtual std::map<std::string, double> getWT() const = 0;
+    virtual UpDown getWT() const = 0;
+    // トンネルレート（待ち時間の期待値の逆数）とその方向を取得（dEが正でなければレート0）
+    virtual std::pair<TunnelDirection, double> getTunnelRate() const = 0;
+    // 接続されている素子（V_sumに足し込まれる素子）を取得
+    virtual const std::vector<std::shared_ptr<BaseElement>> &getConnections() const = 0;
+    // 何も起きない素子か（接続が無く、バイアス・電荷・電圧が全て0）
+    // この状態の素子はVn・dE・wt・Qの計算をしても値が変わらず、トンネルもしないので、gridは計算を省略する
+    virtual bool isInert() const = 0;
     // oneway用の中要素を取り出すメソッド（seoやmultiseoで呼び出すとエラーが発生する）
     virtual std::shared_ptr<BaseElement> getInternalElement(int index) const = 0;
 
@@ -28,14 +92,46 @@ public:
     virtual void setVias(const double Vd) = 0;
     virtual void setVsum(double V) = 0;
     virtual void setConnections(const std::vector<std::shared_ptr<BaseElement>>& conns) = 0;
+    // 待ち時間に使う乱数列を設定（seed: 実行ごとのシード, stream: counter_rng.hppのrngStreamで作った番号）
+    virtual void setRandomStream(std::uint64_t seed, std::uint64_t stream) = 0;
 
     // --- 計算処理 ---
     virtual void setSurroundingVoltages() = 0;
     virtual void setPcalc() = 0;
     virtual void setdEcalc() = 0;
     virtual bool calculateTunnelWt() = 0;
-    virtual void setTunnel(const std::string& direction) = 0;
+    virtual void setTunnel(TunnelDirection direction) = 0;
     virtual void setNodeCharge(double dt) = 0;
+    // 電荷の更新（ChargeIntegrator::Exponential。V_sumをdtの間一定とみなして厳密に積分する）
+    virtual void setNodeChargeExp(double dt) = 0;
+    // 同じくV_sumを一定として電荷が変化したとき、dEが正になる（トンネルできるようになる）までの時間
+    // （既に正なら0、ずっと正にならなければ無限大）
+    virtual double timeToThreshold() const = 0;
+
+    // --- チェックポイント ---
+    // 時間とともに変わる状態（電荷・電圧・Vd・乱数のカウンタなど）を書き出す・読み込む
+    // パラメータ（R, Cj, legsなど）と接続は含まないので、読み込む側で同じ回路を作ってから呼ぶ
+    virtual void saveState(CheckpointWriter &out) const = 0;
+    virtual void loadState(CheckpointReader &in) = 0;
+
+    // --- 何も起きない素子の書き換え ---
+    // 何も起きない素子（isInert）がsetVias・setVsum・setConnections・setQ・setVnで書き換えられて動き出した回数（全素子で共通）
+    // gridは計算する素子の一覧を作ったときの値と比べ、変わっていれば一覧を作り直す
+    static std::uint64_t activationCount()
+    {
+        return activations.load(std::memory_order_relaxed);
+    }
+
+protected:
+    // 書き換えの前に何も起きない素子だったなら、書き換えの後に呼んで動き出したかを記録する
+    static void noteActivation(bool wasInert, bool inert)
+    {
+        if (wasInert && !inert)
+            activations.fetch_add(1, std::memory_order_relaxed);
+    }
+
+private:
+    inline static std::atomic<std::uint64_t> activations{0};
 };
 
 #endif // BASE_ELEMENT_HPP
@@ -0,0 +1,13 @@
+#ifndef BATCH_LOG_HPP
+#define BATCH_LOG_HPP
+
+//---------------------------------------------------------------------------------------------------
+// 対数をまとめて計算する関数（SEOArrayのトンネル待ち時間 wt = (e^2 Rj / dE) * (-log U) の -log U に使う）
+// logはfdlibmと同じ多項式で計算する（std::logとの差は1〜2ULP程度）
+// AVX2版とスカラー版は同じ順番・同じ式で計算するので、命令セットによらず同じ値になる
+//---------------------------------------------------------------------------------------------------
+
+// x[0]〜x[n-1]（正の正規化数）の自然対数をまとめて計算
+void batchLog(int n, const double *x, double *out);
+
+#endif // BATCH_LOG_HPP
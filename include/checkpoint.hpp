@@ -0,0 +1,110 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <type_traits>
+
+//---------------------------------------------------------------------------------------------------
+// チェックポイント（シミュレーションの途中状態）のバイナリ入出力
+// 値はメモリ上の表現をそのまま書き出す（doubleもビット単位で保存されるので、読み込んだ後の計算は中断前と同じになる）
+// 同じ種類のマシン・同じビルドで書き込み・読み込みすることを前提にしている
+//---------------------------------------------------------------------------------------------------
+// ファイルの先頭と末尾に書く識別子と、形式の版（保存する内容を変えたら版を上げる）
+inline constexpr char checkpointMagic[8] = {'S', 'E', 'O', 'C', 'K', 'P', 'T', '\0'};
+inline constexpr std::uint32_t checkpointVersion = 3;
+
+class CheckpointWriter
+{
+private:
+    std::ostream &os;
+
+public:
+    explicit CheckpointWriter(std::ostream &out) : os(out) {}
+
+    // コピーしてよい型（数値・UpDown・enumなど）を1つ書き出す
+    template <typename T>
+    void write(const T &value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "CheckpointWriter::write needs a trivially copyable type");
+        os.write(reinterpret_cast<const char *>(&value), sizeof(T));
+        if (!os)
+            throw std::runtime_error("checkpoint: write failed");
+    }
+
+    // 要素数と中身を書き出す
+    template <typename T>
+    void writeVector(const std::vector<T> &values)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "CheckpointWriter::writeVector needs a trivially copyable type");
+        write<std::uint64_t>(values.size());
+        if (!values.empty())
+            os.write(reinterpret_cast<const char *>(values.data()), sizeof(T) * values.size());
+        if (!os)
+            throw std::runtime_error("checkpoint: write failed");
+    }
+
+    void writeString(const std::string &s)
+    {
+        writeVector(std::vector<char>(s.begin(), s.end()));
+    }
+};
+
+class CheckpointReader
+{
+private:
+    std::istream &is;
+
+public:
+    explicit CheckpointReader(std::istream &in) : is(in) {}
+
+    template <typename T>
+    T read()
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "CheckpointReader::read needs a trivially copyable type");
+        T value;
+        is.read(reinterpret_cast<char *>(&value), sizeof(T));
+        if (!is)
+            throw std::runtime_error("checkpoint: unexpected end of file");
+        return value;
+    }
+
+    template <typename T>
+    void read(T &value)
+    {
+        value = read<T>();
+    }
+
+    template <typename T>
+    std::vector<T> readVector()
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "CheckpointReader::readVector needs a trivially copyable type");
+        std::uint64_t n = read<std::uint64_t>();
+        std::vector<T> values(n);
+        if (n > 0)
+            is.read(reinterpret_cast<char *>(values.data()), sizeof(T) * n);
+        if (!is)
+            throw std::runtime_error("checkpoint: unexpected end of file");
+        return values;
+    }
+
+    std::string readString()
+    {
+        std::vector<char> chars = readVector<char>();
+        return std::string(chars.begin(), chars.end());
+    }
+
+    // 保存時と違う値（gridのサイズなど）なら例外
+    template <typename T>
+    void expect(const T &actual, const char *what)
+    {
+        if (read<T>() != actual)
+            throw std::runtime_error(std::string("checkpoint: ") + what + " does not match the current simulation");
+    }
+};
+
+#endif // CHECKPOINT_HPP
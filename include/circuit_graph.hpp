@@ -0,0 +1,78 @@
+#ifndef CIRCUIT_GRAPH_HPP
+#define CIRCUIT_GRAPH_HPP
+
+#include <vector>
+#include <memory>
+#include <utility>
+#include <functional>
+#include <stdexcept>
+#include "base_element.hpp"
+
+//---------------------------------------------------------------------------------------------------
+// 素子と接続（無向の辺）をCSR形式で持つ回路のグラフ
+// 正方格子以外の回路（六角格子・三角格子・任意の辺のリスト）を、手で隣を探すループを書かずに組み立てる
+// 作ると各素子にsetConnectionsで接続を設定するので、Simulation2D::addGraphでそのままシミュレーションできる
+// gridと違い外周に何もつながっていない素子（パディング）を置く必要は無い
+// 素子iの接続先は neighbor[offset[i]] 〜 neighbor[offset[i + 1] - 1]（setConnectionsに渡す順）
+//---------------------------------------------------------------------------------------------------
+class CircuitGraph
+{
+public:
+    // 素子を作る関数（ノード番号と接続の数を受け取る。接続の数はSEOのlegsなどに使う）
+    using ElementFactory = std::function<std::shared_ptr<BaseElement>(int id, int degree)>;
+
+private:
+    std::vector<std::shared_ptr<BaseElement>> elements; // ノードiの素子
+    std::vector<int> offset, neighbor;                  // 接続（CSR形式）
+
+    // ノードごとの接続先のリストからCSRを作り、素子に接続を設定する
+    void build(const std::vector<std::vector<int>> &adjacency);
+
+    // 辺のリストからノードごとの接続先のリストを作る（辺の順に並べる。範囲外・自己ループ・重複は例外）
+    static std::vector<std::vector<int>> adjacencyOf(int n, const std::vector<std::pair<int, int>> &edges);
+
+    // ノードごとの接続先のリストから素子を作ってグラフにする
+    static CircuitGraph fromAdjacency(const std::vector<std::vector<int>> &adjacency, const ElementFactory &make);
+
+public:
+    CircuitGraph() = default;
+
+    //-----------作り方------------//
+    // 素子と辺のリストから作る（辺(a, b)はaからbとbからaの接続になり、各素子の接続は辺の順に並ぶ）
+    static CircuitGraph fromEdgeList(const std::vector<std::shared_ptr<BaseElement>> &elements,
+                                     const std::vector<std::pair<int, int>> &edges);
+
+    // ノード数と辺のリストから作る（素子はmakeで作る）
+    static CircuitGraph fromEdgeList(int n, const std::vector<std::pair<int, int>> &edges, const ElementFactory &make);
+
+    // rows×colsの正方格子（ノード(row, col)の番号は row * cols + col。接続は上・左・下・右の順）
+    static CircuitGraph squareLattice(int rows, int cols, const ElementFactory &make);
+
+    // rows×colsの三角格子（正方格子に右下がりの対角線を加えたもの。接続は左上・上・左・右・下・右下の順で、内側のノードは6本）
+    static CircuitGraph triangularLattice(int rows, int cols, const ElementFactory &make);
+
+    // rows×colsの六角格子（ハニカム。レンガ積みの形で、左右は常につなぎ、(row + col)が偶数なら下、奇数なら上とつなぐ）
+    // 接続は上・左・右・下の順で、内側のノードは3本
+    static CircuitGraph hexagonalLattice(int rows, int cols, const ElementFactory &make);
+
+    //-----------ゲッター------------//
+    // ノード数
+    int numNodes() const { return static_cast<int>(elements.size()); }
+
+    // 辺の数（無向の辺を1本と数える）
+    int numEdges() const { return static_cast<int>(neighbor.size()) / 2; }
+
+    // ノードidの素子
+    const std::shared_ptr<BaseElement> &getElement(int id) const;
+
+    // 全ての素子（ノードの順）
+    const std::vector<std::shared_ptr<BaseElement>> &getElements() const { return elements; }
+
+    // ノードidの接続の数
+    int degree(int id) const;
+
+    // ノードidの接続先（[first, second)）
+    std::pair<const int *, const int *> neighbors(int id) const;
+};
+
+#endif // CIRCUIT_GRAPH_HPP
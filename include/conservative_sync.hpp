@@ -0,0 +1,280 @@
+#ifndef CONSERVATIVE_SYNC_HPP
+#define CONSERVATIVE_SYNC_HPP
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include "base_element.hpp"
+#include "oneway_unit.hpp"
+#include "thread_pool.hpp"
+#include "grid_2dim.hpp"
+#include "execution_plan.hpp"
+
+//---------------------------------------------------------------------------------------------------
+// 保守的な並列離散イベント同期（Simulation2D::setConservativeSyncで使う）
+// gridをグループに分け、グループごとに自分の時計を持って、他のグループと足並みをそろえずにステップを進める
+//  ・グループ内のステップは従来と同じ（Jacobiの実行プランでVn・dE → グループ内の最小wt → トンネル → 電荷）
+//  ・他のグループの素子への接続（OnewayUnitの境界など）は、相手がステップの始めに書き込んだ時刻つきのVnの履歴から、
+//    lookaheadだけ前の時刻の値を読む（グループ間の結合はlookaheadだけ遅れて伝わる）
+//    履歴はステップの始めにしか書き込まないので、読む値は最大 lookahead + dt だけ古い（Simulation2D::setConservativeSyncの精度を参照）
+//  ・グループは「値を読む相手の時計 + lookahead」より前の時刻でしかステップを始めないので、読む値は必ず確定している
+//    （ロールバックは起きない。進められるだけ進めたらラウンドを区切って履歴を交換し、これを繰り返す）
+// 各グループの計算は自分の素子と確定した履歴だけで決まるので、結果はスレッド数やラウンドの区切り方によらない
+// どのgridにも属さない素子への接続は、誰も書き換えないので今の値を読む
+//---------------------------------------------------------------------------------------------------
+template <typename Element>
+class ConservativeSync
+{
+private:
+    // 時刻つきのVn（時刻tの値は、t以前で最後に書き込まれた値）
+    struct Sample
+    {
+        double time;
+        double vn;
+    };
+    // 他のグループから読まれる素子の値の履歴
+    struct Source
+    {
+        const BaseElement *elem;   // 値を書き込む素子
+        int owner;                 // 素子が属するグループ
+        std::vector<int> readers;  // 値を読むグループ
+        std::deque<Sample> history; // 時刻の昇順
+    };
+    // 1つのグループのトンネル（ラウンドの終わりに時刻の順に知らせる）
+    struct Tunnel
+    {
+        double time;
+        int gridIndex;
+        int elementIndex;
+        TunnelDirection direction;
+    };
+    // 自分の時計で進むグループ
+    struct Process
+    {
+        std::vector<int> gridIndices;              // 属するgrid
+        std::unique_ptr<ExecutionPlan<Element>> plan;
+        double clock = 0.0;                        // このグループの時刻
+        std::vector<int> externalSource;           // planのgridの外の接続先k番目の履歴（-1ならどのgridにも属さない素子）
+        std::vector<double> externalVn;            // planに渡す接続先のVn
+        std::vector<int> published;                // このグループが値を書き込む履歴
+        std::vector<int> inputs;                   // 値を読む相手のグループ
+        std::vector<std::pair<int, Sample>> outbox; // このラウンドに書き込んだ値（ラウンドの終わりに履歴へ移す）
+        std::vector<Tunnel> tunnels;               // このラウンドのトンネル
+    };
+
+    std::vector<Grid2D<Element>> &grids;
+    std::vector<Process> processes;
+    std::vector<Source> sources;
+    double lookahead;
+    ThreadPool serial{1}; // グループ内の計算は直列（グループどうしを並列に進める）
+
+    // 履歴の時刻timeの値
+    static double valueAt(const Source &source, double time)
+    {
+        auto after = std::upper_bound(source.history.begin(), source.history.end(), time,
+                                      [](double t, const Sample &s) { return t < s.time; });
+        return std::prev(after)->vn;
+    }
+
+    // グループをhorizonより前の時刻から始まるステップだけ進める（ステップはtargetで打ち切る）
+    void advanceProcess(Process &p, double horizon, double target, double dt, ChargeIntegrator integrator)
+    {
+        while (p.clock < horizon)
+        {
+            // 他のグループの素子は、lookaheadだけ前の時刻の値を使う
+            const auto &external = p.plan->getExternal();
+            for (size_t k = 0; k < external.size(); ++k)
+            {
+                int s = p.externalSource[k];
+                p.externalVn[k] = (s < 0) ? external[k]->getVn() : valueAt(sources[s], p.clock - lookahead);
+            }
+            p.plan->execute(serial, &p.externalVn);
+            for (int s : p.published)
+                p.outbox.push_back({s, {p.clock, sources[s].elem->getVn()}});
+
+            // グループ内の最小wt（targetを越えるトンネルは起こさず、targetで止まる。待ち時間は次のステップで引き直す）
+            double remaining = target - p.clock;
+            double steptime = std::min(dt, remaining);
+            int best = -1;
+            for (int g : p.gridIndices)
+            {
+                if (grids[g].gridminwt(dt) && grids[g].getMinWT() < steptime)
+                {
+                    steptime = grids[g].getMinWT();
+                    best = g;
+                }
+            }
+            if (best >= 0)
+            {
+                grids[best].getTunnelTarget()->setTunnel(grids[best].getTunnelDirection());
+                p.tunnels.push_back({p.clock, best, grids[best].getTunnelIndex(), grids[best].getTunnelDirection()});
+            }
+            for (int g : p.gridIndices)
+                grids[g].updateGridQn(steptime, integrator);
+            p.clock = (best < 0 && steptime == remaining) ? target : p.clock + steptime;
+        }
+    }
+
+public:
+    // gridsをgroupOfGrid[g]番のグループに分ける（空ならgridごとに1つのグループ）
+    // グループごとにJacobiの実行プラン（sweeps回・許容値tol）を作り、全グループの時計をstartから始める
+    // lookaheadが正でない・グループの番号が0から詰まっていない・プランを作れない回路なら例外
+    ConservativeSync(std::vector<Grid2D<Element>> &gridsRef, const std::vector<int> &groupOfGrid, double look,
+                     int sweeps, double tol, double start)
+        : grids(gridsRef), lookahead(look)
+    {
+        if (!(look > 0))
+            throw std::invalid_argument("ConservativeSync: lookahead must be positive");
+        if (grids.empty())
+            throw std::invalid_argument("ConservativeSync: no grids to simulate");
+        int gridCount = static_cast<int>(grids.size());
+        std::vector<int> groupOf = groupOfGrid;
+        if (groupOf.empty())
+        {
+            for (int g = 0; g < gridCount; ++g)
+                groupOf.push_back(g);
+        }
+        if (static_cast<int>(groupOf.size()) != gridCount)
+            throw std::invalid_argument("ConservativeSync: one group index is needed per grid");
+        int groupCount = *std::max_element(groupOf.begin(), groupOf.end()) + 1;
+        processes.resize(groupCount);
+        for (int g = 0; g < gridCount; ++g)
+        {
+            if (groupOf[g] < 0)
+                throw std::invalid_argument("ConservativeSync: group indices must not be negative");
+            processes[groupOf[g]].gridIndices.push_back(g);
+        }
+
+        // 素子（OnewayUnitとその内部素子を含む）が属するグループ（2つのグループに置かれた素子は両方から書き換えられるので例外）
+        std::unordered_map<const BaseElement *, int> ownerOf;
+        auto own = [&](const BaseElement *elem, int group, int g, int y, int x)
+        {
+            auto added = ownerOf.emplace(elem, group);
+            if (!added.second && added.first->second != group)
+                throw std::invalid_argument("ConservativeSync: the element at grid " + std::to_string(g) + " (" + std::to_string(y) + ", " +
+                                            std::to_string(x) + ") also belongs to group " + std::to_string(added.first->second));
+        };
+        for (int i = 0; i < groupCount; ++i)
+        {
+            if (processes[i].gridIndices.empty())
+                throw std::invalid_argument("ConservativeSync: group " + std::to_string(i) + " has no grids");
+            for (int g : processes[i].gridIndices)
+            {
+                for (int y = 0; y < grids[g].numRows(); ++y)
+                {
+                    for (int x = 0; x < grids[g].numCols(); ++x)
+                    {
+                        std::shared_ptr<BaseElement> elem = grids[g].rowBegin(y)[x];
+                        if (!elem)
+                            continue;
+                        own(elem.get(), i, g, y, x);
+                        if (auto unit = std::dynamic_pointer_cast<OnewayUnit>(elem))
+                        {
+                            for (const auto &internal : unit->getInternalElements())
+                                own(internal.get(), i, g, y, x);
+                        }
+                    }
+                }
+            }
+        }
+
+        // グループごとのプランと、グループをまたぐ接続の履歴
+        std::unordered_map<const BaseElement *, int> sourceOf;
+        for (int i = 0; i < groupCount; ++i)
+        {
+            Process &p = processes[i];
+            std::vector<Grid2D<Element>> ownGrids;
+            for (int g : p.gridIndices)
+                ownGrids.push_back(grids[g]);
+            p.plan = std::make_unique<ExecutionPlan<Element>>(ownGrids, sweeps, tol);
+            p.clock = start;
+            for (const BaseElement *ext : p.plan->getExternal())
+            {
+                auto owner = ownerOf.find(ext);
+                if (owner == ownerOf.end())
+                {
+                    p.externalSource.push_back(-1);
+                    continue;
+                }
+                auto added = sourceOf.emplace(ext, static_cast<int>(sources.size()));
+                if (added.second)
+                {
+                    // 始めの値は今の値（時刻-∞から有効）
+                    sources.push_back({ext, owner->second, {}, {{-std::numeric_limits<double>::infinity(), ext->getVn()}}});
+                    processes[owner->second].published.push_back(added.first->second);
+                }
+                Source &source = sources[added.first->second];
+                if (std::find(source.readers.begin(), source.readers.end(), i) == source.readers.end())
+                    source.readers.push_back(i);
+                if (std::find(p.inputs.begin(), p.inputs.end(), source.owner) == p.inputs.end())
+                    p.inputs.push_back(source.owner);
+                p.externalSource.push_back(added.first->second);
+            }
+            p.externalVn.assign(p.externalSource.size(), 0.0);
+        }
+    }
+
+    // 全グループをtargetまで進める（トンネルはラウンドごとに時刻の順に onTunnel(時刻, grid, 素子のインデックス, 方向) で知らせる）
+    // ラウンドでは、各グループを値を読む相手の時計 + lookahead（とtarget）の手前まで並列に進め、書き込んだ値を履歴に移す
+    // 最も遅れたグループは必ずlookaheadかtargetまで進めるので、ラウンドは止まらない
+    template <typename F>
+    void advance(double target, double dt, ChargeIntegrator integrator, ThreadPool &pool, F &&onTunnel)
+    {
+        int n = static_cast<int>(processes.size());
+        std::vector<double> horizon(n);
+        std::vector<Tunnel> tunnels;
+        while (std::any_of(processes.begin(), processes.end(), [&](const Process &p) { return p.clock < target; }))
+        {
+            for (int i = 0; i < n; ++i)
+            {
+                horizon[i] = target;
+                for (int j : processes[i].inputs)
+                    horizon[i] = std::min(horizon[i], processes[j].clock + lookahead);
+            }
+            pool.parallelFor(n, [&](int i) { advanceProcess(processes[i], horizon[i], target, dt, integrator); });
+
+            // 書き込んだ値を履歴に移し、どのグループももう読まない古い値を捨てる（時刻の最も新しい1つは残す）
+            for (Process &p : processes)
+            {
+                for (const auto &[s, sample] : p.outbox)
+                    sources[s].history.push_back(sample);
+                p.outbox.clear();
+            }
+            for (Source &source : sources)
+            {
+                double oldest = std::numeric_limits<double>::infinity();
+                for (int r : source.readers)
+                    oldest = std::min(oldest, processes[r].clock - lookahead);
+                while (source.history.size() > 1 && source.history[1].time <= oldest)
+                    source.history.pop_front();
+            }
+
+            // トンネルを時刻の順に知らせる（同じ時刻ならグループの順）
+            tunnels.clear();
+            for (Process &p : processes)
+            {
+                tunnels.insert(tunnels.end(), p.tunnels.begin(), p.tunnels.end());
+                p.tunnels.clear();
+            }
+            std::stable_sort(tunnels.begin(), tunnels.end(), [](const Tunnel &a, const Tunnel &b) { return a.time < b.time; });
+            for (const Tunnel &tunnel : tunnels)
+                onTunnel(tunnel.time, tunnel.gridIndex, tunnel.elementIndex, tunnel.direction);
+        }
+    }
+
+    // グループの数
+    int numGroups() const { return static_cast<int>(processes.size()); }
+
+    // グループをまたいで値を読まれる素子の数
+    int numBoundarySources() const { return static_cast<int>(sources.size()); }
+
+    // グループiの時刻
+    double getClock(int i) const { return processes.at(i).clock; }
+};
+
+#endif // CONSERVATIVE_SYNC_HPP
@@ -0,0 +1,113 @@
+#ifndef COUNTER_RNG_HPP
+#define COUNTER_RNG_HPP
+
+#include <cstdint>
+#include <atomic>
+#include <random>
+
+//---------------------------------------------------------------------------------------------------
+// カウンタ方式の乱数（Philox4x32-10）
+// 乱数を (シード, 乱数列の番号, 何回目か) の関数として計算するので、生成器の状態を共有しない
+// 素子ごとに乱数列の番号を割り当てておけば、計算の順番やスレッドの分け方を変えても同じ乱数が出る
+//---------------------------------------------------------------------------------------------------
+
+// 乱数列の番号の用途（上位8bitに入れて、用途ごとに番号が重ならないようにする）
+enum class RngDomain : std::uint64_t
+{
+    Element = 0,    // 素子の待ち時間（番号は (grid全体での通し番号 << 2) + OnewayUnitの内部素子番号）
+    EventQueue = 1, // イベント駆動モードの待ち時間（番号はleavesのインデックス）
+    Network = 2,    // Calculate_NNのゆらぎ
+    Unassigned = 3, // シードを設定する前の既定の乱数列
+    RateTree = 4    // BKL法でイベントの時刻と場所を選ぶ乱数（番号は0のみ）
+};
+
+// 用途と番号から乱数列の番号を作る
+inline std::uint64_t rngStream(RngDomain domain, std::uint64_t id)
+{
+    return (static_cast<std::uint64_t>(domain) << 56) | (id & ((std::uint64_t(1) << 56) - 1));
+}
+
+// Philox4x32-10：128bitのカウンタ(stream, counter)と64bitの鍵(seed)から128bitの乱数を作る
+inline void philox4x32(std::uint64_t seed, std::uint64_t stream, std::uint64_t counter, std::uint64_t &out0, std::uint64_t &out1)
+{
+    std::uint32_t c0 = static_cast<std::uint32_t>(counter), c1 = static_cast<std::uint32_t>(counter >> 32);
+    std::uint32_t c2 = static_cast<std::uint32_t>(stream), c3 = static_cast<std::uint32_t>(stream >> 32);
+    std::uint32_t k0 = static_cast<std::uint32_t>(seed), k1 = static_cast<std::uint32_t>(seed >> 32);
+    for (int round = 0; round < 10; ++round)
+    {
+        std::uint64_t p0 = static_cast<std::uint64_t>(0xD2511F53u) * c0;
+        std::uint64_t p1 = static_cast<std::uint64_t>(0xCD9E8D57u) * c2;
+        std::uint32_t n0 = static_cast<std::uint32_t>(p1 >> 32) ^ c1 ^ k0;
+        std::uint32_t n2 = static_cast<std::uint32_t>(p0 >> 32) ^ c3 ^ k1;
+        c1 = static_cast<std::uint32_t>(p1);
+        c3 = static_cast<std::uint32_t>(p0);
+        c0 = n0;
+        c2 = n2;
+        k0 += 0x9E3779B9u;
+        k1 += 0xBB67AE85u;
+    }
+    out0 = (static_cast<std::uint64_t>(c1) << 32) | c0;
+    out1 = (static_cast<std::uint64_t>(c3) << 32) | c2;
+}
+
+// (0, 1]の一様乱数（上位53bitを使う）
+inline double counterUniform(std::uint64_t seed, std::uint64_t stream, std::uint64_t counter)
+{
+    std::uint64_t r0, r1;
+    philox4x32(seed, stream, counter, r0, r1);
+    return static_cast<double>((r0 >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+// シードを設定しないときの既定のシード（プロセスごとに1回だけrandom_deviceから作る）
+inline std::uint64_t defaultRandomSeed()
+{
+    static const std::uint64_t seed = []
+    {
+        std::random_device rd;
+        return (static_cast<std::uint64_t>(rd()) << 32) ^ rd();
+    }();
+    return seed;
+}
+
+// 既定の乱数列の番号をcount個分予約して先頭を返す（素子ごとに違う乱数列にするため）
+inline std::uint64_t reserveDefaultStreams(std::uint64_t count)
+{
+    static std::atomic<std::uint64_t> next{0};
+    return next.fetch_add(count);
+}
+
+// 1本の乱数列（シード・乱数列の番号・何回目かを持つだけなのでコピーしても他に影響しない）
+class CounterRNG
+{
+private:
+    std::uint64_t key;
+    std::uint64_t streamId;
+    std::uint64_t count = 0;
+
+public:
+    // 既定のシードと、他と重ならない乱数列の番号で初期化
+    CounterRNG() : key(defaultRandomSeed()), streamId(rngStream(RngDomain::Unassigned, reserveDefaultStreams(1) << 2)) {}
+    CounterRNG(std::uint64_t seed, std::uint64_t stream) : key(seed), streamId(stream) {}
+
+    // シードと乱数列の番号を設定し、最初から生成し直す
+    void setStream(std::uint64_t seed, std::uint64_t stream)
+    {
+        key = seed;
+        streamId = stream;
+        count = 0;
+    }
+
+    // (0, 1]の一様乱数
+    double uniform() { return counterUniform(key, streamId, count++); }
+
+    // [min, max]の一様乱数
+    double uniform(double min, double max) { return min + (max - min) * uniform(); }
+
+    std::uint64_t seed() const { return key; }
+    std::uint64_t stream() const { return streamId; }
+    // これまでに生成した個数（次に使うカウンタ）
+    std::uint64_t counter() const { return count; }
+    void setCounter(std::uint64_t c) { count = c; }
+};
+
+#endif // COUNTER_RNG_HPP
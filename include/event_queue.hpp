@@ -0,0 +1,252 @@
+#ifndef EVENT_QUEUE_HPP
+#define EVENT_QUEUE_HPP
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+
+//---------------------------------------------------------------------------------------------------
+// インデックス付きの二分ヒープ（最小値が先頭）
+// 0からn-1までのidごとにキー（次のイベント時刻）を1つだけ持ち、idを指定してキーの更新・削除ができる
+// イベント駆動のシミュレーションで「素子ごとの次のトンネル時刻」を管理するために使う
+//---------------------------------------------------------------------------------------------------
+class IndexedMinHeap
+{
+private:
+    std::vector<int> heap;     // ヒープ本体（idを格納）
+    std::vector<int> position; // idごとのヒープ上の位置（ヒープに無ければ-1）
+    std::vector<double> keys;  // idごとのキー
+
+    void swapNodes(int a, int b)
+    {
+        std::swap(heap[a], heap[b]);
+        position[heap[a]] = a;
+        position[heap[b]] = b;
+    }
+
+    void siftUp(int i)
+    {
+        while (i > 0)
+        {
+            int parent = (i - 1) / 2;
+            if (keys[heap[parent]] <= keys[heap[i]])
+                break;
+            swapNodes(i, parent);
+            i = parent;
+        }
+    }
+
+    void siftDown(int i)
+    {
+        int n = static_cast<int>(heap.size());
+        while (true)
+        {
+            int smallest = i;
+            int left = 2 * i + 1;
+            int right = left + 1;
+            if (left < n && keys[heap[left]] < keys[heap[smallest]])
+                smallest = left;
+            if (right < n && keys[heap[right]] < keys[heap[smallest]])
+                smallest = right;
+            if (smallest == i)
+                break;
+            swapNodes(i, smallest);
+            i = smallest;
+        }
+    }
+
+public:
+    // コンストラクタ：idの数を指定
+    explicit IndexedMinHeap(int n = 0) { resize(n); }
+
+    // idの数を設定（中身は空になる）
+    void resize(int n)
+    {
+        heap.clear();
+        position.assign(n, -1);
+        keys.assign(n, 0.0);
+    }
+
+    // idがヒープに入っているか
+    bool contains(int id) const { return position.at(id) >= 0; }
+
+    // 空かどうか
+    bool empty() const { return heap.empty(); }
+
+    // 入っている要素数
+    int size() const { return static_cast<int>(heap.size()); }
+
+    // idのキーを取得
+    double key(int id) const { return keys.at(id); }
+
+    // 最小キーを持つid
+    int top() const
+    {
+        if (heap.empty())
+            throw std::runtime_error("IndexedMinHeap is empty");
+        return heap.front();
+    }
+
+    // 最小キー
+    double topKey() const { return keys[top()]; }
+
+    // idを追加、または既にあればキーを更新
+    void push(int id, double k)
+    {
+        if (contains(id))
+        {
+            update(id, k);
+            return;
+        }
+        keys[id] = k;
+        position[id] = static_cast<int>(heap.size());
+        heap.push_back(id);
+        siftUp(position[id]);
+    }
+
+    // idのキーを更新（増減どちらでもよい）
+    void update(int id, double k)
+    {
+        int i = position.at(id);
+        if (i < 0)
+            throw std::invalid_argument("IndexedMinHeap: id is not in the heap");
+        double old = keys[id];
+        keys[id] = k;
+        if (k < old)
+            siftUp(i);
+        else
+            siftDown(i);
+    }
+
+    // idをヒープから取り除く
+    void remove(int id)
+    {
+        int i = position.at(id);
+        if (i < 0)
+            return;
+        int last = static_cast<int>(heap.size()) - 1;
+        if (i != last)
+        {
+            swapNodes(i, last);
+        }
+        heap.pop_back();
+        position[id] = -1;
+        if (i != last)
+        {
+            siftUp(i);
+            siftDown(i);
+        }
+    }
+
+    // ヒープの並び（チェックポイントの保存用。同じキーの素子の順番まで保つため並びごと保存する）
+    const std::vector<int> &order() const { return heap; }
+    const std::vector<double> &keyValues() const { return keys; }
+
+    // 保存した並びとキーからヒープを復元
+    void restore(const std::vector<int> &heapOrder, const std::vector<double> &keyValues)
+    {
+        if (keyValues.size() != keys.size())
+            throw std::invalid_argument("IndexedMinHeap: key count does not match");
+        clear();
+        keys = keyValues;
+        for (int i = 0; i < static_cast<int>(heapOrder.size()); ++i)
+        {
+            int id = heapOrder[i];
+            if (id < 0 || id >= static_cast<int>(position.size()) || position[id] >= 0)
+                throw std::invalid_argument("IndexedMinHeap: invalid heap order");
+            position[id] = i;
+        }
+        heap = heapOrder;
+    }
+
+    // 全て取り除く
+    void clear()
+    {
+        for (int id : heap)
+            position[id] = -1;
+        heap.clear();
+    }
+};
+
+//---------------------------------------------------------------------------------------------------
+// レートの和の木（完全二分木で、各節点に子の和を持つ）
+// 0からn-1までのidごとにレートを1つ持ち、合計と「累積和がxを超える最初のid」をO(log n)で求める
+// BKL法（rejection-free）で、全素子のレートの合計から次のイベントの時刻を、累積和から場所を選ぶために使う
+// 節点は更新のたびに子から計算し直すので、差分を足し込む場合と違って丸め誤差がたまらない
+//---------------------------------------------------------------------------------------------------
+class RateSumTree
+{
+private:
+    int count = 0;            // idの数
+    int capacity = 1;         // 葉の数（count以上の2のべき）
+    std::vector<double> sums; // sums[1]が根、sums[capacity + id]がidの葉
+
+public:
+    // コンストラクタ：idの数を指定
+    explicit RateSumTree(int n = 0) { resize(n); }
+
+    // idの数を設定（レートは全て0になる）
+    void resize(int n)
+    {
+        count = n;
+        capacity = 1;
+        while (capacity < n)
+            capacity *= 2;
+        sums.assign(2 * capacity, 0.0);
+    }
+
+    int size() const { return count; }
+
+    // idのレートを取得
+    double rate(int id) const
+    {
+        if (id < 0 || id >= count)
+            throw std::out_of_range("RateSumTree: id is out of range");
+        return sums[capacity + id];
+    }
+
+    // レートの合計
+    double total() const { return sums[1]; }
+
+    // idのレートを設定（根までの和を計算し直す）
+    void set(int id, double r)
+    {
+        if (id < 0 || id >= count)
+            throw std::out_of_range("RateSumTree: id is out of range");
+        if (!(r >= 0))
+            throw std::invalid_argument("RateSumTree: rate must not be negative");
+        int i = capacity + id;
+        sums[i] = r;
+        for (i /= 2; i >= 1; i /= 2)
+            sums[i] = sums[2 * i] + sums[2 * i + 1];
+    }
+
+    // 累積和がxを超える最初のid（xは[0, total())。レートが0のidは選ばない）
+    int find(double x) const
+    {
+        if (!(total() > 0))
+            throw std::runtime_error("RateSumTree: total rate is zero");
+        int i = 1;
+        while (i < capacity)
+        {
+            int left = 2 * i;
+            // 丸め誤差でxが右の和を超えても、レートが正の側に降りる
+            if (x < sums[left] || !(sums[left + 1] > 0))
+            {
+                i = left;
+            }
+            else
+            {
+                x -= sums[left];
+                i = left + 1;
+            }
+        }
+        return i - capacity;
+    }
+
+    // 全て0にする
+    void clear() { std::fill(sums.begin(), sums.end(), 0.0); }
+};
+
+#endif // EVENT_QUEUE_HPP
@@ -0,0 +1,315 @@
+#ifndef EXECUTION_PLAN_HPP
+#define EXECUTION_PLAN_HPP
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include "base_element.hpp"
+#include "seo_class.hpp"
+#include "multi_seo_class.hpp"
+#include "oneway_unit.hpp"
+#include "thread_pool.hpp"
+#include "grid_2dim.hpp"
+#include "circuit_graph.hpp"
+#include "potential_solver.hpp"
+
+//---------------------------------------------------------------------------------------------------
+// 実行プラン（Simulation2D::compileで一度だけ作り、毎ステップのVn・dEの計算をこの表の上で行う）
+// gridと接続を組み終えた後に、素子の展開・接続の検査・接続先のインデックス化をまとめて済ませておく
+//  ・素子はSEO・MultiSEOの具体的な型で持ち、仮想関数やgridの表を通さずに呼ぶ
+//  ・接続先はleavesのインデックス（CSR形式）で持ち、V_sumは各素子のVnを並べた配列から足し込む
+//    （gridの外の素子への接続は、配列の末尾にそのVnをステップの始めに読み込んでおく）
+//  ・計算の順番はJacobiSolver（gridごとにV_sum取得→Vn計算）と同じなので、結果はビット単位で一致する
+// 容量の組み合わせなどパラメータだけで決まる係数は、素子がパラメータを設定したときに計算して持っている
+// 作った後は変更しない。素子・接続を変えたら作り直す（バイアス電圧Vdは表に含まれないので、そのまま変えてよい）
+//---------------------------------------------------------------------------------------------------
+template <typename Element>
+class ExecutionPlan
+{
+private:
+    enum class Kind : unsigned char
+    {
+        SEO,
+        MultiSEO,
+        Other
+    };
+    // 計算の単位になる素子（OnewayUnitは内部の4素子に展開する）
+    struct Leaf
+    {
+        BaseElement *ptr; // 素子のポインタ
+        Kind kind;        // 素子の型
+        bool isolated;    // 接続が無い（何も起きない素子になりうるので毎ステップ確かめる）
+    };
+    std::vector<Leaf> leaves;
+    std::vector<int> gridBegin;         // gridのgの素子は leaves[gridBegin[g], gridBegin[g + 1])
+    std::vector<int> offset, neighbor;  // 接続先（CSR形式、setConnectionsで渡した順。gridの外の素子k番目は leaves.size() + k）
+    std::vector<const BaseElement *> external; // gridの外の接続先
+    int maxSweeps;                      // 最大sweep回数
+    double tolerance;                   // 許容値（0なら必ずmaxSweeps回行う）
+    std::vector<double> vn;             // 各素子とgridの外の接続先のVn（V_sumの足し込みに使う）
+    std::vector<char> skip;             // このステップで飛ばす素子（何も起きない素子）
+    std::vector<double> gridResidual;   // gridごとのVnの最大変化量
+
+    // 素子の型
+    static Kind kindOf(BaseElement *p)
+    {
+        if (dynamic_cast<SEO *>(p))
+            return Kind::SEO;
+        if (dynamic_cast<MultiSEO *>(p))
+            return Kind::MultiSEO;
+        return Kind::Other;
+    }
+
+    // 具体的な型の参照で f(素子) を呼ぶ
+    template <typename F>
+    static void visit(const Leaf &leaf, F &&f)
+    {
+        switch (leaf.kind)
+        {
+        case Kind::SEO:
+            f(static_cast<SEO &>(*leaf.ptr));
+            break;
+        case Kind::MultiSEO:
+            f(static_cast<MultiSEO &>(*leaf.ptr));
+            break;
+        default:
+            f(*leaf.ptr);
+            break;
+        }
+    }
+
+    // gridのgの素子のV_sumを取得
+    void gatherVsum(int g)
+    {
+        for (int i = gridBegin[g]; i < gridBegin[g + 1]; ++i)
+        {
+            if (skip[i])
+                continue;
+            double vsum = 0;
+            for (int k = offset[i]; k < offset[i + 1]; ++k)
+                vsum += vn[neighbor[k]];
+            visit(leaves[i], [vsum](auto &elem) { elem.setVsum(vsum); });
+        }
+    }
+
+    // gridのgの素子のVnを計算（Vnの最大変化量を返す）
+    double updateVn(int g)
+    {
+        double residual = 0.0;
+        for (int i = gridBegin[g]; i < gridBegin[g + 1]; ++i)
+        {
+            if (skip[i])
+                continue;
+            double previous = vn[i];
+            visit(leaves[i], [&](auto &elem)
+            {
+                elem.setPcalc();
+                vn[i] = elem.getVn();
+            });
+            residual = std::max(residual, std::abs(vn[i] - previous));
+        }
+        return residual;
+    }
+
+    // gridのgの素子のdEを計算
+    void updatedE(int g)
+    {
+        for (int i = gridBegin[g]; i < gridBegin[g + 1]; ++i)
+        {
+            if (!skip[i])
+                visit(leaves[i], [](auto &elem) { elem.setdEcalc(); });
+        }
+    }
+
+    // 素子の位置を表す文字列（例外のメッセージ用）
+    static std::string where(int g, int y, int x)
+    {
+        return "grid " + std::to_string(g) + " (" + std::to_string(y) + ", " + std::to_string(x) + ")";
+    }
+
+public:
+    // gridsの素子と接続から表を作る（JacobiSolverと同じsweep回数・許容値で計算する）
+    // 空のセル・内部素子の無いOnewayUnit・2か所に置かれた素子・nullptrの接続があれば例外
+    ExecutionPlan(std::vector<Grid2D<Element>> &grids, int sweeps, double tol)
+        : maxSweeps(sweeps), tolerance(tol)
+    {
+        if (sweeps <= 0)
+            throw std::invalid_argument("ExecutionPlan: sweeps must be positive");
+        if (grids.empty())
+            throw std::invalid_argument("ExecutionPlan: no grids to compile");
+
+        // 素子を展開する（OnewayUnitのポインタは代表の素子0（getVnが返す素子）に対応させる）
+        std::unordered_map<const BaseElement *, int> index;
+        std::vector<std::string> position;
+        gridBegin.assign(grids.size() + 1, 0);
+        for (int g = 0; g < static_cast<int>(grids.size()); ++g)
+        {
+            gridBegin[g] = static_cast<int>(leaves.size());
+            auto &grid = grids[g];
+            for (int y = 0; y < grid.numRows(); ++y)
+            {
+                for (int x = 0; x < grid.numCols(); ++x)
+                {
+                    std::shared_ptr<BaseElement> elem = grid.getElement(y, x);
+                    if (!elem)
+                        throw std::invalid_argument("ExecutionPlan: " + where(g, y, x) + " has no element");
+                    std::vector<BaseElement *> parts;
+                    if (auto unit = std::dynamic_pointer_cast<OnewayUnit>(elem))
+                    {
+                        for (const auto &internal : unit->getInternalElements())
+                        {
+                            if (!internal)
+                                throw std::invalid_argument("ExecutionPlan: OnewayUnit at " + where(g, y, x) + " has no internal elements");
+                            parts.push_back(internal.get());
+                        }
+                        index.emplace(unit.get(), static_cast<int>(leaves.size()));
+                    }
+                    else
+                    {
+                        parts.push_back(elem.get());
+                    }
+                    for (BaseElement *p : parts)
+                    {
+                        if (!index.emplace(p, static_cast<int>(leaves.size())).second)
+                            throw std::invalid_argument("ExecutionPlan: the element at " + where(g, y, x) + " is placed more than once");
+                        leaves.push_back({p, kindOf(p), p->getConnections().empty()});
+                        position.push_back(where(g, y, x));
+                    }
+                }
+            }
+        }
+        gridBegin[grids.size()] = static_cast<int>(leaves.size());
+
+        // 接続先をインデックスにする（gridの外の素子は末尾に番号を振る）
+        int n = static_cast<int>(leaves.size());
+        std::unordered_map<const BaseElement *, int> externalIndex;
+        offset.assign(n + 1, 0);
+        neighbor.clear();
+        external.clear();
+        for (int i = 0; i < n; ++i)
+        {
+            for (const auto &conn : leaves[i].ptr->getConnections())
+            {
+                if (!conn)
+                    throw std::invalid_argument("ExecutionPlan: the element at " + position[i] + " has a null connection");
+                auto found = index.find(conn.get());
+                if (found != index.end())
+                {
+                    neighbor.push_back(found->second);
+                    continue;
+                }
+                auto added = externalIndex.emplace(conn.get(), n + static_cast<int>(external.size()));
+                if (added.second)
+                    external.push_back(conn.get());
+                neighbor.push_back(added.first->second);
+            }
+            offset[i + 1] = static_cast<int>(neighbor.size());
+        }
+        vn.assign(n + external.size(), 0.0);
+        skip.assign(n, 0);
+        gridResidual.assign(grids.size(), 0.0);
+    }
+
+    // 回路のグラフから表を作る（素子の順はノードの順で、Simulation2D::addGraphで登録した1行のgridと同じ）
+    // 接続先はグラフのCSRをそのまま使うので、素子のポインタから番号を引く表を作らない
+    // OnewayUnitのノードと、グラフを作った後に接続を書き換えた素子（グラフのCSRと素子の接続が違う）があれば例外
+    ExecutionPlan(const CircuitGraph &graph, int sweeps, double tol)
+        : maxSweeps(sweeps), tolerance(tol)
+    {
+        if (sweeps <= 0)
+            throw std::invalid_argument("ExecutionPlan: sweeps must be positive");
+        int n = graph.numNodes();
+        if (n == 0)
+            throw std::invalid_argument("ExecutionPlan: the graph has no nodes");
+
+        offset.assign(n + 1, 0);
+        neighbor.clear();
+        for (int i = 0; i < n; ++i)
+        {
+            BaseElement *p = graph.getElement(i).get();
+            if (dynamic_cast<OnewayUnit *>(p))
+                throw std::invalid_argument("ExecutionPlan: graph node " + std::to_string(i) + " is a OnewayUnit");
+            const auto &conns = p->getConnections();
+            auto [first, last] = graph.neighbors(i);
+            bool same = static_cast<long>(conns.size()) == last - first;
+            for (size_t k = 0; same && k < conns.size(); ++k)
+                same = (conns[k].get() == graph.getElement(first[k]).get());
+            if (!same)
+                throw std::invalid_argument("ExecutionPlan: the connections of graph node " + std::to_string(i) + " differ from the graph");
+            neighbor.insert(neighbor.end(), first, last);
+            offset[i + 1] = static_cast<int>(neighbor.size());
+            leaves.push_back({p, kindOf(p), conns.empty()});
+        }
+        gridBegin = {0, n};
+        vn.assign(n, 0.0);
+        skip.assign(n, 0);
+        gridResidual.assign(1, 0.0);
+    }
+
+    // 1ステップ分のVn（sweepの繰り返し）とdEを計算する（反復回数と残差を返す）
+    // スレッドプールが2スレッド以上なら、JacobiSolverと同じく全gridのV_sumを取得してから全gridのVnを計算する
+    // externalVnを渡すと、gridの外の接続先k番目のVnとして素子の今の値の代わりに (*externalVn)[k] を使う
+    // （ConservativeSyncが、他のグループの素子の値を時刻をずらして渡すのに使う）
+    SolverStats execute(ThreadPool &pool, const std::vector<double> *externalVn = nullptr)
+    {
+        int n = static_cast<int>(leaves.size());
+        int gridCount = static_cast<int>(gridBegin.size()) - 1;
+        for (int i = 0; i < n; ++i)
+        {
+            visit(leaves[i], [&](auto &elem)
+            {
+                vn[i] = elem.getVn();
+                skip[i] = leaves[i].isolated && elem.isInert();
+            });
+        }
+        if (externalVn && externalVn->size() != external.size())
+            throw std::invalid_argument("ExecutionPlan: externalVn must have one value per external connection");
+        for (size_t k = 0; k < external.size(); ++k)
+            vn[n + k] = externalVn ? (*externalVn)[k] : external[k]->getVn();
+
+        SolverStats stats;
+        for (int s = 0; s < maxSweeps; ++s)
+        {
+            stats.residual = 0.0;
+            if (pool.size() > 1)
+            {
+                pool.parallelFor(gridCount, [&](int g) { gatherVsum(g); });
+                pool.parallelFor(gridCount, [&](int g) { gridResidual[g] = updateVn(g); });
+            }
+            else
+            {
+                for (int g = 0; g < gridCount; ++g)
+                {
+                    gatherVsum(g);
+                    gridResidual[g] = updateVn(g);
+                }
+            }
+            for (double r : gridResidual)
+                stats.residual = std::max(stats.residual, r);
+            stats.iterations = s + 1;
+            if (stats.residual < tolerance)
+                break;
+        }
+
+        pool.parallelFor(gridCount, [&](int g) { updatedE(g); });
+        return stats;
+    }
+
+    // 計算の単位になる素子の数
+    int numLeaves() const { return static_cast<int>(leaves.size()); }
+
+    // 接続の数（全素子の接続先の数の合計）
+    int numConnections() const { return static_cast<int>(neighbor.size()); }
+
+    // gridの外の接続先の数
+    int numExternal() const { return static_cast<int>(external.size()); }
+
+    // gridの外の接続先（executeに渡すexternalVnの順）
+    const std::vector<const BaseElement *> &getExternal() const { return external; }
+};
+
+#endif // EXECUTION_PLAN_HPP
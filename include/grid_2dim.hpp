@@ -7,27 +7,120 @@
 #include <algorithm>
 #include <string>
 #include <fstream>
+#include <type_traits>
+#include <limits>
+#include <unordered_map>
 #include "base_element.hpp"
+#include "oneway_unit.hpp"
+#include "thread_pool.hpp"
+#include "counter_rng.hpp"
+#include "checkpoint.hpp"
+
+// 待ち時間がdt未満の素子（同時トンネルの候補）
+struct TunnelCandidate
+{
+    double wt;                 // トンネル待ち時間
+    int index;                 // grid内のフラットなインデックス(row * cols + col)
+    TunnelDirection direction; // トンネルの方向
+    BaseElement *target;       // 実際にトンネルする素子（OnewayUnitの内部素子など）
+};
 
 // 2次元グリッドで任意の素子（Element）を管理するテンプレートクラス
 template <typename Element>  // Grid2dはElementに依存するクラスなので、template型で定義
 class Grid2D
 {
 private:
-    // 2次元gridの定義
-    std::vector<std::vector<std::shared_ptr<Element>>> grid;
     // 縦横のサイズ
     int rows_, cols_;
+    // 層を積み重ねたgrid（Grid3D）の1層の行数（層zは行 z * layerRows_ 〜。積み重ねていなければrows_）
+    int layerRows_;
+    // gridの素子（1本の配列に行優先で並べる。素子(row, col)は cells[row * cols + col]）
+    std::vector<std::shared_ptr<Element>> cells;
+    // 素子のポインタから置かれたセルのフラットなインデックスの一覧へ（setElementで記録する。順序は問わない）
+    // 同じ素子を何か所に置いても、置き換えは一覧の中を探すだけで済む
+    std::unordered_map<const Element *, std::vector<int>> cellOf;
     // 出力時のファイル名(デフォルトは空)
     std::string outputlabel = "";
     // 電子トンネルをする場所
     std::shared_ptr<Element> tunnelplace;
+    // 電子トンネルをする場所のフラットなインデックス(row * cols + col)
+    int tunnelindex = -1;
     // 電子トンネルの向き
-    std::string tunneldirection;
+    TunnelDirection tunneldirection = TunnelDirection::None;
     // gridにおける最小の待ち時間
     double minwt;
     // 出力するかのbool値(デフォルトがtrueで出力する)
     bool outputEnabled;
+
+    // 素子の型（BaseElementのgridでは表から型を引き、仮想関数を通さずに具体的な型の関数を呼ぶ）
+    enum class ElementKind : unsigned char
+    {
+        SEO,
+        MultiSEO,
+        Other
+    };
+    // 計算の単位になる素子（OnewayUnitは内部の4素子に展開し、普通の素子と同じように並べる）
+    struct Slot
+    {
+        BaseElement *ptr;     // 素子のポインタ
+        ElementKind kind;     // 素子の型
+        signed char part;     // OnewayUnitの何番目の内部素子か（OnewayUnitでなければ-1）
+        unsigned char parity; // 色（parityOf。積み重ねていなければ (x + y) % 2）
+        int cell;             // 属するセルのフラットなインデックス(row * cols + col)
+    };
+    std::vector<Slot> slots;         // 計算の単位になる素子（行優先）
+    std::vector<int> rowSlotBegin;   // 行iの素子は slots[rowSlotBegin[i], rowSlotBegin[i + 1])
+    bool dispatchValid = false;      // 表が今の素子と一致しているか
+    // 計算する素子（何も起きない素子を除いたslotsのインデックス。行iの分は activeSlots[rowActiveBegin[i], rowActiveBegin[i + 1])）
+    std::vector<int> activeSlots;
+    std::vector<int> rowActiveBegin;
+    bool activeValid = false;        // 計算する素子の一覧が今の状態と一致しているか（refreshActiveSetで作り直させる）
+    std::uint64_t activeActivations = 0; // 一覧を作ったときのBaseElement::activationCount（変わっていれば飛ばした素子が動き出している）
+    BaseElement *tunneltarget = nullptr; // 実際にトンネルする素子（OnewayUnitなら内部素子）
+
+    // gridminwtで最小wtを探すときの途中経過
+    struct MinWT
+    {
+        double wt;
+        int index = -1;
+        int part = -1;
+        TunnelDirection direction = TunnelDirection::None;
+        int claimedCell = -1; // 既に候補の内部素子が決まったOnewayUnitのセル
+    };
+
+    // 表と計算する素子の一覧を必要なら作り直す
+    void ensureDispatch();
+
+    // 具体的な型の参照で f(素子, Slot) を呼ぶ
+    template <typename F>
+    void visitSlot(const Slot &s, F &&f);
+
+    // 素子(row, col)の色（(x + y + z) % 2。y = row % layerRows_、z = row / layerRows_。積み重ねていなければz = 0なので (x + y) % 2）
+    unsigned char parityOf(int row, int col) const
+    {
+        return static_cast<unsigned char>((row % layerRows_ + row / layerRows_ + col) % 2);
+    }
+
+    // [rowBegin, rowEnd)の行の素子について f(素子, Slot) を呼ぶ（parityが0か1なら色がparityの素子だけ）
+    // BaseElementのgridではOnewayUnitの代わりに内部素子0〜3について呼び、具体的な型の参照を渡す
+    // 何も起きない素子（BaseElement::isInert）は飛ばす
+    template <typename F>
+    void forEachElement(int rowBegin, int rowEnd, int parity, F &&f);
+
+    // 何も起きない素子も含めて全ての素子について f(素子, Slot) を呼ぶ（乱数列の設定やチェックポイント用）
+    template <typename F>
+    void forAllElements(F &&f);
+
+    // 素子のwtを計算し、dt未満でそれまでの最小より小さければ記録する
+    template <typename E>
+    void checkMinWT(E &elem, const Slot &slot, MinWT &best);
+
+    // 最小wtの素子をトンネルする場所として記録する
+    void setTunnelPlace(const MinWT &best);
+
+    // 行を帯（連続した行のまとまり）に分けて f(先頭行, 終わりの行, 帯の番号) をスレッドプールで並列に実行
+    template <typename F>
+    void forEachRowBand(ThreadPool &pool, F f);
 public:
     // コンストラクタ：指定した行数・列数でグリッドを初期化
     Grid2D(int rows, int cols, bool enableOutput = true); // ← outputするかどうかのbool。デフォルトをtrueにする
@@ -38,6 +131,14 @@ public:
     // 指定位置の要素を設定
     void setElement(int row, int col, const std::shared_ptr<Element> &element);
 
+    // 行rowの素子の先頭（範囲は確かめない。rowBegin(row)[col]が素子(row, col)）
+    // 毎ステップの出力やバイアス電圧の設定など、範囲が分かっているループで使う
+    const std::shared_ptr<Element> *rowBegin(int row) const { return cells.data() + static_cast<std::size_t>(row) * cols_; }
+
+    // 1層の行数を設定する（Grid3Dが層を縦に並べたgridとして使うときに呼ぶ。rowsを割り切れなければ例外）
+    // 赤黒順序の色が (x + y + z) % 2 になり、上下の層でつながった素子どうしも色が違うようになる
+    void setLayerRows(int layerRows);
+
     // グリッド全体の接続されている電圧を更新
     void updateGridSurVn();
 
@@ -50,11 +151,45 @@ public:
     // グリッド全体のトンネル待ち時間wtを計算し、最小wtとトンネル素子を更新
     bool gridminwt(const double dt);
 
-    // グリッド全体のノード電荷Qnを更新
-    void updateGridQn(const double dt);
+    // グリッド全体のトンネル待ち時間wtを計算し、dt未満の素子を全てoutに追加する（行優先。OnewayUnitはユニットごとに1つ）
+    // 乱数の引き方はgridminwtと同じなので、どちらを呼んでもその後の乱数列は変わらない
+    void gridTunnelCandidates(const double dt, std::vector<TunnelCandidate> &out);
+
+    // グリッド全体のノード電荷Qnを更新（integratorで更新の式を選ぶ）
+    void updateGridQn(const double dt, ChargeIntegrator integrator = ChargeIntegrator::Euler);
+
+    // V_sumを一定として電荷が変化したとき、grid内のどれかの素子のdEが正になるまでの時間（ChargeIntegrator::Exponentialの式による）
+    double timeToThreshold();
+
+    // 以下はgrid内を行の帯に分けて並列に計算する版
+    // parityが0か1のときは色（(x + y) % 2、積み重ねたgridなら (x + y + z) % 2）がparityの素子だけを計算する（赤黒順序。-1なら全素子）
+    void updateGridSurVn(ThreadPool &pool, int parity = -1);
+    void updateGridVn(ThreadPool &pool, int parity = -1);
+    void updateGriddE(ThreadPool &pool);
+    // 帯ごとの最小wtを帯の順に比較するので、結果は直列版と同じ（同じwtなら行優先で先の素子）
+    bool gridminwt(const double dt, ThreadPool &pool);
+    void updateGridQn(const double dt, ThreadPool &pool, ChargeIntegrator integrator = ChargeIntegrator::Euler);
+
+    // 赤黒順序の色が同じ素子どうしが接続されていないか確かめる（あれば例外）
+    // 同じ色の素子は色ごとの計算で互いのVnを読まない前提なので、RedBlackSolverが最初の計算の前に呼ぶ
+    // OnewayUnitの内部素子どうしは同じセルの中の接続なので数えない。他のgridの素子への接続も数えない
+    void checkRedBlackColoring() const;
+
+    // 素子ごとの乱数列を設定（素子(row, col)の通し番号は firstIndex + row * cols + col）
+    void setRandomStreams(std::uint64_t seed, std::uint64_t firstIndex);
+
+    // 次の計算の前に、計算する素子の一覧を作り直させる
+    // 何も起きない素子は自分では変化しないので、一覧はsetElement・loadStateのときと、
+    // 飛ばしている素子がsetVias・setVsum・setConnections・setQで動き出したとき（BaseElement::activationCount）に作り直す
+    // 素子をそれ以外の方法で書き換えたときだけ呼べばよい
+    void refreshActiveSet();
 
-    // グリッド（全体の2次元vector）を取得
-    std::vector<std::vector<std::shared_ptr<Element>>> &getGrid();
+    // 計算している素子の数（OnewayUnitは内部素子を1つずつ数える）
+    int numActiveElements();
+
+    // 全素子の状態をチェックポイントに書き出す・読み込む（行数・列数が保存時と違えば例外）
+    void saveState(CheckpointWriter &out);
+    void loadState(CheckpointReader &in);
 
     // 行数を取得
     int numRows() const;
@@ -65,8 +200,14 @@ public:
     // トンネルが発生する素子を取得
     std::shared_ptr<Element> getTunnelPlace() const;
 
-    // トンネルの方向（"up" or "down"）を取得
-    std::string getTunnelDirection() const;
+    // 実際にトンネルする素子を取得（OnewayUnitなら選ばれた内部素子、それ以外はgetTunnelPlaceと同じ素子）
+    BaseElement *getTunnelTarget() const;
+
+    // トンネルが発生する素子のフラットなインデックス(row * cols + col)を取得
+    int getTunnelIndex() const;
+
+    // トンネルの方向（UpまたはDown）を取得
+    TunnelDirection getTunnelDirection() const;
 
     // 最小トンネル待ち時間wtを取得
     double getMinWT() const;
@@ -86,71 +227,297 @@ public:
     // OutputEnabledの取得
     bool isOutputEnabled() const;
 
-    // ポインタから場所の座標を取得する
+    // ポインタから場所の座標(y, x)を取得する（setElementで記録した位置を引くので、置いた箇所の数に比例する時間で済む。2か所以上なら行優先で先の位置。gridに無ければ例外）
     std::pair<int, int> getPositionOf(const std::shared_ptr<Element>& ptr) const;
 };
 
 // コンストラクタ：全要素をmake_sharedで初期化
 template <typename Element>
 Grid2D<Element>::Grid2D(int rows, int cols, bool enableOutput)
-    : rows_(rows), cols_(cols), grid(rows, std::vector<std::shared_ptr<Element>>(cols)),
-      outputEnabled(enableOutput)
+    : rows_(rows), cols_(cols), layerRows_(rows), outputEnabled(enableOutput)
 {
     if (rows <= 0 || cols <= 0)
     {
         throw std::invalid_argument("Grid size must be positive");
     }
+    cells.resize(static_cast<std::size_t>(rows) * cols);
 }
 
 // 指定位置の要素を取得
 template <typename Element>
 std::shared_ptr<Element> Grid2D<Element>::getElement(int row, int col) const
 {
-    return grid.at(row).at(col);
+    if (row < 0 || row >= rows_ || col < 0 || col >= cols_)
+        throw std::out_of_range("Grid2D::getElement: position out of range");
+    return cells[row * cols_ + col];
 }
 
 // 指定位置の要素を設定
 template <typename Element>
 void Grid2D<Element>::setElement(int row, int col, const std::shared_ptr<Element> &element)
 {
-    grid.at(row).at(col) = element;
+    if (row < 0 || row >= rows_ || col < 0 || col >= cols_)
+        throw std::out_of_range("Grid2D::setElement: position out of range");
+    int index = row * cols_ + col;
+    const Element *old = cells[index].get();
+    cells[index] = element;
+    dispatchValid = false;
+
+    // 置き換えた素子の一覧からこのセルを消す（他のセルに置かれていなければ素子ごと消す）
+    if (old)
+    {
+        auto found = cellOf.find(old);
+        if (found != cellOf.end())
+        {
+            std::vector<int> &at = found->second;
+            auto k = std::find(at.begin(), at.end(), index);
+            if (k != at.end())
+            {
+                *k = at.back();
+                at.pop_back();
+            }
+            if (at.empty())
+                cellOf.erase(found);
+        }
+    }
+    if (element)
+        cellOf[element.get()].push_back(index);
 }
 
-// グリッド全体の接続されている電圧を更新
+// 1層の行数を設定
 template <typename Element>
-void Grid2D<Element>::updateGridSurVn()
+void Grid2D<Element>::setLayerRows(int layerRows)
 {
-    for (auto &row : grid)
+    if (layerRows <= 0 || rows_ % layerRows != 0)
+        throw std::invalid_argument("Grid2D::setLayerRows: layer rows must divide the number of rows");
+    layerRows_ = layerRows;
+    dispatchValid = false;
+}
+
+// 素子の表を作る（BaseElementのgridのみ。setElementで素子が変わったときは作り直す）
+// OnewayUnitは内部の4素子をそれぞれSEO・MultiSEOとして登録するので、毎ステップの計算では普通の素子と同じ扱いになる
+// （OnewayUnitの内部素子をsetInternalElementsで差し替えたときは、setElementで置き直して表を作り直させる）
+template <typename Element>
+void Grid2D<Element>::ensureDispatch()
+{
+    if constexpr (std::is_same<Element, BaseElement>::value)
     {
-        for (auto &elem : row)
+        if (!dispatchValid)
         {
-            elem->setSurroundingVoltages();
+            auto kindOf = [](BaseElement *p)
+            {
+                if (dynamic_cast<SEO *>(p))
+                    return ElementKind::SEO;
+                if (dynamic_cast<MultiSEO *>(p))
+                    return ElementKind::MultiSEO;
+                return ElementKind::Other;
+            };
+            slots.clear();
+            rowSlotBegin.assign(rows_ + 1, 0);
+            for (int i = 0; i < rows_; ++i)
+            {
+                rowSlotBegin[i] = static_cast<int>(slots.size());
+                for (int j = 0; j < cols_; ++j)
+                {
+                    BaseElement *p = cells[i * cols_ + j].get();
+                    unsigned char parity = parityOf(i, j);
+                    int cell = i * cols_ + j;
+                    if (auto *unit = dynamic_cast<OnewayUnit *>(p))
+                    {
+                        for (int k = 0; k < 4; ++k)
+                        {
+                            BaseElement *internal = unit->getInternalElements()[k].get();
+                            if (!internal)
+                                throw std::runtime_error("OnewayUnit has no internal elements");
+                            slots.push_back({internal, kindOf(internal), static_cast<signed char>(k), parity, cell});
+                        }
+                    }
+                    else
+                    {
+                        slots.push_back({p, kindOf(p), -1, parity, cell});
+                    }
+                }
+            }
+            rowSlotBegin[rows_] = static_cast<int>(slots.size());
+            dispatchValid = true;
+            activeValid = false;
         }
+        std::uint64_t activations = BaseElement::activationCount();
+        if (activeValid && activations == activeActivations)
+            return;
+        // 何も起きない素子を除いて計算する素子の一覧を作る
+        activeSlots.clear();
+        rowActiveBegin.assign(rows_ + 1, 0);
+        for (int i = 0; i < rows_; ++i)
+        {
+            rowActiveBegin[i] = static_cast<int>(activeSlots.size());
+            for (int k = rowSlotBegin[i]; k < rowSlotBegin[i + 1]; ++k)
+            {
+                bool inert = false;
+                visitSlot(slots[k], [&](auto &elem, const Slot &) { inert = elem.isInert(); });
+                if (!inert)
+                    activeSlots.push_back(k);
+            }
+        }
+        rowActiveBegin[rows_] = static_cast<int>(activeSlots.size());
+        activeValid = true;
+        activeActivations = activations;
     }
 }
 
-// グリッド全体のノード電圧Vnを計算・更新
+// 具体的な型の参照で f(素子, Slot) を呼ぶ
 template <typename Element>
-void Grid2D<Element>::updateGridVn()
+template <typename F>
+void Grid2D<Element>::visitSlot(const Slot &s, F &&f)
 {
-    for (auto &row : grid)
+    switch (s.kind)
+    {
+    case ElementKind::SEO:
+        f(static_cast<SEO &>(*s.ptr), s);
+        break;
+    case ElementKind::MultiSEO:
+        f(static_cast<MultiSEO &>(*s.ptr), s);
+        break;
+    default:
+        f(*s.ptr, s);
+        break;
+    }
+}
+
+// [rowBegin, rowEnd)の行の素子について f(素子, Slot) を呼ぶ
+template <typename Element>
+template <typename F>
+void Grid2D<Element>::forEachElement(int rowBegin, int rowEnd, int parity, F &&f)
+{
+    if constexpr (std::is_same<Element, BaseElement>::value)
+    {
+        for (int a = rowActiveBegin[rowBegin]; a < rowActiveBegin[rowEnd]; ++a)
+        {
+            const Slot &s = slots[activeSlots[a]];
+            if (parity >= 0 && s.parity != parity)
+                continue;
+            visitSlot(s, f);
+        }
+    }
+    else
     {
-        for (auto &elem : row)
+        for (int i = rowBegin; i < rowEnd; ++i)
         {
-            elem->setPcalc();
+            int j0 = (parity < 0) ? 0 : (i % layerRows_ + i / layerRows_ + parity) % 2;
+            int step = (parity < 0) ? 1 : 2;
+            for (int j = j0; j < cols_; j += step)
+            {
+                Element &elem = *cells[i * cols_ + j];
+                f(elem, Slot{&elem, ElementKind::Other, -1, parityOf(i, j), i * cols_ + j});
+            }
         }
     }
 }
 
+// 何も起きない素子も含めて全ての素子について f(素子, Slot) を呼ぶ
+template <typename Element>
+template <typename F>
+void Grid2D<Element>::forAllElements(F &&f)
+{
+    ensureDispatch();
+    if constexpr (std::is_same<Element, BaseElement>::value)
+    {
+        for (const Slot &s : slots)
+            visitSlot(s, f);
+    }
+    else
+    {
+        forEachElement(0, rows_, -1, f);
+    }
+}
+
+// 行を帯に分けて並列に実行（帯の数はスレッド数、ただし行数以下）
+template <typename Element>
+template <typename F>
+void Grid2D<Element>::forEachRowBand(ThreadPool &pool, F f)
+{
+    ensureDispatch();
+    int bands = std::min(pool.size(), rows_);
+    pool.parallelFor(bands, [&](int b)
+    {
+        int begin = rows_ * b / bands;
+        int end = rows_ * (b + 1) / bands;
+        f(begin, end, b);
+    });
+}
+
+// グリッド全体の接続されている電圧を更新
+template <typename Element>
+void Grid2D<Element>::updateGridSurVn()
+{
+    ensureDispatch();
+    forEachElement(0, rows_, -1, [](auto &elem, const Slot &) { elem.setSurroundingVoltages(); });
+}
+
+// グリッド全体のノード電圧Vnを計算・更新
+template <typename Element>
+void Grid2D<Element>::updateGridVn()
+{
+    ensureDispatch();
+    forEachElement(0, rows_, -1, [](auto &elem, const Slot &) { elem.setPcalc(); });
+}
+
 // グリッド全体のエネルギー変化dEを計算・更新
 template <typename Element>
 void Grid2D<Element>::updateGriddE()
 {
-    for (auto &row : grid)
+    ensureDispatch();
+    forEachElement(0, rows_, -1, [](auto &elem, const Slot &) { elem.setdEcalc(); });
+}
+
+// 素子のwtを計算し、dt未満でそれまでの最小より小さければ記録する
+template <typename Element>
+template <typename E>
+void Grid2D<Element>::checkMinWT(E &elem, const Slot &slot, MinWT &best)
+{
+    if (elem.calculateTunnelWt())
+    {
+        // OnewayUnitの内部素子は、そのユニットで最初にトンネルできる素子だけを候補にする
+        // （OnewayUnit::calculateTunnelWtが選ぶ素子と同じ。残りの内部素子も乱数は引いておく）
+        if (slot.part >= 0)
+        {
+            if (best.claimedCell == slot.cell)
+                return;
+            best.claimedCell = slot.cell;
+        }
+        // up方向かdown方向で値を持っている方をtmpwtに代入
+        const UpDown w = elem.getWT();
+        double tmpwt = std::max(w.up, w.down);
+        // tmpwtがminwtよりも値が小さい時にminwtを更新
+        if (tmpwt < best.wt)
+        {
+            best.direction = (tmpwt == w.up) ? TunnelDirection::Up : TunnelDirection::Down;
+            best.index = slot.cell;
+            best.part = slot.part;
+            best.wt = tmpwt;
+        }
+    }
+}
+
+// 最小wtの素子をトンネルする場所として記録する（見つからなければminwtだけを更新）
+// OnewayUnitなら選んだ内部素子をユニットにも伝えるので、getTunnelPlace()->setTunnelでも同じ素子がトンネルする
+template <typename Element>
+void Grid2D<Element>::setTunnelPlace(const MinWT &best)
+{
+    minwt = best.wt;
+    tunnelindex = best.index;
+    if (best.index < 0)
+        return;
+    tunneldirection = best.direction;
+    tunnelplace = cells[best.index];
+    tunneltarget = tunnelplace.get();
+    if constexpr (std::is_same<Element, BaseElement>::value)
     {
-        for (auto &elem : row)
+        if (best.part >= 0)
         {
-            elem->setdEcalc();
+            auto &unit = static_cast<OnewayUnit &>(*tunnelplace);
+            unit.setTunnelTarget(best.part, best.direction);
+            tunneltarget = unit.getInternalElements()[best.part].get();
         }
     }
 }
@@ -159,45 +526,203 @@ void Grid2D<Element>::updateGriddE()
 template <typename Element>
 bool Grid2D<Element>::gridminwt(const double dt)
 {
-    minwt = dt;
-    for (auto &row : grid)
+    ensureDispatch();
+    MinWT best{dt};
+    forEachElement(0, rows_, -1, [&](auto &elem, const Slot &slot) { checkMinWT(elem, slot, best); });
+    setTunnelPlace(best);
+    return minwt < dt;
+}
+
+// グリッド全体のトンネル待ち時間wtを計算し、dt未満の素子を全て集める
+template <typename Element>
+void Grid2D<Element>::gridTunnelCandidates(const double dt, std::vector<TunnelCandidate> &out)
+{
+    ensureDispatch();
+    int claimedCell = -1;
+    forEachElement(0, rows_, -1, [&](auto &elem, const Slot &slot)
     {
-        for (auto &elem : row)
+        if (!elem.calculateTunnelWt())
+            return;
+        // OnewayUnitの内部素子は、そのユニットで最初にトンネルできる素子だけを候補にする（checkMinWTと同じ）
+        if (slot.part >= 0)
         {
-            if (elem->calculateTunnelWt())
-            {
-                // up方向かdown方向で値を持っている方をtmpwtに代入
-                double tmpwt = std::max(elem->getWT()["up"], elem->getWT()["down"]);
-                // tmpwtがminwtよりも値が小さい時にminwtを更新
-                if(tmpwt < minwt){
-                    tunneldirection = (tmpwt == elem->getWT()["up"]) ? "up" : "down";
-                    tunnelplace = elem;
-                    minwt = std::min(minwt, tmpwt);
-                }
-            }
+            if (claimedCell == slot.cell)
+                return;
+            claimedCell = slot.cell;
         }
+        const UpDown w = elem.getWT();
+        double tmpwt = std::max(w.up, w.down);
+        if (tmpwt < dt)
+            out.push_back({tmpwt, slot.cell, (tmpwt == w.up) ? TunnelDirection::Up : TunnelDirection::Down, slot.ptr});
+    });
+}
+
+// グリッド全体のノード電荷Qnを計算・更新
+template <typename Element>
+void Grid2D<Element>::updateGridQn(const double dt, ChargeIntegrator integrator)
+{
+    ensureDispatch();
+    if (integrator == ChargeIntegrator::Exponential)
+        forEachElement(0, rows_, -1, [dt](auto &elem, const Slot &) { elem.setNodeChargeExp(dt); });
+    else
+        forEachElement(0, rows_, -1, [dt](auto &elem, const Slot &) { elem.setNodeCharge(dt); });
+}
+
+// grid内のどれかの素子のdEが正になるまでの時間（何も起きない素子はずっと正にならないので除く）
+template <typename Element>
+double Grid2D<Element>::timeToThreshold()
+{
+    ensureDispatch();
+    double earliest = std::numeric_limits<double>::infinity();
+    forEachElement(0, rows_, -1, [&](auto &elem, const Slot &) { earliest = std::min(earliest, elem.timeToThreshold()); });
+    return earliest;
+}
+
+// グリッド全体の接続されている電圧を更新（行の帯ごとに並列）
+template <typename Element>
+void Grid2D<Element>::updateGridSurVn(ThreadPool &pool, int parity)
+{
+    forEachRowBand(pool, [&](int begin, int end, int)
+    {
+        forEachElement(begin, end, parity, [](auto &elem, const Slot &) { elem.setSurroundingVoltages(); });
+    });
+}
+
+// グリッド全体のノード電圧Vnを計算・更新（行の帯ごとに並列）
+template <typename Element>
+void Grid2D<Element>::updateGridVn(ThreadPool &pool, int parity)
+{
+    forEachRowBand(pool, [&](int begin, int end, int)
+    {
+        forEachElement(begin, end, parity, [](auto &elem, const Slot &) { elem.setPcalc(); });
+    });
+}
+
+// グリッド全体のエネルギー変化dEを計算・更新（行の帯ごとに並列）
+template <typename Element>
+void Grid2D<Element>::updateGriddE(ThreadPool &pool)
+{
+    forEachRowBand(pool, [&](int begin, int end, int)
+    {
+        forEachElement(begin, end, -1, [](auto &elem, const Slot &) { elem.setdEcalc(); });
+    });
+}
+
+// グリッド全体のトンネル待ち時間wtを計算し、最小wtとトンネル素子・方向を記録（行の帯ごとに並列）
+template <typename Element>
+bool Grid2D<Element>::gridminwt(const double dt, ThreadPool &pool)
+{
+    int bands = std::min(pool.size(), rows_);
+    std::vector<MinWT> bandbest(bands, MinWT{dt});
+    forEachRowBand(pool, [&](int begin, int end, int b)
+    {
+        forEachElement(begin, end, -1, [&](auto &elem, const Slot &slot) { checkMinWT(elem, slot, bandbest[b]); });
+    });
+    MinWT best{dt};
+    for (int b = 0; b < bands; ++b)
+    {
+        if (bandbest[b].index >= 0 && bandbest[b].wt < best.wt)
+            best = bandbest[b];
     }
+    setTunnelPlace(best);
     return minwt < dt;
 }
 
-// グリッド全体のノード電荷Qnを計算・更新
+// グリッド全体のノード電荷Qnを計算・更新（行の帯ごとに並列）
+template <typename Element>
+void Grid2D<Element>::updateGridQn(const double dt, ThreadPool &pool, ChargeIntegrator integrator)
+{
+    forEachRowBand(pool, [&](int begin, int end, int)
+    {
+        if (integrator == ChargeIntegrator::Exponential)
+            forEachElement(begin, end, -1, [dt](auto &elem, const Slot &) { elem.setNodeChargeExp(dt); });
+        else
+            forEachElement(begin, end, -1, [dt](auto &elem, const Slot &) { elem.setNodeCharge(dt); });
+    });
+}
+
+// 素子ごとの乱数列を設定（OnewayUnitの内部素子のために番号を2bit左にずらす）
 template <typename Element>
-void Grid2D<Element>::updateGridQn(const double dt)
+void Grid2D<Element>::setRandomStreams(std::uint64_t seed, std::uint64_t firstIndex)
 {
-    for (auto &row : grid)
+    forAllElements([&](auto &elem, const Slot &slot)
     {
-        for (auto &elem : row)
+        std::uint64_t id = ((firstIndex + slot.cell) << 2) + std::max<int>(slot.part, 0);
+        elem.setRandomStream(seed, rngStream(RngDomain::Element, id));
+    });
+}
+
+// 次の計算の前に、計算する素子の一覧を作り直させる
+template <typename Element>
+void Grid2D<Element>::refreshActiveSet()
+{
+    activeValid = false;
+}
+
+// 赤黒順序の色が同じ素子どうしが接続されていないか確かめる
+template <typename Element>
+void Grid2D<Element>::checkRedBlackColoring() const
+{
+    // 素子（OnewayUnitは内部素子も）→セルの番号
+    std::unordered_map<const BaseElement *, int> cellOf;
+    for (int cell = 0; cell < rows_ * cols_; ++cell)
+    {
+        const BaseElement *p = cells[cell].get();
+        if (!p)
+            continue;
+        cellOf.emplace(p, cell);
+        if constexpr (std::is_same<Element, BaseElement>::value)
         {
-            elem->setNodeCharge(dt);
+            if (auto *unit = dynamic_cast<const OnewayUnit *>(p))
+                for (const auto &internal : unit->getInternalElements())
+                    cellOf.emplace(internal.get(), cell);
         }
     }
+    for (const auto &[elem, cell] : cellOf)
+    {
+        for (const auto &conn : elem->getConnections())
+        {
+            auto found = cellOf.find(conn.get());
+            if (found == cellOf.end() || found->second == cell)
+                continue;
+            int y1 = cell / cols_, x1 = cell % cols_, y2 = found->second / cols_, x2 = found->second % cols_;
+            if (parityOf(y1, x1) == parityOf(y2, x2))
+                throw std::logic_error("Red-black ordering: elements (" + std::to_string(y1) + ", " + std::to_string(x1) + ") and (" +
+                                       std::to_string(y2) + ", " + std::to_string(x2) + ") are connected but have the same colour");
+        }
+    }
+}
+
+// 計算している素子の数
+template <typename Element>
+int Grid2D<Element>::numActiveElements()
+{
+    ensureDispatch();
+    if constexpr (std::is_same<Element, BaseElement>::value)
+        return static_cast<int>(activeSlots.size());
+    else
+        return rows_ * cols_;
+}
+
+// 全素子の状態を行優先の順に書き出す
+template <typename Element>
+void Grid2D<Element>::saveState(CheckpointWriter &out)
+{
+    ensureDispatch();
+    out.write<std::int32_t>(rows_);
+    out.write<std::int32_t>(cols_);
+    forAllElements([&](auto &elem, const Slot &) { elem.saveState(out); });
 }
 
-// グリッド全体のデータを取得
+// 全素子の状態を読み込む
 template <typename Element>
-std::vector<std::vector<std::shared_ptr<Element>>> &Grid2D<Element>::getGrid()
+void Grid2D<Element>::loadState(CheckpointReader &in)
 {
-    return grid;
+    ensureDispatch();
+    in.expect<std::int32_t>(rows_, "grid rows");
+    in.expect<std::int32_t>(cols_, "grid cols");
+    forAllElements([&](auto &elem, const Slot &) { elem.loadState(in); });
+    activeValid = false;
 }
 
 // グリッドの行数を取得
@@ -221,9 +746,23 @@ std::shared_ptr<Element> Grid2D<Element>::getTunnelPlace() const
     return tunnelplace;
 }
 
-// トンネルの方向を取得（"up" または "down"）
+// 最小wtでトンネルが発生する素子のフラットなインデックスを取得
 template <typename Element>
-std::string Grid2D<Element>::getTunnelDirection() const
+int Grid2D<Element>::getTunnelIndex() const
+{
+    return tunnelindex;
+}
+
+// 実際にトンネルする素子を取得
+template <typename Element>
+BaseElement *Grid2D<Element>::getTunnelTarget() const
+{
+    return tunneltarget;
+}
+
+// トンネルの方向を取得
+template <typename Element>
+TunnelDirection Grid2D<Element>::getTunnelDirection() const
 {
     return tunneldirection;
 }
@@ -274,14 +813,12 @@ bool Grid2D<Element>::isOutputEnabled() const
 // ポインタから場所の座標を取得する
 template <typename Element>
 std::pair<int, int> Grid2D<Element>::getPositionOf(const std::shared_ptr<Element>& ptr) const {
-    for (int i = 0; i < rows_; ++i) {
-        for (int j = 0; j < cols_; ++j) {
-            if (grid[i][j] == ptr) {
-                return {i, j}; // (y, x)
-            }
-        }
+    auto found = cellOf.find(ptr.get());
+    if (found == cellOf.end()) {
+        throw std::runtime_error("Element pointer not found in grid");
     }
-    throw std::runtime_error("Element pointer not found in grid");
+    int cell = *std::min_element(found->second.begin(), found->second.end()); // 2か所以上に置かれていれば行優先で先のセル
+    return {cell / cols_, cell % cols_}; // (y, x)
 }
 
 #endif // GRID_2DIM_HPP
@@ -0,0 +1,219 @@
+#ifndef GRID_3DIM_HPP
+#define GRID_3DIM_HPP
+
+#include <vector>
+#include <memory>
+#include <array>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include "base_element.hpp"
+#include "grid_2dim.hpp"
+
+//---------------------------------------------------------------------------------------------------
+// 3次元グリッド（層を積み重ねた素子の配列）で任意の素子（Element）を管理するテンプレートクラス
+// 素子は z（層）→ y（行）→ x（列）の順に1本の配列に並べる。素子(z, y, x)は z * rows * cols + y * cols + x 番目
+// これは layers * rows 行 × cols 列のGrid2Dの行優先の並びと同じなので、中身はそのGrid2Dとして持ち、
+// Simulation2D::addGrid3Dで1つのgridとして登録する（層ごとにgridを作るより、gridごとの処理が1回で済む）
+// 接続はconnectNeighborsでステンシル（隣の素子への(dz, dy, dx)の一覧）から設定する。デフォルトは6近傍
+//---------------------------------------------------------------------------------------------------
+template <typename Element>
+class Grid3D
+{
+private:
+    // 層数と1層の縦横のサイズ
+    int layers_, rows_, cols_;
+    // 層を縦に並べたgrid（層zの行yは行 z * rows + y）
+    Grid2D<Element> flat;
+    // connectNeighborsで設定した接続が全て色の違う素子どうしか（赤黒順序で計算できるか）
+    bool redBlackColourable = true;
+
+    // 層を縦に並べたgridの行数（サイズが正でなければ例外）
+    static int flatRows(int layers, int rows, int cols);
+
+public:
+    // 隣の素子へのずれ(dz, dy, dx)
+    using Offset = std::array<int, 3>;
+
+    // コンストラクタ：指定した層数・行数・列数でグリッドを初期化
+    Grid3D(int layers, int rows, int cols, bool enableOutput = true);
+
+    // 6近傍のステンシル（下の層・上・左・下・右・上の層の順。1層なら正方格子の上・左・下・右と同じ順になる）
+    static std::vector<Offset> sixNeighbors();
+
+    // 指定位置の要素を取得
+    std::shared_ptr<Element> getElement(int layer, int row, int col) const;
+
+    // 指定位置の要素を設定
+    void setElement(int layer, int row, int col, const std::shared_ptr<Element> &element);
+
+    // ステンシルの順に、範囲内にある隣の素子を各素子にsetConnectionsで設定する
+    // ステンシルは(0, 0, 0)を含まず、(dz, dy, dx)があれば(-dz, -dy, -dx)もある（接続が対称になる）ものに限る
+    // 素子を置いていないセルがあれば例外。SEOのlegsなどは接続の数に合わせて設定しておく
+    // 赤黒順序の色は (x + y + z) % 2 なので、dz + dy + dx が偶数のずれ（18近傍の斜めなど）で接続すると
+    // 同じ色の素子がつながり、赤黒順序では計算できない（isRedBlackColourableがfalseになる）
+    void connectNeighbors(const std::vector<Offset> &stencil = sixNeighbors());
+
+    // 赤黒順序で計算できるか（同じ色の素子をつないでいなければtrue）
+    // falseのgridは、赤黒順序（Simulation2D::setIntraGridParallel・RedBlackSolver）を使うと例外になるので、
+    // デフォルトのJacobiなど他のソルバーで計算する
+    bool isRedBlackColourable() const;
+
+    // 層を縦に並べたgrid（Simulation2Dへの登録や出力に使う）
+    const Grid2D<Element> &getFlatGrid() const;
+    Grid2D<Element> &getFlatGrid();
+
+    // 層数
+    int numLayers() const;
+
+    // 1層の行数
+    int numRows() const;
+
+    // 1層の列数
+    int numCols() const;
+
+    // 出力時のファイル名を設定
+    void setOutputLabel(const std::string &label);
+
+    // 素子の位置(z, y, x)（見つからなければ例外）
+    Offset getPositionOf(const std::shared_ptr<Element> &ptr) const;
+};
+
+// コンストラクタ：層を縦に並べたgridを作り、1層の行数を伝える（赤黒順序の色を (x + y + z) % 2 にする）
+template <typename Element>
+Grid3D<Element>::Grid3D(int layers, int rows, int cols, bool enableOutput)
+    : layers_(layers), rows_(rows), cols_(cols),
+      flat(flatRows(layers, rows, cols), cols, enableOutput)
+{
+    flat.setLayerRows(rows);
+}
+
+// 層を縦に並べたgridの行数
+template <typename Element>
+int Grid3D<Element>::flatRows(int layers, int rows, int cols)
+{
+    if (layers <= 0 || rows <= 0 || cols <= 0)
+        throw std::invalid_argument("Grid size must be positive");
+    return layers * rows;
+}
+
+// 6近傍のステンシル
+template <typename Element>
+std::vector<typename Grid3D<Element>::Offset> Grid3D<Element>::sixNeighbors()
+{
+    return {{-1, 0, 0}, {0, -1, 0}, {0, 0, -1}, {0, 1, 0}, {0, 0, 1}, {1, 0, 0}};
+}
+
+// 指定位置の要素を取得
+template <typename Element>
+std::shared_ptr<Element> Grid3D<Element>::getElement(int layer, int row, int col) const
+{
+    if (layer < 0 || layer >= layers_ || row < 0 || row >= rows_ || col < 0 || col >= cols_)
+        throw std::out_of_range("Grid3D::getElement: position out of range");
+    return flat.rowBegin(layer * rows_ + row)[col];
+}
+
+// 指定位置の要素を設定
+template <typename Element>
+void Grid3D<Element>::setElement(int layer, int row, int col, const std::shared_ptr<Element> &element)
+{
+    if (layer < 0 || layer >= layers_ || row < 0 || row >= rows_ || col < 0 || col >= cols_)
+        throw std::out_of_range("Grid3D::setElement: position out of range");
+    flat.setElement(layer * rows_ + row, col, element);
+}
+
+// ステンシルから接続を設定
+template <typename Element>
+void Grid3D<Element>::connectNeighbors(const std::vector<Offset> &stencil)
+{
+    for (const Offset &d : stencil)
+    {
+        if (d == Offset{0, 0, 0})
+            throw std::invalid_argument("Grid3D::connectNeighbors: stencil must not contain (0, 0, 0)");
+        if (std::find(stencil.begin(), stencil.end(), Offset{-d[0], -d[1], -d[2]}) == stencil.end())
+            throw std::invalid_argument("Grid3D::connectNeighbors: stencil must be symmetric");
+    }
+    redBlackColourable = true;
+    for (int z = 0; z < layers_; ++z)
+    {
+        for (int y = 0; y < rows_; ++y)
+        {
+            for (int x = 0; x < cols_; ++x)
+            {
+                const std::shared_ptr<Element> &elem = flat.rowBegin(z * rows_ + y)[x];
+                if (!elem)
+                    throw std::invalid_argument("Grid3D::connectNeighbors: (" + std::to_string(z) + ", " + std::to_string(y) + ", " +
+                                                std::to_string(x) + ") has no element");
+                std::vector<std::shared_ptr<BaseElement>> conns;
+                for (const Offset &d : stencil)
+                {
+                    int nz = z + d[0], ny = y + d[1], nx = x + d[2];
+                    if (nz < 0 || nz >= layers_ || ny < 0 || ny >= rows_ || nx < 0 || nx >= cols_)
+                        continue;
+                    conns.push_back(flat.rowBegin(nz * rows_ + ny)[nx]);
+                    if (((d[0] + d[1] + d[2]) & 1) == 0)
+                        redBlackColourable = false;
+                }
+                elem->setConnections(conns);
+            }
+        }
+    }
+}
+
+// 赤黒順序で計算できるか
+template <typename Element>
+bool Grid3D<Element>::isRedBlackColourable() const
+{
+    return redBlackColourable;
+}
+
+// 層を縦に並べたgrid
+template <typename Element>
+const Grid2D<Element> &Grid3D<Element>::getFlatGrid() const
+{
+    return flat;
+}
+
+template <typename Element>
+Grid2D<Element> &Grid3D<Element>::getFlatGrid()
+{
+    return flat;
+}
+
+// 層数
+template <typename Element>
+int Grid3D<Element>::numLayers() const
+{
+    return layers_;
+}
+
+// 1層の行数
+template <typename Element>
+int Grid3D<Element>::numRows() const
+{
+    return rows_;
+}
+
+// 1層の列数
+template <typename Element>
+int Grid3D<Element>::numCols() const
+{
+    return cols_;
+}
+
+// 出力時のファイル名を設定
+template <typename Element>
+void Grid3D<Element>::setOutputLabel(const std::string &label)
+{
+    flat.setOutputLabel(label);
+}
+
+// 素子の位置(z, y, x)
+template <typename Element>
+typename Grid3D<Element>::Offset Grid3D<Element>::getPositionOf(const std::shared_ptr<Element> &ptr) const
+{
+    auto [row, col] = flat.getPositionOf(ptr);
+    return {row / rows_, row % rows_, col};
+}
+
+#endif // GRID_3DIM_HPP
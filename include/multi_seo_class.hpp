@@ -10,9 +10,10 @@
 #include <random>
 #include <memory>
 #include "constants.hpp"
+#include "counter_rng.hpp"
 #include "base_element.hpp"
 
-class MultiSEO : public BaseElement {
+class MultiSEO final : public BaseElement {
 private:
     double Q;               // ノード電荷
     double Vn;              // ノード電圧
@@ -23,11 +24,21 @@ private:
     double C;               // 接続容量
     int legs;               // 足の数
     double V_sum;           // 周囲のノード電圧の総和
-    std::map<std::string, double> dE; // エネルギー変化量(up, down)
-    std::map<std::string, double> wt; // トンネル待時間(up, down)
+    UpDown dE;              // エネルギー変化量(up, down)
+    UpDown wt;              // トンネル待時間(up, down)
+    CounterRNG rng;         // 待ち時間に使う乱数列
     std::vector<std::shared_ptr<BaseElement>> connections; // 隣接する素子
     int multi_num;          // ジャンクションの数（多重の数）
     int tunnel_num;         // トンネルした回数
+    // パラメータだけで決まる係数（パラメータを設定したときに計算しておき、毎ステップの計算で使い回す）
+    double ctotal;          // 全容量 legs * multi_num * C + Cj
+    double ceff;            // Qに対する実効容量 ctotal / multi_num
+    double cCj;             // C * Cj
+    double twoCCj;          // 2 * C * Cj
+    double tunnelScale;     // トンネルレートの分母 e * e * Rj
+
+    // パラメータだけで決まる係数を計算し直す
+    void updateCoefficients();
 
 public:
     //-----------コンストラクタ---------// 
@@ -49,6 +60,9 @@ public:
     // 接続情報を設定
     void setConnections(const std::vector<std::shared_ptr<BaseElement>> &conns) override;
 
+    // 待ち時間に使う乱数列を設定
+    void setRandomStream(std::uint64_t seed, std::uint64_t stream) override;
+
     // 周囲の電圧を設定
     void setSurroundingVoltages() override;
 
@@ -61,11 +75,17 @@ public:
     // 電荷の更新
     void setNodeCharge(const double dt) override;
 
+    // 電荷の更新（V_sumを一定として指数関数で厳密に積分）
+    void setNodeChargeExp(const double dt) override;
+
+    // dEが正になるまでの時間
+    double timeToThreshold() const override;
+
     // トンネル待ち時間計算(upまたはdownが正の時にwtを計算してtrueを返す)
     bool calculateTunnelWt() override;
 
     // 振動子のトンネル
-    void setTunnel(const std::string& direction) override;
+    void setTunnel(TunnelDirection direction) override;
 
     //-----------ゲッター------------//    
     // ノード電圧を取得
@@ -74,20 +94,34 @@ public:
     // 接続されてる振動子の電圧の総和を取得
     double getSurroundingVsum() const override;
 
+    // 接続されてる振動子を取得
+    const std::vector<std::shared_ptr<BaseElement>> &getConnections() const override;
+
+    // 何も起きない素子か
+    bool isInert() const override;
+
     // dEの取得
-    std::map<std::string, double> getdE() const;
+    UpDown getdE() const;
 
     // Qの取得
     double getQ() const;
 
     // wtの取得
-    std::map<std::string, double> getWT() const override;
+    UpDown getWT() const override;
+
+    // トンネルレートと方向の取得（calculateTunnelWtと同じくupを優先）
+    std::pair<TunnelDirection, double> getTunnelRate() const override;
 
     // Vdの取得
     double getVd() const override;
 
     // oneway用の関数のため呼び出すとエラー発生
     std::shared_ptr<BaseElement> getInternalElement(int index) const override;
+
+    //-------- チェックポイント -------------//
+    // Q, Vn, Vd, V_sum, dE, wt, tunnel_numと乱数列の状態を書き出す・読み込む
+    void saveState(CheckpointWriter &out) const override;
+    void loadState(CheckpointReader &in) override;
     //-------- 汎用処理 -------------//
     // 0から1の間の乱数を生成
     double Random();
@@ -109,7 +143,7 @@ public:
     int getlegs() const;
 
     // テスト用dEセッター
-    void setdE(const std::string& direction, double value);
+    void setdE(TunnelDirection direction, double value);
 
     // テスト用Vnセッター
     void setVn(double vn);
@@ -118,4 +152,80 @@ public:
     void setQ(double qn);
 };
 
+//-------- 毎ステップ呼ばれる計算はinlineにする（MultiSEOはfinalなので型が分かっていれば直接呼び出せる） --------//
+// V_sumを設定
+inline void MultiSEO::setVsum(double v)
+{
+    bool wasInert = isInert();
+    V_sum = v;
+    noteActivation(wasInert, isInert());
+}
+
+// 周囲の電圧を設定
+inline void MultiSEO::setSurroundingVoltages()
+{
+    V_sum = 0;
+    for (const auto &elem : connections)
+    {
+        V_sum += elem->getVn();
+    }
+}
+
+// 振動子のパラメータ計算
+inline void MultiSEO::setPcalc()
+{
+    Vn = (multi_num * (Cj * Q + cCj * V_sum) - Cj * tunnel_num * e) / (Cj * ctotal);
+}
+
+// 電荷の更新
+inline void MultiSEO::setNodeCharge(const double dt)
+{
+    Q += (Vd - Vn) * dt / R;
+}
+
+// 電荷の更新（V_sumを一定として指数関数で厳密に積分）
+// Vnは multi_num * Q / (legs * multi_num * C + Cj) の傾きでQに比例するので、Qは時定数 R * (legs * multi_num * C + Cj) / multi_num で平衡値に近づく
+inline void MultiSEO::setNodeChargeExp(const double dt)
+{
+    double tau = R * ceff;
+    double drive = ceff * (Vd - Vn);
+    Q += (tau > 0) ? -drive * std::expm1(-dt / tau) : drive;
+}
+
+// dEが正になるまでの時間（setdEcalcの分子はQの1次式なので、Qがあとどれだけ変われば符号が変わるかを求める）
+inline double MultiSEO::timeToThreshold() const
+{
+    double tau = R * ceff;
+    double drive = ceff * (Vd - Vn);
+    double upNumerator = (-(multi_num - 1) * legs + 2 * legs * tunnel_num) * C * e + Cj * (2 * Q - e) + twoCCj * V_sum;
+    double downNumerator = -(-(multi_num - 1) * legs - 2 * legs * tunnel_num) * C * e + Cj * (2 * Q + e) + twoCCj * V_sum;
+    if (upNumerator > 0 || downNumerator < 0)
+        return 0.0;
+    return (drive >= 0) ? exponentialCrossingTime(-upNumerator / (2 * Cj), drive, tau) : exponentialCrossingTime(downNumerator / (2 * Cj), -drive, tau);
+}
+
+// ノード電圧を取得
+inline double MultiSEO::getVn() const
+{
+    return Vn;
+}
+
+// 何も起きない素子か（途中までトンネルした接合が残っていれば動く）
+inline bool MultiSEO::isInert() const
+{
+    return connections.empty() && Q == 0.0 && Vn == 0.0 && V_sum == 0.0 && Vd == 0.0 && tunnel_num == 0;
+}
+
+// dEの取得
+inline UpDown MultiSEO::getdE() const
+{
+    return dE;
+}
+
+// wtの取得
+inline UpDown MultiSEO::getWT() const
+{
+    return wt;
+}
+
 #endif // SEO_HPP
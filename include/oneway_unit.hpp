@@ -5,8 +5,11 @@
 #include "base_element.hpp"
 #include "seo_class.hpp"
 #include "multi_seo_class.hpp"
+#include "checkpoint.hpp"
 #include <memory>
 #include <array>
+#include <algorithm>
+#include <limits>
 #include <vector>
 #include <string>
 #include <map>
@@ -14,13 +17,13 @@
 #include <stdexcept>
 
 // 一方向伝導素子を表すクラス（BaseElementに対応）
-class OnewayUnit : public BaseElement
+class OnewayUnit final : public BaseElement
 {
 private:
     std::array<std::shared_ptr<BaseElement>, 4> ows; // 一方通行のための4つの素子を用意
     std::string oneway_direction;                      // 一方通行の方向("left"3から0の方向,"right"0から3の方向)
     std::shared_ptr<BaseElement> locate = nullptr;     // 最小wtを持つ素子
-    std::string tunnel_direction = "none";            // トンネルの方向を保持
+    TunnelDirection tunnel_direction = TunnelDirection::None; // トンネルの方向を保持
 
 public:
     // コンストラクタ：一方通行の向きと4つの素子を初期化（デフォルトは右向き。左向きにしたい場合は引数にleftを指定）
@@ -55,6 +58,8 @@ public:
         for (int i = 0; i < 4; i++)
         {
             auto ptr = std::dynamic_pointer_cast<SEO>(ows[i]);
+            if (!ptr)
+                throw std::invalid_argument("OnewayUnit: internal elements must be SEO");
             if (i == 0 || i == 3)
             {
                 ptr->setUp(r, rj, cj_leg3, c, -vd, 3);
@@ -64,10 +69,7 @@ public:
                 ptr->setUp(r, rj, cj_leg2, c, vd, 2);
             }
         }
-        if (oneway_direction == "right")
-            std::dynamic_pointer_cast<SEO>(ows[3])->setVias(vias);
-        else
-            std::dynamic_pointer_cast<SEO>(ows[0])->setVias(vias);
+        ows[oneway_direction == "right" ? 3 : 0]->setVias(vias);
     }
 
     // 一方通行の中身の素子(multiseo)にパラメータを付与(R,Rj,Cj_leg2,Cj_leg3,C,Vd,multi_num)
@@ -77,6 +79,8 @@ public:
         for (int i = 0; i < 4; i++)
         {
             auto ptr = std::dynamic_pointer_cast<MultiSEO>(ows[i]);
+            if (!ptr)
+                throw std::invalid_argument("OnewayUnit: internal elements must be MultiSEO");
             if (i == 0 || i == 3)
             {
                 ptr->setUp(r, rj, cj_leg3, c, -vd, 3, junction_num);
@@ -86,10 +90,7 @@ public:
                 ptr->setUp(r, rj, cj_leg2, c, vd, 2, junction_num);
             }
         }
-        if (oneway_direction == "right")
-            std::dynamic_pointer_cast<MultiSEO>(ows[3])->setVias(vias);
-        else
-            std::dynamic_pointer_cast<MultiSEO>(ows[0])->setVias(vias);
+        ows[oneway_direction == "right" ? 3 : 0]->setVias(vias);
     }
     // 両端の素子を含むconnectionの設定
     void setOnewayConnections(std::shared_ptr<BaseElement> left_elem, std::shared_ptr<BaseElement> right_elem)
@@ -125,6 +126,15 @@ public:
     // 印加電圧Vdを返す（代表として素子0を利用）
     double getVd() const override { return ows[0]->getVd(); }
 
+    // 内部素子が全て何も起きない素子か
+    bool isInert() const override
+    {
+        for (const auto &e : ows)
+            if (!e->isInert())
+                return false;
+        return true;
+    }
+
     // 接続素子の周辺電圧を設定
     void setSurroundingVoltages() override
     {
@@ -155,26 +165,50 @@ public:
         {
             if (e->calculateTunnelWt())
             {
-                auto wt_map = e->getWT();
-                for (const auto &entry : wt_map)
+                // down, upの順に比べる（同じ値ならdownを優先）
+                const UpDown w = e->getWT();
+                if (w.down < min_wt)
+                {
+                    min_wt = w.down;
+                    locate = e;
+                    tunnel_direction = TunnelDirection::Down;
+                    found = true;
+                }
+                if (w.up < min_wt)
                 {
-                    if (entry.second < min_wt)
-                    {
-                        min_wt = entry.second;
-                        locate = e;
-                        tunnel_direction = entry.first;
-                        found = true;
-                    }
+                    min_wt = w.up;
+                    locate = e;
+                    tunnel_direction = TunnelDirection::Up;
+                    found = true;
                 }
             }
         }
         return found;
     }
 
-    // 最小トンネル素子のWT（待ち時間）を返す（locateが存在しなければ空のmapを返す）
-    std::map<std::string, double> getWT() const override
+    // 最小トンネル素子のWT（待ち時間）を返す（locateが存在しなければ0を返す）
+    UpDown getWT() const override
     {
-        return locate ? locate->getWT() : std::map<std::string, double>{};
+        return locate ? locate->getWT() : UpDown{};
+    }
+
+    // 内部素子のトンネルレートの合計を返す（方向はレートが最大の内部素子のもの）
+    // イベント駆動の計算では内部素子を個別に扱うので、これは目安として使う
+    std::pair<TunnelDirection, double> getTunnelRate() const override
+    {
+        std::pair<TunnelDirection, double> result{TunnelDirection::None, 0.0};
+        double max_rate = 0.0;
+        for (const auto &e : ows)
+        {
+            auto rate = e->getTunnelRate();
+            result.second += rate.second;
+            if (rate.second > max_rate)
+            {
+                max_rate = rate.second;
+                result.first = rate.first;
+            }
+        }
+        return result;
     }
 
     // 全ての素子に対して電荷の更新処理を行う
@@ -184,8 +218,24 @@ public:
             e->setNodeCharge(dt);
     }
 
+    // 全ての素子に対して電荷の更新処理を行う（指数関数で厳密に積分）
+    void setNodeChargeExp(double dt) override
+    {
+        for (auto &e : ows)
+            e->setNodeChargeExp(dt);
+    }
+
+    // 内部素子のうち最も早くdEが正になるまでの時間
+    double timeToThreshold() const override
+    {
+        double earliest = std::numeric_limits<double>::infinity();
+        for (const auto &e : ows)
+            earliest = std::min(earliest, e->timeToThreshold());
+        return earliest;
+    }
+
     // 最小wt素子に対してトンネルを設定
-    void setTunnel(const std::string &direction) override
+    void setTunnel(TunnelDirection direction) override
     {
         if (locate)
         {
@@ -193,8 +243,16 @@ public:
         }
     }
 
+    // トンネルする内部素子と方向を外から指定する
+    // Grid2D<BaseElement>は内部素子を直接計算してcalculateTunnelWtを呼ばないので、選んだ素子をここで伝える
+    void setTunnelTarget(int index, TunnelDirection direction)
+    {
+        locate = ows.at(index);
+        tunnel_direction = direction;
+    }
+
     // 記録されたトンネル方向を返す
-    std::string getTunnelDirection() const
+    TunnelDirection getTunnelDirection() const
     {
         return tunnel_direction;
     }
@@ -211,6 +269,12 @@ public:
         return ows[0]->getSurroundingVsum();
     }
 
+    // 接続素子を取得（代表として素子0を利用）
+    const std::vector<std::shared_ptr<BaseElement>> &getConnections() const override
+    {
+        return ows[0]->getConnections();
+    }
+
     // Vsum設定（各素子に一括）
     void setVsum(double v) override
     {
@@ -218,6 +282,26 @@ public:
             e->setVsum(v);
     }
 
+    // 乱数列の設定（内部素子0〜3にstream + 0〜3を割り当てる）
+    void setRandomStream(std::uint64_t seed, std::uint64_t stream) override
+    {
+        for (int i = 0; i < 4; i++)
+            ows[i]->setRandomStream(seed, stream + i);
+    }
+
+    // 内部素子0〜3の状態を順に書き出す・読み込む
+    void saveState(CheckpointWriter &out) const override
+    {
+        for (const auto &e : ows)
+            e->saveState(out);
+    }
+
+    void loadState(CheckpointReader &in) override
+    {
+        for (auto &e : ows)
+            e->loadState(in);
+    }
+
     // 接続を一括で設定
     void setConnections(const std::vector<std::shared_ptr<BaseElement>> &conns) override
     {
@@ -53,7 +53,7 @@ void setMazeBias(Grid2D<Element>& grid, const std::vector<std::vector<int>>& maz
 
     for (int y = 0; y < rows; ++y) {
         for (int x = 0; x < cols; ++x) {
-            auto elem = grid.getElement(y, x);
+            const auto &elem = grid.rowBegin(y)[x];
 
             // 端は無条件で壁電圧
             if (x == 0 || y == 0 || x == cols - 1 || y == rows - 1) {
@@ -84,6 +84,8 @@ void setMazeBias(Grid2D<Element>& grid, const std::vector<std::vector<int>>& maz
             }
         }
     }
+    // Vdを0にした壁の素子を計算から外し、通路の素子を計算に入れる
+    grid.refreshActiveSet();
 }
 
 // 与えられた迷路ベクトルの0（壁）1（通路)を読み取ってgridの要素にVdを設定。上下左右の方向を読み取り、障害物の１マス手前を低めの値で設定する関数
@@ -111,7 +113,7 @@ void setMazeBiasWithDirection(
     // まずすべてを壁に初期化
     for (int y = 0; y < rows; ++y)
         for (int x = 0; x < cols; ++x)
-            grid.getElement(y, x)->setVias(Vd_wall);
+            grid.rowBegin(y)[x]->setVias(Vd_wall);
 
     for (int y = 1; y < rows - 1; ++y) {
         for (int x = 1; x < cols - 1; ++x) {
@@ -123,23 +125,24 @@ void setMazeBiasWithDirection(
             bool hasWall = false;
             if (direction == "up" && maze_y > 0 && maze[maze_y - 1][maze_x] == 0) {
                 hasWall = true;
-                grid.getElement(y, x)->setVias(Vd_normal);
-                if (y + 1 < rows - 1 && maze[maze_y + 1][maze_x] == 1) grid.getElement(y + 1, x)->setVias(Vd_lower);
+                grid.rowBegin(y)[x]->setVias(Vd_normal);
+                if (y + 1 < rows - 1 && maze[maze_y + 1][maze_x] == 1) grid.rowBegin(y + 1)[x]->setVias(Vd_lower);
             } else if (direction == "down" && maze_y < maze.size() - 1 && maze[maze_y + 1][maze_x] == 0) {
                 hasWall = true;
-                grid.getElement(y, x)->setVias(Vd_normal);
-                if (y - 1 > 0 && maze[maze_y - 1][maze_x] == 1) grid.getElement(y - 1, x)->setVias(Vd_lower);
+                grid.rowBegin(y)[x]->setVias(Vd_normal);
+                if (y - 1 > 0 && maze[maze_y - 1][maze_x] == 1) grid.rowBegin(y - 1)[x]->setVias(Vd_lower);
             } else if (direction == "left" && maze_x > 0 && maze[maze_y][maze_x - 1] == 0) {
                 hasWall = true;
-                grid.getElement(y, x)->setVias(Vd_normal);
-                if (x + 1 < cols - 1 && maze[maze_y][maze_x + 1] == 1) grid.getElement(y, x + 1)->setVias(Vd_lower);
+                grid.rowBegin(y)[x]->setVias(Vd_normal);
+                if (x + 1 < cols - 1 && maze[maze_y][maze_x + 1] == 1) grid.rowBegin(y)[x + 1]->setVias(Vd_lower);
             } else if (direction == "right" && maze_x < maze[0].size() - 1 && maze[maze_y][maze_x + 1] == 0) {
                 hasWall = true;
-                grid.getElement(y, x)->setVias(Vd_normal);
-                if (x - 1 > 0 && maze[maze_y][maze_x - 1] == 1) grid.getElement(y, x - 1)->setVias(Vd_lower);
+                grid.rowBegin(y)[x]->setVias(Vd_normal);
+                if (x - 1 > 0 && maze[maze_y][maze_x - 1] == 1) grid.rowBegin(y)[x - 1]->setVias(Vd_lower);
             }
         }
     }
+    grid.refreshActiveSet();
 }
 
 
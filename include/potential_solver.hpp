@@ -0,0 +1,611 @@
+#ifndef POTENTIAL_SOLVER_HPP
+#define POTENTIAL_SOLVER_HPP
+
+#include <vector>
+#include <memory>
+#include <array>
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include "base_element.hpp"
+#include "oneway_unit.hpp"
+#include "thread_pool.hpp"
+#include "grid_2dim.hpp"
+
+//---------------------------------------------------------------------------------------------------
+// ノード電圧Vnを求めるソルバー
+// Simulation2D::runStepの「V_sumの取得→Vnの計算」の繰り返しを差し替えられるようにしたもの
+//  ・JacobiSolver      : 従来の方法（gridごとに全素子のV_sumを取得してからVnを計算）。デフォルトは5回固定
+//  ・RedBlackSolver    : grid内を (x + y) % 2 で赤黒に分け、色ごとに行の帯で並列に計算する
+//  ・GaussSeidelSolver : Gauss-Seidel / SOR。残差が許容値を下回るまで繰り返す
+//  ・MultigridSolver   : gridの座標で2×2ずつまとめた粗い格子を使うマルチグリッド（Vサイクル）
+// 各素子のVnは V_sum について1次式（Vn = a + b * V_sum）なので、GaussSeidelとMultigridは
+// 素子から a, b を取り出して配列上で解き、最後に V_sum を設定して setPcalc で書き戻す
+//---------------------------------------------------------------------------------------------------
+
+// 1ステップ分のソルバーの記録
+struct SolverStats
+{
+    int iterations = 0;    // 反復回数（sweepやVサイクルの回数）
+    double residual = 0.0; // 最後の残差（Vnの最大誤差[V]）
+};
+
+// ソルバーの記録の集計（ステップごとの記録をためずに、長い計算でも一定の大きさで持てる）
+struct SolverSummary
+{
+    std::uint64_t steps = 0;      // 記録したステップ数
+    std::uint64_t iterations = 0; // 反復回数の合計
+    int maxIterations = 0;        // 反復回数の最大
+    double maxResidual = 0.0;     // 残差の最大
+    SolverStats last;             // 最後のステップの記録
+
+    void add(const SolverStats &stats)
+    {
+        steps++;
+        iterations += stats.iterations;
+        maxIterations = std::max(maxIterations, stats.iterations);
+        maxResidual = std::max(maxResidual, stats.residual);
+        last = stats;
+    }
+
+    // 1ステップあたりの平均の反復回数
+    double meanIterations() const { return steps ? static_cast<double>(iterations) / steps : 0.0; }
+};
+
+// ソルバーのインターフェース
+template <typename Element>
+class PotentialSolver
+{
+public:
+    virtual ~PotentialSolver() = default;
+
+    // grids全体のVnを計算する（反復回数と残差を返す）
+    virtual SolverStats solve(std::vector<Grid2D<Element>> &grids) = 0;
+
+    // 接続や素子のパラメータ（R, Cj, C, legsなど）を変えたときに呼ぶ
+    virtual void reset() {}
+
+    // 最初のsolveで行う準備を先に済ませる
+    // 準備で素子のV_sum・Vnを書き換えるソルバーがあるので、チェックポイントを読み込む前に呼ぶ
+    virtual void prepare(std::vector<Grid2D<Element>> &) {}
+
+    // gridごとの並列計算に使うスレッドプールを設定（nullptrなら直列）
+    void setThreadPool(std::shared_ptr<ThreadPool> p) { pool = p; }
+
+protected:
+    std::shared_ptr<ThreadPool> pool;
+};
+
+// gridの素子を計算単位の素子に展開する（OnewayUnitは内部の4素子）
+// coordsには各素子の(gridのインデックス, y, x)が入る
+template <typename Element>
+void expandLeafElements(std::vector<Grid2D<Element>> &grids,
+                        std::vector<std::shared_ptr<BaseElement>> &leaves,
+                        std::vector<std::array<int, 3>> &coords)
+{
+    leaves.clear();
+    coords.clear();
+    for (int g = 0; g < static_cast<int>(grids.size()); ++g)
+    {
+        auto &grid = grids[g];
+        for (int y = 0; y < grid.numRows(); ++y)
+        {
+            for (int x = 0; x < grid.numCols(); ++x)
+            {
+                std::shared_ptr<BaseElement> elem = grid.getElement(y, x);
+                if (auto unit = std::dynamic_pointer_cast<OnewayUnit>(elem))
+                {
+                    for (const auto &internal : unit->getInternalElements())
+                    {
+                        leaves.push_back(internal);
+                        coords.push_back({g, y, x});
+                    }
+                }
+                else
+                {
+                    leaves.push_back(elem);
+                    coords.push_back({g, y, x});
+                }
+            }
+        }
+    }
+}
+
+//------------------------------------- Jacobi（従来の方法） -------------------------------------
+template <typename Element>
+class JacobiSolver : public PotentialSolver<Element>
+{
+private:
+    int maxSweeps;    // 最大sweep回数
+    double tolerance; // 許容値（0なら必ずmaxSweeps回行う）
+    std::vector<std::shared_ptr<BaseElement>> leaves;
+    std::vector<std::array<int, 3>> coords;
+    std::vector<double> previous;
+
+public:
+    // コンストラクタ（デフォルトは従来と同じ5回固定）
+    explicit JacobiSolver(int sweeps = 5, double tol = 0.0) : maxSweeps(sweeps), tolerance(tol)
+    {
+        if (sweeps <= 0)
+            throw std::invalid_argument("JacobiSolver: sweeps must be positive");
+    }
+
+    SolverStats solve(std::vector<Grid2D<Element>> &grids) override
+    {
+        if (leaves.empty())
+            expandLeafElements(grids, leaves, coords);
+
+        SolverStats stats;
+        previous.resize(leaves.size());
+        for (int i = 0; i < maxSweeps; i++)
+        {
+            for (size_t k = 0; k < leaves.size(); ++k)
+                previous[k] = leaves[k]->getVn();
+            if (this->pool && this->pool->size() > 1)
+            {
+                // 並列時は全gridのV_sumを取得してから全gridのVnを計算する（grid間もJacobi）
+                int n = static_cast<int>(grids.size());
+                this->pool->parallelFor(n, [&](int g) { grids[g].updateGridSurVn(); });
+                this->pool->parallelFor(n, [&](int g) { grids[g].updateGridVn(); });
+            }
+            else
+            {
+                for (auto &grid : grids)
+                {
+                    // 接続されている電圧を更新
+                    grid.updateGridSurVn();
+                    // 電圧を更新
+                    grid.updateGridVn();
+                }
+            }
+            // このsweepでのVnの最大変化量を残差とする
+            stats.residual = 0.0;
+            for (size_t k = 0; k < leaves.size(); ++k)
+                stats.residual = std::max(stats.residual, std::abs(leaves[k]->getVn() - previous[k]));
+            stats.iterations = i + 1;
+            if (stats.residual < tolerance)
+                break;
+        }
+        return stats;
+    }
+
+    void reset() override
+    {
+        leaves.clear();
+    }
+
+    // 最大sweep回数と許容値（Simulation2D::compileで実行プランに引き継ぐ）
+    int getMaxSweeps() const { return maxSweeps; }
+    double getTolerance() const { return tolerance; }
+};
+
+// 赤黒順序のソルバー
+// gridの順に、(x + y) % 2 == 0 の素子のV_sum取得→Vn計算、続いて (x + y) % 2 == 1 の素子について同じことを行う
+// （Grid3Dを積み重ねたgridでは (x + y + z) % 2 で色を分ける）
+// 正方格子の隣接素子は必ず色が違うので、同じ色の素子は互いに独立に計算でき、grid内を行の帯に分けて並列に計算する
+// 斜めの接続など、同じ色の素子がgrid内でつながっている回路では最初の計算の前に例外を投げる
+template <typename Element>
+class RedBlackSolver : public PotentialSolver<Element>
+{
+private:
+    int maxSweeps;    // 最大sweep回数
+    double tolerance; // 許容値（0なら必ずmaxSweeps回行う）
+    std::vector<std::shared_ptr<BaseElement>> leaves;
+    std::vector<std::array<int, 3>> coords;
+    std::vector<double> previous;
+    std::shared_ptr<ThreadPool> serial = std::make_shared<ThreadPool>(1); // スレッドプール未設定時に使う
+
+    // 素子リストを作り、各gridが2色に塗り分けられているか確かめる
+    void setup(std::vector<Grid2D<Element>> &grids)
+    {
+        for (const auto &grid : grids)
+            grid.checkRedBlackColoring();
+        expandLeafElements(grids, leaves, coords);
+    }
+
+public:
+    explicit RedBlackSolver(int sweeps = 5, double tol = 0.0) : maxSweeps(sweeps), tolerance(tol)
+    {
+        if (sweeps <= 0)
+            throw std::invalid_argument("RedBlackSolver: sweeps must be positive");
+    }
+
+    SolverStats solve(std::vector<Grid2D<Element>> &grids) override
+    {
+        if (leaves.empty())
+            setup(grids);
+        ThreadPool &p = this->pool ? *this->pool : *serial;
+
+        SolverStats stats;
+        previous.resize(leaves.size());
+        for (int i = 0; i < maxSweeps; i++)
+        {
+            for (size_t k = 0; k < leaves.size(); ++k)
+                previous[k] = leaves[k]->getVn();
+            for (auto &grid : grids)
+            {
+                for (int parity = 0; parity < 2; ++parity)
+                {
+                    grid.updateGridSurVn(p, parity);
+                    grid.updateGridVn(p, parity);
+                }
+            }
+            stats.residual = 0.0;
+            for (size_t k = 0; k < leaves.size(); ++k)
+                stats.residual = std::max(stats.residual, std::abs(leaves[k]->getVn() - previous[k]));
+            stats.iterations = i + 1;
+            if (stats.residual < tolerance)
+                break;
+        }
+        return stats;
+    }
+
+    void reset() override
+    {
+        leaves.clear();
+    }
+
+    void prepare(std::vector<Grid2D<Element>> &grids) override
+    {
+        if (leaves.empty())
+            setup(grids);
+    }
+};
+
+//----------------------------- 配列上で解くソルバーの共通部分 -----------------------------
+// 連立方程式 u_i - b_i * Σ_{j∈接続} u_j = a_i + b_i * (gridの外の素子のVnの和) を扱う
+template <typename Element>
+class LinearPotentialSolver : public PotentialSolver<Element>
+{
+protected:
+    std::vector<std::shared_ptr<BaseElement>> leaves;
+    std::vector<std::array<int, 3>> coords;  // 各素子の(grid, y, x)
+    std::vector<int> offset, neighbor;       // 接続（CSR形式、重複あり）
+    std::vector<std::vector<const BaseElement *>> external; // gridの外の接続先
+    std::vector<double> a, b;                // Vn = a + b * V_sum
+    std::vector<double> rhs;                 // 右辺
+    std::vector<double> u;                   // 解（Vn）
+
+    // 素子リスト・接続・係数bを作る
+    virtual void setup(std::vector<Grid2D<Element>> &grids)
+    {
+        expandLeafElements(grids, leaves, coords);
+        int n = static_cast<int>(leaves.size());
+        std::unordered_map<const BaseElement *, int> index;
+        for (int i = 0; i < n; ++i)
+            index.emplace(leaves[i].get(), i);
+        // OnewayUnitのポインタは代表の素子0（getVnが返す素子）に対応させる
+        for (auto &grid : grids)
+            for (int y = 0; y < grid.numRows(); ++y)
+                for (int x = 0; x < grid.numCols(); ++x)
+                {
+                    std::shared_ptr<BaseElement> elem = grid.getElement(y, x);
+                    if (auto unit = std::dynamic_pointer_cast<OnewayUnit>(elem))
+                        index.emplace(unit.get(), index.at(unit->getInternalElement(0).get()));
+                }
+
+        offset.assign(n + 1, 0);
+        neighbor.clear();
+        external.assign(n, {});
+        for (int i = 0; i < n; ++i)
+        {
+            for (const auto &conn : leaves[i]->getConnections())
+            {
+                auto found = index.find(conn.get());
+                if (found != index.end())
+                    neighbor.push_back(found->second);
+                else
+                    external[i].push_back(conn.get());
+            }
+            offset[i + 1] = static_cast<int>(neighbor.size());
+        }
+
+        // V_sumを0と1にしたときのVnの差から係数bを求める（パラメータだけで決まる）
+        a.assign(n, 0.0);
+        b.assign(n, 0.0);
+        for (int i = 0; i < n; ++i)
+        {
+            leaves[i]->setVsum(0.0);
+            leaves[i]->setPcalc();
+            double v0 = leaves[i]->getVn();
+            leaves[i]->setVsum(1.0);
+            leaves[i]->setPcalc();
+            b[i] = leaves[i]->getVn() - v0;
+        }
+    }
+
+    // 現在の電荷から右辺を作り、現在のVnを初期値にする
+    void gather()
+    {
+        int n = static_cast<int>(leaves.size());
+        u.resize(n);
+        rhs.resize(n);
+        for (int i = 0; i < n; ++i)
+            u[i] = leaves[i]->getVn();
+        for (int i = 0; i < n; ++i)
+        {
+            // V_sum = 0のときのVnが a（電荷Qやtunnel_numで決まる）
+            leaves[i]->setVsum(0.0);
+            leaves[i]->setPcalc();
+            a[i] = leaves[i]->getVn();
+            double ext = 0.0;
+            for (const auto *e : external[i])
+                ext += e->getVn();
+            rhs[i] = a[i] + b[i] * ext;
+        }
+    }
+
+    // 解をV_sumとして素子に書き戻してVnを計算させる
+    void scatter()
+    {
+        int n = static_cast<int>(leaves.size());
+        for (int i = 0; i < n; ++i)
+        {
+            double vsum = 0.0;
+            for (int k = offset[i]; k < offset[i + 1]; ++k)
+                vsum += u[neighbor[k]];
+            for (const auto *e : external[i])
+                vsum += e->getVn();
+            leaves[i]->setVsum(vsum);
+        }
+        for (int i = 0; i < n; ++i)
+            leaves[i]->setPcalc();
+    }
+
+    // 残差の最大値
+    double residualNorm() const
+    {
+        double r = 0.0;
+        for (size_t i = 0; i < u.size(); ++i)
+        {
+            double sum = 0.0;
+            for (int k = offset[i]; k < offset[i + 1]; ++k)
+                sum += u[neighbor[k]];
+            r = std::max(r, std::abs(rhs[i] - (u[i] - b[i] * sum)));
+        }
+        return r;
+    }
+
+public:
+    void reset() override
+    {
+        leaves.clear();
+    }
+
+    void prepare(std::vector<Grid2D<Element>> &grids) override
+    {
+        if (leaves.empty())
+            setup(grids);
+    }
+};
+
+//---------------------------------- Gauss-Seidel / SOR ----------------------------------
+template <typename Element>
+class GaussSeidelSolver : public LinearPotentialSolver<Element>
+{
+private:
+    double omega;      // 緩和係数（1ならGauss-Seidel、1より大きければSOR）
+    double tolerance;  // 許容値[V]
+    int maxIterations; // 最大反復回数
+
+public:
+    explicit GaussSeidelSolver(double w = 1.0, double tol = 1e-10, int maxIter = 100)
+        : omega(w), tolerance(tol), maxIterations(maxIter)
+    {
+        if (w <= 0.0 || w >= 2.0)
+            throw std::invalid_argument("GaussSeidelSolver: omega must be in (0, 2)");
+        if (maxIter <= 0)
+            throw std::invalid_argument("GaussSeidelSolver: maxIterations must be positive");
+    }
+
+    SolverStats solve(std::vector<Grid2D<Element>> &grids) override
+    {
+        if (this->leaves.empty())
+            this->setup(grids);
+        this->gather();
+
+        auto &u = this->u;
+        SolverStats stats;
+        stats.residual = this->residualNorm();
+        while (stats.residual >= tolerance && stats.iterations < maxIterations)
+        {
+            for (size_t i = 0; i < u.size(); ++i)
+            {
+                double sum = 0.0;
+                for (int k = this->offset[i]; k < this->offset[i + 1]; ++k)
+                    sum += u[this->neighbor[k]];
+                double target = this->rhs[i] + this->b[i] * sum;
+                u[i] += omega * (target - u[i]);
+            }
+            stats.iterations++;
+            stats.residual = this->residualNorm();
+        }
+        this->scatter();
+        return stats;
+    }
+};
+
+//------------------------------------- マルチグリッド -------------------------------------
+// gridの座標(y, x)を2×2ずつまとめて粗い格子を作る（まとめた素子の値は同じとみなす）
+// 粗い格子の係数は細かい格子の係数の和（Galerkin近似）。平滑化はGauss-Seidel
+template <typename Element>
+class MultigridSolver : public LinearPotentialSolver<Element>
+{
+private:
+    // 1つの階層の行列（対角と非対角をCSR形式で持つ）
+    struct Level
+    {
+        int n = 0;
+        std::vector<double> diag;
+        std::vector<int> offset, column;
+        std::vector<double> value;
+        std::vector<int> parent;           // 1つ粗い階層での番号
+        std::vector<std::array<int, 3>> coords;
+        std::vector<double> x, f, r;       // 解・右辺・残差の作業領域
+    };
+    std::vector<Level> levels;
+
+    double tolerance;
+    int maxCycles;
+    int smoothing; // 前後の平滑化の回数
+
+    void smooth(Level &lv, int sweeps)
+    {
+        for (int s = 0; s < sweeps; ++s)
+        {
+            for (int i = 0; i < lv.n; ++i)
+            {
+                double sum = lv.f[i];
+                for (int k = lv.offset[i]; k < lv.offset[i + 1]; ++k)
+                    sum -= lv.value[k] * lv.x[lv.column[k]];
+                lv.x[i] = sum / lv.diag[i];
+            }
+        }
+    }
+
+    void computeResidual(Level &lv)
+    {
+        for (int i = 0; i < lv.n; ++i)
+        {
+            double sum = lv.diag[i] * lv.x[i];
+            for (int k = lv.offset[i]; k < lv.offset[i + 1]; ++k)
+                sum += lv.value[k] * lv.x[lv.column[k]];
+            lv.r[i] = lv.f[i] - sum;
+        }
+    }
+
+    void vcycle(int l)
+    {
+        Level &lv = levels[l];
+        if (l + 1 == static_cast<int>(levels.size()))
+        {
+            // 一番粗い階層は十分に平滑化して解く
+            smooth(lv, 50);
+            return;
+        }
+        smooth(lv, smoothing);
+        computeResidual(lv);
+        Level &coarse = levels[l + 1];
+        std::fill(coarse.f.begin(), coarse.f.end(), 0.0);
+        std::fill(coarse.x.begin(), coarse.x.end(), 0.0);
+        for (int i = 0; i < lv.n; ++i)
+            coarse.f[lv.parent[i]] += lv.r[i];
+        vcycle(l + 1);
+        for (int i = 0; i < lv.n; ++i)
+            lv.x[i] += coarse.x[lv.parent[i]];
+        smooth(lv, smoothing);
+    }
+
+    // 細かい階層から粗い階層を作る
+    Level coarsen(Level &fine)
+    {
+        Level coarse;
+        std::map<std::array<int, 3>, int> aggregate;
+        fine.parent.resize(fine.n);
+        for (int i = 0; i < fine.n; ++i)
+        {
+            std::array<int, 3> key{fine.coords[i][0], fine.coords[i][1] / 2, fine.coords[i][2] / 2};
+            auto it = aggregate.find(key);
+            if (it == aggregate.end())
+            {
+                it = aggregate.emplace(key, coarse.n++).first;
+                coarse.coords.push_back(key);
+            }
+            fine.parent[i] = it->second;
+        }
+        // 粗い行列 = まとめた素子同士の係数の和
+        std::vector<std::map<int, double>> rows(coarse.n);
+        coarse.diag.assign(coarse.n, 0.0);
+        for (int i = 0; i < fine.n; ++i)
+        {
+            int I = fine.parent[i];
+            coarse.diag[I] += fine.diag[i];
+            for (int k = fine.offset[i]; k < fine.offset[i + 1]; ++k)
+            {
+                int J = fine.parent[fine.column[k]];
+                if (I == J)
+                    coarse.diag[I] += fine.value[k];
+                else
+                    rows[I][J] += fine.value[k];
+            }
+        }
+        coarse.offset.assign(coarse.n + 1, 0);
+        for (int I = 0; I < coarse.n; ++I)
+        {
+            for (const auto &[J, v] : rows[I])
+            {
+                coarse.column.push_back(J);
+                coarse.value.push_back(v);
+            }
+            coarse.offset[I + 1] = static_cast<int>(coarse.column.size());
+        }
+        coarse.x.assign(coarse.n, 0.0);
+        coarse.f.assign(coarse.n, 0.0);
+        coarse.r.assign(coarse.n, 0.0);
+        return coarse;
+    }
+
+protected:
+    void setup(std::vector<Grid2D<Element>> &grids) override
+    {
+        LinearPotentialSolver<Element>::setup(grids);
+        levels.clear();
+        Level fine;
+        fine.n = static_cast<int>(this->leaves.size());
+        fine.diag.assign(fine.n, 1.0);
+        fine.offset = this->offset;
+        fine.column = this->neighbor;
+        fine.value.resize(this->neighbor.size());
+        for (int i = 0; i < fine.n; ++i)
+            for (int k = fine.offset[i]; k < fine.offset[i + 1]; ++k)
+                fine.value[k] = -this->b[i];
+        fine.coords = this->coords;
+        fine.x.assign(fine.n, 0.0);
+        fine.f.assign(fine.n, 0.0);
+        fine.r.assign(fine.n, 0.0);
+        levels.push_back(std::move(fine));
+        // 素子数が十分小さくなるか、まとめても減らなくなるまで粗くする
+        while (levels.back().n > 16)
+        {
+            Level coarse = coarsen(levels.back());
+            if (coarse.n == levels.back().n)
+                break;
+            levels.push_back(std::move(coarse));
+        }
+    }
+
+public:
+    explicit MultigridSolver(double tol = 1e-10, int maxCycle = 20, int smoothSweeps = 2)
+        : tolerance(tol), maxCycles(maxCycle), smoothing(smoothSweeps)
+    {
+        if (maxCycle <= 0)
+            throw std::invalid_argument("MultigridSolver: maxCycles must be positive");
+    }
+
+    SolverStats solve(std::vector<Grid2D<Element>> &grids) override
+    {
+        if (this->leaves.empty())
+            setup(grids);
+        this->gather();
+
+        Level &fine = levels.front();
+        fine.x = this->u;
+        fine.f = this->rhs;
+        SolverStats stats;
+        stats.residual = this->residualNorm();
+        while (stats.residual >= tolerance && stats.iterations < maxCycles)
+        {
+            vcycle(0);
+            this->u = fine.x;
+            stats.iterations++;
+            stats.residual = this->residualNorm();
+        }
+        this->scatter();
+        return stats;
+    }
+};
+
+#endif // POTENTIAL_SOLVER_HPP
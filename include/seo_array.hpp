@@ -0,0 +1,442 @@
+#ifndef SEO_ARRAY_HPP
+#define SEO_ARRAY_HPP
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <stdexcept>
+#include <random>
+#include <utility>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+#include "constants.hpp"
+#include "seo_class.hpp"
+#include "grid_2dim.hpp"
+
+//---------------------------------------------------------------------------------------------------
+// SEOをまとめて配列で持つクラス（Structure of Arrays）
+// 素子ごとにQ, Vn, Vd, V_sum, R, Rj, Cj, C, legsを連続した配列に置き、接続はCSR形式のインデックスで持つ
+// 計算式はSEOと同じ。SEOのようにshared_ptrや仮想関数、mapを経由しないので、1素子あたりのメモリが小さく、
+// sweepは配列を先頭から順に読むだけになる
+// 範囲を指定する関数は [begin, end) の素子だけを計算する（行の帯ごとの並列計算用）
+//---------------------------------------------------------------------------------------------------
+class SEOArray
+{
+private:
+    int n;                         // 素子数
+    std::vector<double> Q;         // ノード電荷
+    std::vector<double> Vn;        // ノード電圧
+    std::vector<double> Vd;        // バイアス電圧
+    std::vector<double> V_sum;     // 周囲のノード電圧の総和
+    std::vector<double> R;         // 抵抗
+    std::vector<double> Rj;        // トンネル抵抗
+    std::vector<double> Cj;        // 接合容量
+    std::vector<double> C;         // 接続容量
+    std::vector<int> legs;         // 足の数
+    std::vector<double> dEup;      // エネルギー変化量(up)
+    std::vector<double> dEdown;    // エネルギー変化量(down)
+    std::vector<double> wt;        // トンネル待ち時間（トンネルしない素子は0）
+    std::vector<TunnelDirection> dir; // トンネルの方向
+
+    // 接続（CSR形式）：素子iの接続先は neighbourIndex[neighbourOffset[i]] 〜 neighbourIndex[neighbourOffset[i+1]-1]
+    std::vector<int> neighbourOffset;
+    std::vector<int> neighbourIndex;
+    std::vector<std::vector<int>> pendingConnections; // setConnectionsで受け取った接続（CSRを作ったら解放する）
+    bool connectionsChanged = false;
+    bool batchedSampling = true; // 待ち時間の対数をbatchLogでまとめて計算するか
+    // 待ち時間の乱数列（素子iは乱数列 rngStreamBase + (streamNumber[i] << 2) の rngCounter[i] 番目を使う。SEOと同じ番号の付け方）
+    std::uint64_t rngSeed = 0;
+    std::uint64_t rngStreamBase = 0;
+    std::vector<std::uint64_t> rngCounter;
+    std::vector<int> streamNumber; // 素子iの乱数列の通し番号（空なら i）
+
+    void checkIndex(int i) const;
+
+public:
+    //-----------コンストラクタ---------//
+    // 素子数を指定（パラメータは全て0）
+    explicit SEOArray(int count = 0);
+
+    //-----------セッター------------//
+    // 素子数を変更（全ての値と接続が初期化される）
+    void resize(int count);
+
+    // パラメータセットアップ
+    void setUp(int i, double r, double rj, double cj, double c, double vd, int legscounts);
+
+    // バイアス電圧を設定
+    void setVias(int i, double vd);
+
+    // V_sumを設定
+    void setVsum(int i, double v);
+
+    // 接続情報を設定（接続先は同じ配列の素子のインデックス）
+    void setConnections(int i, const std::vector<int> &conns);
+
+    // 待ち時間の計算方法を設定（trueなら対数をbatchLogでまとめて計算、falseならSEOと同じく素子ごとにstd::logを使う）
+    void setBatchedSampling(bool flag) { batchedSampling = flag; }
+
+    // 素子ごとの乱数列を設定（素子iの通し番号は firstIndex + i。Grid2D::setRandomStreamsと同じ番号になる）
+    void setRandomStreams(std::uint64_t seed, std::uint64_t firstIndex);
+
+    // 素子iの乱数列の通し番号を numbers[i] にする（空なら i。素子を並べ替えても同じ乱数列を使うため）
+    void setStreamNumbers(const std::vector<int> &numbers);
+
+    // 接続情報からCSRを作る（接続を変えた後、並列計算の前に呼ぶ。直列の計算では自動で呼ばれる）
+    void buildConnections();
+
+    // 周囲の電圧を設定（範囲を指定する版はCSRを作らないので、接続を変えた後はbuildConnectionsを先に呼ぶ）
+    void setSurroundingVoltages(int begin, int end);
+
+    // 振動子のパラメータ計算
+    void setPcalc(int begin, int end);
+
+    // 振動子のエネルギー計算
+    void setdEcalc(int begin, int end);
+
+    // 電荷の更新
+    void setNodeCharge(double dt, int begin, int end);
+
+    // トンネル待ち時間計算（upまたはdownが正の素子のwtを計算）
+    // [begin, end)の中で最小のwt（dt未満のもの）を持つ素子のインデックスを返す（無ければ-1）
+    int calculateTunnelWt(double dt, int begin, int end);
+
+    // 振動子のトンネル
+    void setTunnel(int i, TunnelDirection direction);
+
+    // 全素子についての計算
+    void setSurroundingVoltages()
+    {
+        buildConnections();
+        setSurroundingVoltages(0, n);
+    }
+    void setPcalc() { setPcalc(0, n); }
+    void setdEcalc() { setdEcalc(0, n); }
+    void setNodeCharge(double dt) { setNodeCharge(dt, 0, n); }
+
+    //-----------ゲッター------------//
+    // 素子数
+    int size() const { return n; }
+
+    double getVn(int i) const { return Vn[i]; }
+    double getQ(int i) const { return Q[i]; }
+    double getVd(int i) const { return Vd[i]; }
+    double getSurroundingVsum(int i) const { return V_sum[i]; }
+    double getR(int i) const { return R[i]; }
+    double getRj(int i) const { return Rj[i]; }
+    double getCj(int i) const { return Cj[i]; }
+    double getC(int i) const { return C[i]; }
+    int getlegs(int i) const { return legs[i]; }
+    double getdEup(int i) const { return dEup[i]; }
+    double getdEdown(int i) const { return dEdown[i]; }
+    double getWT(int i) const { return wt[i]; }
+
+    // トンネルの方向（トンネルしないならNone）
+    TunnelDirection getTunnelDirection(int i) const;
+
+    // 接続されてる素子のインデックスを取得
+    std::vector<int> getConnections(int i) const;
+
+    // トンネルレートと方向の取得（calculateTunnelWtと同じくupを優先）
+    std::pair<TunnelDirection, double> getTunnelRate(int i) const;
+
+    // 1素子あたりのメモリ使用量[byte]（配列とCSRの容量から計算）
+    double bytesPerElement() const;
+
+    //-------- 汎用処理 -------------//
+    // 素子iの乱数列から0から1の間の乱数を生成
+    double Random(int i);
+
+    //-------- テスト用 -------------//
+    void setVn(int i, double vn);
+    void setQ(int i, double qn);
+};
+
+//---------------------------------------------------------------------------------------------------
+// Grid2D<SEOArray>の素子の並べ方（SEOArrayの中での順番）
+// 行優先では上下の素子が配列の中でcols個離れるので、列数が多いとsweepで上下の素子を読むたびにキャッシュを外れやすい
+// タイルやZ順序に並べると、隣どうしの素子が配列の中でも近くに来る
+// ただし、上下の行がL2に収まる大きさなら行優先のほうがプリフェッチが効いて速いことが多い（bench/grid_layout_bench.cppで比べる）
+//---------------------------------------------------------------------------------------------------
+enum class GridLayout
+{
+    RowMajor, // 行優先（index = row * cols + col）
+    Tiled,    // tile×tileのタイルごとにまとめる（タイルの並びとタイルの中は行優先）
+    Morton    // Z順序（rowとcolのビットを交互に並べた値の順。2の累乗でないサイズは間を詰める）
+};
+
+// layoutで並べたときに配列のi番目に来るセルの行優先の番号（row * cols + col）の一覧
+// tileSizeはTiledのタイルの1辺（正でなければ例外）
+std::vector<int> gridLayoutOrder(int rows, int cols, GridLayout layout, int tileSize);
+
+//---------------------------------------------------------------------------------------------------
+// SEOArrayを使うGrid2Dの特殊化
+// 素子をlayoutの順（デフォルトは行優先）で1つのSEOArrayに格納し、Grid2Dと同じ名前の関数で計算する
+// 素子のshared_ptrは存在しないので、素子へのアクセスは (row, col) を指定する関数で行う
+// (row, col)から配列のインデックスへの変換はindexが行うので、並べ方によらず同じ呼び方で同じ結果になる
+// （素子の乱数列とgetTunnelIndexも行優先の番号で数えるので、Grid2D<SEO>と同じトンネルの列になる）
+//---------------------------------------------------------------------------------------------------
+template <>
+class Grid2D<SEOArray>
+{
+private:
+    SEOArray elements;
+    int rows_, cols_;
+    GridLayout layout_;
+    // 行優先以外の並べ方の対応表（行優先なら空）
+    std::vector<int> cellAt;              // 配列のi番目のセルの行優先の番号
+    std::vector<int> indexOfCell;         // 行優先の番号のセルの配列のインデックス
+    std::vector<unsigned char> parityAt;  // 配列のi番目のセルの (x + y) % 2
+    std::string outputlabel = "";
+    int tunnelindex = -1;
+    TunnelDirection tunneldirection = TunnelDirection::None;
+    double minwt = 0.0;
+    bool outputEnabled;
+
+    // 行優先なら行の帯、それ以外は配列を同じ長さに分けた範囲ごとに並列にfを呼ぶ
+    template <typename F>
+    void forEachRowBand(ThreadPool &pool, F f)
+    {
+        int bands = std::min(pool.size(), rows_);
+        long long n = static_cast<long long>(rows_) * cols_;
+        auto edge = [&](int b)
+        { return (layout_ == GridLayout::RowMajor) ? cols_ * (rows_ * b / bands) : static_cast<int>(n * b / bands); };
+        pool.parallelFor(bands, [&](int b) { f(edge(b), edge(b + 1), b); });
+    }
+
+    // parityが0か1のときは (x + y) % 2 == parity の素子だけについてfを呼ぶ
+    template <typename F>
+    void forEachParity(int begin, int end, int parity, F f)
+    {
+        if (parity < 0)
+        {
+            f(begin, end);
+            return;
+        }
+        if (layout_ != GridLayout::RowMajor)
+        {
+            // 同じ色が続く範囲ごとに呼ぶ
+            for (int i = begin; i < end;)
+            {
+                if (parityAt[i] != parity)
+                {
+                    ++i;
+                    continue;
+                }
+                int j = i + 1;
+                while (j < end && parityAt[j] == parity)
+                    ++j;
+                f(i, j);
+                i = j;
+            }
+            return;
+        }
+        for (int i = begin; i < end; i += cols_)
+        {
+            int row = i / cols_;
+            for (int j = (row + parity) % 2; j < cols_; j += 2)
+                f(i + j, i + j + 1);
+        }
+    }
+
+public:
+    // layoutで素子の並べ方を選ぶ（tileSizeはTiledのタイルの1辺）
+    Grid2D(int rows, int cols, bool enableOutput = true, GridLayout layout = GridLayout::RowMajor, int tileSize = 32)
+        : elements(0), rows_(rows), cols_(cols), layout_(layout), outputEnabled(enableOutput)
+    {
+        if (rows <= 0 || cols <= 0)
+        {
+            throw std::invalid_argument("Grid size must be positive");
+        }
+        elements.resize(rows * cols);
+        if (layout != GridLayout::RowMajor)
+        {
+            cellAt = gridLayoutOrder(rows, cols, layout, tileSize);
+            indexOfCell.resize(cellAt.size());
+            parityAt.resize(cellAt.size());
+            for (int i = 0; i < static_cast<int>(cellAt.size()); ++i)
+            {
+                indexOfCell[cellAt[i]] = i;
+                parityAt[i] = static_cast<unsigned char>((cellAt[i] / cols + cellAt[i] % cols) % 2);
+            }
+            elements.setStreamNumbers(cellAt);
+        }
+    }
+
+    // SEOのGrid2Dからパラメータ・状態・接続をコピーして作る（接続先は同じgridのSEOに限る）
+    static Grid2D<SEOArray> fromGrid(const Grid2D<SEO> &source, GridLayout layout = GridLayout::RowMajor, int tileSize = 32)
+    {
+        Grid2D<SEOArray> result(source.numRows(), source.numCols(), true, layout, tileSize);
+        result.outputlabel = source.getOutputLabel();
+        result.outputEnabled = source.isOutputEnabled();
+        std::unordered_map<const BaseElement *, int> indexOf;
+        for (int y = 0; y < source.numRows(); ++y)
+            for (int x = 0; x < source.numCols(); ++x)
+                indexOf[source.getElement(y, x).get()] = result.index(y, x);
+        for (int y = 0; y < source.numRows(); ++y)
+        {
+            for (int x = 0; x < source.numCols(); ++x)
+            {
+                auto seo = source.getElement(y, x);
+                int i = result.index(y, x);
+                result.elements.setUp(i, seo->getR(), seo->getRj(), seo->getCj(), seo->getC(), seo->getVd(), seo->getlegs());
+                result.elements.setQ(i, seo->getQ());
+                result.elements.setVn(i, seo->getVn());
+                result.elements.setVsum(i, seo->getSurroundingVsum());
+                std::vector<int> conns;
+                for (const auto &c : seo->getConnections())
+                {
+                    auto it = indexOf.find(c.get());
+                    if (it == indexOf.end())
+                        throw std::invalid_argument("Grid2D<SEOArray>: connections must stay inside the grid");
+                    conns.push_back(it->second);
+                }
+                result.elements.setConnections(i, conns);
+            }
+        }
+        result.elements.buildConnections();
+        return result;
+    }
+
+    // (row, col)の配列のインデックス（行優先なら row * cols + col）
+    int index(int row, int col) const
+    {
+        if (row < 0 || row >= rows_ || col < 0 || col >= cols_)
+            throw std::out_of_range("Grid2D<SEOArray>: index out of range");
+        int cell = row * cols_ + col;
+        return indexOfCell.empty() ? cell : indexOfCell[cell];
+    }
+
+    // 配列のi番目の素子の位置(row, col)
+    std::pair<int, int> positionOf(int i) const
+    {
+        if (i < 0 || i >= elements.size())
+            throw std::out_of_range("Grid2D<SEOArray>: index out of range");
+        int cell = cellAt.empty() ? i : cellAt[i];
+        return {cell / cols_, cell % cols_};
+    }
+
+    // 素子の並べ方
+    GridLayout getLayout() const { return layout_; }
+
+    // 素子の配列を取得
+    SEOArray &getElements() { return elements; }
+    const SEOArray &getElements() const { return elements; }
+
+    // パラメータセットアップ
+    void setUp(int row, int col, double r, double rj, double cj, double c, double vd, int legscounts)
+    {
+        elements.setUp(index(row, col), r, rj, cj, c, vd, legscounts);
+    }
+
+    // バイアス電圧を設定
+    void setVias(int row, int col, double vd) { elements.setVias(index(row, col), vd); }
+
+    // 接続情報を設定（接続先は(row, col)の組）
+    void setConnections(int row, int col, const std::vector<std::pair<int, int>> &conns)
+    {
+        std::vector<int> ids;
+        for (const auto &rc : conns)
+            ids.push_back(index(rc.first, rc.second));
+        elements.setConnections(index(row, col), ids);
+    }
+
+    double getVn(int row, int col) const { return elements.getVn(index(row, col)); }
+    double getQ(int row, int col) const { return elements.getQ(index(row, col)); }
+    double getVd(int row, int col) const { return elements.getVd(index(row, col)); }
+
+    // グリッド全体の接続されている電圧を更新
+    void updateGridSurVn() { elements.setSurroundingVoltages(); }
+
+    // グリッド全体のノード電圧Vnを計算・更新
+    void updateGridVn() { elements.setPcalc(); }
+
+    // グリッド全体のエネルギー変化dEを計算・更新
+    void updateGriddE() { elements.setdEcalc(); }
+
+    // グリッド全体のトンネル待ち時間wtを計算し、最小wtとトンネル素子を更新
+    bool gridminwt(const double dt)
+    {
+        tunnelindex = elements.calculateTunnelWt(dt, 0, elements.size());
+        minwt = (tunnelindex >= 0) ? elements.getWT(tunnelindex) : dt;
+        if (tunnelindex >= 0)
+            tunneldirection = elements.getTunnelDirection(tunnelindex);
+        return minwt < dt;
+    }
+
+    // グリッド全体のノード電荷Qnを更新
+    void updateGridQn(const double dt) { elements.setNodeCharge(dt); }
+
+    // 以下は行の帯に分けて並列に計算する版（parityが0か1なら (x + y) % 2 == parity の素子だけ）
+    void updateGridSurVn(ThreadPool &pool, int parity = -1)
+    {
+        elements.buildConnections();
+        forEachRowBand(pool, [&](int begin, int end, int)
+        {
+            forEachParity(begin, end, parity, [&](int b, int e) { elements.setSurroundingVoltages(b, e); });
+        });
+    }
+
+    void updateGridVn(ThreadPool &pool, int parity = -1)
+    {
+        forEachRowBand(pool, [&](int begin, int end, int)
+        {
+            forEachParity(begin, end, parity, [&](int b, int e) { elements.setPcalc(b, e); });
+        });
+    }
+
+    void updateGriddE(ThreadPool &pool)
+    {
+        forEachRowBand(pool, [&](int begin, int end, int) { elements.setdEcalc(begin, end); });
+    }
+
+    bool gridminwt(const double dt, ThreadPool &pool)
+    {
+        int bands = std::min(pool.size(), rows_);
+        std::vector<int> bandindex(bands, -1);
+        forEachRowBand(pool, [&](int begin, int end, int b) { bandindex[b] = elements.calculateTunnelWt(dt, begin, end); });
+        minwt = dt;
+        tunnelindex = -1;
+        for (int b = 0; b < bands; ++b)
+        {
+            if (bandindex[b] >= 0 && elements.getWT(bandindex[b]) < minwt)
+            {
+                tunnelindex = bandindex[b];
+                minwt = elements.getWT(tunnelindex);
+            }
+        }
+        if (tunnelindex >= 0)
+            tunneldirection = elements.getTunnelDirection(tunnelindex);
+        return minwt < dt;
+    }
+
+    void updateGridQn(const double dt, ThreadPool &pool)
+    {
+        forEachRowBand(pool, [&](int begin, int end, int) { elements.setNodeCharge(dt, begin, end); });
+    }
+
+    // 素子ごとの乱数列を設定（Grid2D<SEO>と同じ番号なので、同じシードなら同じ乱数を使う）
+    void setRandomStreams(std::uint64_t seed, std::uint64_t firstIndex) { elements.setRandomStreams(seed, firstIndex); }
+
+    // トンネルが発生する素子で実際にトンネルさせる
+    void applyTunnel()
+    {
+        if (tunnelindex >= 0)
+            elements.setTunnel(tunnelindex, tunneldirection);
+    }
+
+    int numRows() const { return rows_; }
+    int numCols() const { return cols_; }
+    // トンネルする素子の行優先の番号（row * cols + col。並べ方によらない）
+    int getTunnelIndex() const { return (tunnelindex < 0 || cellAt.empty()) ? tunnelindex : cellAt[tunnelindex]; }
+    TunnelDirection getTunnelDirection() const { return tunneldirection; }
+    double getMinWT() const { return minwt; }
+    void setOutputLabel(const std::string &label) { outputlabel = label; }
+    std::string getOutputLabel() const { return outputlabel; }
+    bool hasOutputLabel() const { return !outputlabel.empty(); }
+    void setOutputEnabled(bool flag) { outputEnabled = flag; }
+    bool isOutputEnabled() const { return outputEnabled; }
+};
+
+#endif // SEO_ARRAY_HPP
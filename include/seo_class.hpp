@@ -11,8 +11,9 @@
 #include <memory>
 #include "base_element.hpp"
 #include "constants.hpp"
+#include "counter_rng.hpp"
 
-class SEO : public BaseElement {
+class SEO final : public BaseElement {
 private:
     double Q;               // ノード電荷
     double Vn;              // ノード電圧
@@ -23,10 +24,19 @@ private:
     double C;               // 接続容量
     int legs;               // 足の数
     double V_sum;           // 周囲のノード電圧の総和
-    std::map<std::string, double> dE; // エネルギー変化量(up, down)
-    std::map<std::string, double> wt; // トンネル待時間(up, down)
+    UpDown dE;              // エネルギー変化量(up, down)
+    UpDown wt;              // トンネル待時間(up, down)
+    CounterRNG rng;         // 待ち時間に使う乱数列
     // std::vector<std::shared_ptr<SEO>> connection; // 接続されている素子のポインタ
     std::vector<std::shared_ptr<BaseElement>> connections;  // 接続されている素子のポインタ
+    std::vector<const SEO *> connectedSEO;  // 接続先がSEOならそのポインタ（仮想関数を通さずにVnを読む）、それ以外はnullptr
+    // パラメータだけで決まる係数（パラメータを設定したときに計算しておき、毎ステップの計算で使い回す）
+    double ctotal;          // 全容量 legs * C + Cj
+    double vnCoeff;         // Vnの式のV_sum側の係数 C / (Cj * ctotal)
+    double tunnelScale;     // トンネルレートの分母 e * e * Rj
+
+    // パラメータだけで決まる係数を計算し直す
+    void updateCoefficients();
 
 public:
     //-----------コンストラクタ---------// 
@@ -50,6 +60,9 @@ public:
 
     void setConnections(const std::vector<std::shared_ptr<BaseElement>>& conns) override;
 
+    // 待ち時間に使う乱数列を設定
+    void setRandomStream(std::uint64_t seed, std::uint64_t stream) override;
+
     // 周囲の電圧を設定
     void setSurroundingVoltages() override;
 
@@ -62,11 +75,17 @@ public:
     // 電荷の更新
     void setNodeCharge(const double dt) override;
 
+    // 電荷の更新（V_sumを一定として指数関数で厳密に積分）
+    void setNodeChargeExp(const double dt) override;
+
+    // dEが正になるまでの時間
+    double timeToThreshold() const override;
+
     // トンネル待ち時間計算(upまたはdownが正の時にwtを計算してtrueを返す)
     bool calculateTunnelWt() override;
 
     // 振動子のトンネル
-    void setTunnel(const std::string& direction) override;
+    void setTunnel(TunnelDirection direction) override;
 
     //-----------ゲッター------------//    
     // ノード電圧を取得
@@ -78,17 +97,31 @@ public:
     // 接続されてる振動子の電圧の総和を取得
     double getSurroundingVsum() const override;
 
+    // 接続されてる振動子を取得
+    const std::vector<std::shared_ptr<BaseElement>> &getConnections() const override;
+
+    // 何も起きない素子か
+    bool isInert() const override;
+
     // dEの取得
-    std::map<std::string, double> getdE() const;
+    UpDown getdE() const;
 
     // Qの取得
     double getQ() const;
 
     // wtの取得
-    std::map<std::string, double> getWT() const override;
+    UpDown getWT() const override;
+
+    // トンネルレートと方向の取得（calculateTunnelWtと同じくupを優先）
+    std::pair<TunnelDirection, double> getTunnelRate() const override;
 
     // oneway用の関数のため呼び出すとエラー発生
     std::shared_ptr<BaseElement> getInternalElement(int index) const override;
+
+    //-------- チェックポイント -------------//
+    // Q, Vn, Vd, V_sum, dE, wtと乱数列の状態を書き出す・読み込む
+    void saveState(CheckpointWriter &out) const override;
+    void loadState(CheckpointReader &in) override;
     //-------- 汎用処理 -------------//
     // 0から1の間の乱数を生成
     double Random();
@@ -116,7 +149,7 @@ public:
     int getlegs() const;
 
     // テスト用dEセッター
-    void setdE(const std::string& direction, double value);
+    void setdE(TunnelDirection direction, double value);
 
     // テスト用Vnセッター
     void setVn(double vn);
@@ -125,4 +158,81 @@ public:
     void setQ(double qn);
 };
 
+//-------- 毎ステップ呼ばれる計算はinlineにする（SEOはfinalなので型が分かっていれば直接呼び出せる） --------//
+// V_sumを設定
+inline void SEO::setVsum(double v)
+{
+    bool wasInert = isInert();
+    V_sum = v;
+    noteActivation(wasInert, isInert());
+}
+
+// 周囲の電圧を設定
+inline void SEO::setSurroundingVoltages()
+{
+    V_sum = 0;
+    for (size_t k = 0; k < connections.size(); ++k)
+    {
+        const SEO *seo = connectedSEO[k];
+        V_sum += seo ? seo->Vn : connections[k]->getVn();
+    }
+}
+
+// 振動子のパラメータ計算
+inline void SEO::setPcalc()
+{
+    Vn = Q / Cj + vnCoeff * (Cj * V_sum - legs * Q);
+}
+
+// 電荷の更新
+inline void SEO::setNodeCharge(const double dt)
+{
+    Q += (Vd - Vn) * dt / R;
+}
+
+// 電荷の更新（V_sumを一定として指数関数で厳密に積分）
+// Vn = (Q + C * V_sum) / (legs * C + Cj) なので、Qは時定数 R * (legs * C + Cj) で平衡値 Q + (legs * C + Cj) * (Vd - Vn) に近づく
+// dtが時定数に比べて小さければsetNodeChargeと一致する
+inline void SEO::setNodeChargeExp(const double dt)
+{
+    double tau = R * ctotal;
+    double drive = ctotal * (Vd - Vn);
+    Q += (tau > 0) ? -drive * std::expm1(-dt / tau) : drive;
+}
+
+// dEが正になるまでの時間（dE.upはQ + C * V_sum > e / 2、dE.downはQ + C * V_sum < -e / 2のとき正）
+inline double SEO::timeToThreshold() const
+{
+    double tau = R * ctotal;
+    double s = Q + C * V_sum;
+    double drive = ctotal * (Vd - Vn);
+    if (s > e / 2 || s < -e / 2)
+        return 0.0;
+    return (drive >= 0) ? exponentialCrossingTime(e / 2 - s, drive, tau) : exponentialCrossingTime(s + e / 2, -drive, tau);
+}
+
+// ノード電圧を取得
+inline double SEO::getVn() const
+{
+    return Vn;
+}
+
+// 何も起きない素子か（接続が無ければV_sumは0のままなので、Q・Vn・Vdが0ならずっと0）
+inline bool SEO::isInert() const
+{
+    return connections.empty() && Q == 0.0 && Vn == 0.0 && V_sum == 0.0 && Vd == 0.0;
+}
+
+// dEの取得
+inline UpDown SEO::getdE() const
+{
+    return dE;
+}
+
+// wtの取得
+inline UpDown SEO::getWT() const
+{
+    return wt;
+}
+
 #endif // SEO_HPP
@@ -0,0 +1,52 @@
+#ifndef SEO_KERNELS_HPP
+#define SEO_KERNELS_HPP
+
+#include <string>
+
+//---------------------------------------------------------------------------------------------------
+// SEO・MultiSEOのVn・dEを連続した配列でまとめて計算するカーネル
+// 計算式と演算の順番はSEO::setPcalc / setdEcalc、MultiSEO::setPcalc / setdEcalc と同じで、
+// AVX2・AVX-512版もスカラー版とビット単位で同じ結果になる（FMAにまとめないようにコンパイルする）
+// どの命令セットを使うかは実行時にCPUを調べて決める（setSimdLevelで変更可。計算中の別のスレッドから変えてもよい）
+//---------------------------------------------------------------------------------------------------
+
+// 使う命令セット
+enum class SimdLevel
+{
+    Scalar,
+    AVX2,
+    AVX512
+};
+
+// CPUが対応している一番速い命令セット
+SimdLevel detectSimdLevel();
+
+// 今使っている命令セットを取得
+SimdLevel getSimdLevel();
+
+// 使う命令セットを設定（CPUが対応していなければ例外）
+void setSimdLevel(SimdLevel level);
+
+// 命令セットをCPUが使えるかどうか
+bool isSimdLevelSupported(SimdLevel level);
+
+// 命令セットの名前
+std::string simdLevelName(SimdLevel level);
+
+// SEOのVnを計算（n素子分）
+void seoPotentialKernel(int n, const double *Q, const double *V_sum, const double *Cj, const double *C,
+                        const int *legs, double *Vn);
+
+// SEOのdE(up, down)を計算（n素子分）
+void seoEnergyKernel(int n, const double *Q, const double *V_sum, const double *Cj, const double *C,
+                     const int *legs, double *dEup, double *dEdown);
+
+// MultiSEOのVnを計算（n素子分）
+void multiSeoPotentialKernel(int n, const double *Q, const double *V_sum, const double *Cj, const double *C,
+                             const int *legs, const int *multi_num, const int *tunnel_num, double *Vn);
+
+// MultiSEOのdE(up, down)を計算（n素子分）
+void multiSeoEnergyKernel(int n, const double *Q, const double *V_sum, const double *Cj, const double *C,
+                          const int *legs, const int *multi_num, const int *tunnel_num, double *dEup, double *dEdown);
+
+#endif // SEO_KERNELS_HPP
@@ -2,13 +2,28 @@
 #define SIMULATION_2D_HPP
 
 #include <fstream>
+#include <cstdio>
 #include <vector>
 #include <memory>
 #include <utility>
 #include <map>
 #include <cmath>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
 #include "seo_class.hpp"
+#include "seo_array.hpp"
+#include "oneway_unit.hpp"
 #include "grid_2dim.hpp"
+#include "event_queue.hpp"
+#include "potential_solver.hpp"
+#include "execution_plan.hpp"
+#include "conservative_sync.hpp"
+#include "circuit_graph.hpp"
+#include "grid_3dim.hpp"
+#include "thread_pool.hpp"
+#include "counter_rng.hpp"
+#include "checkpoint.hpp"
 // #include "output_class.hpp"
 #include "tsp_methods.hpp"
 
@@ -17,6 +32,24 @@
 #include <string>
 #include <algorithm>
 
+// comparewtで選ばれたトンネルの情報（gridのコピーを作らずに位置だけを持つ軽量な記録）
+struct TunnelEvent
+{
+    int gridIndex = -1;    // gridsの中のインデックス
+    int elementIndex = -1; // grid内の素子のフラットなインデックス(row * cols + col)
+    TunnelDirection direction = TunnelDirection::None; // トンネルの方向
+    double wt = 0.0;       // トンネル待ち時間
+    BaseElement *target = nullptr; // 実際にトンネルする素子（OnewayUnitの内部素子など。nullptrならgridの素子そのもの）
+};
+
+// トンネルの選び方
+enum class EngineMode
+{
+    Step,      // 毎ステップ全素子の待ち時間を引き直して最小を選ぶ（従来の方法）
+    EventQueue, // 素子ごとの次のトンネル時刻をヒープで管理し、レートが変わった素子だけ更新する
+    RateTree    // 素子ごとのレートを和の木で管理し、合計レートから時刻を、累積和から場所を選ぶ（BKL法。乱数は1イベント2個）
+};
+
 template <typename Element>
 class Simulation2D
 {
@@ -44,15 +77,241 @@ private:
 
     Calculate_NN CalcNN; //ニューラルネットワークの計算をシミュレーション内で行うためのクラス
 
+    EngineMode engineMode = EngineMode::Step; // トンネルの選び方
+    // Vnを求めるソルバー（デフォルトは従来と同じ5回のJacobi）と、反復回数・残差の集計
+    // ステップごとの記録はsetSolverLoggingでオンにしたときだけためる（毎ステップためると長い計算でメモリが増え続けるため）
+    std::shared_ptr<PotentialSolver<Element>> potentialSolver = std::make_shared<JacobiSolver<Element>>();
+    SolverSummary solverSummary;
+    bool solverLogging = false;
+    std::vector<SolverStats> solverLog;
+    // compileで作った実行プラン（作っていなければnullptrで、ソルバーとgridで計算する）
+    std::shared_ptr<ExecutionPlan<Element>> executionPlan;
+    // addGraphで登録したグラフ（compileでCSRをそのまま使う。addGridで破棄する）
+    std::shared_ptr<const CircuitGraph> circuitGraph;
+    // gridごとの並列計算に使うスレッドプール（1スレッドなら従来どおり直列）
+    std::shared_ptr<ThreadPool> threadPool = std::make_shared<ThreadPool>(1);
+    std::vector<char> gridHasTunnel; // comparewtでgridごとにdt以内のトンネルがあったか
+    bool intraGridParallel = false;  // trueならgridを順に処理し、grid内を行の帯に分けて並列に計算する
+    // setIntraGridParallel(true)で設定したRedBlackSolverと、その前に設定されていたソルバー（falseで戻す）
+    std::shared_ptr<PotentialSolver<Element>> intraGridSolver, solverBeforeIntraGrid;
+    // イベント駆動モード・差分更新モードで扱う素子（OnewayUnitは内部素子に展開する）
+    struct LeafElement
+    {
+        std::shared_ptr<BaseElement> elem; // 実際にトンネルする素子
+        int gridIndex;                     // 属するgridのインデックス
+        int elementIndex;                  // grid内のフラットなインデックス
+        double rate;                       // 現在登録しているトンネルレート（0ならヒープ・和の木に無い）
+        TunnelDirection direction;         // トンネルの方向
+        std::uint64_t draws = 0;           // イベント駆動モードでこの素子の待ち時間を引いた回数（乱数のカウンタ）
+    };
+    std::vector<LeafElement> leaves;
+    std::unordered_map<const BaseElement *, int> leafIndexOf; // 素子のポインタからleavesのインデックスへ
+    IndexedMinHeap eventQueue;                          // 素子ごとの次のトンネル時刻（絶対時刻）
+    RateSumTree rateTree;                               // BKL法で使う素子ごとのトンネルレート
+    std::uint64_t selectorDraws = 0;                    // BKL法で引いた乱数の個数（乱数のカウンタ）
+    // 乱数のシード（素子の待ち時間・イベント駆動モード・Calculate_NNの乱数列は全てこのシードから作る）
+    std::uint64_t randomSeed = defaultRandomSeed();
+    bool seedSet = false; // setSeedが呼ばれたか（呼ばれていればaddGridしたgridにも乱数列を割り当てる）
+
+    // 乱数列をgridの素子・イベント駆動モード・Calculate_NNに割り当てる
+    void applySeed();
+
+    // チェックポイント（runの途中で一定の時間ごとに状態をファイルに保存し、次のrunの始めに読み込む）
+    std::string checkpointPath;       // 保存先（空なら保存しない）
+    double checkpointInterval = 0.0;  // 保存する間隔（シミュレーション時間）
+    double nextCheckpointTime = 0.0;  // 次に保存する時刻
+    bool resumeFromCheckpoint = true; // runの始めにcheckpointPathがあれば読み込むか
+    int printLoop = 0;                // 途中経過を表示するまでのcalcLの回数
+
+    // 電荷の更新方法と、トンネルが起きない間に一度に進める時間の上限（0なら常にdtずつ進める）
+    ChargeIntegrator chargeIntegrator = ChargeIntegrator::Euler;
+    double maxIdleJump = 0.0;
+
+    // トンネルが起きなかったステップで進める時間（次にどれかの素子のdEが正になる時刻まで。出力などの予定は飛び越さない）
+    double idleStepTime();
+
+    // 保守的な並列離散イベント同期（gridのグループごとに自分の時計で進める。lookaheadが0なら無効）
+    double syncLookahead = 0.0;
+    std::vector<int> syncGroups;                            // gridごとのグループの番号（空ならgridごとに1つのグループ）
+    std::shared_ptr<ConservativeSync<Element>> conservativeSync; // 最初のrunStepで作る（addGridなどで破棄する）
+
+    // 全グループを次の出力時刻（calcLの時刻を越えない）まで進める（保守的な同期のrunStep）
+    void advanceConservative();
+
+    // トンネルの記録（到達回数の集計とログの出力。timeはトンネルした時刻）
+    void logTunnel(const TunnelEvent &event, double time);
+
+    // 差分更新モード（Vnが変化した素子だけがδを隣に押し付け、印のついた素子だけ再計算する）
+    bool incrementalUpdate = false;
+    int resyncInterval = 1000;            // 何ステップごとにV_sumを全て取り直すか（δの足し込みによる丸め誤差を消す）
+    int stepsSinceResync = 0;
+    std::vector<int> dependentOffset;     // 素子iのVnをV_sumに含む素子の一覧（CSR形式、重複あり）
+    std::vector<int> dependentList;
+    std::vector<std::vector<int>> dirtyByGrid; // 今のsweepで再計算する素子（gridごと）
+    std::vector<std::pair<int, double>> pendingDeltas; // 次のsweepの始めにV_sumへ足し込むδ（接続先, δ）
+    std::vector<char> dirtyFlag, touchedFlag;
+    std::vector<int> touchedList;              // このステップでQかV_sumが変わった素子（dEとレートの再計算対象）
+
+    // 素子に今のsweepで再計算する印をつける
+    void markDirty(int id);
+    // 素子にこのステップで変化した印をつける
+    void markTouched(int id);
+    // V_sumを全て取り直して全素子に印をつける
+    void resyncIncremental();
+    // ソルバーの1ステップ分の記録を集計に加える
+    void recordSolverStats(const SolverStats &stats);
+
+    // 同時トンネル：最小wtから concurrentWindow 以内の候補のうち、接続でつながる範囲が重ならない素子も同じステップでトンネルさせる
+    double concurrentWindow = 0.0;                 // 0なら無効（1ステップに1回だけトンネルする。setConcurrentWindowで設定）
+    std::vector<std::vector<TunnelCandidate>> tunnelCandidates; // gridごとの候補
+    std::vector<TunnelEvent> concurrentEvents;     // 最小wtの素子と同時にトンネルさせる素子（runStepで処理して空にする）
+
+    // 同時トンネルモードでのwtの比較（最小wtの素子を返し、同時にトンネルさせる素子をconcurrentEventsに入れる）
+    // 返す素子のwtはこのステップで進める時間（最小wtではなく、同時トンネルの幅の終わり）
+    std::pair<bool, TunnelEvent> compareConcurrent();
+
 public:
     // コンストラクタ(刻み時間,シミュレーションの終了タイミング)
     Simulation2D(double dT, double EndTime);
 
     // wtの比較（gridごと）
-    std::pair<bool, std::shared_ptr<Grid2D<Element>>> comparewt();
+    std::pair<bool, TunnelEvent> comparewt();
 
     // トンネルの処理
-    void handleTunnels(Grid2D<Element> &tunnelgrid);
+    void handleTunnels(const TunnelEvent &event);
+
+    // Vnを求めるソルバーを設定（差分更新モードでは使われない。compileした実行プランは破棄される）
+    void setPotentialSolver(std::shared_ptr<PotentialSolver<Element>> solver);
+
+    // Vnを求めるソルバーを取得
+    std::shared_ptr<PotentialSolver<Element>> getPotentialSolver() const;
+
+    // gridと接続を組み終えた後に一度呼び、接続を検査して実行プランを作る（以降のrunStepはプランでVn・dEを計算する）
+    // 今のソルバー（JacobiSolverのみ）と同じsweep回数・許容値で計算するので結果は変わらない
+    // 接続の誤りやJacobiSolver以外のソルバーでは例外。addGrid・setPotentialSolverでプランは破棄される
+    void compile();
+
+    // 実行プランを作ってあるか
+    bool isCompiled() const;
+
+    // 素子(grid g, row, col)のバイアス電圧を変える（実行プランを作り直さずに済む）
+    void setVias(int gridIndex, int row, int col, double vd);
+
+    // ステップごとのソルバーの反復回数・残差を記録するかを設定（デフォルトはオフで、集計だけをとる）
+    void setSolverLogging(bool flag);
+
+    // ステップごとのソルバーの反復回数・残差の記録を取得（setSolverLogging(true)にしてからのステップだけ）
+    const std::vector<SolverStats> &getSolverLog() const;
+
+    // ソルバーの反復回数・残差の集計を取得
+    const SolverSummary &getSolverSummary() const;
+
+    // gridごとの並列計算のスレッド数を設定（1なら直列）
+    void setThreadCount(int threads);
+
+    // gridごとの並列計算のスレッド数を取得
+    int getThreadCount() const;
+
+    // grid内の並列計算の設定（trueならRedBlackSolverに切り替え、dE・wt・電荷もgrid内を行の帯に分けて計算する）
+    // 既にRedBlackSolverを設定していればそのまま使う。falseにすると、trueにしたときに切り替えたソルバーだけを元に戻す
+    // （その間にsetPotentialSolverで設定したソルバーはそのまま）
+    void setIntraGridParallel(bool flag);
+
+    // grid内の並列計算をしているかどうか
+    bool isIntraGridParallel() const;
+
+    // 乱数のシードを設定（同じシードなら、スレッド数や計算の順番によらず同じ結果になる）
+    // 素子(grid g, row, col)には gridの順に数えた通し番号で乱数列を割り当てる
+    void setSeed(std::uint64_t seed);
+
+    // 乱数のシードを取得（setSeedしていなければ実行ごとに変わる既定のシード）
+    std::uint64_t getSeed() const;
+
+    // チェックポイントの設定（runの中でinterval[ns]ごとにpathへ保存する。resumeがtrueならrunの始めにpathがあれば読み込んで続きから計算する）
+    void setCheckpoint(const std::string &path, double interval, bool resume = true);
+
+    // 今の状態をチェックポイントとして保存（一時ファイルに書いてから置き換えるので、途中で止まっても前のファイルは壊れない）
+    // 保守的な同期（setConservativeSync）を使っている間は、グループ間の境界の履歴を保存できないので例外
+    void saveCheckpoint(const std::string &path);
+
+    // チェックポイントを読み込む（ファイルが無ければfalse。回路が保存時と違えば例外）
+    // gridの回路（素子・パラメータ・接続）とソルバー・モードの設定は保存時と同じにしてから呼ぶ
+    bool loadCheckpoint(const std::string &path);
+
+    // トンネルの選び方を設定
+    // StepからEventQueue・RateTreeに切り替えると差分更新モードもオンにする（レートを更新するのがdEの変わった素子だけになる）
+    // Stepに戻すとオフに戻す。差分更新を使わないソルバーと組み合わせる場合は、この後でsetIncrementalUpdate(false)にする
+    // （その場合は毎ステップ全素子のレートを取り直す）
+    void setEngineMode(EngineMode mode);
+
+    // トンネルの選び方を取得
+    EngineMode getEngineMode() const;
+
+    // イベント駆動モード・差分更新モード用の素子リストとヒープを作り直す
+    void buildLeaves();
+
+    // 差分更新モードの設定（Vnが変化した素子の周りだけを再計算する）
+    void setIncrementalUpdate(bool flag);
+
+    // 差分更新モードかどうか
+    bool isIncrementalUpdate() const;
+
+    // 差分更新モードでV_sumを全て取り直す間隔（ステップ数）を設定
+    void setResyncInterval(int steps);
+
+    // 電荷の更新方法を設定（デフォルトはEuler）
+    void setChargeIntegrator(ChargeIntegrator integrator);
+
+    // 電荷の更新方法を取得
+    ChargeIntegrator getChargeIntegrator() const;
+
+    // トンネルが起きない間、次にどれかの素子がトンネルできるようになる時刻まで最大maxJumpだけ一度に進める（0で無効）
+    // ChargeIntegrator::Exponentialのときだけ有効。進める間は各素子のV_sumを一定とみなすので、maxJumpで近似の誤差を抑える
+    void setIdleJump(double maxJump);
+
+    // 同時トンネルの幅を設定（0で無効。Stepモードのみ）
+    // 最小wtから最大windowの間にトンネルする素子を、互いに接続の2段先まで重ならなければ1ステップでまとめてトンネルさせる
+    // 精度：同時にトンネルする素子どうしは接続の距離が3以上なので、互いのV_sumを直接は変えない
+    // ステップの間はレートを一定とみなすので、トンネルの影響が周りの素子のレートに反映されるのが最大windowだけ遅れる
+    // （つながっていない素子だけなら1つずつ処理する場合と同じ分布。windowを0に近づけると従来の方法に一致する）
+    void setConcurrentWindow(double window);
+
+    // 同時トンネルの幅を取得
+    double getConcurrentWindow() const;
+
+    // 保守的な並列離散イベント同期の設定（lookaheadが0なら無効。負なら例外）
+    // gridをgroupOfGrid[g]番のグループに分け（空ならgridごとに1つ）、グループごとに自分の時計を持って並列に進める
+    // グループ間の接続（OnewayUnitの境界など）はlookahead[ns]だけ遅れて伝わり、相手の時計 + lookaheadまでは待たずに進める
+    // runStepは全グループを次の出力時刻（終了時刻・calcLの時刻を越えない）まで進めるので、出力はそろった時刻で行う
+    // 境界の履歴は保存しないので、有効な間はsaveCheckpointが例外になる
+    // 同じシード・lookahead・グループ分けなら結果はスレッド数によらない
+    // 精度: 他のグループのVnは最大 lookahead + dt だけ古い値を読むので、境界の素子のV_sumの誤差は
+    // (lookahead + dt) × 相手のVnの変化の速さ 以下。トンネルが起きない間はVnの差も従来の方法からこの程度に収まる
+    // トンネルの時刻がずれるとその後の経過は乱数で変わるので、そこから先で一致するのはトンネルの頻度などの統計的な性質だけ
+    // StepモードでJacobiSolverのとき（差分更新・同時トンネル・grid内の並列計算なし）のみ使える。トンネルが無いときの
+    // まとめた進め方（setIdleJump）とソルバーの記録は使わない
+    void setConservativeSync(double lookahead, const std::vector<int> &groupOfGrid = {});
+
+    // 保守的な同期のlookaheadを取得（0なら無効）
+    double getSyncLookahead() const;
+
+    // oyl-video形式の出力の間隔を設定（デフォルトはdt。トンネルが無い間に進める時間はこの間隔を超えない）
+    void setOutputInterval(double interval);
+
+    // 差分更新モードでのVn・dEの計算（従来の5回のsweepと同じ順序で、印のついた素子だけ計算する）
+    void relaxIncremental();
+
+    // 差分更新モードでの電荷の更新（電荷が変わった素子に印をつける）
+    void chargeIncremental(double steptime);
+
+    // 差分更新モードでトンネルした素子に印をつける
+    void markTunnelDirty(const TunnelEvent &event);
+
+    // イベント駆動モードで次のトンネルを取り出す（dt以内に起こるかどうかのbool, トンネルの情報）
+    std::pair<bool, TunnelEvent> nextQueuedEvent();
+
+    // BKL法で次のトンネルを選ぶ（dt以内に起こるかどうかのbool, トンネルの情報）
+    std::pair<bool, TunnelEvent> nextRateTreeEvent();
 
     // ファイル作成
     void openFiles() const;
@@ -72,6 +331,18 @@ public:
     // シミュレーションにgridを追加
     void addGrid(const std::vector<Grid2D<Element>> &Gridinstance);
 
+    // 回路のグラフをシミュレーションする（ノードiを1行のgridの(0, i)に並べて登録する）
+    // 接続はグラフの素子に設定済みなので、compileすればグラフのCSRをそのまま使った実行プランで計算できる
+    // 既にgridを登録していれば例外（グラフは他のgridと一緒には登録できない）
+    // oyl-video形式の出力は格子の形が無いので行わない（トンネルのログのxはノード番号）
+    void addGraph(const CircuitGraph &graph, const std::string &label = "graph");
+
+    // 3次元グリッドをシミュレーションする（層を縦に並べた1つのgridとして登録する）
+    // oyl-video形式の出力は層を上から順に縦に並べた画像になり、トンネルのログのyは z * 1層の行数 + y
+    // 同じ色の素子をつないだgrid（Grid3D::isRedBlackColourableがfalse）は、赤黒順序のソルバーを使っていれば例外
+    // （登録した後に赤黒順序にしても、最初の計算の前に例外になる）
+    void addGrid3D(const Grid3D<Element> &grid);
+
     // シミュレーションの実行
     void run();
 
@@ -81,6 +352,9 @@ public:
     // グリッド取得
     std::vector<Grid2D<Element>> &getGrids();
 
+    // 現在の時刻を取得
+    double getTime() const;
+
     // outputsを取得
     const std::map<std::string, std::vector<std::vector<std::vector<double>>>> &getOutputs() const;
 
@@ -96,79 +370,1090 @@ public:
     //解候補の数によりリセット
     void resetfunction();
 
-    // ファイル出力する素子とファイルを格納するベクトルに追加する
-    void addSelectedElements(std::shared_ptr<std::ofstream> ofs, const std::vector<std::shared_ptr<Element>>& elems);
+    // ファイル出力する素子とファイルを格納するベクトルに追加する
+    void addSelectedElements(std::shared_ptr<std::ofstream> ofs, const std::vector<std::shared_ptr<Element>>& elems);
+
+    // selectedElementsから該当する素子のVnを記録するファイル出力
+    void outputSelectedElements();
+
+    // gnuplot用データ出力
+    void generateGnuplotScript(const std::string& dataFilename, const std::vector<std::string>& labels);
+
+    // 実行中の進捗状況を表示する
+    void printProgressBar();
+
+    //結果表示ファイル
+    void writeresFile();
+
+};
+
+
+// コンストラクタ
+template <typename Element>
+Simulation2D<Element>::Simulation2D(double dT, double EndTime)
+    : t(0.0), dt(dT), cLt(0.0), rt(0.0), endtime(EndTime), outputInterval(dT), nextOutputTime(0.0), CalcNN(Cost) {}
+
+// 最小wtをもつgridを探索する（最小wtがdtより小さいかどうかのbool, 最小のwtを持つトンネルの情報）
+// gridごとの最小wtは並列に求め、最後にgridの順に比較する（同じwtなら番号の小さいgridを選ぶ）
+template <typename Element>
+std::pair<bool, TunnelEvent> Simulation2D<Element>::comparewt()
+{
+    int n = static_cast<int>(grids.size());
+    gridHasTunnel.assign(n, 0);
+    if (intraGridParallel)
+    {
+        for (int g = 0; g < n; ++g)
+            gridHasTunnel[g] = grids[g].gridminwt(dt, *threadPool);
+    }
+    else
+    {
+        threadPool->parallelFor(n, [&](int g) { gridHasTunnel[g] = grids[g].gridminwt(dt); });
+    }
+
+    TunnelEvent event;
+    event.wt = dt;
+    for (int g = 0; g < n; ++g)
+    {
+        auto &grid = grids[g];
+        if (gridHasTunnel[g])
+        {
+            double candidate = grid.getMinWT();
+            if (candidate < event.wt)
+            {
+                event.gridIndex = g;
+                event.elementIndex = grid.getTunnelIndex();
+                event.direction = grid.getTunnelDirection();
+                event.wt = candidate;
+                event.target = grid.getTunnelTarget();
+            }
+        }
+    }
+    return {event.gridIndex >= 0, event};
+}
+
+
+// 同時トンネルモードでのwtの比較
+// dt未満の候補をwtの小さい順（同じwtならgrid・行優先の順。comparewtと同じ）に見て、最小wtの素子は必ず選ぶ
+// 残りは、wtが最小wt + concurrentWindow以内で、自分と接続先の集合がそれまでに選んだ素子のものと重ならなければ選ぶ
+// 重ならなければ、選んだ素子どうしの距離は接続の3段以上になる
+// 時間は幅の終わりまで進める（選ばなかった素子はその時刻までトンネルしなかったことになり、次のステップで引き直す）
+// 重なる候補があれば、その素子のレートは先にトンネルした素子で変わっているので、幅をその候補のwtで打ち切る
+template <typename Element>
+std::pair<bool, TunnelEvent> Simulation2D<Element>::compareConcurrent()
+{
+    int n = static_cast<int>(grids.size());
+    tunnelCandidates.resize(n);
+    threadPool->parallelFor(n, [&](int g)
+    {
+        tunnelCandidates[g].clear();
+        grids[g].gridTunnelCandidates(dt, tunnelCandidates[g]);
+    });
+
+    std::vector<TunnelEvent> candidates;
+    for (int g = 0; g < n; ++g)
+    {
+        for (const auto &c : tunnelCandidates[g])
+        {
+            TunnelEvent event;
+            event.gridIndex = g;
+            event.elementIndex = c.index;
+            event.direction = c.direction;
+            event.wt = c.wt;
+            event.target = c.target;
+            candidates.push_back(event);
+        }
+    }
+    concurrentEvents.clear();
+    if (candidates.empty())
+        return {false, TunnelEvent{}};
+    std::stable_sort(candidates.begin(), candidates.end(), [](const TunnelEvent &a, const TunnelEvent &b) { return a.wt < b.wt; });
+
+    // 選んだ素子とその接続先
+    std::unordered_set<const BaseElement *> claimed;
+    auto claim = [&](const BaseElement *elem)
+    {
+        claimed.insert(elem);
+        for (const auto &conn : elem->getConnections())
+            claimed.insert(conn.get());
+    };
+    auto overlaps = [&](const BaseElement *elem)
+    {
+        if (claimed.count(elem))
+            return true;
+        for (const auto &conn : elem->getConnections())
+        {
+            if (claimed.count(conn.get()))
+                return true;
+        }
+        return false;
+    };
+
+    TunnelEvent first = candidates.front();
+    claim(first.target);
+    double horizon = std::min(dt, first.wt + concurrentWindow);
+    for (size_t k = 1; k < candidates.size() && candidates[k].wt <= horizon; ++k)
+    {
+        if (overlaps(candidates[k].target))
+        {
+            horizon = candidates[k].wt;
+            break;
+        }
+        claim(candidates[k].target);
+        concurrentEvents.push_back(candidates[k]);
+    }
+    first.wt = horizon;
+    return {true, first};
+}
+
+// トンネル処理を実行
+template <typename Element>
+void Simulation2D<Element>::handleTunnels(const TunnelEvent &event)
+{
+    logTunnel(event, t);
+    // 実際のトンネル処理
+    if (event.target)
+    {
+        event.target->setTunnel(event.direction);
+    }
+    else
+    {
+        auto &tunnelgrid = grids[event.gridIndex];
+        tunnelgrid.rowBegin(event.elementIndex / tunnelgrid.numCols())[event.elementIndex % tunnelgrid.numCols()]->setTunnel(event.direction);
+    }
+}
+
+// トンネルの記録
+template <typename Element>
+void Simulation2D<Element>::logTunnel(const TunnelEvent &event, double time)
+{
+    auto &tunnelgrid = grids[event.gridIndex];
+    //----------------トンネル場所の記録--------------------------------
+    int y = event.elementIndex / tunnelgrid.numCols();
+    int x = event.elementIndex % tunnelgrid.numCols();
+    if (((x + 1) % tenthlane == 0 ) && (y % (WideLane + 1) == CenterLane)){  //レーン長XSIZEを10分割して各場所に到達したらカウント+1
+        CalcNN.Ctvk[y / (WideLane + 1)] += 1;
+        if (CalcNN.Nvk[y / (WideLane + 1)] < 30){
+            CalcNN.Nvk[y / (WideLane + 1)] += 1;
+        }else{
+            //NR
+        }
+    }
+    std::ofstream log("../output/tunnel_log.txt", std::ios::app);
+    if (log.is_open()) {
+        log << "t=" << time
+            << ", x=" << x
+            << ", y=" << y
+            << ", dir=" << tunnelDirectionName(event.direction)
+            << ", grid=" << tunnelgrid.getOutputLabel()
+            << std::endl;
+    }
+    //-----------------------------------------------------------------
+}
+
+// Vnを求めるソルバーを設定
+template <typename Element>
+void Simulation2D<Element>::setPotentialSolver(std::shared_ptr<PotentialSolver<Element>> solver)
+{
+    if (!solver)
+        throw std::invalid_argument("Potential solver must not be null");
+    potentialSolver = solver;
+    potentialSolver->setThreadPool(threadPool);
+    solverSummary = SolverSummary{};
+    solverLog.clear();
+    executionPlan.reset();
+    conservativeSync.reset();
+}
+
+// Vnを求めるソルバーを取得
+template <typename Element>
+std::shared_ptr<PotentialSolver<Element>> Simulation2D<Element>::getPotentialSolver() const
+{
+    return potentialSolver;
+}
+
+// 接続を検査して実行プランを作る
+template <typename Element>
+void Simulation2D<Element>::compile()
+{
+    auto jacobi = std::dynamic_pointer_cast<JacobiSolver<Element>>(potentialSolver);
+    if (!jacobi)
+        throw std::logic_error("compile: the execution plan runs Jacobi sweeps, so the potential solver must be a JacobiSolver");
+    if (circuitGraph)
+        executionPlan = std::make_shared<ExecutionPlan<Element>>(*circuitGraph, jacobi->getMaxSweeps(), jacobi->getTolerance());
+    else
+        executionPlan = std::make_shared<ExecutionPlan<Element>>(grids, jacobi->getMaxSweeps(), jacobi->getTolerance());
+}
+
+// 実行プランを作ってあるか
+template <typename Element>
+bool Simulation2D<Element>::isCompiled() const
+{
+    return executionPlan != nullptr;
+}
+
+// 素子のバイアス電圧を変える
+// プランはVdを持たないのでそのまま使える。Vdが0になると何も起きない素子になりうるので、gridの計算する素子の一覧から外させる
+template <typename Element>
+void Simulation2D<Element>::setVias(int gridIndex, int row, int col, double vd)
+{
+    auto &grid = grids.at(gridIndex);
+    grid.getElement(row, col)->setVias(vd);
+    grid.refreshActiveSet();
+}
+
+// ステップごとのソルバーの反復回数・残差を記録するかを設定
+template <typename Element>
+void Simulation2D<Element>::setSolverLogging(bool flag)
+{
+    solverLogging = flag;
+    if (!flag)
+        solverLog.clear();
+}
+
+// ステップごとのソルバーの反復回数・残差の記録を取得
+template <typename Element>
+const std::vector<SolverStats> &Simulation2D<Element>::getSolverLog() const
+{
+    return solverLog;
+}
+
+// ソルバーの反復回数・残差の集計を取得
+template <typename Element>
+const SolverSummary &Simulation2D<Element>::getSolverSummary() const
+{
+    return solverSummary;
+}
+
+// ソルバーの1ステップ分の記録を集計に加える
+template <typename Element>
+void Simulation2D<Element>::recordSolverStats(const SolverStats &stats)
+{
+    solverSummary.add(stats);
+    if (solverLogging)
+        solverLog.push_back(stats);
+}
+
+// gridごとの並列計算のスレッド数を設定
+template <typename Element>
+void Simulation2D<Element>::setThreadCount(int threads)
+{
+    if (threads <= 0)
+        throw std::invalid_argument("Thread count must be positive");
+    threadPool = std::make_shared<ThreadPool>(threads);
+    potentialSolver->setThreadPool(threadPool);
+}
+
+// gridごとの並列計算のスレッド数を取得
+template <typename Element>
+int Simulation2D<Element>::getThreadCount() const
+{
+    return threadPool->size();
+}
+
+// grid内の並列計算の設定
+template <typename Element>
+void Simulation2D<Element>::setIntraGridParallel(bool flag)
+{
+    intraGridParallel = flag;
+    if (flag)
+    {
+        if (std::dynamic_pointer_cast<RedBlackSolver<Element>>(potentialSolver))
+            return;
+        solverBeforeIntraGrid = potentialSolver;
+        setPotentialSolver(std::make_shared<RedBlackSolver<Element>>());
+        intraGridSolver = potentialSolver;
+    }
+    else
+    {
+        if (intraGridSolver && potentialSolver == intraGridSolver)
+        {
+            // 元のソルバーはその間のgridの変更を知らないので、作り直させてから戻す
+            solverBeforeIntraGrid->reset();
+            setPotentialSolver(solverBeforeIntraGrid);
+        }
+        intraGridSolver.reset();
+        solverBeforeIntraGrid.reset();
+    }
+}
+
+// grid内の並列計算をしているかどうか
+template <typename Element>
+bool Simulation2D<Element>::isIntraGridParallel() const
+{
+    return intraGridParallel;
+}
+
+// 乱数のシードを設定
+template <typename Element>
+void Simulation2D<Element>::setSeed(std::uint64_t seed)
+{
+    randomSeed = seed;
+    seedSet = true;
+    applySeed();
+}
+
+// 乱数のシードを取得
+template <typename Element>
+std::uint64_t Simulation2D<Element>::getSeed() const
+{
+    return randomSeed;
+}
+
+// 乱数列をgridの素子・イベント駆動モード・Calculate_NNに割り当てる
+template <typename Element>
+void Simulation2D<Element>::applySeed()
+{
+    std::uint64_t firstIndex = 0;
+    for (auto &grid : grids)
+    {
+        grid.setRandomStreams(randomSeed, firstIndex);
+        firstIndex += static_cast<std::uint64_t>(grid.numRows()) * grid.numCols();
+    }
+    for (auto &leaf : leaves)
+        leaf.draws = 0;
+    selectorDraws = 0;
+    CalcNN.setSeed(randomSeed);
+}
+
+// チェックポイントの設定
+template <typename Element>
+void Simulation2D<Element>::setCheckpoint(const std::string &path, double interval, bool resume)
+{
+    if (!path.empty() && interval <= 0)
+        throw std::invalid_argument("Checkpoint interval must be positive");
+    checkpointPath = path;
+    checkpointInterval = interval;
+    nextCheckpointTime = t + interval;
+    resumeFromCheckpoint = resume;
+}
+
+// 今の状態をチェックポイントとして保存
+template <typename Element>
+void Simulation2D<Element>::saveCheckpoint(const std::string &path)
+{
+    if (syncLookahead > 0)
+        throw std::logic_error("saveCheckpoint: checkpoints are not supported while conservative sync is enabled");
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+        if (!ofs)
+            throw std::runtime_error("Cannot open checkpoint file: " + tmp);
+        CheckpointWriter out(ofs);
+        for (char c : checkpointMagic)
+            out.write(c);
+        out.write(checkpointVersion);
+
+        // 時刻とカウンタ
+        out.write(t);
+        out.write(cLt);
+        out.write(rt);
+        out.write(nextOutputTime);
+        out.write(nextCheckpointTime);
+        out.write(printLoop);
+        out.write(randomSeed);
+        out.write(seedSet);
+        out.write(selectorDraws);
+
+        // ソルバーの集計と記録
+        out.write(solverSummary.steps);
+        out.write(solverSummary.iterations);
+        out.write<std::int32_t>(solverSummary.maxIterations);
+        out.write(solverSummary.maxResidual);
+        out.write<std::int32_t>(solverSummary.last.iterations);
+        out.write(solverSummary.last.residual);
+        out.write<std::uint64_t>(solverLog.size());
+        for (const auto &stats : solverLog)
+        {
+            out.write<std::int32_t>(stats.iterations);
+            out.write(stats.residual);
+        }
+
+        // 素子の状態とニューラルネットワーク
+        out.write<std::uint64_t>(grids.size());
+        for (auto &grid : grids)
+            grid.saveState(out);
+        CalcNN.saveState(out);
+
+        // トリガ（gridはgridsの中の番号で保存する）
+        out.write<std::uint64_t>(voltageTriggers.size());
+        for (const auto &[gridPtr, triggerTime, y, x, voltage] : voltageTriggers)
+        {
+            std::int32_t g = -1;
+            for (int k = 0; k < static_cast<int>(grids.size()); ++k)
+            {
+                if (gridPtr == &grids[k] || (gridPtr && gridPtr->getElement(0, 0) == grids[k].getElement(0, 0)))
+                {
+                    g = k;
+                    break;
+                }
+            }
+            if (g < 0)
+                throw std::runtime_error("Trigger references a grid that is not in the simulation");
+            out.write(g);
+            out.write(triggerTime);
+            out.write<std::int32_t>(y);
+            out.write<std::int32_t>(x);
+            out.write(voltage);
+        }
+
+        // oyl-video用にためている出力
+        out.write<std::uint64_t>(outputs.size());
+        for (const auto &[label, frames] : outputs)
+        {
+            out.writeString(label);
+            out.write<std::uint64_t>(frames.size());
+            for (const auto &frame : frames)
+            {
+                out.write<std::uint64_t>(frame.size());
+                for (const auto &row : frame)
+                    out.writeVector(row);
+            }
+        }
+
+        // イベント駆動モード・差分更新モードの状態
+        // （leavesが空なら次のrunでbuildLeavesし直すので、ここには何も書かない）
+        out.write<std::uint64_t>(leaves.size());
+        if (!leaves.empty())
+        {
+            for (const auto &leaf : leaves)
+            {
+                out.write(leaf.rate);
+                out.write(leaf.direction);
+                out.write(leaf.draws);
+            }
+            out.writeVector(eventQueue.order());
+            out.writeVector(eventQueue.keyValues());
+        }
+        out.write<std::int32_t>(stepsSinceResync);
+        out.write<std::uint64_t>(dirtyByGrid.size());
+        for (const auto &dirty : dirtyByGrid)
+            out.writeVector(dirty);
+        out.write<std::uint64_t>(pendingDeltas.size());
+        for (const auto &[id, delta] : pendingDeltas)
+        {
+            out.write<std::int32_t>(id);
+            out.write(delta);
+        }
+        out.writeVector(dirtyFlag);
+        out.writeVector(touchedFlag);
+        out.writeVector(touchedList);
+
+        for (char c : checkpointMagic)
+            out.write(c);
+    }
+    // POSIXのrenameは既存のファイルを1回の操作で置き換えるので、途中で止まってもpathは古いか新しいかのどちらかになる
+    // 既存のファイルがあると失敗する環境（Windows）だけ、消してから置き直す
+    if (std::rename(tmp.c_str(), path.c_str()) != 0)
+    {
+        std::remove(path.c_str());
+        if (std::rename(tmp.c_str(), path.c_str()) != 0)
+            throw std::runtime_error("Cannot replace checkpoint file: " + path);
+    }
+}
+
+// チェックポイントを読み込む
+template <typename Element>
+bool Simulation2D<Element>::loadCheckpoint(const std::string &path)
+{
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs)
+        return false;
+    CheckpointReader in(ifs);
+    for (char c : checkpointMagic)
+        in.expect(c, "file format");
+    in.expect(checkpointVersion, "checkpoint version");
+
+    // ソルバーの準備で素子のVnが書き換わらないように、先に準備を済ませてから素子の状態を読み込む
+    potentialSolver->prepare(grids);
+
+    in.read(t);
+    in.read(cLt);
+    in.read(rt);
+    in.read(nextOutputTime);
+    in.read(nextCheckpointTime);
+    in.read(printLoop);
+    in.read(randomSeed);
+    in.read(seedSet);
+    in.read(selectorDraws);
+
+    in.read(solverSummary.steps);
+    in.read(solverSummary.iterations);
+    in.read<std::int32_t>(solverSummary.maxIterations);
+    in.read(solverSummary.maxResidual);
+    in.read<std::int32_t>(solverSummary.last.iterations);
+    in.read(solverSummary.last.residual);
+    solverLog.resize(in.read<std::uint64_t>());
+    for (auto &stats : solverLog)
+    {
+        in.read<std::int32_t>(stats.iterations);
+        in.read(stats.residual);
+    }
+
+    in.expect<std::uint64_t>(grids.size(), "number of grids");
+    for (auto &grid : grids)
+        grid.loadState(in);
+    conservativeSync.reset(); // 境界の履歴は保存しないので、読み込んだ値から始め直す
+    CalcNN.loadState(in);
+
+    std::uint64_t triggerCount = in.read<std::uint64_t>();
+    voltageTriggers.clear();
+    for (std::uint64_t k = 0; k < triggerCount; ++k)
+    {
+        std::int32_t g = in.read<std::int32_t>();
+        if (g < 0 || g >= static_cast<std::int32_t>(grids.size()))
+            throw std::runtime_error("checkpoint: trigger grid index out of range");
+        double triggerTime = in.read<double>();
+        int y = in.read<std::int32_t>();
+        int x = in.read<std::int32_t>();
+        double voltage = in.read<double>();
+        voltageTriggers.emplace_back(&grids[g], triggerTime, y, x, voltage);
+    }
+
+    outputs.clear();
+    std::uint64_t labelCount = in.read<std::uint64_t>();
+    for (std::uint64_t k = 0; k < labelCount; ++k)
+    {
+        auto &frames = outputs[in.readString()];
+        frames.resize(in.read<std::uint64_t>());
+        for (auto &frame : frames)
+        {
+            frame.resize(in.read<std::uint64_t>());
+            for (auto &row : frame)
+                row = in.readVector<double>();
+        }
+    }
+
+    std::uint64_t leafCount = in.read<std::uint64_t>();
+    leaves.clear();
+    if (leafCount > 0)
+    {
+        buildLeaves();
+        if (leafCount != leaves.size())
+            throw std::runtime_error("checkpoint: number of elements does not match the current simulation");
+        for (auto &leaf : leaves)
+        {
+            in.read(leaf.rate);
+            in.read(leaf.direction);
+            in.read(leaf.draws);
+        }
+        std::vector<int> order = in.readVector<int>();
+        eventQueue.restore(order, in.readVector<double>());
+        // 和の木は葉のレートだけで決まるので、保存せずに作り直す
+        for (int i = 0; i < static_cast<int>(leaves.size()); ++i)
+            rateTree.set(i, leaves[i].rate);
+    }
+    in.read<std::int32_t>(stepsSinceResync);
+    dirtyByGrid.resize(in.read<std::uint64_t>());
+    for (auto &dirty : dirtyByGrid)
+        dirty = in.readVector<int>();
+    pendingDeltas.resize(in.read<std::uint64_t>());
+    for (auto &[id, delta] : pendingDeltas)
+    {
+        in.read<std::int32_t>(id);
+        in.read(delta);
+    }
+    dirtyFlag = in.readVector<char>();
+    touchedFlag = in.readVector<char>();
+    touchedList = in.readVector<int>();
+
+    for (char c : checkpointMagic)
+        in.expect(c, "end marker");
+    return true;
+}
+
+// トンネルの選び方を設定
+template <typename Element>
+void Simulation2D<Element>::setEngineMode(EngineMode mode)
+{
+    if ((mode == EngineMode::Step) != (engineMode == EngineMode::Step))
+        incrementalUpdate = (mode != EngineMode::Step);
+    engineMode = mode;
+    leaves.clear();
+}
+
+// トンネルの選び方を取得
+template <typename Element>
+EngineMode Simulation2D<Element>::getEngineMode() const
+{
+    return engineMode;
+}
+
+// 電荷の更新方法を設定
+template <typename Element>
+void Simulation2D<Element>::setChargeIntegrator(ChargeIntegrator integrator)
+{
+    chargeIntegrator = integrator;
+}
+
+// 電荷の更新方法を取得
+template <typename Element>
+ChargeIntegrator Simulation2D<Element>::getChargeIntegrator() const
+{
+    return chargeIntegrator;
+}
+
+// トンネルが起きない間に一度に進める時間の上限を設定
+template <typename Element>
+void Simulation2D<Element>::setIdleJump(double maxJump)
+{
+    if (maxJump < 0)
+        throw std::invalid_argument("Idle jump must not be negative");
+    maxIdleJump = maxJump;
+}
+
+// 同時トンネルの幅を設定
+template <typename Element>
+void Simulation2D<Element>::setConcurrentWindow(double window)
+{
+    if (window < 0)
+        throw std::invalid_argument("Concurrent window must not be negative");
+    concurrentWindow = window;
+}
+
+// 同時トンネルの幅を取得
+template <typename Element>
+double Simulation2D<Element>::getConcurrentWindow() const
+{
+    return concurrentWindow;
+}
+
+// 保守的な並列離散イベント同期の設定
+template <typename Element>
+void Simulation2D<Element>::setConservativeSync(double lookahead, const std::vector<int> &groupOfGrid)
+{
+    if (lookahead < 0)
+        throw std::invalid_argument("Sync lookahead must not be negative");
+    syncLookahead = lookahead;
+    syncGroups = groupOfGrid;
+    conservativeSync.reset();
+}
+
+// 保守的な同期のlookaheadを取得
+template <typename Element>
+double Simulation2D<Element>::getSyncLookahead() const
+{
+    return syncLookahead;
+}
+
+// 全グループを次の出力時刻まで進める（calcLの時刻を越えない）
+// グループ分けとグループごとの実行プランは最初に呼ばれたときに作る（その時点の素子の値が境界の始めの値になる）
+template <typename Element>
+void Simulation2D<Element>::advanceConservative()
+{
+    auto jacobi = std::dynamic_pointer_cast<JacobiSolver<Element>>(potentialSolver);
+    if (!jacobi || engineMode != EngineMode::Step || incrementalUpdate || concurrentWindow > 0)
+        throw std::logic_error("Conservative sync needs the Step engine with a JacobiSolver (no incremental update or concurrent window)");
+    if (!conservativeSync)
+        conservativeSync = std::make_shared<ConservativeSync<Element>>(grids, syncGroups, syncLookahead, jacobi->getMaxSweeps(), jacobi->getTolerance(), t);
+
+    double target = nextOutputTime;
+    if (t < endtime)
+        target = std::min(target, endtime);
+    if (target <= t)
+        target = t + outputInterval;
+    // runがcalcLを行う時刻を越えない（idleStepTimeと同じく、過ぎていれば無視し、残りがdtより短ければdtだけ進める）
+    if (cLt <= calcL_time)
+        target = std::min(target, t + std::max(calcL_time - cLt, dt));
+    conservativeSync->advance(target, dt, chargeIntegrator, *threadPool,
+                              [&](double time, int gridIndex, int elementIndex, TunnelDirection direction)
+                              {
+                                  TunnelEvent event;
+                                  event.gridIndex = gridIndex;
+                                  event.elementIndex = elementIndex;
+                                  event.direction = direction;
+                                  logTunnel(event, time);
+                              });
+    cLt += target - t;
+    rt += target - t;
+    t = target;
+}
+
+// oyl-video形式の出力の間隔を設定
+template <typename Element>
+void Simulation2D<Element>::setOutputInterval(double interval)
+{
+    if (interval <= 0)
+        throw std::invalid_argument("Output interval must be positive");
+    outputInterval = interval;
+}
+
+// トンネルが起きなかったステップで進める時間
+// どの素子もdt以内にdEが正にならなければ、最も早く正になる時刻まで進める（指数関数の式ならdtより長く進めても安定）
+// 出力・calcL・終了の時刻は飛び越さない
+template <typename Element>
+double Simulation2D<Element>::idleStepTime()
+{
+    if (chargeIntegrator != ChargeIntegrator::Exponential || maxIdleJump <= dt)
+        return dt;
+    double jump = std::min({maxIdleJump, nextOutputTime - t, endtime - t});
+    // runがcalcLを行う時刻（runStepだけを呼ぶ場合はcLtが戻らないので、過ぎていれば無視する）
+    if (cLt <= calcL_time)
+        jump = std::min(jump, calcL_time - cLt);
+    if (jump <= dt)
+        return dt;
+    std::vector<double> earliest(grids.size());
+    threadPool->parallelFor(static_cast<int>(grids.size()), [&](int g) { earliest[g] = grids[g].timeToThreshold(); });
+    for (double h : earliest)
+        jump = std::min(jump, h);
+    return std::max(jump, dt);
+}
+
+// イベント駆動モード・差分更新モード用の素子リストを作る
+// OnewayUnitは内部の4素子をそれぞれ独立した素子として登録する
+// 接続の逆引き（誰のV_sumに自分のVnが入っているか）もここで作るので、接続の設定が終わってから呼ぶ
+template <typename Element>
+void Simulation2D<Element>::buildLeaves()
+{
+    leaves.clear();
+    leafIndexOf.clear();
+    for (int g = 0; g < static_cast<int>(grids.size()); ++g)
+    {
+        auto &grid = grids[g];
+        for (int y = 0; y < grid.numRows(); ++y)
+        {
+            for (int x = 0; x < grid.numCols(); ++x)
+            {
+                std::shared_ptr<BaseElement> elem = grid.getElement(y, x);
+                int index = y * grid.numCols() + x;
+                if (auto unit = std::dynamic_pointer_cast<OnewayUnit>(elem))
+                {
+                    // OnewayUnitのポインタは代表の素子0（getVnが返す素子）に対応させる
+                    leafIndexOf.emplace(unit.get(), static_cast<int>(leaves.size()));
+                    for (const auto &internal : unit->getInternalElements())
+                    {
+                        leafIndexOf.emplace(internal.get(), static_cast<int>(leaves.size()));
+                        leaves.push_back({internal, g, index, 0.0, TunnelDirection::None});
+                    }
+                }
+                else
+                {
+                    leafIndexOf.emplace(elem.get(), static_cast<int>(leaves.size()));
+                    leaves.push_back({elem, g, index, 0.0, TunnelDirection::None});
+                }
+            }
+        }
+    }
+    int n = static_cast<int>(leaves.size());
+    eventQueue.resize(n);
+    rateTree.resize(n);
+
+    // 接続の逆引きをCSR形式で作る（gridの外の素子はVnが変わらないので除く）
+    std::vector<std::pair<int, int>> edges; // (接続先, 自分)
+    for (int i = 0; i < n; ++i)
+    {
+        for (const auto &conn : leaves[i].elem->getConnections())
+        {
+            auto found = leafIndexOf.find(conn.get());
+            if (found != leafIndexOf.end())
+                edges.emplace_back(found->second, i);
+        }
+    }
+    dependentOffset.assign(n + 1, 0);
+    for (const auto &[src, dst] : edges)
+        dependentOffset[src + 1]++;
+    for (int i = 0; i < n; ++i)
+        dependentOffset[i + 1] += dependentOffset[i];
+    dependentList.assign(edges.size(), 0);
+    std::vector<int> fill(dependentOffset.begin(), dependentOffset.end() - 1);
+    for (const auto &[src, dst] : edges)
+        dependentList[fill[src]++] = dst;
+
+    dirtyByGrid.assign(grids.size(), {});
+    pendingDeltas.clear();
+    dirtyFlag.assign(n, 0);
+    touchedFlag.assign(n, 0);
+    touchedList.clear();
+    stepsSinceResync = 0;
+}
+
+// 差分更新モードの設定
+template <typename Element>
+void Simulation2D<Element>::setIncrementalUpdate(bool flag)
+{
+    incrementalUpdate = flag;
+    leaves.clear();
+}
+
+// 差分更新モードかどうか
+template <typename Element>
+bool Simulation2D<Element>::isIncrementalUpdate() const
+{
+    return incrementalUpdate;
+}
+
+// 差分更新モードでV_sumを全て取り直す間隔（ステップ数）を設定
+template <typename Element>
+void Simulation2D<Element>::setResyncInterval(int steps)
+{
+    if (steps <= 0)
+        throw std::invalid_argument("Resync interval must be positive");
+    resyncInterval = steps;
+}
+
+// 素子に今のsweepで再計算する印をつける
+template <typename Element>
+void Simulation2D<Element>::markDirty(int id)
+{
+    if (!dirtyFlag[id])
+    {
+        dirtyFlag[id] = 1;
+        dirtyByGrid[leaves[id].gridIndex].push_back(id);
+    }
+    markTouched(id);
+}
+
+// 素子にこのステップで変化した印をつける
+template <typename Element>
+void Simulation2D<Element>::markTouched(int id)
+{
+    if (!touchedFlag[id])
+    {
+        touchedFlag[id] = 1;
+        touchedList.push_back(id);
+    }
+}
 
-    // selectedElementsから該当する素子のVnを記録するファイル出力
-    void outputSelectedElements();
+// V_sumを全て取り直して全素子に印をつける
+template <typename Element>
+void Simulation2D<Element>::resyncIncremental()
+{
+    pendingDeltas.clear();
+    for (int i = 0; i < static_cast<int>(leaves.size()); ++i)
+    {
+        leaves[i].elem->setSurroundingVoltages();
+        markDirty(i);
+    }
+    stepsSinceResync = 0;
+}
 
-    // gnuplot用データ出力
-    void generateGnuplotScript(const std::string& dataFilename, const std::vector<std::string>& labels);
+// 差分更新モードでのVn・dEの計算
+// 従来のrunStepと同じく5回のsweepを行い、各sweepではgridの順に「V_sumの取得→Vnの計算」を行う。
+// ただしVnが変わった素子だけがδを接続先のV_sumに足し込み、印のついた素子だけが再計算される。
+//  ・後ろのgridへのδは同じsweepの中で、同じgridや前のgridへのδは次のsweepの始めに足し込む（従来のV_sumの取得と同じ順序）
+//  ・5回目のsweepのδは次のステップの1回目のsweepまで持ち越す（従来もdEは5回目のsweep前のV_sumで計算している）
+// Q・V_sumが変わらない素子はVn・dEも変わらないので、結果は従来の計算と（足し込みの丸め誤差を除いて）一致する
+template <typename Element>
+void Simulation2D<Element>::relaxIncremental()
+{
+    if (leaves.empty())
+    {
+        buildLeaves();
+        resyncIncremental();
+    }
+    else if (++stepsSinceResync >= resyncInterval)
+    {
+        resyncIncremental();
+    }
 
-    // 実行中の進捗状況を表示する
-    void printProgressBar();
+    std::vector<std::pair<int, double>> deltas;
+    std::vector<std::pair<int, double>> deferred;
+    for (int i = 0; i < 5; i++)
+    {
+        // 前のsweepからのδを足し込む
+        deferred.swap(pendingDeltas);
+        pendingDeltas.clear();
+        for (const auto &[dep, delta] : deferred)
+        {
+            auto &depElem = leaves[dep].elem;
+            depElem->setVsum(depElem->getSurroundingVsum() + delta);
+            markDirty(dep);
+        }
 
-    //結果表示ファイル
-    void writeresFile();
+        for (int g = 0; g < static_cast<int>(grids.size()); ++g)
+        {
+            // 同じgridの中では全てのVnを計算してから足し込む
+            deltas.clear();
+            for (int id : dirtyByGrid[g])
+            {
+                dirtyFlag[id] = 0;
+                auto &elem = leaves[id].elem;
+                double old = elem->getVn();
+                elem->setPcalc();
+                double delta = elem->getVn() - old;
+                if (delta != 0.0)
+                    deltas.emplace_back(id, delta);
+            }
+            dirtyByGrid[g].clear();
 
-};
+            for (const auto &[id, delta] : deltas)
+            {
+                for (int k = dependentOffset[id]; k < dependentOffset[id + 1]; ++k)
+                {
+                    int dep = dependentList[k];
+                    if (leaves[dep].gridIndex > g)
+                    {
+                        auto &depElem = leaves[dep].elem;
+                        depElem->setVsum(depElem->getSurroundingVsum() + delta);
+                        markDirty(dep);
+                    }
+                    else
+                    {
+                        pendingDeltas.emplace_back(dep, delta);
+                    }
+                }
+            }
+        }
+    }
 
+    // QかV_sumが変わった素子だけdEを計算
+    for (int id : touchedList)
+        leaves[id].elem->setdEcalc();
+}
 
-// コンストラクタ
+// 差分更新モードでの電荷の更新（Vd != VnならQが変わるので印をつける）
 template <typename Element>
-Simulation2D<Element>::Simulation2D(double dT, double EndTime)
-    : t(0.0), dt(dT), cLt(0.0), rt(0.0), endtime(EndTime), outputInterval(dT), nextOutputTime(0.0), CalcNN(Cost) {}
+void Simulation2D<Element>::chargeIncremental(double steptime)
+{
+    for (int i = 0; i < static_cast<int>(leaves.size()); ++i)
+    {
+        auto &elem = leaves[i].elem;
+        if (elem->getVd() != elem->getVn())
+            markDirty(i);
+        if (chargeIntegrator == ChargeIntegrator::Exponential)
+            elem->setNodeChargeExp(steptime);
+        else
+            elem->setNodeCharge(steptime);
+    }
+}
 
-// 最小wtをもつgridを探索する（最小wtがdtより小さいかどうかのbool, 最小のwtを持つgrid）
+// 差分更新モードでトンネルした素子に印をつける
 template <typename Element>
-std::pair<bool, std::shared_ptr<Grid2D<Element>>> Simulation2D<Element>::comparewt()
+void Simulation2D<Element>::markTunnelDirty(const TunnelEvent &event)
 {
-    double minwt = dt;
-    std::shared_ptr<Grid2D<Element>> tunnelgrid = nullptr;
-    for (auto &grid : grids)
+    const BaseElement *target = event.target;
+    int count = 1;
+    if (!target)
+    {
+        auto &grid = grids[event.gridIndex];
+        std::shared_ptr<BaseElement> cell = grid.getElement(event.elementIndex / grid.numCols(), event.elementIndex % grid.numCols());
+        target = cell.get();
+        // OnewayUnitはどの内部素子がトンネルしたか分からないので4つとも印をつける
+        if (std::dynamic_pointer_cast<OnewayUnit>(cell))
+            count = 4;
+    }
+    int first = leafIndexOf.at(target);
+    for (int i = first; i < first + count; ++i)
+        markDirty(i);
+}
+
+// イベント駆動モードで次のトンネルを取り出す
+// 各素子は「次にトンネルする絶対時刻」をヒープに持つ。レートが変わった素子は残り時間をレートの比で伸縮する
+// （指数分布の無記憶性より、毎ステップ引き直す従来の方法と同じ分布になる）
+// 乱数を引くのはレートが0から正になった素子だけ
+template <typename Element>
+std::pair<bool, TunnelEvent> Simulation2D<Element>::nextQueuedEvent()
+{
+    if (leaves.empty())
+        buildLeaves();
+
+    auto refresh = [&](int i)
     {
-        if (grid.gridminwt(dt))
+        auto &leaf = leaves[i];
+        auto [direction, rate] = leaf.elem->getTunnelRate();
+        if (rate <= 0)
         {
-            double candidate = grid.getMinWT();
-            if (candidate < minwt)
+            if (leaf.rate > 0)
             {
-                minwt = candidate;
-                tunnelgrid = std::make_shared<Grid2D<Element>>(grid);
+                eventQueue.remove(i);
+                leaf.rate = 0.0;
             }
+            return;
+        }
+        if (leaf.rate <= 0)
+        {
+            // 新しくトンネル可能になった素子は待ち時間を引く
+            double u = counterUniform(randomSeed, rngStream(RngDomain::EventQueue, i), leaf.draws++);
+            eventQueue.push(i, t + std::log(1 / u) / rate);
+        }
+        else if (rate != leaf.rate)
+        {
+            // 残り時間をレートの比で伸縮
+            double remaining = std::max(0.0, eventQueue.key(i) - t);
+            eventQueue.update(i, t + remaining * leaf.rate / rate);
         }
+        leaf.rate = rate;
+        leaf.direction = direction;
+    };
+    if (incrementalUpdate)
+    {
+        // 差分更新モードではdEが変わった素子だけレートが変わる
+        for (int i : touchedList)
+            refresh(i);
+    }
+    else
+    {
+        // ソルバーで全素子のVnを計算し直した場合（setIncrementalUpdate(false)）はどの素子のレートも変わりうる
+        for (int i = 0; i < static_cast<int>(leaves.size()); ++i)
+            refresh(i);
     }
-    if (minwt < dt) return {true, tunnelgrid};
-    return {false, nullptr};
-}
 
+    if (eventQueue.empty() || eventQueue.topKey() - t >= dt)
+        return {false, TunnelEvent{}};
+
+    int i = eventQueue.top();
+    auto &leaf = leaves[i];
+    TunnelEvent event;
+    event.gridIndex = leaf.gridIndex;
+    event.elementIndex = leaf.elementIndex;
+    event.direction = leaf.direction;
+    event.wt = std::max(0.0, eventQueue.topKey() - t);
+    event.target = leaf.elem.get();
+    // トンネルした素子は次のステップで待ち時間を引き直す
+    eventQueue.remove(i);
+    leaf.rate = 0.0;
+    return {true, event};
+}
 
-// トンネル処理を実行
+// BKL法で次のトンネルを選ぶ
+// レートが変わった素子だけ和の木を更新し、合計レートRから待ち時間 -ln(u1) / R を引く
+// dt以内なら、累積和が u2 * R を超える素子をトンネルさせる（素子ごとに待ち時間を引いて最小を取る方法と同じ分布）
+// dt以内に起こらなければ、無記憶性よりdtだけ進めて次のステップで引き直してよい
 template <typename Element>
-void Simulation2D<Element>::handleTunnels(Grid2D<Element> &tunnelgrid)
+std::pair<bool, TunnelEvent> Simulation2D<Element>::nextRateTreeEvent()
 {
-    auto ptr = tunnelgrid.getTunnelPlace();
-    //----------------トンネル場所の記録--------------------------------
-    auto [y, x] = tunnelgrid.getPositionOf(ptr);
-    if (((x + 1) % tenthlane == 0 ) && (y % (WideLane + 1) == CenterLane)){  //レーン長XSIZEを10分割して各場所に到達したらカウント+1
-        CalcNN.Ctvk[y / (WideLane + 1)] += 1;
-        if (CalcNN.Nvk[y / (WideLane + 1)] < 30){
-            CalcNN.Nvk[y / (WideLane + 1)] += 1;
-        }else{
-            //NR
-        }
+    if (leaves.empty())
+        buildLeaves();
+
+    auto refresh = [&](int i)
+    {
+        auto &leaf = leaves[i];
+        auto [direction, rate] = leaf.elem->getTunnelRate();
+        rate = std::max(rate, 0.0);
+        if (rate != leaf.rate)
+            rateTree.set(i, rate);
+        leaf.rate = rate;
+        leaf.direction = direction;
+    };
+    if (incrementalUpdate)
+    {
+        // 差分更新モードではdEが変わった素子だけレートが変わる
+        for (int i : touchedList)
+            refresh(i);
     }
-    std::ofstream log("../output/tunnel_log.txt", std::ios::app);
-    if (log.is_open()) {
-        log << "t=" << t
-            << ", x=" << x
-            << ", y=" << y
-            << ", dir=" << tunnelgrid.getTunnelDirection()
-            << ", grid=" << tunnelgrid.getOutputLabel()
-            << std::endl;
+    else
+    {
+        for (int i = 0; i < static_cast<int>(leaves.size()); ++i)
+            refresh(i);
     }
-    //-----------------------------------------------------------------
-    // 実際のトンネル処理
-    ptr->setTunnel(tunnelgrid.getTunnelDirection());
+
+    double total = rateTree.total();
+    if (!(total > 0))
+        return {false, TunnelEvent{}};
+    std::uint64_t stream = rngStream(RngDomain::RateTree, 0);
+    double wt = std::log(1 / counterUniform(randomSeed, stream, selectorDraws++)) / total;
+    if (wt >= dt)
+        return {false, TunnelEvent{}};
+
+    // counterUniformは(0, 1]なので、1から引いて[0, 1)にする
+    int i = rateTree.find((1.0 - counterUniform(randomSeed, stream, selectorDraws++)) * total);
+    auto &leaf = leaves[i];
+    TunnelEvent event;
+    event.gridIndex = leaf.gridIndex;
+    event.elementIndex = leaf.elementIndex;
+    event.direction = leaf.direction;
+    event.wt = wt;
+    event.target = leaf.elem.get();
+    return {true, event};
 }
 
 // ファイルを開く
@@ -279,9 +1564,10 @@ void Simulation2D<Element>::outputTooyl()
             std::vector<std::vector<double>> vnGrid(rows - 2, std::vector<double>(cols - 2));
             for (int i = 1; i < rows - 1; ++i)
             {
+                const auto *row = grid.rowBegin(i);
                 for (int j = 1; j < cols - 1; ++j)
                 {
-                    auto elem = grid.getElement(i, j);
+                    const auto &elem = row[j];
                     double vn = elem->getVn();
                     double vd = elem->getVd();
             
@@ -313,42 +1599,102 @@ void Simulation2D<Element>::runStep()
     // ファイル出力
     outputSelectedElements();
     
+    if (syncLookahead > 0)
+    {
+        // グループごとに自分の時計で次の出力時刻まで進める
+        advanceConservative();
+        return;
+    }
 
-    // grid全体のVn計算(5回計算してならす)
-    for (int i = 0; i < 5; i++)
+    if (incrementalUpdate)
     {
-        for (auto &grid : grids)
-        {
-            // 接続されている電圧を更新
-            grid.updateGridSurVn();
-            // トリガの適用
-            // applyVoltageTriggers();   トリガないからコメントアウト
-            // 電圧を更新
-            grid.updateGridVn();
-        }
+        // 変化のあった素子の周りだけVn・dEを計算
+        relaxIncremental();
+    }
+    else if (executionPlan)
+    {
+        // compileした実行プランでVnとdEを計算
+        recordSolverStats(executionPlan->execute(*threadPool));
     }
+    else
+    {
+        // grid全体のVn計算（デフォルトは5回計算してならす）
+        // トリガの適用
+        // applyVoltageTriggers();   トリガないからコメントアウト
+        recordSolverStats(potentialSolver->solve(grids));
 
-    // grid全体のdE計算
-    for (auto &grid : grids)
-    {    
-        // if(t > 150 && t < 151) cout << "t = " << t << " dE = " << grid.getElement(15,15)->getdE()["up"] << endl;
-        grid.updateGriddE();
+        // grid全体のdE計算
+        if (intraGridParallel)
+        {
+            for (auto &grid : grids)
+                grid.updateGriddE(*threadPool);
+        }
+        else
+        {
+            threadPool->parallelFor(static_cast<int>(grids.size()), [&](int g)
+            {
+                // if(t > 150 && t < 151) cout << "t = " << t << " dE = " << grids[g].getElement(15,15)->getdE()["up"] << endl;
+                grids[g].updateGriddE();
+            });
+        }
     }
 
 
 
     // wtの計算と比較
-    auto compared = this->comparewt();
+    std::pair<bool, TunnelEvent> compared;
+    if (engineMode == EngineMode::EventQueue)
+        compared = nextQueuedEvent();
+    else if (engineMode == EngineMode::RateTree)
+        compared = nextRateTreeEvent();
+    else if (concurrentWindow > 0)
+        compared = compareConcurrent();
+    else
+        compared = this->comparewt();
+    if (incrementalUpdate)
+    {
+        // このステップの変化の印を消す（以降の電荷の更新とトンネルで次のステップの印がつく）
+        for (int id : touchedList)
+            touchedFlag[id] = 0;
+        touchedList.clear();
+    }
     if (compared.first)
     {
-        handleTunnels(*compared.second);
-        steptime = compared.second->getMinWT();
+        handleTunnels(compared.second);
+        steptime = compared.second.wt;
+        if (incrementalUpdate)
+            markTunnelDirty(compared.second);
+        // 同時トンネルモードで選んだ残りの素子
+        for (const auto &event : concurrentEvents)
+        {
+            handleTunnels(event);
+            if (incrementalUpdate)
+                markTunnelDirty(event);
+        }
+        concurrentEvents.clear();
+    }
+    else
+    {
+        // トンネルが無ければ、次にトンネルできるようになる時刻まで進められる
+        steptime = idleStepTime();
     }
 
     // チャージの計算
-    for (auto &grid : grids)
+    if (incrementalUpdate)
+    {
+        chargeIncremental(steptime);
+    }
+    else
     {
-        grid.updateGridQn(steptime);
+        if (intraGridParallel)
+        {
+            for (auto &grid : grids)
+                grid.updateGridQn(steptime, *threadPool, chargeIntegrator);
+        }
+        else
+        {
+            threadPool->parallelFor(static_cast<int>(grids.size()), [&](int g) { grids[g].updateGridQn(steptime, chargeIntegrator); });
+        }
     }
 
     // tの増加
@@ -362,16 +1708,54 @@ template <typename Element>
 void Simulation2D<Element>::addGrid(const std::vector<Grid2D<Element>> &Gridinstance)
 {
     grids = Gridinstance;
+    leaves.clear();
+    potentialSolver->reset();
+    executionPlan.reset();
+    circuitGraph.reset();
+    conservativeSync.reset();
+    if (seedSet)
+        applySeed();
+}
+
+// 回路のグラフを1行のgridとして登録
+template <typename Element>
+void Simulation2D<Element>::addGraph(const CircuitGraph &graph, const std::string &label)
+{
+    if (!grids.empty())
+        throw std::logic_error("addGraph: grids are already registered (use a new Simulation2D for a graph)");
+    if (graph.numNodes() == 0)
+        throw std::invalid_argument("addGraph: the graph has no nodes");
+    Grid2D<Element> grid(1, graph.numNodes(), false);
+    grid.setOutputLabel(label);
+    for (int i = 0; i < graph.numNodes(); ++i)
+    {
+        auto elem = std::dynamic_pointer_cast<Element>(graph.getElement(i));
+        if (!elem)
+            throw std::invalid_argument("addGraph: node " + std::to_string(i) + " does not hold the simulation's element type");
+        grid.setElement(0, i, elem);
+    }
+    addGrid({grid});
+    circuitGraph = std::make_shared<const CircuitGraph>(graph);
+}
+
+// 3次元グリッドを層を縦に並べたgridとして登録
+template <typename Element>
+void Simulation2D<Element>::addGrid3D(const Grid3D<Element> &grid)
+{
+    if (!grid.isRedBlackColourable() && std::dynamic_pointer_cast<RedBlackSolver<Element>>(potentialSolver))
+        throw std::logic_error("addGrid3D: the stencil connects elements of the same colour, so red-black ordering cannot be used");
+    addGrid({grid.getFlatGrid()});
 }
 
 // 全体シミュレーションの実行
 template <typename Element>
 void Simulation2D<Element>::run()
 {
-    int printloop = 0;
+    if (!checkpointPath.empty() && resumeFromCheckpoint)
+        loadCheckpoint(checkpointPath);
     while (t < endtime)
     {
-        if(printloop > 15){  //15nsごとに表示
+        if(printLoop > 15){  //15nsごとに表示
             
             std::cout << t << "[ns]" <<std::endl;
             for(int i=0;i<N;i++){
@@ -383,14 +1767,14 @@ void Simulation2D<Element>::run()
                 std::cout << i << " : X=" << CalcNN.Xvk[i] <<", dX=" << CalcNN.dX[i] << ", Lvk=" << CalcNN.Lvk[i] <<"\n";
                 }
             }
-            printloop = 0;
+            printLoop = 0;
         }
 
 
 
         if (calcL_time < cLt){  //calcL_time毎にcalcLを行う
             CalcNN.calcL();
-            printloop++;
+            printLoop++;
             applychangeVd();
             if (reset_time < rt){
                 resetfunction();
@@ -401,6 +1785,12 @@ void Simulation2D<Element>::run()
 
         runStep();
         printProgressBar();
+        if (!checkpointPath.empty() && t >= nextCheckpointTime)
+        {
+            while (nextCheckpointTime <= t)
+                nextCheckpointTime += checkpointInterval;
+            saveCheckpoint(checkpointPath);
+        }
     }
 }
 
@@ -414,6 +1804,13 @@ void Simulation2D<Element>::printCt() {
 }
 */
 
+// 現在の時刻を取得
+template <typename Element>
+double Simulation2D<Element>::getTime() const
+{
+    return t;
+}
+
 // グリッド取得
 template <typename Element>
 std::vector<Grid2D<Element>> &Simulation2D<Element>::getGrids()
@@ -458,7 +1855,6 @@ void Simulation2D<Element>::applyVoltageTriggers()
 template <typename Element>
 void Simulation2D<Element>::applychangeVd(){
     double biasVd = 0;
-    std::shared_ptr<Element> chseo;
     //経路幅調整
     for (auto &grid : grids)
     {    
@@ -469,13 +1865,11 @@ void Simulation2D<Element>::applychangeVd(){
                         // Center下側
                         biasVd = (((vk * (WideLane + 1) + y) + x) % 2 == 0) ? 0.003 : -0.003;
                         //applyVd
-                        chseo = grid.getElement((vk * (WideLane + 1) + y), x);
-                        chseo->setVias(biasVd);
+                        grid.rowBegin(vk * (WideLane + 1) + y)[x]->setVias(biasVd);
 
                         // Center上側
                         biasVd = ((((vk + 1) * (WideLane + 1) - y) + x) % 2 == 0) ? 0.003 : -0.003;
-                        chseo = grid.getElement(((vk + 1) * (WideLane + 1) - y), x);
-                        chseo->setVias(biasVd);
+                        grid.rowBegin((vk + 1) * (WideLane + 1) - y)[x]->setVias(biasVd);
                     }
                 }
             }else{
@@ -484,17 +1878,17 @@ void Simulation2D<Element>::applychangeVd(){
                         // Center下側
                         biasVd = (((vk * (WideLane + 1) + y) + x) % 2 == 0) ? Vd : -Vd;
                         //applyVd
-                        chseo = grid.getElement((vk * (WideLane + 1) + y), x);
-                        chseo->setVias(biasVd);
+                        grid.rowBegin(vk * (WideLane + 1) + y)[x]->setVias(biasVd);
 
                         // Center上側
                         biasVd = ((((vk + 1) * (WideLane + 1) - y) + x) % 2 == 0) ? Vd : -Vd;
-                        chseo = grid.getElement(((vk + 1) * (WideLane + 1) - y), x);
-                        chseo->setVias(biasVd);
+                        grid.rowBegin((vk + 1) * (WideLane + 1) - y)[x]->setVias(biasVd);
                     }
                 }
             }  
         }
+        // Vdを0にした素子が計算から外れるように（動き出した素子はgridが自分で計算に入れる）
+        grid.refreshActiveSet();
     }
 }
 
@@ -529,7 +1923,7 @@ void Simulation2D<Element>::resetfunction(){
 
 
 //一般関数（下のファイル出力名に使う）
-std::string sanitizeTimeString(const std::string& raw) {
+inline std::string sanitizeTimeString(const std::string& raw) {
     // ファイル名で使えない文字（スペースやコロン）をアンダースコアに置換
     std::string s = raw;
     std::replace(s.begin(), s.end(), ' ', '_');
@@ -684,4 +2078,264 @@ void Simulation2D<Element>::printProgressBar(){
     }
 }
 
+//---------------------------------------------------------------------------------------------------
+// SEOArrayを使うSimulation2Dの特殊化
+// Grid2D<SEOArray>のgridを従来のStepモードで計算する（5回のJacobiでVnをならし、全gridで最小のwtを持つ素子を
+// 1つトンネルさせ、Eulerで電荷を更新する）。計算の順番はSimulation2D<SEO>と同じなので、同じ回路・同じシードなら
+// 同じトンネルの列になる（SEOArrayのsetBatchedSampling(false)のとき。既定のbatchLogでは待ち時間の対数の丸めだけが違う）
+// 接続は同じgridの中だけで、イベント駆動モード・ソルバーの切り替え・チェックポイント・Calculate_NNの計算は無い
+//---------------------------------------------------------------------------------------------------
+template <>
+class Simulation2D<SEOArray>
+{
+private:
+    double t;                                  // 現在の時間
+    double dt;                                 // 基本刻み
+    double endtime;                            // 終了時刻
+    double outputInterval;                     // 出力間隔
+    double nextOutputTime;                     // 次に出力すべき時刻
+    std::vector<Grid2D<SEOArray>> grids;       // Grid2Dのインスタンス配列
+    // oyl-video形式のデータ（ラベル名 → [timeframe][y][x]）
+    std::map<std::string, std::vector<std::vector<std::vector<double>>>> outputs;
+    // gridごとの並列計算に使うスレッドプール（1スレッドなら直列）
+    std::shared_ptr<ThreadPool> threadPool = std::make_shared<ThreadPool>(1);
+    std::vector<char> gridHasTunnel; // comparewtでgridごとにdt以内のトンネルがあったか
+    bool intraGridParallel = false;  // trueならgridを順に処理し、grid内を行の帯に分けて並列に計算する
+    std::uint64_t randomSeed = defaultRandomSeed();
+    bool seedSet = false;
+    std::uint64_t tunnelCount = 0;   // トンネルの回数
+    GridLayout gridLayout = GridLayout::RowMajor; // SEOのgridを変換するときの素子の並べ方
+    int gridTileSize = 32;                        // Tiledのタイルの1辺
+
+    // 乱数列をgridの素子に割り当てる（Simulation2D<SEO>と同じ通し番号）
+    void applySeed()
+    {
+        std::uint64_t firstIndex = 0;
+        for (auto &grid : grids)
+        {
+            grid.setRandomStreams(randomSeed, firstIndex);
+            firstIndex += static_cast<std::uint64_t>(grid.numRows()) * grid.numCols();
+        }
+    }
+
+    // Vnを5回のJacobiでならす（JacobiSolverの既定と同じ順番）
+    void relax()
+    {
+        int n = static_cast<int>(grids.size());
+        for (int sweep = 0; sweep < 5; ++sweep)
+        {
+            if (intraGridParallel)
+            {
+                for (auto &grid : grids)
+                {
+                    grid.updateGridSurVn(*threadPool);
+                    grid.updateGridVn(*threadPool);
+                }
+            }
+            else
+            {
+                // 接続は同じgridの中だけなので、gridごとに独立に計算できる
+                threadPool->parallelFor(n, [&](int g)
+                {
+                    grids[g].updateGridSurVn();
+                    grids[g].updateGridVn();
+                });
+            }
+        }
+    }
+
+public:
+    // コンストラクタ(刻み時間,シミュレーションの終了タイミング)
+    Simulation2D(double dT, double EndTime) : t(0.0), dt(dT), endtime(EndTime), outputInterval(dT), nextOutputTime(0.0) {}
+
+    // wtの比較（gridごとの最小wtを求め、gridの順に比較する。同じwtなら番号の小さいgridを選ぶ）
+    std::pair<bool, TunnelEvent> comparewt()
+    {
+        int n = static_cast<int>(grids.size());
+        gridHasTunnel.assign(n, 0);
+        if (intraGridParallel)
+        {
+            for (int g = 0; g < n; ++g)
+                gridHasTunnel[g] = grids[g].gridminwt(dt, *threadPool);
+        }
+        else
+        {
+            threadPool->parallelFor(n, [&](int g) { gridHasTunnel[g] = grids[g].gridminwt(dt); });
+        }
+
+        TunnelEvent event;
+        event.wt = dt;
+        for (int g = 0; g < n; ++g)
+        {
+            if (gridHasTunnel[g] && grids[g].getMinWT() < event.wt)
+            {
+                event.gridIndex = g;
+                event.elementIndex = grids[g].getTunnelIndex();
+                event.direction = grids[g].getTunnelDirection();
+                event.wt = grids[g].getMinWT();
+            }
+        }
+        return {event.gridIndex >= 0, event};
+    }
+
+    // シミュレーションの1ステップ
+    void runStep()
+    {
+        outputTooyl();
+        relax();
+        if (intraGridParallel)
+        {
+            for (auto &grid : grids)
+                grid.updateGriddE(*threadPool);
+        }
+        else
+        {
+            threadPool->parallelFor(static_cast<int>(grids.size()), [&](int g) { grids[g].updateGriddE(); });
+        }
+
+        double steptime = dt;
+        auto compared = comparewt();
+        if (compared.first)
+        {
+            grids[compared.second.gridIndex].applyTunnel();
+            steptime = compared.second.wt;
+            ++tunnelCount;
+        }
+
+        if (intraGridParallel)
+        {
+            for (auto &grid : grids)
+                grid.updateGridQn(steptime, *threadPool);
+        }
+        else
+        {
+            threadPool->parallelFor(static_cast<int>(grids.size()), [&](int g) { grids[g].updateGridQn(steptime); });
+        }
+        t += steptime;
+    }
+
+    // シミュレーションの実行
+    void run()
+    {
+        while (t < endtime)
+            runStep();
+    }
+
+    // シミュレーションにgridを追加
+    void addGrid(const std::vector<Grid2D<SEOArray>> &Gridinstance)
+    {
+        grids = Gridinstance;
+        if (seedSet)
+            applySeed();
+    }
+
+    // SEOのgridをSEOArrayに変換して追加（接続は同じgridのSEOに限る。素子はsetGridLayoutの並べ方で格納する）
+    void addGrid(const std::vector<Grid2D<SEO>> &Gridinstance)
+    {
+        std::vector<Grid2D<SEOArray>> converted;
+        for (const auto &grid : Gridinstance)
+            converted.push_back(Grid2D<SEOArray>::fromGrid(grid, gridLayout, gridTileSize));
+        addGrid(converted);
+    }
+
+    // SEOのgridを変換するときの素子の並べ方を設定（次のaddGridから使う。デフォルトは行優先）
+    // 並べ方によらず同じシードなら同じ結果になる。列数が多くて上下の行がL2に収まらないときに使う
+    void setGridLayout(GridLayout layout, int tileSize = 32)
+    {
+        if (layout == GridLayout::Tiled && tileSize <= 0)
+            throw std::invalid_argument("Tile size must be positive");
+        gridLayout = layout;
+        gridTileSize = tileSize;
+    }
+
+    // SEOのgridを変換するときの素子の並べ方を取得
+    GridLayout getGridLayout() const { return gridLayout; }
+
+    // 乱数のシードを設定（素子(grid g, row, col)にはgridの順に数えた通し番号で乱数列を割り当てる）
+    void setSeed(std::uint64_t seed)
+    {
+        randomSeed = seed;
+        seedSet = true;
+        applySeed();
+    }
+
+    // 乱数のシードを取得
+    std::uint64_t getSeed() const { return randomSeed; }
+
+    // gridごとの並列計算のスレッド数を設定（1なら直列）
+    void setThreadCount(int threads)
+    {
+        if (threads <= 0)
+            throw std::invalid_argument("Thread count must be positive");
+        threadPool = std::make_shared<ThreadPool>(threads);
+    }
+
+    // gridごとの並列計算のスレッド数を取得
+    int getThreadCount() const { return threadPool->size(); }
+
+    // grid内の並列計算の設定（trueならgrid内を行の帯に分けて計算する。Jacobiのままなので結果は変わらない）
+    void setIntraGridParallel(bool flag) { intraGridParallel = flag; }
+
+    // grid内の並列計算をしているかどうか
+    bool isIntraGridParallel() const { return intraGridParallel; }
+
+    // oyl-video形式の出力の間隔を設定（デフォルトはdt）
+    void setOutputInterval(double interval)
+    {
+        if (interval <= 0)
+            throw std::invalid_argument("Output interval must be positive");
+        outputInterval = interval;
+    }
+
+    // oyl-video形式に合わせた出力を生成（Simulation2D<SEO>と同じく外周の素子を除き、Vdが負の素子はVnを反転する）
+    void outputTooyl()
+    {
+        if (t < nextOutputTime)
+            return;
+        int timeframe = static_cast<int>(std::round(nextOutputTime / outputInterval));
+        int outputIndex = 0;
+        for (const auto &grid : grids)
+        {
+            if (!grid.isOutputEnabled())
+                continue;
+            std::string label;
+            if (grid.hasOutputLabel())
+            {
+                label = grid.getOutputLabel();
+            }
+            else
+            {
+                label = "../output" + std::to_string(outputIndex);
+                ++outputIndex;
+            }
+            int rows = grid.numRows();
+            int cols = grid.numCols();
+            std::vector<std::vector<double>> vnGrid(rows - 2, std::vector<double>(cols - 2));
+            for (int i = 1; i < rows - 1; ++i)
+            {
+                for (int j = 1; j < cols - 1; ++j)
+                {
+                    double vn = grid.getVn(i, j);
+                    vnGrid[i - 1][j - 1] = (grid.getVd(i, j) < 0) ? -vn : vn;
+                }
+            }
+            outputs[label].resize(timeframe + 1);
+            outputs[label][timeframe] = vnGrid;
+        }
+        nextOutputTime += outputInterval;
+    }
+
+    // グリッド取得
+    std::vector<Grid2D<SEOArray>> &getGrids() { return grids; }
+
+    // 現在の時刻を取得
+    double getTime() const { return t; }
+
+    // トンネルの回数を取得
+    std::uint64_t getTunnelCount() const { return tunnelCount; }
+
+    // outputsを取得
+    const std::map<std::string, std::vector<std::vector<std::vector<double>>>> &getOutputs() const { return outputs; }
+};
+
 #endif // SIMULATION_2D_HPP
\ No newline at end of file
@@ -0,0 +1,130 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include <stdexcept>
+
+//---------------------------------------------------------------------------------------------------
+// 使い回すスレッドプール
+// シミュレーションの各フェーズ（V_sum, Vn, dE, wt, 電荷）をgridごとに並列に実行するために使う
+// parallelFor(n, f)は f(0)〜f(n-1) を全スレッド（呼び出し元のスレッドも含む）で分担し、全て終わるまで待つ
+// （＝フェーズの終わりがそのままバリアになる）
+//---------------------------------------------------------------------------------------------------
+class ThreadPool
+{
+private:
+    std::vector<std::thread> workers;
+    std::mutex mtx;
+    std::condition_variable wake;       // 仕事が来たことを知らせる
+    std::condition_variable done;       // 仕事が終わったことを知らせる
+    std::function<void(int)> job;       // 今の仕事
+    int jobSize = 0;                    // 今の仕事の数
+    std::atomic<int> next{0};           // 次に取る仕事の番号
+    int busy = 0;                       // 仕事中のワーカー数
+    unsigned generation = 0;            // 仕事の世代（ワーカーが新しい仕事かどうか判断する）
+    bool stopping = false;
+    std::exception_ptr error;           // 仕事中に投げられた例外
+
+    // 仕事を1つずつ取って実行する
+    void runJobs()
+    {
+        int i;
+        while ((i = next.fetch_add(1)) < jobSize)
+        {
+            try
+            {
+                job(i);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (!error)
+                    error = std::current_exception();
+            }
+        }
+    }
+
+    void workerLoop()
+    {
+        unsigned seen = 0;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping)
+                    return;
+                seen = generation;
+            }
+            runJobs();
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (--busy == 0)
+                    done.notify_one();
+            }
+        }
+    }
+
+public:
+    // コンストラクタ（threadsは呼び出し元のスレッドも含めたスレッド数）
+    explicit ThreadPool(int threads = 1)
+    {
+        if (threads <= 0)
+            throw std::invalid_argument("ThreadPool: thread count must be positive");
+        for (int i = 1; i < threads; ++i)
+            workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &w : workers)
+            w.join();
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // スレッド数（呼び出し元のスレッドも含む）
+    int size() const { return static_cast<int>(workers.size()) + 1; }
+
+    // f(0)〜f(n-1)を並列に実行し、全て終わるまで待つ
+    template <typename F>
+    void parallelFor(int n, F &&f)
+    {
+        if (workers.empty() || n <= 1)
+        {
+            for (int i = 0; i < n; ++i)
+                f(i);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            job = std::forward<F>(f);
+            jobSize = n;
+            next = 0;
+            busy = static_cast<int>(workers.size());
+            error = nullptr;
+            ++generation;
+        }
+        wake.notify_all();
+        runJobs();
+        std::unique_lock<std::mutex> lock(mtx);
+        done.wait(lock, [&] { return busy == 0; });
+        job = nullptr;
+        if (error)
+            std::rethrow_exception(error);
+    }
+};
+
+#endif // THREAD_POOL_HPP
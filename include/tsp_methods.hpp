@@ -3,6 +3,9 @@
 
 #include <array>
 #include <string>
+#include <cstdint>
+#include "counter_rng.hpp"
+#include "checkpoint.hpp"
 
 constexpr int N = 4;
 constexpr int N2 = N * N;
@@ -51,8 +54,8 @@ constexpr double endtime = 100;
 
 
 //関数宣言（中身は最後）
-double sigmoid(int gamma, double theta, double value);
-double rnd_generate(double min, double max);
+inline double sigmoid(int gamma, double theta, double value);
+inline double rnd_generate(CounterRNG &rng, double min, double max);
 
 class Weight {
 public:
@@ -65,6 +68,7 @@ class Calculate_NN
 private:
     double t;
     std::vector<std::vector<Weight>> W;
+    CounterRNG rng; // calcLのゆらぎに使う乱数列
     
 public:
     //コンストラクタ
@@ -84,6 +88,9 @@ public:
     template <std::size_t SIZE>
     void calcweight(const std::array<double, SIZE>& Cost);
     void calcL();
+    void setSeed(std::uint64_t seed);
+    void saveState(CheckpointWriter &out) const;
+    void loadState(CheckpointReader &in);
     std::vector<int> getCt();
     std::vector<int> getNvk();
 
@@ -91,7 +98,7 @@ public:
 
 //コンストラクタ
 template <std::size_t SIZE>
-Calculate_NN::Calculate_NN(const std::array<double, SIZE>& Cost)
+inline Calculate_NN::Calculate_NN(const std::array<double, SIZE>& Cost)
     : costarray(N, std::vector<double>(N, 0.0)),
       Lvk(N2, 0.0),
       Xvk(N2, Ini_X),
@@ -108,7 +115,7 @@ Calculate_NN::Calculate_NN(const std::array<double, SIZE>& Cost)
 
 
 template <std::size_t SIZE>
-void Calculate_NN::calcweight(const std::array<double, SIZE>& Cost){
+inline void Calculate_NN::calcweight(const std::array<double, SIZE>& Cost){
     // コストからコスト表作成
     int ctarrayroop = 0;
     for (int i = 0; i < N; i++) {
@@ -169,7 +176,7 @@ void Calculate_NN::calcweight(const std::array<double, SIZE>& Cost){
 }
 
 
-void Calculate_NN::calcL(){ //Lの計算、それに伴うXの更新等
+inline void Calculate_NN::calcL(){ //Lの計算、それに伴うXの更新等
     /*デバッグ用
     std::cout << "calcL" << std::endl;
     for (double L : Lvk){
@@ -224,7 +231,7 @@ void Calculate_NN::calcL(){ //Lの計算、それに伴うXの更新等
 
 
     for(int vk=0;vk<N2;vk++){  //Xstの更新
-        dX[vk] += rnd_generate(-0.002,0.002);
+        dX[vk] += rnd_generate(rng, -0.002,0.002);
         if(Lvk[vk] < 0.5){ //光照射なし
             if(Xvk[vk] < 1.0){
                 //Inを足す
@@ -239,11 +246,43 @@ void Calculate_NN::calcL(){ //Lの計算、それに伴うXの更新等
 
 }
 
-std::vector<int> Calculate_NN::getNvk(){
+//ゆらぎの乱数列のシードを設定
+inline void Calculate_NN::setSeed(std::uint64_t seed){
+    rng.setStream(seed, rngStream(RngDomain::Network, 0));
+}
+
+//チェックポイントへの書き出し（Lvk, Xvk, dX, Loffcity, Nvk, Ctvkと乱数列）
+inline void Calculate_NN::saveState(CheckpointWriter &out) const{
+    out.writeVector(Lvk);
+    out.writeVector(Xvk);
+    out.writeVector(dX);
+    out.writeVector(Loffcity);
+    out.writeVector(Nvk);
+    out.writeVector(Ctvk);
+    out.write(rng.seed());
+    out.write(rng.stream());
+    out.write(rng.counter());
+}
+
+//チェックポイントからの読み込み
+inline void Calculate_NN::loadState(CheckpointReader &in){
+    Lvk = in.readVector<double>();
+    Xvk = in.readVector<double>();
+    dX = in.readVector<double>();
+    Loffcity = in.readVector<int>();
+    Nvk = in.readVector<int>();
+    Ctvk = in.readVector<int>();
+    std::uint64_t seed = in.read<std::uint64_t>();
+    std::uint64_t stream = in.read<std::uint64_t>();
+    rng.setStream(seed, stream);
+    rng.setCounter(in.read<std::uint64_t>());
+}
+
+inline std::vector<int> Calculate_NN::getNvk(){
     return Nvk;
 }
 
-std::vector<int> Calculate_NN::getCt(){
+inline std::vector<int> Calculate_NN::getCt(){
     return Ctvk;
 }
 
@@ -269,16 +308,15 @@ constexpr std::array<std::string, N> getNameArray() {
 
 
 //シグモイド関数（CalcL内）
-double sigmoid(int gamma, double theta, double value){
+inline double sigmoid(int gamma, double theta, double value){
     double ex = exp(-gamma * (value - theta));
     double h=1/(1 + ex);
     return h;
 }
 
 //指定の範囲の乱数を生成
-double rnd_generate(double min, double max){
-    double t = (double)rand() / RAND_MAX;
-    return min + (max - min)*t;
+inline double rnd_generate(CounterRNG &rng, double min, double max){
+    return rng.uniform(min, max);
 }
 
 #endif
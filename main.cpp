@@ -4,6 +4,8 @@
 #include <fstream>
 #include <memory>
 #include <vector>
+#include <cstdint>
+#include <ctime>
 #include "seo_class.hpp"
 #include "grid_2dim.hpp"
 #include "simulation_2d.hpp"
@@ -20,8 +22,6 @@ using Sim = Simulation2D<BaseElement>;
 
 int main()
 {
-    srand(time(0)); //乱数のシード
-
     Grid grid(size_y, size_x, true);
     grid.setOutputLabel("seo");
 
@@ -73,6 +73,12 @@ int main()
     // シミュレーション初期化
     Sim sim(dt, endtime);
     sim.addGrid({grid});
+    // 乱数のシード（実行ごとに変える。表示した値をsetSeedに渡せば同じ結果を再現できる）
+    const std::uint64_t seed = static_cast<std::uint64_t>(std::time(nullptr));
+    sim.setSeed(seed);
+    std::cout << "seed: " << seed << std::endl;
+    // 接続を検査して実行プランを作る（以降はプランでVn・dEを計算する）
+    sim.compile();
 
     /*
     // 特定素子の出力設定
@@ -0,0 +1,106 @@
+#include "batch_log.hpp"
+#include "seo_kernels.hpp"
+#include <cstdint>
+#include <cstring>
+
+// AVX2版とスカラー版を同じ結果にするため、乗算と加算をFMAにまとめない（CMakeでも -ffp-contract=off を付けている）
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BATCH_LOG_X86 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+// fdlibmの対数の定数
+constexpr double ln2_hi = 6.93147180369123816490e-01;
+constexpr double ln2_lo = 1.90821492927058770002e-10;
+constexpr double Lg1 = 6.666666666666735130e-01;
+constexpr double Lg2 = 3.999999999940941908e-01;
+constexpr double Lg3 = 2.857142874366239149e-01;
+constexpr double Lg4 = 2.222219843214978396e-01;
+constexpr double Lg5 = 1.818357216161805012e-01;
+constexpr double Lg6 = 1.531383769920937332e-01;
+constexpr double Lg7 = 1.479819860511658591e-01;
+constexpr double sqrt2 = 1.41421356237309504880;
+constexpr std::uint64_t mantissaMask = 0x000FFFFFFFFFFFFFULL;
+constexpr std::uint64_t oneBits = 0x3FF0000000000000ULL;
+
+// 正の正規化数の対数（x = 2^k * m, m∈[√2/2, √2) に分けて log(m) を多項式で求める）
+inline double logScalar(double x)
+{
+    std::uint64_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    std::int64_t k = static_cast<std::int64_t>(bits >> 52) - 1023;
+    std::uint64_t mbits = (bits & mantissaMask) | oneBits;
+    double m;
+    std::memcpy(&m, &mbits, sizeof(m));
+    if (m > sqrt2)
+    {
+        m = m * 0.5;
+        k += 1;
+    }
+    double f = m - 1.0;
+    double hfsq = 0.5 * f * f;
+    double s = f / (2.0 + f);
+    double z = s * s;
+    double w = z * z;
+    double t1 = w * (Lg2 + w * (Lg4 + w * Lg6));
+    double t2 = z * (Lg1 + w * (Lg3 + w * (Lg5 + w * Lg7)));
+    double R = t2 + t1;
+    double dk = static_cast<double>(k);
+    return dk * ln2_hi - ((hfsq - (s * (hfsq + R) + dk * ln2_lo)) - f);
+}
+
+#ifdef BATCH_LOG_X86
+__attribute__((target("avx2"))) inline __m256d logAVX2(__m256d x)
+{
+    const __m256i mant = _mm256_set1_epi64x(static_cast<long long>(mantissaMask));
+    const __m256i one = _mm256_set1_epi64x(static_cast<long long>(oneBits));
+    // kを倍精度にする：1.5 * 2^52 のビット列に足してから 1.5 * 2^52 を引く
+    const __m256i magicBits = _mm256_set1_epi64x(0x4338000000000000LL - 1023);
+    const __m256d magic = _mm256_set1_pd(6755399441055744.0);
+    __m256i bits = _mm256_castpd_si256(x);
+    __m256i kexp = _mm256_srli_epi64(bits, 52);
+    __m256d m = _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(bits, mant), one));
+    __m256d big = _mm256_cmp_pd(m, _mm256_set1_pd(sqrt2), _CMP_GT_OQ);
+    m = _mm256_blendv_pd(m, _mm256_mul_pd(m, _mm256_set1_pd(0.5)), big);
+    kexp = _mm256_add_epi64(kexp, _mm256_and_si256(_mm256_castpd_si256(big), _mm256_set1_epi64x(1)));
+    __m256d dk = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_add_epi64(kexp, magicBits)), magic);
+
+    __m256d f = _mm256_sub_pd(m, _mm256_set1_pd(1.0));
+    __m256d hfsq = _mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(0.5), f), f);
+    __m256d s = _mm256_div_pd(f, _mm256_add_pd(_mm256_set1_pd(2.0), f));
+    __m256d z = _mm256_mul_pd(s, s);
+    __m256d w = _mm256_mul_pd(z, z);
+    __m256d t1 = _mm256_mul_pd(w, _mm256_add_pd(_mm256_set1_pd(Lg2), _mm256_mul_pd(w, _mm256_add_pd(_mm256_set1_pd(Lg4), _mm256_mul_pd(w, _mm256_set1_pd(Lg6))))));
+    __m256d t2 = _mm256_mul_pd(z, _mm256_add_pd(_mm256_set1_pd(Lg1), _mm256_mul_pd(w, _mm256_add_pd(_mm256_set1_pd(Lg3), _mm256_mul_pd(w, _mm256_add_pd(_mm256_set1_pd(Lg5), _mm256_mul_pd(w, _mm256_set1_pd(Lg7))))))));
+    __m256d R = _mm256_add_pd(t2, t1);
+    __m256d inner = _mm256_sub_pd(hfsq, _mm256_add_pd(_mm256_mul_pd(s, _mm256_add_pd(hfsq, R)), _mm256_mul_pd(dk, _mm256_set1_pd(ln2_lo))));
+    return _mm256_sub_pd(_mm256_mul_pd(dk, _mm256_set1_pd(ln2_hi)), _mm256_sub_pd(inner, f));
+}
+
+__attribute__((target("avx2"))) int batchLogAVX2(int n, const double *x, double *out)
+{
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(out + i, logAVX2(_mm256_loadu_pd(x + i)));
+    return i;
+}
+#endif
+} // namespace
+
+// 対数をまとめて計算
+void batchLog(int n, const double *x, double *out)
+{
+    int i = 0;
+#ifdef BATCH_LOG_X86
+    if (getSimdLevel() != SimdLevel::Scalar)
+        i = batchLogAVX2(n, x, out);
+#endif
+    for (; i < n; ++i)
+        out[i] = logScalar(x[i]);
+}
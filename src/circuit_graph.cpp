@@ -0,0 +1,208 @@
+#include "circuit_graph.hpp"
+#include <algorithm>
+#include <string>
+
+//-----------内部処理------------//
+// ノードごとの接続先のリストからCSRを作り、素子に接続を設定する
+void CircuitGraph::build(const std::vector<std::vector<int>> &adjacency)
+{
+    int n = static_cast<int>(elements.size());
+    offset.assign(n + 1, 0);
+    neighbor.clear();
+    for (int i = 0; i < n; ++i)
+    {
+        if (!elements[i])
+        {
+            throw std::invalid_argument("CircuitGraph: node " + std::to_string(i) + " has no element");
+        }
+        neighbor.insert(neighbor.end(), adjacency[i].begin(), adjacency[i].end());
+        offset[i + 1] = static_cast<int>(neighbor.size());
+    }
+    for (int i = 0; i < n; ++i)
+    {
+        std::vector<std::shared_ptr<BaseElement>> conns;
+        conns.reserve(adjacency[i].size());
+        for (int j : adjacency[i])
+        {
+            conns.push_back(elements[j]);
+        }
+        elements[i]->setConnections(conns);
+    }
+}
+
+// 辺のリストからノードごとの接続先のリストを作る
+std::vector<std::vector<int>> CircuitGraph::adjacencyOf(int n, const std::vector<std::pair<int, int>> &edges)
+{
+    if (n < 0)
+    {
+        throw std::invalid_argument("CircuitGraph: node count must not be negative");
+    }
+    std::vector<std::vector<int>> adjacency(n);
+    for (const auto &[a, b] : edges)
+    {
+        if (a < 0 || a >= n || b < 0 || b >= n)
+        {
+            throw std::invalid_argument("CircuitGraph: edge (" + std::to_string(a) + ", " + std::to_string(b) + ") is out of range");
+        }
+        if (a == b)
+        {
+            throw std::invalid_argument("CircuitGraph: node " + std::to_string(a) + " cannot connect to itself");
+        }
+        if (std::find(adjacency[a].begin(), adjacency[a].end(), b) != adjacency[a].end())
+        {
+            throw std::invalid_argument("CircuitGraph: edge (" + std::to_string(a) + ", " + std::to_string(b) + ") appears twice");
+        }
+        adjacency[a].push_back(b);
+        adjacency[b].push_back(a);
+    }
+    return adjacency;
+}
+
+// ノードごとの接続先のリストから素子を作ってグラフにする
+CircuitGraph CircuitGraph::fromAdjacency(const std::vector<std::vector<int>> &adjacency, const ElementFactory &make)
+{
+    if (!make)
+    {
+        throw std::invalid_argument("CircuitGraph: element factory must not be empty");
+    }
+    CircuitGraph graph;
+    int n = static_cast<int>(adjacency.size());
+    graph.elements.reserve(n);
+    for (int i = 0; i < n; ++i)
+    {
+        graph.elements.push_back(make(i, static_cast<int>(adjacency[i].size())));
+    }
+    graph.build(adjacency);
+    return graph;
+}
+
+//-----------作り方------------//
+// 素子と辺のリストから作る
+CircuitGraph CircuitGraph::fromEdgeList(const std::vector<std::shared_ptr<BaseElement>> &elements,
+                                        const std::vector<std::pair<int, int>> &edges)
+{
+    CircuitGraph graph;
+    graph.elements = elements;
+    graph.build(adjacencyOf(static_cast<int>(elements.size()), edges));
+    return graph;
+}
+
+// ノード数と辺のリストから作る
+CircuitGraph CircuitGraph::fromEdgeList(int n, const std::vector<std::pair<int, int>> &edges, const ElementFactory &make)
+{
+    return fromAdjacency(adjacencyOf(n, edges), make);
+}
+
+// 正方格子
+CircuitGraph CircuitGraph::squareLattice(int rows, int cols, const ElementFactory &make)
+{
+    if (rows <= 0 || cols <= 0)
+    {
+        throw std::invalid_argument("CircuitGraph: lattice size must be positive");
+    }
+    std::vector<std::vector<int>> adjacency(rows * cols);
+    for (int y = 0; y < rows; ++y)
+    {
+        for (int x = 0; x < cols; ++x)
+        {
+            auto &adj = adjacency[y * cols + x];
+            if (y > 0)
+                adj.push_back((y - 1) * cols + x);
+            if (x > 0)
+                adj.push_back(y * cols + x - 1);
+            if (y < rows - 1)
+                adj.push_back((y + 1) * cols + x);
+            if (x < cols - 1)
+                adj.push_back(y * cols + x + 1);
+        }
+    }
+    return fromAdjacency(adjacency, make);
+}
+
+// 三角格子
+CircuitGraph CircuitGraph::triangularLattice(int rows, int cols, const ElementFactory &make)
+{
+    if (rows <= 0 || cols <= 0)
+    {
+        throw std::invalid_argument("CircuitGraph: lattice size must be positive");
+    }
+    std::vector<std::vector<int>> adjacency(rows * cols);
+    for (int y = 0; y < rows; ++y)
+    {
+        for (int x = 0; x < cols; ++x)
+        {
+            auto &adj = adjacency[y * cols + x];
+            if (y > 0 && x > 0)
+                adj.push_back((y - 1) * cols + x - 1);
+            if (y > 0)
+                adj.push_back((y - 1) * cols + x);
+            if (x > 0)
+                adj.push_back(y * cols + x - 1);
+            if (x < cols - 1)
+                adj.push_back(y * cols + x + 1);
+            if (y < rows - 1)
+                adj.push_back((y + 1) * cols + x);
+            if (y < rows - 1 && x < cols - 1)
+                adj.push_back((y + 1) * cols + x + 1);
+        }
+    }
+    return fromAdjacency(adjacency, make);
+}
+
+// 六角格子
+CircuitGraph CircuitGraph::hexagonalLattice(int rows, int cols, const ElementFactory &make)
+{
+    if (rows <= 0 || cols <= 0)
+    {
+        throw std::invalid_argument("CircuitGraph: lattice size must be positive");
+    }
+    std::vector<std::vector<int>> adjacency(rows * cols);
+    for (int y = 0; y < rows; ++y)
+    {
+        for (int x = 0; x < cols; ++x)
+        {
+            auto &adj = adjacency[y * cols + x];
+            bool down = (x + y) % 2 == 0;
+            if (!down && y > 0)
+                adj.push_back((y - 1) * cols + x);
+            if (x > 0)
+                adj.push_back(y * cols + x - 1);
+            if (x < cols - 1)
+                adj.push_back(y * cols + x + 1);
+            if (down && y < rows - 1)
+                adj.push_back((y + 1) * cols + x);
+        }
+    }
+    return fromAdjacency(adjacency, make);
+}
+
+//-----------ゲッター------------//
+// ノードidの素子
+const std::shared_ptr<BaseElement> &CircuitGraph::getElement(int id) const
+{
+    if (id < 0 || id >= numNodes())
+    {
+        throw std::out_of_range("CircuitGraph node index out of range");
+    }
+    return elements[id];
+}
+
+// ノードidの接続の数
+int CircuitGraph::degree(int id) const
+{
+    if (id < 0 || id >= numNodes())
+    {
+        throw std::out_of_range("CircuitGraph node index out of range");
+    }
+    return offset[id + 1] - offset[id];
+}
+
+// ノードidの接続先
+std::pair<const int *, const int *> CircuitGraph::neighbors(int id) const
+{
+    if (id < 0 || id >= numNodes())
+    {
+        throw std::out_of_range("CircuitGraph node index out of range");
+    }
+    return {neighbor.data() + offset[id], neighbor.data() + offset[id + 1]};
+}
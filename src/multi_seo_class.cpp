@@ -1,12 +1,10 @@
 #include "multi_seo_class.hpp"
+#include "checkpoint.hpp"
 //------ コンストラクタ（パラメータの初期設定）---------//
 // 初期値無し
 MultiSEO::MultiSEO() : R(0), Rj(0), Cj(0), C(0), Vd(0), Q(0), Vn(0), legs(0), V_sum(0), multi_num(1), tunnel_num(0)
 {
-    dE["up"] = 0.0;
-    dE["down"] = 0.0;
-    wt["up"] = 0.0;
-    wt["down"] = 0.0;
+    updateCoefficients();
 }
 
 // 初期値あり
@@ -14,10 +12,7 @@ MultiSEO::MultiSEO(double r, double rj, double cj, double c, double vd, int legs
     : R(r), Rj(rj), Cj(cj), C(c), Vd(vd), Q(0.0), Vn(0.0), legs(legscounts),
       V_sum(0.0), multi_num(junction_num), tunnel_num(0)
 {
-    dE["up"] = 0.0;
-    dE["down"] = 0.0;
-    wt["up"] = 0.0;
-    wt["down"] = 0.0;
+    updateCoefficients();
 }
 
 //-----------セッター------------//
@@ -31,23 +26,37 @@ void MultiSEO::setUp(double r, double rj, double cj, double c, double vd, int le
     Vd = vd;
     legs = legscounts;
     multi_num = junction_num;
+    updateCoefficients();
+}
+
+// パラメータだけで決まる係数を計算し直す（setPcalc・setdEcalcの式と同じ順序で計算するので結果は変わらない）
+void MultiSEO::updateCoefficients()
+{
+    ctotal = legs * multi_num * C + Cj;
+    ceff = ctotal / multi_num;
+    cCj = C * Cj;
+    twoCCj = 2 * C * Cj;
+    tunnelScale = e * e * Rj;
 }
 
 // バイアス電圧を設定
 void MultiSEO::setVias(const double vd)
 {
+    bool wasInert = isInert();
     Vd = vd;
+    noteActivation(wasInert, isInert());
 }
 
-// V_sumを設定
-void MultiSEO::setVsum(double v)
+// 待ち時間に使う乱数列を設定
+void MultiSEO::setRandomStream(std::uint64_t seed, std::uint64_t stream)
 {
-    V_sum = v;
+    rng.setStream(seed, stream);
 }
 
 // 接続情報を設定
 void MultiSEO::setConnections(const std::vector<std::shared_ptr<BaseElement>> &conns)
 {
+    bool wasInert = isInert();
     connections.clear();
     if (conns.size() > legs)
     {
@@ -61,71 +70,42 @@ void MultiSEO::setConnections(const std::vector<std::shared_ptr<BaseElement>> &c
         }
         connections.push_back(elem);
     }
-}
-
-// 周囲の電圧を設定
-void MultiSEO::setSurroundingVoltages()
-{
-    V_sum = 0;
-    for (auto elem : connections)
-    {
-        V_sum += elem->getVn();
-    }
-}
-
-// 振動子のパラメータ計算
-void MultiSEO::setPcalc()
-{
-    Vn = (multi_num * (Cj * Q + C * Cj * V_sum) - Cj * tunnel_num * e) / (Cj * (legs * multi_num * C + Cj));
+    noteActivation(wasInert, isInert());
 }
 
 // 振動子のエネルギー計算
 void MultiSEO::setdEcalc()
 {
-    dE["up"] = e * ((-(multi_num - 1) * legs + 2 * legs * tunnel_num) * C * e + Cj * (2 * Q - e) + 2 * C * Cj * V_sum) / (2 * Cj * (legs * multi_num * C + Cj));
-    dE["down"] = -e * (-(-(multi_num - 1) * legs - 2 * legs * tunnel_num) * C * e + Cj * (2 * Q + e) + 2 * C * Cj * V_sum) / (2 * Cj * (legs * multi_num * C + Cj));
-}
-
-// 電荷の更新
-void MultiSEO::setNodeCharge(const double dt)
-{
-    Q += (Vd - Vn) * dt / R;
+    dE.up = e * ((-(multi_num - 1) * legs + 2 * legs * tunnel_num) * C * e + Cj * (2 * Q - e) + twoCCj * V_sum) / (2 * Cj * ctotal);
+    dE.down = -e * (-(-(multi_num - 1) * legs - 2 * legs * tunnel_num) * C * e + Cj * (2 * Q + e) + twoCCj * V_sum) / (2 * Cj * ctotal);
 }
 
 // トンネル待ち時間計算(upまたはdownが正の時にwtを計算してtrueを返す)
+// トンネルできる接合はmulti_num - |tunnel_num|個あり、それぞれの待ち時間は同じレートの指数分布に従う
+// k個の指数分布の最小値はk倍のレートの指数分布になるので、乱数1個で最小値を直接求める
 bool MultiSEO::calculateTunnelWt()
 {
     // 初期化
-    wt["up"] = 0;
-    wt["down"] = 0;
-    if (dE["up"] > 0)
+    wt.up = 0;
+    wt.down = 0;
+    int junctions = multi_num - abs(tunnel_num);
+    if (dE.up > 0)
     {
-        wt["up"] = 100;
-        // ジャンクションの数からトンネルした回数を引いた分だけwtを計算して最小値を算出
-        for (int rep = 0; rep < multi_num - abs(tunnel_num); rep++)
-        {
-            double tmpwt = (e * e * Rj / dE["up"]) * std::log(1 / Random());
-            wt["up"] = std::min(tmpwt, wt["up"]);
-        }
+        wt.up = (tunnelScale / (junctions * dE.up)) * std::log(1 / Random());
         return true;
     }
-    if (dE["down"] > 0)
+    if (dE.down > 0)
     {
-        wt["down"] = 100;
-        for (int rep = 0; rep < multi_num - abs(tunnel_num); rep++)
-        {
-            double tmpwt = (e * e * Rj / dE["down"]) * std::log(1 / Random());
-            wt["down"] = std::min(tmpwt, wt["down"]);
-        }
+        wt.down = (tunnelScale / (junctions * dE.down)) * std::log(1 / Random());
         return true;
     }
     return false;
 }
 
 // 振動子のトンネル
-void MultiSEO::setTunnel(const std::string& direction)
+void MultiSEO::setTunnel(TunnelDirection direction)
 {
-    if (direction == "up")
+    if (direction == TunnelDirection::Up)
     {
         // トンネル回数をカウント
         tunnel_num++;
@@ -136,7 +116,7 @@ void MultiSEO::setTunnel(const std::string& direction)
             tunnel_num = 0;
         }
     }
-    else if (direction == "down")
+    else if (direction == TunnelDirection::Down)
     {
         tunnel_num--;
         if(abs(tunnel_num) == multi_num)
@@ -152,12 +132,6 @@ void MultiSEO::setTunnel(const std::string& direction)
 }
 //-----------ゲッター------------//
 
-// ノード電圧を取得
-double MultiSEO::getVn() const
-{
-    return Vn;
-}
-
 // // 接続されてる振動子を取得
 // vector<shared_ptr<MultiSEO>> MultiSEO::getConnection() const
 // {
@@ -170,10 +144,10 @@ double MultiSEO::getSurroundingVsum() const
     return V_sum;
 }
 
-// dEの取得
-std::map<std::string, double> MultiSEO::getdE() const
+// 接続されてる振動子を取得
+const std::vector<std::shared_ptr<BaseElement>> &MultiSEO::getConnections() const
 {
-    return dE;
+    return connections;
 }
 
 // Qの取得
@@ -182,10 +156,22 @@ double MultiSEO::getQ() const
     return Q;
 }
 
-// wtの取得
-std::map<std::string, double> MultiSEO::getWT() const
+// トンネルレートと方向の取得（calculateTunnelWtと同じくupを優先）
+// トンネルできる接合はmulti_num - |tunnel_num|個あり、それぞれが同じレートを持つので合計はその個数倍
+std::pair<TunnelDirection, double> MultiSEO::getTunnelRate() const
 {
-    return wt;
+    int junctions = multi_num - abs(tunnel_num);
+    double up = dE.up;
+    if (up > 0)
+    {
+        return {TunnelDirection::Up, junctions * up / tunnelScale};
+    }
+    double down = dE.down;
+    if (down > 0)
+    {
+        return {TunnelDirection::Down, junctions * down / tunnelScale};
+    }
+    return {TunnelDirection::None, 0.0};
 }
 
 // oneway用の関数のため呼び出すとエラー発生
@@ -194,14 +180,43 @@ std::shared_ptr<BaseElement> MultiSEO::getInternalElement(int index) const
     throw std::runtime_error("This element does not have internal elements.");
 }
 
+//-------- チェックポイント -------------//
+// 状態を書き出す
+void MultiSEO::saveState(CheckpointWriter &out) const
+{
+    out.write(Q);
+    out.write(Vn);
+    out.write(Vd);
+    out.write(V_sum);
+    out.write(dE);
+    out.write(wt);
+    out.write(tunnel_num);
+    out.write(rng.seed());
+    out.write(rng.stream());
+    out.write(rng.counter());
+}
+
+// 状態を読み込む
+void MultiSEO::loadState(CheckpointReader &in)
+{
+    in.read(Q);
+    in.read(Vn);
+    in.read(Vd);
+    in.read(V_sum);
+    in.read(dE);
+    in.read(wt);
+    in.read(tunnel_num);
+    std::uint64_t seed = in.read<std::uint64_t>();
+    std::uint64_t stream = in.read<std::uint64_t>();
+    rng.setStream(seed, stream);
+    rng.setCounter(in.read<std::uint64_t>());
+}
+
 //-------- 汎用処理 -------------//
-// 0から1の間の乱数を生成
+// 0から1の間の乱数を生成（素子ごとの乱数列から取るので、計算の順番やスレッドによらず同じ値になる）
 double MultiSEO::Random()
 {
-    static std::random_device rd;
-    static std::mt19937 mt(rd());
-    static std::uniform_real_distribution<double> dist(0.0, 1.0);
-    return dist(mt);
+    return rng.uniform();
 }
 
 //-------- テスト用 -----------//
@@ -242,19 +257,28 @@ int MultiSEO::getlegs() const
 }
 
 // テスト用dEセッター
-void MultiSEO::setdE(const std::string &direction, double value)
+void MultiSEO::setdE(TunnelDirection direction, double value)
 {
-    dE[direction] = value;
+    if (direction == TunnelDirection::Up)
+        dE.up = value;
+    else if (direction == TunnelDirection::Down)
+        dE.down = value;
+    else
+        throw std::invalid_argument("Invalid tunnel direction");
 }
 
 // テスト用Vnセッター
 void MultiSEO::setVn(double vn)
 {
+    bool wasInert = isInert();
     Vn = vn;
+    noteActivation(wasInert, isInert());
 }
 
 // テスト用Qnセッター
 void MultiSEO::setQ(double qn)
 {
+    bool wasInert = isInert();
     Q = qn;
+    noteActivation(wasInert, isInert());
 }
\ No newline at end of file
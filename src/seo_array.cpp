@@ -0,0 +1,383 @@
+#include "seo_array.hpp"
+#include "seo_kernels.hpp"
+#include "batch_log.hpp"
+#include "counter_rng.hpp"
+#include <algorithm>
+//------ コンストラクタ ---------//
+SEOArray::SEOArray(int count) : n(0)
+{
+    resize(count);
+}
+
+//-----------セッター------------//
+// 素子数を変更（全ての値と接続が初期化される）
+void SEOArray::resize(int count)
+{
+    if (count < 0)
+    {
+        throw std::invalid_argument("SEOArray size must not be negative");
+    }
+    n = count;
+    for (auto *v : {&Q, &Vn, &Vd, &V_sum, &R, &Rj, &Cj, &C, &dEup, &dEdown, &wt})
+    {
+        v->assign(n, 0.0);
+    }
+    legs.assign(n, 0);
+    dir.assign(n, TunnelDirection::None);
+    rngSeed = defaultRandomSeed();
+    rngStreamBase = rngStream(RngDomain::Unassigned, reserveDefaultStreams(n) << 2);
+    rngCounter.assign(n, 0);
+    streamNumber.clear();
+    neighbourOffset.assign(n + 1, 0);
+    neighbourIndex.clear();
+    pendingConnections.clear();
+    connectionsChanged = false;
+}
+
+void SEOArray::checkIndex(int i) const
+{
+    if (i < 0 || i >= n)
+    {
+        throw std::out_of_range("SEOArray index out of range");
+    }
+}
+
+// パラメータセットアップ
+void SEOArray::setUp(int i, double r, double rj, double cj, double c, double vd, int legscounts)
+{
+    checkIndex(i);
+    R[i] = r;
+    Rj[i] = rj;
+    Cj[i] = cj;
+    C[i] = c;
+    Vd[i] = vd;
+    legs[i] = legscounts;
+}
+
+// バイアス電圧を設定
+void SEOArray::setVias(int i, double vd)
+{
+    checkIndex(i);
+    Vd[i] = vd;
+}
+
+// V_sumを設定
+void SEOArray::setVsum(int i, double v)
+{
+    checkIndex(i);
+    V_sum[i] = v;
+}
+
+// 素子ごとの乱数列を設定
+void SEOArray::setRandomStreams(std::uint64_t seed, std::uint64_t firstIndex)
+{
+    rngSeed = seed;
+    rngStreamBase = rngStream(RngDomain::Element, firstIndex << 2);
+    rngCounter.assign(n, 0);
+}
+
+// 素子ごとの乱数列の通し番号を設定
+void SEOArray::setStreamNumbers(const std::vector<int> &numbers)
+{
+    if (!numbers.empty() && static_cast<int>(numbers.size()) != n)
+    {
+        throw std::invalid_argument("SEOArray: one stream number is needed per element");
+    }
+    streamNumber = numbers;
+}
+
+// 接続情報を設定
+void SEOArray::setConnections(int i, const std::vector<int> &conns)
+{
+    checkIndex(i);
+    if (conns.size() > static_cast<size_t>(legs[i]))
+    {
+        throw std::invalid_argument("Too many connections for the number of legs.");
+    }
+    for (int j : conns)
+    {
+        checkIndex(j);
+        if (j == i)
+        {
+            throw std::invalid_argument("Cannot connect to itself.");
+        }
+    }
+    if (!connectionsChanged)
+    {
+        // CSRから素子ごとの接続に戻してから書き換える
+        pendingConnections.assign(n, {});
+        for (int k = 0; k < n; ++k)
+        {
+            pendingConnections[k] = getConnections(k);
+        }
+    }
+    pendingConnections[i] = conns;
+    connectionsChanged = true;
+}
+
+// 接続情報からCSRを作る
+void SEOArray::buildConnections()
+{
+    if (!connectionsChanged)
+        return;
+    neighbourOffset.assign(n + 1, 0);
+    for (int i = 0; i < n; ++i)
+    {
+        neighbourOffset[i + 1] = neighbourOffset[i] + static_cast<int>(pendingConnections[i].size());
+    }
+    neighbourIndex.resize(neighbourOffset[n]);
+    for (int i = 0; i < n; ++i)
+    {
+        std::copy(pendingConnections[i].begin(), pendingConnections[i].end(), neighbourIndex.begin() + neighbourOffset[i]);
+    }
+    std::vector<std::vector<int>>().swap(pendingConnections);
+    connectionsChanged = false;
+}
+
+// 周囲の電圧を設定
+void SEOArray::setSurroundingVoltages(int begin, int end)
+{
+    const int *offset = neighbourOffset.data();
+    const int *index = neighbourIndex.data();
+    const double *vn = Vn.data();
+    for (int i = begin; i < end; ++i)
+    {
+        double sum = 0;
+        for (int k = offset[i]; k < offset[i + 1]; ++k)
+        {
+            sum += vn[index[k]];
+        }
+        V_sum[i] = sum;
+    }
+}
+
+// 振動子のパラメータ計算（SIMDカーネルでまとめて計算）
+void SEOArray::setPcalc(int begin, int end)
+{
+    if (end <= begin)
+        return;
+    seoPotentialKernel(end - begin, &Q[begin], &V_sum[begin], &Cj[begin], &C[begin], &legs[begin], &Vn[begin]);
+}
+
+// 振動子のエネルギー計算（SIMDカーネルでまとめて計算）
+void SEOArray::setdEcalc(int begin, int end)
+{
+    if (end <= begin)
+        return;
+    seoEnergyKernel(end - begin, &Q[begin], &V_sum[begin], &Cj[begin], &C[begin], &legs[begin], &dEup[begin], &dEdown[begin]);
+}
+
+// 電荷の更新
+void SEOArray::setNodeCharge(double dt, int begin, int end)
+{
+    for (int i = begin; i < end; ++i)
+    {
+        Q[i] += (Vd[i] - Vn[i]) * dt / R[i];
+    }
+}
+
+// トンネル待ち時間計算（SEO::calculateTunnelWtと同じくupを優先する）
+// まとめて計算する場合は、dEが正の素子を集めて乱数を引いてから対数を一度に計算する
+int SEOArray::calculateTunnelWt(double dt, int begin, int end)
+{
+    int best = -1;
+    double minwt = dt;
+    if (batchedSampling)
+    {
+        // スレッドごとに作業用の配列を持つ
+        thread_local std::vector<int> candidates;
+        thread_local std::vector<double> samples;
+        candidates.clear();
+        for (int i = begin; i < end; ++i)
+        {
+            wt[i] = 0;
+            dir[i] = (dEup[i] > 0) ? TunnelDirection::Up : ((dEdown[i] > 0) ? TunnelDirection::Down : TunnelDirection::None);
+            if (dir[i] != TunnelDirection::None)
+                candidates.push_back(i);
+        }
+        int m = static_cast<int>(candidates.size());
+        samples.resize(m);
+        for (int k = 0; k < m; ++k)
+            samples[k] = Random(candidates[k]);
+        batchLog(m, samples.data(), samples.data());
+        for (int k = 0; k < m; ++k)
+        {
+            int i = candidates[k];
+            wt[i] = (e * e * Rj[i] / (dir[i] == TunnelDirection::Up ? dEup[i] : dEdown[i])) * (0.0 - samples[k]);
+            if (wt[i] < minwt)
+            {
+                minwt = wt[i];
+                best = i;
+            }
+        }
+        return best;
+    }
+    for (int i = begin; i < end; ++i)
+    {
+        wt[i] = 0;
+        dir[i] = TunnelDirection::None;
+        if (dEup[i] > 0)
+        {
+            wt[i] = (e * e * Rj[i] / dEup[i]) * std::log(1 / Random(i));
+            dir[i] = TunnelDirection::Up;
+        }
+        else if (dEdown[i] > 0)
+        {
+            wt[i] = (e * e * Rj[i] / dEdown[i]) * std::log(1 / Random(i));
+            dir[i] = TunnelDirection::Down;
+        }
+        else
+        {
+            continue;
+        }
+        if (wt[i] < minwt)
+        {
+            minwt = wt[i];
+            best = i;
+        }
+    }
+    return best;
+}
+
+// 振動子のトンネル
+void SEOArray::setTunnel(int i, TunnelDirection direction)
+{
+    checkIndex(i);
+    if (direction == TunnelDirection::Up)
+    {
+        Q[i] += -e;
+    }
+    else if (direction == TunnelDirection::Down)
+    {
+        Q[i] += e;
+    }
+    else
+    {
+        throw std::invalid_argument("Invalid tunnel direction");
+    }
+}
+
+//-----------ゲッター------------//
+// トンネルの方向
+TunnelDirection SEOArray::getTunnelDirection(int i) const
+{
+    checkIndex(i);
+    return dir[i];
+}
+
+// 接続されてる素子のインデックスを取得
+std::vector<int> SEOArray::getConnections(int i) const
+{
+    checkIndex(i);
+    if (connectionsChanged)
+    {
+        return pendingConnections[i];
+    }
+    return std::vector<int>(neighbourIndex.begin() + neighbourOffset[i], neighbourIndex.begin() + neighbourOffset[i + 1]);
+}
+
+// トンネルレートと方向の取得（calculateTunnelWtと同じくupを優先）
+std::pair<TunnelDirection, double> SEOArray::getTunnelRate(int i) const
+{
+    checkIndex(i);
+    if (dEup[i] > 0)
+    {
+        return {TunnelDirection::Up, dEup[i] / (e * e * Rj[i])};
+    }
+    if (dEdown[i] > 0)
+    {
+        return {TunnelDirection::Down, dEdown[i] / (e * e * Rj[i])};
+    }
+    return {TunnelDirection::None, 0.0};
+}
+
+// 1素子あたりのメモリ使用量[byte]
+double SEOArray::bytesPerElement() const
+{
+    if (n == 0)
+        return 0.0;
+    size_t bytes = 11 * sizeof(double) * n + sizeof(int) * n + sizeof(signed char) * n;
+    bytes += sizeof(int) * (neighbourOffset.size() + neighbourIndex.size());
+    return static_cast<double>(bytes) / n;
+}
+
+//-------- 汎用処理 -------------//
+// 素子iの乱数列から0から1の間の乱数を生成（計算の順番やスレッドによらず同じ値になる）
+double SEOArray::Random(int i)
+{
+    std::uint64_t number = streamNumber.empty() ? i : streamNumber[i];
+    return counterUniform(rngSeed, rngStreamBase + (number << 2), rngCounter[i]++);
+}
+
+//-------- テスト用 -----------//
+// テスト用Vnセッター
+void SEOArray::setVn(int i, double vn)
+{
+    checkIndex(i);
+    Vn[i] = vn;
+}
+
+// テスト用Qnセッター
+void SEOArray::setQ(int i, double qn)
+{
+    checkIndex(i);
+    Q[i] = qn;
+}
+
+//-------- Grid2D<SEOArray>の並べ方 -------------//
+namespace
+{
+// vの下位32ビットを1ビットおきに並べる（Z順序の値を作る）
+std::uint64_t spreadBits(std::uint64_t v)
+{
+    v &= 0xffffffffULL;
+    v = (v | (v << 16)) & 0x0000ffff0000ffffULL;
+    v = (v | (v << 8)) & 0x00ff00ff00ff00ffULL;
+    v = (v | (v << 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    v = (v | (v << 2)) & 0x3333333333333333ULL;
+    v = (v | (v << 1)) & 0x5555555555555555ULL;
+    return v;
+}
+} // namespace
+
+// layoutで並べたときに配列のi番目に来るセルの行優先の番号の一覧
+std::vector<int> gridLayoutOrder(int rows, int cols, GridLayout layout, int tileSize)
+{
+    if (rows <= 0 || cols <= 0)
+    {
+        throw std::invalid_argument("Grid size must be positive");
+    }
+    std::vector<int> order;
+    order.reserve(static_cast<size_t>(rows) * cols);
+    if (layout == GridLayout::RowMajor)
+    {
+        for (int cell = 0; cell < rows * cols; ++cell)
+            order.push_back(cell);
+    }
+    else if (layout == GridLayout::Tiled)
+    {
+        if (tileSize <= 0)
+        {
+            throw std::invalid_argument("Tile size must be positive");
+        }
+        // 右端・下端のタイルは小さくなる
+        for (int ty = 0; ty < rows; ty += tileSize)
+            for (int tx = 0; tx < cols; tx += tileSize)
+                for (int y = ty; y < std::min(ty + tileSize, rows); ++y)
+                    for (int x = tx; x < std::min(tx + tileSize, cols); ++x)
+                        order.push_back(y * cols + x);
+    }
+    else
+    {
+        // Z順序の値で並べ、グリッドの外の値は飛ばす
+        std::vector<std::pair<std::uint64_t, int>> keys;
+        keys.reserve(static_cast<size_t>(rows) * cols);
+        for (int y = 0; y < rows; ++y)
+            for (int x = 0; x < cols; ++x)
+                keys.push_back({(spreadBits(y) << 1) | spreadBits(x), y * cols + x});
+        std::sort(keys.begin(), keys.end());
+        for (const auto &key : keys)
+            order.push_back(key.second);
+    }
+    return order;
+}
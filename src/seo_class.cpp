@@ -1,12 +1,10 @@
 #include "seo_class.hpp"
+#include "checkpoint.hpp"
 //------ コンストラクタ（パラメータの初期設定）---------//
 // 初期値無し
 SEO::SEO() : R(0), Rj(0), Cj(0), C(0), Vd(0), Q(0), Vn(0), legs(0), V_sum(0)
 {
-    dE["up"] = 0.0;
-    dE["down"] = 0.0;
-    wt["up"] = 0.0;
-    wt["down"] = 0.0;
+    updateCoefficients();
 }
 
 // 初期値あり
@@ -14,10 +12,7 @@ SEO::SEO(double r, double rj, double cj, double c, double vd, int legscounts)
     : R(r), Rj(rj), Cj(cj), C(c), Vd(vd), Q(0.0), Vn(0.0), legs(legscounts),
       V_sum(0.0)
 {
-    dE["up"] = 0.0;
-    dE["down"] = 0.0;
-    wt["up"] = 0.0;
-    wt["down"] = 0.0;
+    updateCoefficients();
 }
 
 //-----------セッター------------//
@@ -30,23 +25,36 @@ void SEO::setUp(double r, double rj, double cj, double c, double vd, int legscou
     C = c;
     Vd = vd;
     legs = legscounts;
+    updateCoefficients();
+}
+
+// パラメータだけで決まる係数を計算し直す（setPcalc・setdEcalcの式と同じ順序で計算するので結果は変わらない）
+void SEO::updateCoefficients()
+{
+    ctotal = legs * C + Cj;
+    vnCoeff = C / (Cj * ctotal);
+    tunnelScale = e * e * Rj;
 }
 
 // バイアス電圧を設定
 void SEO::setVias(const double vd)
 {
+    bool wasInert = isInert();
     Vd = vd;
+    noteActivation(wasInert, isInert());
 }
 
-// V_sumを設定
-void SEO::setVsum(double v)
+// 待ち時間に使う乱数列を設定
+void SEO::setRandomStream(std::uint64_t seed, std::uint64_t stream)
 {
-    V_sum = v;
+    rng.setStream(seed, stream);
 }
 
 // 接続情報を設定
 void SEO::setConnections(const std::vector<std::shared_ptr<BaseElement>>& conns) {
+    bool wasInert = isInert();
     connections.clear();
+    connectedSEO.clear();
     if (conns.size() > legs) {
         throw std::invalid_argument("Too many connections for the number of legs.");
     }
@@ -55,65 +63,45 @@ void SEO::setConnections(const std::vector<std::shared_ptr<BaseElement>>& conns)
             throw std::invalid_argument("Cannot connect to itself.");
         }
         connections.push_back(elem);
+        connectedSEO.push_back(dynamic_cast<const SEO *>(elem.get()));
     }
-}
-
-// 周囲の電圧を設定
-void SEO::setSurroundingVoltages()
-{
-    V_sum = 0;
-    for (auto elem : connections)
-    {
-        V_sum += elem->getVn();
-    }
-}
-
-// 振動子のパラメータ計算
-void SEO::setPcalc()
-{
-    Vn = Q / Cj + (C / (Cj * (legs * C + Cj))) * (Cj * V_sum - legs * Q);
+    noteActivation(wasInert, isInert());
 }
 
 // 振動子のエネルギー計算
 void SEO::setdEcalc()
 {
-    dE["up"] = -e * (e - 2 * (Q + C * V_sum)) / (2 * (legs * C + Cj));
-    dE["down"] = -e * (e + 2 * (Q + C * V_sum)) / (2 * (legs * C + Cj));
-}
-
-// 電荷の更新
-void SEO::setNodeCharge(const double dt)
-{
-    Q += (Vd - Vn) * dt / R;
+    dE.up = -e * (e - 2 * (Q + C * V_sum)) / (2 * ctotal);
+    dE.down = -e * (e + 2 * (Q + C * V_sum)) / (2 * ctotal);
 }
 
 // トンネル待ち時間計算(upまたはdownが正の時にwtを計算してtrueを返す)
 bool SEO::calculateTunnelWt()
 {
     // 初期化
-    wt["up"] = 0;
-    wt["down"] = 0;
-    if (dE["up"] > 0)
+    wt.up = 0;
+    wt.down = 0;
+    if (dE.up > 0)
     {
-        wt["up"] = (e * e * Rj / dE["up"]) * std::log(1 / Random());
+        wt.up = (tunnelScale / dE.up) * std::log(1 / Random());
         return true;
     }
-    if (dE["down"] > 0)
+    if (dE.down > 0)
     {
-        wt["down"] = (e * e * Rj / dE["down"]) * std::log(1 / Random());
+        wt.down = (tunnelScale / dE.down) * std::log(1 / Random());
         return true;
     }
     return false;
 }
 
 // 振動子のトンネル
-void SEO::setTunnel(const std::string& direction)
+void SEO::setTunnel(TunnelDirection direction)
 {
-    if (direction == "up")
+    if (direction == TunnelDirection::Up)
     {
         Q += -e;
     }
-    else if (direction == "down")
+    else if (direction == TunnelDirection::Down)
     {
         Q += e;
     }
@@ -124,22 +112,16 @@ void SEO::setTunnel(const std::string& direction)
 }
 //-----------ゲッター------------//
 
-// ノード電圧を取得
-double SEO::getVn() const
-{
-    return Vn;
-}
-
 // 接続されてる振動子の電圧の総和を取得
 double SEO::getSurroundingVsum() const
 {
     return V_sum;
 }
 
-// dEの取得
-std::map<std::string, double> SEO::getdE() const
+// 接続されてる振動子を取得
+const std::vector<std::shared_ptr<BaseElement>> &SEO::getConnections() const
 {
-    return dE;
+    return connections;
 }
 
 // Qの取得
@@ -148,10 +130,20 @@ double SEO::getQ() const
     return Q;
 }
 
-// wtの取得
-std::map<std::string, double> SEO::getWT() const
+// トンネルレートと方向の取得（calculateTunnelWtと同じくupを優先）
+std::pair<TunnelDirection, double> SEO::getTunnelRate() const
 {
-    return wt;
+    double up = dE.up;
+    if (up > 0)
+    {
+        return {TunnelDirection::Up, up / tunnelScale};
+    }
+    double down = dE.down;
+    if (down > 0)
+    {
+        return {TunnelDirection::Down, down / tunnelScale};
+    }
+    return {TunnelDirection::None, 0.0};
 }
 
 // oneway用の関数のため呼び出すとエラー発生
@@ -160,14 +152,41 @@ std::shared_ptr<BaseElement> SEO::getInternalElement(int index) const
     throw std::runtime_error("This element does not have internal elements.");
 }
 
+//-------- チェックポイント -------------//
+// 状態を書き出す
+void SEO::saveState(CheckpointWriter &out) const
+{
+    out.write(Q);
+    out.write(Vn);
+    out.write(Vd);
+    out.write(V_sum);
+    out.write(dE);
+    out.write(wt);
+    out.write(rng.seed());
+    out.write(rng.stream());
+    out.write(rng.counter());
+}
+
+// 状態を読み込む
+void SEO::loadState(CheckpointReader &in)
+{
+    in.read(Q);
+    in.read(Vn);
+    in.read(Vd);
+    in.read(V_sum);
+    in.read(dE);
+    in.read(wt);
+    std::uint64_t seed = in.read<std::uint64_t>();
+    std::uint64_t stream = in.read<std::uint64_t>();
+    rng.setStream(seed, stream);
+    rng.setCounter(in.read<std::uint64_t>());
+}
+
 //-------- 汎用処理 -------------//
-// 0から1の間の乱数を生成
+// 0から1の間の乱数を生成（素子ごとの乱数列から取るので、計算の順番やスレッドによらず同じ値になる）
 double SEO::Random()
 {
-    static std::random_device rd;
-    static std::mt19937 mt(rd());
-    static std::uniform_real_distribution<double> dist(0.0, 1.0);
-    return dist(mt);
+    return rng.uniform();
 }
 
 //-------- テスト用 -----------//
@@ -208,19 +227,28 @@ int SEO::getlegs() const
 }
 
 // テスト用dEセッター
-void SEO::setdE(const std::string &direction, double value)
+void SEO::setdE(TunnelDirection direction, double value)
 {
-    dE[direction] = value;
+    if (direction == TunnelDirection::Up)
+        dE.up = value;
+    else if (direction == TunnelDirection::Down)
+        dE.down = value;
+    else
+        throw std::invalid_argument("Invalid tunnel direction");
 }
 
 // テスト用Vnセッター
 void SEO::setVn(double vn)
 {
+    bool wasInert = isInert();
     Vn = vn;
+    noteActivation(wasInert, isInert());
 }
 
 // テスト用Qnセッター
 void SEO::setQ(double qn)
 {
+    bool wasInert = isInert();
     Q = qn;
+    noteActivation(wasInert, isInert());
 }
\ No newline at end of file
@@ -0,0 +1,362 @@
+#include "seo_kernels.hpp"
+#include "constants.hpp"
+#include <atomic>
+#include <stdexcept>
+
+// AVX-512を有効にするとFMAも使えるようになり、乗算と加算がまとめられてスカラー版と結果がずれるので禁止する
+// （CMakeでも -ffp-contract=off を付けている）
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SEO_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+//-------- スカラー版（1素子分の式。ベクトル版の端数もこれで計算する） --------//
+namespace
+{
+inline double seoVn(double Q, double V_sum, double Cj, double C, int legs)
+{
+    return Q / Cj + (C / (Cj * (legs * C + Cj))) * (Cj * V_sum - legs * Q);
+}
+
+inline void seodE(double Q, double V_sum, double Cj, double C, int legs, double &up, double &down)
+{
+    up = -e * (e - 2 * (Q + C * V_sum)) / (2 * (legs * C + Cj));
+    down = -e * (e + 2 * (Q + C * V_sum)) / (2 * (legs * C + Cj));
+}
+
+inline double multiVn(double Q, double V_sum, double Cj, double C, int legs, int multi_num, int tunnel_num)
+{
+    return (multi_num * (Cj * Q + C * Cj * V_sum) - Cj * tunnel_num * e) / (Cj * (legs * multi_num * C + Cj));
+}
+
+inline void multidE(double Q, double V_sum, double Cj, double C, int legs, int multi_num, int tunnel_num,
+                    double &up, double &down)
+{
+    up = e * ((-(multi_num - 1) * legs + 2 * legs * tunnel_num) * C * e + Cj * (2 * Q - e) + 2 * C * Cj * V_sum) / (2 * Cj * (legs * multi_num * C + Cj));
+    down = -e * (-(-(multi_num - 1) * legs - 2 * legs * tunnel_num) * C * e + Cj * (2 * Q + e) + 2 * C * Cj * V_sum) / (2 * Cj * (legs * multi_num * C + Cj));
+}
+
+void seoPotentialScalar(int begin, int n, const double *Q, const double *V_sum, const double *Cj, const double *C,
+                        const int *legs, double *Vn)
+{
+    for (int i = begin; i < n; ++i)
+        Vn[i] = seoVn(Q[i], V_sum[i], Cj[i], C[i], legs[i]);
+}
+
+void seoEnergyScalar(int begin, int n, const double *Q, const double *V_sum, const double *Cj, const double *C,
+                     const int *legs, double *dEup, double *dEdown)
+{
+    for (int i = begin; i < n; ++i)
+        seodE(Q[i], V_sum[i], Cj[i], C[i], legs[i], dEup[i], dEdown[i]);
+}
+
+void multiPotentialScalar(int begin, int n, const double *Q, const double *V_sum, const double *Cj, const double *C,
+                          const int *legs, const int *multi_num, const int *tunnel_num, double *Vn)
+{
+    for (int i = begin; i < n; ++i)
+        Vn[i] = multiVn(Q[i], V_sum[i], Cj[i], C[i], legs[i], multi_num[i], tunnel_num[i]);
+}
+
+void multiEnergyScalar(int begin, int n, const double *Q, const double *V_sum, const double *Cj, const double *C,
+                       const int *legs, const int *multi_num, const int *tunnel_num, double *dEup, double *dEdown)
+{
+    for (int i = begin; i < n; ++i)
+        multidE(Q[i], V_sum[i], Cj[i], C[i], legs[i], multi_num[i], tunnel_num[i], dEup[i], dEdown[i]);
+}
+
+#ifdef SEO_KERNELS_X86
+//-------- AVX2版（4素子ずつ） --------//
+__attribute__((target("avx2"))) int seoPotentialAVX2(int n, const double *Q, const double *V_sum, const double *Cj,
+                                                     const double *C, const int *legs, double *Vn)
+{
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d q = _mm256_loadu_pd(Q + i), vs = _mm256_loadu_pd(V_sum + i);
+        __m256d cj = _mm256_loadu_pd(Cj + i), c = _mm256_loadu_pd(C + i);
+        __m256d l = _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i *>(legs + i)));
+        __m256d coef = _mm256_div_pd(c, _mm256_mul_pd(cj, _mm256_add_pd(_mm256_mul_pd(l, c), cj)));
+        __m256d inner = _mm256_sub_pd(_mm256_mul_pd(cj, vs), _mm256_mul_pd(l, q));
+        _mm256_storeu_pd(Vn + i, _mm256_add_pd(_mm256_div_pd(q, cj), _mm256_mul_pd(coef, inner)));
+    }
+    return i;
+}
+
+__attribute__((target("avx2"))) int seoEnergyAVX2(int n, const double *Q, const double *V_sum, const double *Cj,
+                                                  const double *C, const int *legs, double *dEup, double *dEdown)
+{
+    const __m256d ve = _mm256_set1_pd(e), vne = _mm256_set1_pd(-e), two = _mm256_set1_pd(2.0);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d q = _mm256_loadu_pd(Q + i), vs = _mm256_loadu_pd(V_sum + i);
+        __m256d cj = _mm256_loadu_pd(Cj + i), c = _mm256_loadu_pd(C + i);
+        __m256d l = _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i *>(legs + i)));
+        __m256d x2 = _mm256_mul_pd(two, _mm256_add_pd(q, _mm256_mul_pd(c, vs)));
+        __m256d denom = _mm256_mul_pd(two, _mm256_add_pd(_mm256_mul_pd(l, c), cj));
+        _mm256_storeu_pd(dEup + i, _mm256_div_pd(_mm256_mul_pd(vne, _mm256_sub_pd(ve, x2)), denom));
+        _mm256_storeu_pd(dEdown + i, _mm256_div_pd(_mm256_mul_pd(vne, _mm256_add_pd(ve, x2)), denom));
+    }
+    return i;
+}
+
+__attribute__((target("avx2"))) int multiPotentialAVX2(int n, const double *Q, const double *V_sum, const double *Cj,
+                                                       const double *C, const int *legs, const int *multi_num,
+                                                       const int *tunnel_num, double *Vn)
+{
+    const __m256d ve = _mm256_set1_pd(e);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d q = _mm256_loadu_pd(Q + i), vs = _mm256_loadu_pd(V_sum + i);
+        __m256d cj = _mm256_loadu_pd(Cj + i), c = _mm256_loadu_pd(C + i);
+        __m128i li = _mm_loadu_si128(reinterpret_cast<const __m128i *>(legs + i));
+        __m128i mi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(multi_num + i));
+        __m128i ti = _mm_loadu_si128(reinterpret_cast<const __m128i *>(tunnel_num + i));
+        __m256d m = _mm256_cvtepi32_pd(mi), t = _mm256_cvtepi32_pd(ti);
+        __m256d lm = _mm256_cvtepi32_pd(_mm_mullo_epi32(li, mi));
+        __m256d num = _mm256_sub_pd(_mm256_mul_pd(m, _mm256_add_pd(_mm256_mul_pd(cj, q), _mm256_mul_pd(_mm256_mul_pd(c, cj), vs))),
+                                    _mm256_mul_pd(_mm256_mul_pd(cj, t), ve));
+        __m256d den = _mm256_mul_pd(cj, _mm256_add_pd(_mm256_mul_pd(lm, c), cj));
+        _mm256_storeu_pd(Vn + i, _mm256_div_pd(num, den));
+    }
+    return i;
+}
+
+__attribute__((target("avx2"))) int multiEnergyAVX2(int n, const double *Q, const double *V_sum, const double *Cj,
+                                                    const double *C, const int *legs, const int *multi_num,
+                                                    const int *tunnel_num, double *dEup, double *dEdown)
+{
+    const __m256d ve = _mm256_set1_pd(e), vne = _mm256_set1_pd(-e), two = _mm256_set1_pd(2.0);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d q = _mm256_loadu_pd(Q + i), vs = _mm256_loadu_pd(V_sum + i);
+        __m256d cj = _mm256_loadu_pd(Cj + i), c = _mm256_loadu_pd(C + i);
+        __m128i li = _mm_loadu_si128(reinterpret_cast<const __m128i *>(legs + i));
+        __m128i mi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(multi_num + i));
+        __m128i ti = _mm_loadu_si128(reinterpret_cast<const __m128i *>(tunnel_num + i));
+        // 整数部分：(m - 1) * legs と 2 * legs * tunnel_num
+        __m128i ml = _mm_mullo_epi32(_mm_sub_epi32(mi, _mm_set1_epi32(1)), li);
+        __m128i lt = _mm_mullo_epi32(_mm_add_epi32(li, li), ti);
+        __m256d kup = _mm256_cvtepi32_pd(_mm_sub_epi32(lt, ml));   // -(m-1)*legs + 2*legs*t
+        __m256d kdown = _mm256_cvtepi32_pd(_mm_add_epi32(ml, lt)); // -(-(m-1)*legs - 2*legs*t)
+        __m256d lm = _mm256_cvtepi32_pd(_mm_mullo_epi32(li, mi));
+        __m256d q2 = _mm256_mul_pd(two, q);
+        __m256d ccv = _mm256_mul_pd(_mm256_mul_pd(_mm256_mul_pd(two, c), cj), vs);
+        __m256d den = _mm256_mul_pd(_mm256_mul_pd(two, cj), _mm256_add_pd(_mm256_mul_pd(lm, c), cj));
+        __m256d up = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(kup, c), ve), _mm256_mul_pd(cj, _mm256_sub_pd(q2, ve))), ccv);
+        __m256d down = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(kdown, c), ve), _mm256_mul_pd(cj, _mm256_add_pd(q2, ve))), ccv);
+        _mm256_storeu_pd(dEup + i, _mm256_div_pd(_mm256_mul_pd(ve, up), den));
+        _mm256_storeu_pd(dEdown + i, _mm256_div_pd(_mm256_mul_pd(vne, down), den));
+    }
+    return i;
+}
+
+//-------- AVX-512版（8素子ずつ） --------//
+// int32×8 → double×8。_mm512_cvtepi32_pdは内部で未定義値を通すためGCCが-Wmaybe-uninitializedを出す。
+// 全レーンを有効にしたゼロマスク版は同じ変換結果になり、警告も出ない
+__attribute__((target("avx512f"))) inline __m512d toPd8(__m256i v)
+{
+    return _mm512_maskz_cvtepi32_pd(0xFF, v);
+}
+
+__attribute__((target("avx512f"))) int seoPotentialAVX512(int n, const double *Q, const double *V_sum, const double *Cj,
+                                                          const double *C, const int *legs, double *Vn)
+{
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m512d q = _mm512_loadu_pd(Q + i), vs = _mm512_loadu_pd(V_sum + i);
+        __m512d cj = _mm512_loadu_pd(Cj + i), c = _mm512_loadu_pd(C + i);
+        __m512d l = toPd8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(legs + i)));
+        __m512d coef = _mm512_div_pd(c, _mm512_mul_pd(cj, _mm512_add_pd(_mm512_mul_pd(l, c), cj)));
+        __m512d inner = _mm512_sub_pd(_mm512_mul_pd(cj, vs), _mm512_mul_pd(l, q));
+        _mm512_storeu_pd(Vn + i, _mm512_add_pd(_mm512_div_pd(q, cj), _mm512_mul_pd(coef, inner)));
+    }
+    return i;
+}
+
+__attribute__((target("avx512f"))) int seoEnergyAVX512(int n, const double *Q, const double *V_sum, const double *Cj,
+                                                       const double *C, const int *legs, double *dEup, double *dEdown)
+{
+    const __m512d ve = _mm512_set1_pd(e), vne = _mm512_set1_pd(-e), two = _mm512_set1_pd(2.0);
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m512d q = _mm512_loadu_pd(Q + i), vs = _mm512_loadu_pd(V_sum + i);
+        __m512d cj = _mm512_loadu_pd(Cj + i), c = _mm512_loadu_pd(C + i);
+        __m512d l = toPd8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(legs + i)));
+        __m512d x2 = _mm512_mul_pd(two, _mm512_add_pd(q, _mm512_mul_pd(c, vs)));
+        __m512d denom = _mm512_mul_pd(two, _mm512_add_pd(_mm512_mul_pd(l, c), cj));
+        _mm512_storeu_pd(dEup + i, _mm512_div_pd(_mm512_mul_pd(vne, _mm512_sub_pd(ve, x2)), denom));
+        _mm512_storeu_pd(dEdown + i, _mm512_div_pd(_mm512_mul_pd(vne, _mm512_add_pd(ve, x2)), denom));
+    }
+    return i;
+}
+
+__attribute__((target("avx512f"))) int multiPotentialAVX512(int n, const double *Q, const double *V_sum, const double *Cj,
+                                                            const double *C, const int *legs, const int *multi_num,
+                                                            const int *tunnel_num, double *Vn)
+{
+    const __m512d ve = _mm512_set1_pd(e);
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m512d q = _mm512_loadu_pd(Q + i), vs = _mm512_loadu_pd(V_sum + i);
+        __m512d cj = _mm512_loadu_pd(Cj + i), c = _mm512_loadu_pd(C + i);
+        __m256i li = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(legs + i));
+        __m256i mi = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(multi_num + i));
+        __m256i ti = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(tunnel_num + i));
+        __m512d m = toPd8(mi), t = toPd8(ti);
+        __m512d lm = toPd8(_mm256_mullo_epi32(li, mi));
+        __m512d num = _mm512_sub_pd(_mm512_mul_pd(m, _mm512_add_pd(_mm512_mul_pd(cj, q), _mm512_mul_pd(_mm512_mul_pd(c, cj), vs))),
+                                    _mm512_mul_pd(_mm512_mul_pd(cj, t), ve));
+        __m512d den = _mm512_mul_pd(cj, _mm512_add_pd(_mm512_mul_pd(lm, c), cj));
+        _mm512_storeu_pd(Vn + i, _mm512_div_pd(num, den));
+    }
+    return i;
+}
+
+__attribute__((target("avx512f"))) int multiEnergyAVX512(int n, const double *Q, const double *V_sum, const double *Cj,
+                                                         const double *C, const int *legs, const int *multi_num,
+                                                         const int *tunnel_num, double *dEup, double *dEdown)
+{
+    const __m512d ve = _mm512_set1_pd(e), vne = _mm512_set1_pd(-e), two = _mm512_set1_pd(2.0);
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m512d q = _mm512_loadu_pd(Q + i), vs = _mm512_loadu_pd(V_sum + i);
+        __m512d cj = _mm512_loadu_pd(Cj + i), c = _mm512_loadu_pd(C + i);
+        __m256i li = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(legs + i));
+        __m256i mi = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(multi_num + i));
+        __m256i ti = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(tunnel_num + i));
+        __m256i ml = _mm256_mullo_epi32(_mm256_sub_epi32(mi, _mm256_set1_epi32(1)), li);
+        __m256i lt = _mm256_mullo_epi32(_mm256_add_epi32(li, li), ti);
+        __m512d kup = toPd8(_mm256_sub_epi32(lt, ml));
+        __m512d kdown = toPd8(_mm256_add_epi32(ml, lt));
+        __m512d lm = toPd8(_mm256_mullo_epi32(li, mi));
+        __m512d q2 = _mm512_mul_pd(two, q);
+        __m512d ccv = _mm512_mul_pd(_mm512_mul_pd(_mm512_mul_pd(two, c), cj), vs);
+        __m512d den = _mm512_mul_pd(_mm512_mul_pd(two, cj), _mm512_add_pd(_mm512_mul_pd(lm, c), cj));
+        __m512d up = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(_mm512_mul_pd(kup, c), ve), _mm512_mul_pd(cj, _mm512_sub_pd(q2, ve))), ccv);
+        __m512d down = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(_mm512_mul_pd(kdown, c), ve), _mm512_mul_pd(cj, _mm512_add_pd(q2, ve))), ccv);
+        _mm512_storeu_pd(dEup + i, _mm512_div_pd(_mm512_mul_pd(ve, up), den));
+        _mm512_storeu_pd(dEdown + i, _mm512_div_pd(_mm512_mul_pd(vne, down), den));
+    }
+    return i;
+}
+#endif
+
+// 今使っている命令セット（setSimdLevelと計算中の別のスレッドのカーネルが同時に触れてもよいようにatomicにする）
+std::atomic<SimdLevel> currentLevel{detectSimdLevel()};
+} // namespace
+
+//-------- 命令セットの選択 --------//
+// CPUが対応している一番速い命令セット
+SimdLevel detectSimdLevel()
+{
+#ifdef SEO_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return SimdLevel::AVX512;
+    if (__builtin_cpu_supports("avx2"))
+        return SimdLevel::AVX2;
+#endif
+    return SimdLevel::Scalar;
+}
+
+// 命令セットをCPUが使えるかどうか
+bool isSimdLevelSupported(SimdLevel level)
+{
+    return static_cast<int>(level) <= static_cast<int>(detectSimdLevel());
+}
+
+// 今使っている命令セットを取得
+SimdLevel getSimdLevel()
+{
+    return currentLevel;
+}
+
+// 使う命令セットを設定
+void setSimdLevel(SimdLevel level)
+{
+    if (!isSimdLevelSupported(level))
+        throw std::invalid_argument("SIMD level " + simdLevelName(level) + " is not supported on this CPU");
+    currentLevel = level;
+}
+
+// 命令セットの名前
+std::string simdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::AVX512:
+        return "AVX-512";
+    case SimdLevel::AVX2:
+        return "AVX2";
+    default:
+        return "scalar";
+    }
+}
+
+//-------- カーネル（ベクトル版で計算できなかった端数はスカラー版で計算する） --------//
+void seoPotentialKernel(int n, const double *Q, const double *V_sum, const double *Cj, const double *C,
+                        const int *legs, double *Vn)
+{
+    int done = 0;
+#ifdef SEO_KERNELS_X86
+    SimdLevel level = currentLevel.load(std::memory_order_relaxed);
+    if (level == SimdLevel::AVX512)
+        done = seoPotentialAVX512(n, Q, V_sum, Cj, C, legs, Vn);
+    else if (level == SimdLevel::AVX2)
+        done = seoPotentialAVX2(n, Q, V_sum, Cj, C, legs, Vn);
+#endif
+    seoPotentialScalar(done, n, Q, V_sum, Cj, C, legs, Vn);
+}
+
+void seoEnergyKernel(int n, const double *Q, const double *V_sum, const double *Cj, const double *C,
+                     const int *legs, double *dEup, double *dEdown)
+{
+    int done = 0;
+#ifdef SEO_KERNELS_X86
+    SimdLevel level = currentLevel.load(std::memory_order_relaxed);
+    if (level == SimdLevel::AVX512)
+        done = seoEnergyAVX512(n, Q, V_sum, Cj, C, legs, dEup, dEdown);
+    else if (level == SimdLevel::AVX2)
+        done = seoEnergyAVX2(n, Q, V_sum, Cj, C, legs, dEup, dEdown);
+#endif
+    seoEnergyScalar(done, n, Q, V_sum, Cj, C, legs, dEup, dEdown);
+}
+
+void multiSeoPotentialKernel(int n, const double *Q, const double *V_sum, const double *Cj, const double *C,
+                             const int *legs, const int *multi_num, const int *tunnel_num, double *Vn)
+{
+    int done = 0;
+#ifdef SEO_KERNELS_X86
+    SimdLevel level = currentLevel.load(std::memory_order_relaxed);
+    if (level == SimdLevel::AVX512)
+        done = multiPotentialAVX512(n, Q, V_sum, Cj, C, legs, multi_num, tunnel_num, Vn);
+    else if (level == SimdLevel::AVX2)
+        done = multiPotentialAVX2(n, Q, V_sum, Cj, C, legs, multi_num, tunnel_num, Vn);
+#endif
+    multiPotentialScalar(done, n, Q, V_sum, Cj, C, legs, multi_num, tunnel_num, Vn);
+}
+
+void multiSeoEnergyKernel(int n, const double *Q, const double *V_sum, const double *Cj, const double *C,
+                          const int *legs, const int *multi_num, const int *tunnel_num, double *dEup, double *dEdown)
+{
+    int done = 0;
+#ifdef SEO_KERNELS_X86
+    SimdLevel level = currentLevel.load(std::memory_order_relaxed);
+    if (level == SimdLevel::AVX512)
+        done = multiEnergyAVX512(n, Q, V_sum, Cj, C, legs, multi_num, tunnel_num, dEup, dEdown);
+    else if (level == SimdLevel::AVX2)
+        done = multiEnergyAVX2(n, Q, V_sum, Cj, C, legs, multi_num, tunnel_num, dEup, dEdown);
+#endif
+    multiEnergyScalar(done, n, Q, V_sum, Cj, C, legs, multi_num, tunnel_num, dEup, dEdown);
+}
@@ -0,0 +1,42 @@
+#ifndef CHECKER_GRID_HPP
+#define CHECKER_GRID_HPP
+
+#include <memory>
+#include <vector>
+#include "grid_2dim.hpp"
+#include "seo_class.hpp"
+
+// テストで使う回路
+// 市松模様にバイアス（±vd）をかけたrows×colsのSEOの格子（4近傍で接続。接続の順は上・左・下・右）
+template <typename Element = BaseElement>
+Grid2D<Element> makeCheckerGrid(int rows, int cols, double vd = 0.009, double rj = 0.05)
+{
+    Grid2D<Element> grid(rows, cols, false);
+    for (int y = 0; y < rows; ++y)
+        for (int x = 0; x < cols; ++x)
+            grid.setElement(y, x, std::make_shared<SEO>(1.0, rj, 10.0, 2.0, ((x + y) % 2) ? vd : -vd, 4));
+    for (int y = 0; y < rows; ++y)
+        for (int x = 0; x < cols; ++x)
+        {
+            std::vector<std::shared_ptr<BaseElement>> conns;
+            if (y > 0)
+                conns.push_back(grid.getElement(y - 1, x));
+            if (x > 0)
+                conns.push_back(grid.getElement(y, x - 1));
+            if (y < rows - 1)
+                conns.push_back(grid.getElement(y + 1, x));
+            if (x < cols - 1)
+                conns.push_back(grid.getElement(y, x + 1));
+            grid.getElement(y, x)->setConnections(conns);
+        }
+    return grid;
+}
+
+// N×Nの市松模様の格子
+template <typename Element = BaseElement>
+Grid2D<Element> makeCheckerGrid(int n, double vd = 0.009, double rj = 0.05)
+{
+    return makeCheckerGrid<Element>(n, n, vd, rj);
+}
+
+#endif // CHECKER_GRID_HPP
@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+#include <memory>
+#include <vector>
+#include "grid_2dim.hpp"
+
+// 何も起きない素子を計算から外すテスト
+// ・接続もバイアスも無い素子は計算しないが、全ての素子を計算するGrid2D<SEO>と同じ結果になること
+// ・ステップの間にバイアスを与えた素子は、refreshActiveSetを呼ばなくても次のステップから計算に戻ること
+namespace
+{
+constexpr int n = 8, pad = 2; // 外周pad個分は何もつながっていない素子
+
+bool isPadding(int y, int x)
+{
+    return y < pad || x < pad || y >= n - pad || x >= n - pad;
+}
+
+// 中央に市松模様にバイアスをかけた格子（4近傍で接続）、外周はバイアス0で接続なし
+template <typename Element>
+Grid2D<Element> makeGrid()
+{
+    Grid2D<Element> grid(n, n, false);
+    for (int y = 0; y < n; ++y)
+        for (int x = 0; x < n; ++x)
+        {
+            double vd = isPadding(y, x) ? 0.0 : (((x + y) % 2) ? 0.009 : -0.009);
+            grid.setElement(y, x, std::make_shared<SEO>(1.0, 0.05, 10.0, 2.0, vd, 4));
+        }
+    for (int y = pad; y < n - pad; ++y)
+        for (int x = pad; x < n - pad; ++x)
+        {
+            std::vector<std::shared_ptr<BaseElement>> conns;
+            for (auto [dy, dx] : {std::pair{-1, 0}, {0, -1}, {1, 0}, {0, 1}})
+                if (!isPadding(y + dy, x + dx))
+                    conns.push_back(grid.getElement(y + dy, x + dx));
+            grid.getElement(y, x)->setConnections(conns);
+        }
+    grid.setRandomStreams(17, 0);
+    return grid;
+}
+
+struct Tunnel
+{
+    int index;
+    TunnelDirection direction;
+    double wt;
+    bool operator==(const Tunnel &o) const { return index == o.index && direction == o.direction && wt == o.wt; }
+};
+
+template <typename Element>
+void step(Grid2D<Element> &grid, std::vector<Tunnel> &out)
+{
+    for (int k = 0; k < 5; ++k)
+    {
+        grid.updateGridSurVn();
+        grid.updateGridVn();
+    }
+    grid.updateGriddE();
+    double st = 0.1;
+    if (grid.gridminwt(0.1))
+    {
+        out.push_back({grid.getTunnelIndex(), grid.getTunnelDirection(), grid.getMinWT()});
+        grid.getTunnelPlace()->setTunnel(grid.getTunnelDirection());
+        st = grid.getMinWT();
+    }
+    grid.updateGridQn(st);
+}
+
+template <typename A, typename B>
+void expectSameVn(Grid2D<A> &a, Grid2D<B> &b)
+{
+    for (int y = 0; y < n; ++y)
+        for (int x = 0; x < n; ++x)
+            EXPECT_EQ(a.getElement(y, x)->getVn(), b.getElement(y, x)->getVn()) << y << "," << x;
+}
+} // namespace
+
+// 外周の素子を計算しなくても、全て計算した場合と同じトンネルの列・電圧
+TEST(ActiveSetTest, SkipsPaddingWithoutChangingResults)
+{
+    auto base = makeGrid<BaseElement>();
+    auto full = makeGrid<SEO>();
+    EXPECT_EQ(base.numActiveElements(), (n - 2 * pad) * (n - 2 * pad));
+    std::vector<Tunnel> a, b;
+    for (int s = 0; s < 1000; ++s)
+    {
+        step(base, a);
+        step(full, b);
+    }
+    ASSERT_FALSE(a.empty());
+    EXPECT_EQ(a, b);
+    expectSameVn(base, full);
+}
+
+// ステップの間にgetElementからバイアスを与えた外周の素子は、refreshActiveSetを呼ばなくても計算に戻り、単独で振動する
+TEST(ActiveSetTest, ReactivatesWhenBiasChanges)
+{
+    auto base = makeGrid<BaseElement>();
+    auto full = makeGrid<SEO>();
+    std::vector<Tunnel> a, b;
+    for (int s = 0; s < 200; ++s)
+    {
+        step(base, a);
+        step(full, b);
+    }
+    base.getElement(0, 0)->setVias(0.02);
+    full.getElement(0, 0)->setVias(0.02);
+    EXPECT_EQ(base.numActiveElements(), (n - 2 * pad) * (n - 2 * pad) + 1);
+    for (int s = 0; s < 2000; ++s)
+    {
+        step(base, a);
+        step(full, b);
+    }
+    EXPECT_EQ(base.numActiveElements(), (n - 2 * pad) * (n - 2 * pad) + 1);
+    EXPECT_EQ(a, b);
+    expectSameVn(base, full);
+    bool cornerTunnelled = false;
+    for (const auto &t : a)
+        cornerTunnelled |= (t.index == 0);
+    EXPECT_TRUE(cornerTunnelled);
+}
@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "batch_log.hpp"
+#include "seo_kernels.hpp"
+
+// batchLogのテスト
+// ・対数の多項式がstd::logと数ULP以内で一致すること（AVX2版・スカラー版とも）
+namespace
+{
+class SimdLevelGuard
+{
+    SimdLevel saved;
+
+public:
+    explicit SimdLevelGuard(SimdLevel level) : saved(getSimdLevel()) { setSimdLevel(level); }
+    ~SimdLevelGuard() { setSimdLevel(saved); }
+};
+
+// 2つの倍精度の間のULP数
+std::int64_t ulpDistance(double a, double b)
+{
+    std::int64_t ia, ib;
+    std::memcpy(&ia, &a, sizeof(a));
+    std::memcpy(&ib, &b, sizeof(b));
+    if (ia < 0)
+        ia = INT64_MIN - ia;
+    if (ib < 0)
+        ib = INT64_MIN - ib;
+    return ia > ib ? ia - ib : ib - ia;
+}
+} // namespace
+
+// 対数の多項式はstd::logと2ULP以内
+TEST(BatchLogTest, MatchesStdLog)
+{
+    std::mt19937_64 mt(7);
+    std::uniform_real_distribution<double> unit(0.0, 1.0), expo(-700.0, 700.0);
+    std::vector<double> x;
+    for (int i = 0; i < 20000; ++i)
+    {
+        x.push_back(1.0 - unit(mt));          // (0, 1]
+        x.push_back(std::exp(expo(mt)));      // 広い範囲
+    }
+    x.push_back(1.0);
+    x.push_back(std::sqrt(2.0));
+    x.push_back(0.5);
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::AVX2})
+    {
+        if (!isSimdLevelSupported(level))
+            continue;
+        SimdLevelGuard guard(level);
+        std::vector<double> out(x.size());
+        batchLog(static_cast<int>(x.size()), x.data(), out.data());
+        std::int64_t worst = 0;
+        for (size_t i = 0; i < x.size(); ++i)
+            worst = std::max(worst, ulpDistance(out[i], std::log(x[i])));
+        EXPECT_LE(worst, 2) << simdLevelName(level);
+    }
+}
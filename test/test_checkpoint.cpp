@@ -0,0 +1,150 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "simulation_2d.hpp"
+#include "checker_grid.hpp"
+
+// チェックポイントのテスト
+// 途中で保存して別のインスタンスで読み込んで続けた結果が、止めずに続けた結果とビット単位で一致すること
+namespace
+{
+using Sim = Simulation2D<BaseElement>;
+
+struct Options
+{
+    EngineMode mode = EngineMode::Step;
+    bool incremental = false;
+};
+
+std::unique_ptr<Sim> makeSim(const Options &opt)
+{
+    auto sim = std::make_unique<Sim>(0.1, 1000);
+    sim->addGrid({makeCheckerGrid(6), makeCheckerGrid(4)});
+    sim->setSeed(31);
+    sim->setEngineMode(opt.mode);
+    sim->setIncrementalUpdate(opt.incremental);
+    return sim;
+}
+
+std::string readFile(const std::string &path)
+{
+    std::ifstream ifs(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+}
+
+// 途中で保存・読み込みした場合と止めずに続けた場合で、最後の状態を保存したファイルが一致する
+void expectResumeMatches(const Options &opt, const std::string &name)
+{
+    const std::string mid = name + "_mid.ckpt", straight = name + "_straight.ckpt", resumed = name + "_resumed.ckpt";
+    auto a = makeSim(opt);
+    for (int s = 0; s < 300; ++s)
+        a->runStep();
+    a->saveCheckpoint(mid);
+    for (int s = 0; s < 300; ++s)
+        a->runStep();
+    a->saveCheckpoint(straight);
+
+    auto b = makeSim(opt);
+    ASSERT_TRUE(b->loadCheckpoint(mid));
+    for (int s = 0; s < 300; ++s)
+        b->runStep();
+    b->saveCheckpoint(resumed);
+
+    std::string x = readFile(straight), y = readFile(resumed);
+    EXPECT_FALSE(x.empty());
+    EXPECT_NE(readFile(mid), x);
+    EXPECT_TRUE(x == y) << name;
+    for (int g = 0; g < 2; ++g)
+        for (int i = 0; i < a->getGrids()[g].numRows(); ++i)
+            EXPECT_EQ(a->getGrids()[g].getElement(i, i)->getVn(), b->getGrids()[g].getElement(i, i)->getVn());
+    std::remove(mid.c_str());
+    std::remove(straight.c_str());
+    std::remove(resumed.c_str());
+}
+} // namespace
+
+TEST(CheckpointTest, ResumeStepEngine)
+{
+    expectResumeMatches({}, "ckpt_step");
+}
+
+TEST(CheckpointTest, ResumeEventQueueEngine)
+{
+    expectResumeMatches({EngineMode::EventQueue, false}, "ckpt_event");
+}
+
+TEST(CheckpointTest, ResumeIncrementalUpdate)
+{
+    expectResumeMatches({EngineMode::Step, true}, "ckpt_incr");
+}
+
+TEST(CheckpointTest, ResumeRateTreeEngine)
+{
+    expectResumeMatches({EngineMode::RateTree, false}, "ckpt_tree");
+    expectResumeMatches({EngineMode::RateTree, true}, "ckpt_tree_incr");
+}
+
+// ファイルが無ければfalse、回路の形が違えば例外
+TEST(CheckpointTest, RejectsMissingOrMismatchedFile)
+{
+    Sim sim(0.1, 10);
+    sim.addGrid({makeCheckerGrid(4)});
+    EXPECT_FALSE(sim.loadCheckpoint("ckpt_does_not_exist.ckpt"));
+    sim.saveCheckpoint("ckpt_small.ckpt");
+
+    Sim other(0.1, 10);
+    other.addGrid({makeCheckerGrid(5)});
+    EXPECT_THROW(other.loadCheckpoint("ckpt_small.ckpt"), std::runtime_error);
+    std::remove("ckpt_small.ckpt");
+}
+
+// 既にあるファイルに保存すると新しい状態に置き換わり、一時ファイルは残らない
+TEST(CheckpointTest, SaveReplacesExistingFile)
+{
+    const std::string path = "ckpt_replace.ckpt";
+    Sim sim(0.1, 10);
+    sim.addGrid({makeCheckerGrid(4)});
+    sim.setSeed(2);
+    sim.saveCheckpoint(path);
+    std::string first = readFile(path);
+    for (int s = 0; s < 20; ++s)
+        sim.runStep();
+    sim.saveCheckpoint(path);
+    std::string second = readFile(path);
+    EXPECT_NE(second, first);
+    EXPECT_FALSE(std::ifstream(path + ".tmp").good());
+
+    Sim resumed(0.1, 10);
+    resumed.addGrid({makeCheckerGrid(4)});
+    ASSERT_TRUE(resumed.loadCheckpoint(path));
+    EXPECT_EQ(resumed.getTime(), sim.getTime());
+    std::remove(path.c_str());
+}
+
+// 素子単体の保存・読み込みで、乱数のカウンタも含めて同じ待ち時間が出る
+TEST(CheckpointTest, ElementRoundTrip)
+{
+    SEO a(1.0, 0.05, 10.0, 2.0, 0.009, 4);
+    a.setRandomStream(3, rngStream(RngDomain::Element, 0));
+    a.setdE(TunnelDirection::Up, 0.01);
+    a.setdE(TunnelDirection::Down, -0.01);
+    a.calculateTunnelWt();
+    std::stringstream buf;
+    CheckpointWriter out(buf);
+    a.saveState(out);
+
+    SEO b(1.0, 0.05, 10.0, 2.0, 0.009, 4);
+    CheckpointReader in(buf);
+    b.loadState(in);
+    for (int k = 0; k < 10; ++k)
+    {
+        ASSERT_TRUE(a.calculateTunnelWt());
+        ASSERT_TRUE(b.calculateTunnelWt());
+        EXPECT_EQ(a.getWT().up, b.getWT().up);
+    }
+}
@@ -0,0 +1,186 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "circuit_graph.hpp"
+#include "simulation_2d.hpp"
+#include "checker_grid.hpp"
+
+// 回路のグラフ（CircuitGraph）のテスト
+// ・格子ごとの接続の数・辺の数・接続の順番が正しいこと、誤った辺のリストは例外になること
+// ・正方格子のグラフが同じ接続のgridとビット単位で同じ結果になること
+// ・六角格子・三角格子でもシミュレーションでき、実行プランの結果と一致すること
+// ・gridを登録済みのシミュレーションにはグラフを登録できず、グラフと違う接続はcompileで例外になること
+namespace
+{
+using Sim = Simulation2D<BaseElement>;
+
+// 市松模様にバイアスをかけたSEO（legsは4で固定。gridのテストと同じパラメータ）
+std::shared_ptr<BaseElement> checkerSEO(int id, int cols)
+{
+    int y = id / cols, x = id % cols;
+    return std::make_shared<SEO>(1.0, 0.05, 10.0, 2.0, ((x + y) % 2) ? 0.009 : -0.009, 4);
+}
+
+std::vector<int> neighborsOf(const CircuitGraph &graph, int id)
+{
+    auto [first, last] = graph.neighbors(id);
+    return std::vector<int>(first, last);
+}
+
+// endtimeまで回したときのトンネルの回数（1ステップでQがe/2より大きく変わった回数）
+int countTunnels(Sim &sim, const std::vector<std::shared_ptr<BaseElement>> &elements, double endtime)
+{
+    auto chargeOf = [&](size_t k) { return std::static_pointer_cast<SEO>(elements[k])->getQ(); };
+    std::vector<double> q(elements.size());
+    for (size_t k = 0; k < elements.size(); ++k)
+        q[k] = chargeOf(k);
+    int tunnels = 0;
+    while (sim.getTime() < endtime)
+    {
+        sim.runStep();
+        for (size_t k = 0; k < elements.size(); ++k)
+        {
+            double now = chargeOf(k);
+            if (std::abs(now - q[k]) > e / 2)
+                ++tunnels;
+            q[k] = now;
+        }
+    }
+    return tunnels;
+}
+} // namespace
+
+// 格子ごとの接続の数と辺の数
+TEST(CircuitGraphTest, LatticeDegreesAndEdgeCounts)
+{
+    const int rows = 5, cols = 6;
+    auto make = [](int, int degree) { return std::make_shared<SEO>(1.0, 0.05, 10.0, 2.0, 0.0, degree); };
+
+    CircuitGraph square = CircuitGraph::squareLattice(rows, cols, make);
+    EXPECT_EQ(square.numNodes(), rows * cols);
+    EXPECT_EQ(square.numEdges(), rows * (cols - 1) + cols * (rows - 1));
+    EXPECT_EQ(square.degree(2 * cols + 3), 4);
+    EXPECT_EQ(square.degree(0), 2);
+
+    CircuitGraph triangular = CircuitGraph::triangularLattice(rows, cols, make);
+    EXPECT_EQ(triangular.numEdges(), rows * (cols - 1) + cols * (rows - 1) + (rows - 1) * (cols - 1));
+    EXPECT_EQ(triangular.degree(2 * cols + 3), 6);
+    EXPECT_EQ(neighborsOf(triangular, 2 * cols + 3),
+              (std::vector<int>{cols + 2, cols + 3, 2 * cols + 2, 2 * cols + 4, 3 * cols + 3, 3 * cols + 4}));
+
+    CircuitGraph hexagonal = CircuitGraph::hexagonalLattice(rows, cols, make);
+    int vertical = 0;
+    for (int y = 0; y < rows - 1; ++y)
+        for (int x = 0; x < cols; ++x)
+            vertical += ((x + y) % 2 == 0);
+    EXPECT_EQ(hexagonal.numEdges(), rows * (cols - 1) + vertical);
+    for (int y = 1; y < rows - 1; ++y)
+        for (int x = 1; x < cols - 1; ++x)
+            EXPECT_EQ(hexagonal.degree(y * cols + x), 3) << y << ", " << x;
+
+    // 素子には接続の数がlegsとして渡され、接続が設定されている
+    auto seo = std::static_pointer_cast<SEO>(hexagonal.getElement(cols + 1));
+    EXPECT_EQ(seo->getlegs(), 3);
+    EXPECT_EQ(seo->getConnections().size(), 3u);
+}
+
+// 辺のリストの順に接続が並び、範囲外・自己ループ・重複した辺は例外
+TEST(CircuitGraphTest, EdgeListKeepsOrderAndRejectsBadEdges)
+{
+    std::vector<std::shared_ptr<BaseElement>> elems;
+    for (int i = 0; i < 4; ++i)
+        elems.push_back(std::make_shared<SEO>(1.0, 0.05, 10.0, 2.0, 0.0, 4));
+    CircuitGraph graph = CircuitGraph::fromEdgeList(elems, {{0, 2}, {1, 0}, {3, 0}, {2, 3}});
+    EXPECT_EQ(graph.numEdges(), 4);
+    EXPECT_EQ(neighborsOf(graph, 0), (std::vector<int>{2, 1, 3}));
+    EXPECT_EQ(neighborsOf(graph, 2), (std::vector<int>{0, 3}));
+    const auto &conns = elems[0]->getConnections();
+    ASSERT_EQ(conns.size(), 3u);
+    EXPECT_EQ(conns[0], elems[2]);
+    EXPECT_EQ(conns[1], elems[1]);
+    EXPECT_EQ(conns[2], elems[3]);
+
+    EXPECT_THROW(CircuitGraph::fromEdgeList(elems, {{0, 4}}), std::invalid_argument);
+    EXPECT_THROW(CircuitGraph::fromEdgeList(elems, {{1, 1}}), std::invalid_argument);
+    EXPECT_THROW(CircuitGraph::fromEdgeList(elems, {{0, 1}, {1, 0}}), std::invalid_argument);
+    EXPECT_THROW(CircuitGraph::squareLattice(0, 3, [](int, int) { return std::make_shared<SEO>(); }), std::invalid_argument);
+    EXPECT_THROW(graph.neighbors(4), std::out_of_range);
+}
+
+// 正方格子のグラフは、同じ接続のgridと乱数列・計算の順番が同じなのでビット単位で一致する
+TEST(CircuitGraphTest, SquareLatticeMatchesGrid)
+{
+    const int n = 6;
+    CircuitGraph graph = CircuitGraph::squareLattice(n, n, [n](int id, int) { return checkerSEO(id, n); });
+    Grid2D<BaseElement> grid = makeCheckerGrid(n);
+
+    Sim onGraph(0.1, 1000), onGrid(0.1, 1000);
+    onGraph.addGraph(graph);
+    onGrid.addGrid({grid});
+    for (Sim *sim : {&onGraph, &onGrid})
+        sim->setSeed(12);
+    onGraph.compile();
+    for (int s = 0; s < 500; ++s)
+    {
+        onGraph.runStep();
+        onGrid.runStep();
+    }
+    EXPECT_EQ(onGraph.getTime(), onGrid.getTime());
+    for (int k = 0; k < n * n; ++k)
+        EXPECT_EQ(std::static_pointer_cast<SEO>(graph.getElement(k))->getQ(),
+                  std::static_pointer_cast<SEO>(grid.getElement(k / n, k % n))->getQ())
+            << "node " << k;
+}
+
+// 六角格子・三角格子でもトンネルが起き、実行プランを使っても同じ結果になる
+TEST(CircuitGraphTest, NonSquareLatticesSimulate)
+{
+    const int rows = 6, cols = 8;
+    auto make = [](int id, int degree)
+    {
+        int y = id / cols, x = id % cols;
+        return std::make_shared<SEO>(1.0, 0.05, 10.0, 2.0, ((x + y) % 2) ? 0.012 : -0.012, std::max(degree, 1));
+    };
+    for (auto build : {&CircuitGraph::hexagonalLattice, &CircuitGraph::triangularLattice})
+    {
+        CircuitGraph plain = build(rows, cols, make), compiled = build(rows, cols, make);
+        Sim a(0.1, 1000), b(0.1, 1000);
+        a.addGraph(plain);
+        b.addGraph(compiled);
+        a.setSeed(5);
+        b.setSeed(5);
+        b.compile();
+        int tunnelsA = countTunnels(a, plain.getElements(), 100.0);
+        int tunnelsB = countTunnels(b, compiled.getElements(), 100.0);
+        EXPECT_GT(tunnelsA, 0);
+        EXPECT_EQ(tunnelsA, tunnelsB);
+        for (int k = 0; k < rows * cols; ++k)
+            EXPECT_EQ(std::static_pointer_cast<SEO>(plain.getElement(k))->getQ(),
+                      std::static_pointer_cast<SEO>(compiled.getElement(k))->getQ());
+    }
+}
+
+// グラフは既にgridを登録したシミュレーションには登録できず、グラフを作った後に接続を書き換えるとcompileで例外になる
+TEST(CircuitGraphTest, AddGraphRejectsExistingGridsAndStaleConnections)
+{
+    const int n = 4;
+    CircuitGraph graph = CircuitGraph::squareLattice(n, n, [n](int id, int) { return checkerSEO(id, n); });
+    Sim withGrid(0.1, 1000);
+    withGrid.addGrid({makeCheckerGrid(n)});
+    EXPECT_THROW(withGrid.addGraph(graph), std::logic_error);
+
+    Sim sim(0.1, 1000);
+    sim.addGraph(graph);
+    EXPECT_THROW(sim.addGraph(graph), std::logic_error);
+    EXPECT_NO_THROW(sim.compile());
+
+    auto a = graph.getElement(0);
+    auto conns = a->getConnections();
+    conns.push_back(graph.getElement(n * n - 1));
+    a->setConnections(conns);
+    EXPECT_THROW(sim.compile(), std::invalid_argument);
+}
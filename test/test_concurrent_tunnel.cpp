@@ -0,0 +1,171 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+#include "simulation_2d.hpp"
+#include "checker_grid.hpp"
+
+// 同時トンネルのテスト
+// ・幅を十分小さくすれば、1ステップに1回だけトンネルする従来の方法とビット単位で一致すること
+// ・同じステップでトンネルする素子どうしが接続の3段以上離れていること
+// ・トンネルの頻度が従来の方法と統計的に一致し、ステップ数は減ること
+namespace
+{
+using Sim = Simulation2D<BaseElement>;
+
+double chargeOf(Grid2D<BaseElement> &grid, int k)
+{
+    return std::static_pointer_cast<SEO>(grid.getElement(k / grid.numCols(), k % grid.numCols()))->getQ();
+}
+
+struct RunResult
+{
+    int steps = 0;
+    int tunnels = 0;
+};
+
+// endtimeまで回して、ステップ数とトンネルの回数（1ステップでQがe/2より大きく変わった回数）を数える
+RunResult runUntil(Sim &sim, double endtime)
+{
+    auto &grid = sim.getGrids()[0];
+    int n = grid.numRows() * grid.numCols();
+    std::vector<double> q(n);
+    for (int k = 0; k < n; ++k)
+        q[k] = chargeOf(grid, k);
+    RunResult result;
+    while (sim.getTime() < endtime)
+    {
+        sim.runStep();
+        ++result.steps;
+        for (int k = 0; k < n; ++k)
+        {
+            double now = chargeOf(grid, k);
+            if (std::abs(now - q[k]) > e / 2)
+                ++result.tunnels;
+            q[k] = now;
+        }
+    }
+    return result;
+}
+
+std::unique_ptr<Sim> makeSim(int n, std::uint64_t seed, double window, bool incremental = false)
+{
+    auto sim = std::make_unique<Sim>(0.1, 1e9);
+    sim->addGrid({makeCheckerGrid(n)});
+    sim->setSeed(seed);
+    sim->setConcurrentWindow(window);
+    sim->setIncrementalUpdate(incremental);
+    return sim;
+}
+// 電荷をためてすぐにトンネルできるようにした素子だけを持つ10×10の格子で1ステップ進め、トンネルした素子を返す
+// （トンネル抵抗を小さくしてレートを上げる。ためた電荷は隣の素子のdEを正にしない大きさにする）
+std::vector<int> tunnelOnce(std::uint64_t seed, const std::vector<std::pair<int, int>> &charged)
+{
+    const int n = 10;
+    Sim sim(0.1, 1e9);
+    sim.addGrid({makeCheckerGrid(n, 0.0, 0.001)});
+    sim.setSeed(seed);
+    sim.setConcurrentWindow(0.1);
+    auto &grid = sim.getGrids()[0];
+    for (const auto &[y, x] : charged)
+    {
+        grid.getElement(y, x)->setVias(0.1);
+        grid.getElement(y, x)->setPcalc();
+        grid.getElement(y, x)->setNodeCharge(5.0);
+    }
+    grid.refreshActiveSet();
+
+    std::vector<double> q(n * n);
+    for (int k = 0; k < n * n; ++k)
+        q[k] = chargeOf(grid, k);
+    sim.runStep();
+    std::vector<int> tunnelled;
+    for (int k = 0; k < n * n; ++k)
+    {
+        if (std::abs(chargeOf(grid, k) - q[k]) > e / 2)
+            tunnelled.push_back(k);
+    }
+    return tunnelled;
+}
+} // namespace
+
+// 幅がごく小さければ同時にトンネルする素子は無く、従来の方法と同じ結果になる
+TEST(ConcurrentTunnelTest, TinyWindowMatchesSingleEventEngine)
+{
+    for (bool incremental : {false, true})
+    {
+        auto single = makeSim(8, 4, 0.0, incremental), concurrent = makeSim(8, 4, 1e-300, incremental);
+        for (int s = 0; s < 500; ++s)
+        {
+            single->runStep();
+            concurrent->runStep();
+        }
+        EXPECT_EQ(single->getTime(), concurrent->getTime()) << incremental;
+        auto &a = single->getGrids()[0];
+        auto &b = concurrent->getGrids()[0];
+        for (int k = 0; k < 64; ++k)
+            EXPECT_EQ(chargeOf(a, k), chargeOf(b, k)) << "element " << k << " incremental " << incremental;
+    }
+}
+
+// 3つおきの素子は互いに距離が3以上なので、全て同じステップでトンネルする
+TEST(ConcurrentTunnelTest, IndependentElementsTunnelTogether)
+{
+    std::vector<std::pair<int, int>> charged;
+    for (int y = 0; y < 10; y += 3)
+        for (int x = 0; x < 10; x += 3)
+            charged.emplace_back(y, x);
+    EXPECT_EQ(tunnelOnce(8, charged).size(), charged.size());
+}
+
+// 隣どうしの素子が混ざっていても、同じステップでトンネルした素子はどの2つも距離が3以上
+TEST(ConcurrentTunnelTest, CommittedEventsAreIndependent)
+{
+    std::vector<std::pair<int, int>> charged;
+    for (int y = 0; y < 10; y += 3)
+        for (int x = 0; x < 10; x += 3)
+            charged.emplace_back(y, x);
+    charged.emplace_back(3, 4);
+    charged.emplace_back(7, 6);
+    size_t total = 0;
+    for (std::uint64_t seed = 1; seed <= 20; ++seed)
+    {
+        std::vector<int> tunnelled = tunnelOnce(seed, charged);
+        total += tunnelled.size();
+        for (size_t a = 0; a < tunnelled.size(); ++a)
+            for (size_t b = a + 1; b < tunnelled.size(); ++b)
+            {
+                int ya = tunnelled[a] / 10, xa = tunnelled[a] % 10, yb = tunnelled[b] / 10, xb = tunnelled[b] % 10;
+                EXPECT_GE(std::abs(ya - yb) + std::abs(xa - xb), 3) << "seed " << seed;
+            }
+    }
+    EXPECT_GT(total, 40u);
+}
+
+// 同じ時間でのトンネルの回数は従来の方法と統計的に一致し、ステップ数は減る
+TEST(ConcurrentTunnelTest, TunnelRateMatchesSingleEventEngine)
+{
+    RunResult single, concurrent;
+    for (std::uint64_t seed : {1, 2, 3})
+    {
+        auto a = makeSim(16, seed, 0.0), b = makeSim(16, seed, 0.1);
+        RunResult ra = runUntil(*a, 200.0), rb = runUntil(*b, 200.0);
+        single.steps += ra.steps;
+        single.tunnels += ra.tunnels;
+        concurrent.steps += rb.steps;
+        concurrent.tunnels += rb.tunnels;
+    }
+    ASSERT_GT(single.tunnels, 3000);
+    EXPECT_NEAR(concurrent.tunnels, single.tunnels, 0.03 * single.tunnels);
+    EXPECT_LT(concurrent.steps, single.steps * 3 / 4);
+}
+
+// 負の幅は設定できない
+TEST(ConcurrentTunnelTest, RejectsNegativeWindow)
+{
+    Sim sim(0.1, 10);
+    EXPECT_THROW(sim.setConcurrentWindow(-0.1), std::invalid_argument);
+    sim.setConcurrentWindow(0.05);
+    EXPECT_EQ(sim.getConcurrentWindow(), 0.05);
+}
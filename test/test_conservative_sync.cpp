@@ -0,0 +1,272 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <memory>
+#include <string>
+#include <vector>
+#include "simulation_2d.hpp"
+#include "checker_grid.hpp"
+
+// 保守的な並列離散イベント同期（Simulation2D::setConservativeSync）のテスト
+// ・結果がスレッド数によらないこと、runStepが出力時刻まで進めること
+// ・つながっていないグループは他のグループに影響されず、単独で計算したときと同じ結果になること
+// ・トンネルが起きない回路では、Vnの差が従来の方法から (lookahead + dt) × Vnの変化の速さ 以内に収まること
+// ・グループをまたぐ接続があってもトンネルの頻度が従来の方法と統計的に一致すること
+// ・runStepがcalcLの時刻を越えないこと、有効な間はチェックポイントを保存できないこと
+namespace
+{
+using Sim = Simulation2D<BaseElement>;
+
+// 2つの格子の境界（左の格子の右端の列と右の格子の左端の列）をつなぐ
+void connectAcross(Grid2D<BaseElement> &left, Grid2D<BaseElement> &right)
+{
+    int n = left.numRows(), last = left.numCols() - 1;
+    for (int y = 0; y < n; ++y)
+    {
+        auto a = left.getElement(y, last), b = right.getElement(y, 0);
+        auto connsA = a->getConnections(), connsB = b->getConnections();
+        connsA.push_back(b);
+        connsB.push_back(a);
+        a->setConnections(connsA);
+        b->setConnections(connsB);
+    }
+}
+
+std::vector<Grid2D<BaseElement>> makeCoupledGrids(int n, int count, double vd = 0.009)
+{
+    std::vector<Grid2D<BaseElement>> grids;
+    for (int k = 0; k < count; ++k)
+        grids.push_back(makeCheckerGrid(n, vd));
+    for (int k = 0; k + 1 < count; ++k)
+        connectAcross(grids[k], grids[k + 1]);
+    return grids;
+}
+
+// endtimeまで回して、トンネルの回数（runStepの間にQがe/2より大きく変わった回数）を数える
+int countTunnels(Sim &sim, double endtime)
+{
+    std::vector<std::shared_ptr<BaseElement>> elems;
+    for (auto &grid : sim.getGrids())
+        for (int y = 0; y < grid.numRows(); ++y)
+            for (int x = 0; x < grid.numCols(); ++x)
+                elems.push_back(grid.getElement(y, x));
+    auto chargeOf = [&](size_t k) { return std::static_pointer_cast<SEO>(elems[k])->getQ(); };
+    std::vector<double> q(elems.size());
+    for (size_t k = 0; k < elems.size(); ++k)
+        q[k] = chargeOf(k);
+    int tunnels = 0;
+    while (sim.getTime() < endtime)
+    {
+        sim.runStep();
+        for (size_t k = 0; k < elems.size(); ++k)
+        {
+            double now = chargeOf(k);
+            if (std::abs(now - q[k]) > e / 2)
+                ++tunnels;
+            q[k] = now;
+        }
+    }
+    return tunnels;
+}
+
+// 全素子のQとVn
+std::vector<double> stateOf(Sim &sim)
+{
+    std::vector<double> state;
+    for (auto &grid : sim.getGrids())
+        for (int y = 0; y < grid.numRows(); ++y)
+            for (int x = 0; x < grid.numCols(); ++x)
+            {
+                auto elem = grid.getElement(y, x);
+                state.push_back(std::static_pointer_cast<SEO>(elem)->getQ());
+                state.push_back(elem->getVn());
+            }
+    return state;
+}
+} // namespace
+
+// スレッド数によらず同じ結果になり、runStepのたびに全グループが次の出力時刻にそろう
+TEST(ConservativeSyncTest, DeterministicAcrossThreadCounts)
+{
+    std::vector<std::vector<double>> states;
+    for (int threads : {1, 3})
+    {
+        Sim sim(0.1, 1000);
+        sim.addGrid(makeCoupledGrids(6, 3));
+        sim.setSeed(31);
+        sim.setThreadCount(threads);
+        sim.setConservativeSync(0.05);
+        for (int s = 1; s <= 200; ++s)
+        {
+            sim.runStep();
+            ASSERT_NEAR(sim.getTime(), 0.1 * s, 1e-9);
+        }
+        states.push_back(stateOf(sim));
+    }
+    EXPECT_EQ(states[0], states[1]);
+}
+
+// つながっていないグループは互いを待たないので、1つだけで計算したときとビット単位で一致する
+TEST(ConservativeSyncTest, IndependentGroupsDoNotInteract)
+{
+    Grid2D<BaseElement> alone = makeCheckerGrid(6), first = makeCheckerGrid(6), second = makeCheckerGrid(8, 0.012);
+    Sim single(0.1, 1000), pair(0.1, 1000);
+    single.addGrid({alone});
+    pair.addGrid({first, second});
+    for (Sim *sim : {&single, &pair})
+    {
+        sim->setSeed(4);
+        sim->setThreadCount(2);
+        sim->setConservativeSync(0.1);
+    }
+    for (int s = 0; s < 300; ++s)
+    {
+        single.runStep();
+        pair.runStep();
+    }
+    for (int y = 0; y < 6; ++y)
+        for (int x = 0; x < 6; ++x)
+            EXPECT_EQ(std::static_pointer_cast<SEO>(alone.getElement(y, x))->getQ(),
+                      std::static_pointer_cast<SEO>(first.getElement(y, x))->getQ())
+                << y << ", " << x;
+}
+
+// トンネルが起きないバイアスでは計算は乱数によらないので、従来の方法と値を直接比べられる
+// 他のグループのVnは最大 lookahead + dt だけ古い値なので、Vnの差は (lookahead + dt) × 従来の方法でのVnの変化の速さ 以内に収まり、
+// lookaheadを小さくすると差も小さくなる
+TEST(ConservativeSyncTest, VnErrorBoundedByLookahead)
+{
+    const double dt = 0.1;
+    auto vnOf = [](Sim &sim)
+    {
+        std::vector<double> vn;
+        for (auto &grid : sim.getGrids())
+            for (int y = 0; y < grid.numRows(); ++y)
+                for (int x = 0; x < grid.numCols(); ++x)
+                    vn.push_back(grid.getElement(y, x)->getVn());
+        return vn;
+    };
+    std::vector<double> errors;
+    for (double lookahead : {0.8, 0.2})
+    {
+        Sim lockstep(dt, 1e9), synced(dt, 1e9);
+        lockstep.addGrid(makeCoupledGrids(6, 2, 0.003));
+        synced.addGrid(makeCoupledGrids(6, 2, 0.003));
+        synced.setThreadCount(2);
+        synced.setConservativeSync(lookahead);
+        std::vector<double> prev = vnOf(lockstep);
+        double error = 0.0, rate = 0.0;
+        while (lockstep.getTime() < 30.0)
+        {
+            lockstep.runStep();
+            synced.runStep();
+            ASSERT_DOUBLE_EQ(synced.getTime(), lockstep.getTime());
+            std::vector<double> a = vnOf(lockstep), b = vnOf(synced);
+            for (size_t k = 0; k < a.size(); ++k)
+            {
+                error = std::max(error, std::abs(a[k] - b[k]));
+                rate = std::max(rate, std::abs(a[k] - prev[k]) / dt);
+            }
+            prev = a;
+        }
+        ASSERT_GT(error, 0.0);
+        EXPECT_LE(error, (lookahead + dt) * rate) << "lookahead " << lookahead;
+        errors.push_back(error);
+    }
+    EXPECT_GT(errors[0], 2 * errors[1]);
+}
+
+// グループをまたぐ接続がある回路でも、トンネルの頻度は全gridを同時に進める従来の方法と統計的に一致する
+TEST(ConservativeSyncTest, CoupledTunnelRateMatchesLockStep)
+{
+    int lockstep = 0, synced = 0;
+    for (std::uint64_t seed : {1, 2, 3})
+    {
+        Sim a(0.1, 1e9), b(0.1, 1e9);
+        a.addGrid(makeCoupledGrids(8, 2));
+        b.addGrid(makeCoupledGrids(8, 2));
+        a.setSeed(seed);
+        b.setSeed(seed);
+        b.setThreadCount(2);
+        b.setConservativeSync(0.02);
+        lockstep += countTunnels(a, 200.0);
+        synced += countTunnels(b, 200.0);
+    }
+    ASSERT_GT(lockstep, 2000);
+    EXPECT_NEAR(synced, lockstep, 0.05 * lockstep);
+}
+
+// グループの指定の誤りと、使えないモードは例外
+TEST(ConservativeSyncTest, RejectsInvalidConfiguration)
+{
+    Sim sim(0.1, 10);
+    EXPECT_THROW(sim.setConservativeSync(-0.1), std::invalid_argument);
+    sim.addGrid(makeCoupledGrids(4, 3));
+
+    sim.setConservativeSync(0.05, {0, 1});
+    EXPECT_THROW(sim.runStep(), std::invalid_argument);
+    sim.setConservativeSync(0.05, {0, 2, 2});
+    EXPECT_THROW(sim.runStep(), std::invalid_argument);
+
+    sim.setConservativeSync(0.05, {0, 0, 1});
+    sim.setEngineMode(EngineMode::EventQueue);
+    EXPECT_THROW(sim.runStep(), std::logic_error);
+    sim.setEngineMode(EngineMode::Step);
+    sim.setPotentialSolver(std::make_shared<GaussSeidelSolver<BaseElement>>());
+    EXPECT_THROW(sim.runStep(), std::logic_error);
+    sim.setPotentialSolver(std::make_shared<JacobiSolver<BaseElement>>());
+    sim.runStep();
+    EXPECT_EQ(sim.getSyncLookahead(), 0.05);
+
+    // 2つのグループのgridに置かれた素子
+    Sim shared(0.1, 10);
+    Grid2D<BaseElement> a = makeCheckerGrid(3), b = makeCheckerGrid(3);
+    b.setElement(1, 1, a.getElement(1, 1));
+    shared.addGrid({a, b});
+    shared.setConservativeSync(0.05);
+    EXPECT_THROW(shared.runStep(), std::invalid_argument);
+
+    // lookaheadを0にすると従来の方法に戻る
+    sim.setConservativeSync(0.0);
+    double before = sim.getTime();
+    sim.runStep();
+    EXPECT_LE(sim.getTime() - before, 0.1 + 1e-12);
+}
+
+// 出力の間隔が長くても、runStepはrunがcalcLを行う時刻で止まる（残りがdtより短ければdtだけ進める）
+TEST(ConservativeSyncTest, StopsAtCalcLTime)
+{
+    Sim sim(0.1, 1000);
+    sim.addGrid(makeCoupledGrids(4, 2));
+    sim.setSeed(6);
+    sim.setOutputInterval(5.0);
+    sim.setConservativeSync(0.05);
+    sim.runStep();
+    EXPECT_DOUBLE_EQ(sim.getTime(), calcL_time);
+    sim.runStep();
+    EXPECT_DOUBLE_EQ(sim.getTime(), calcL_time + 0.1);
+    // runStepだけならcalcLの時刻は戻らないので、その後は出力時刻まで進める
+    sim.runStep();
+    EXPECT_DOUBLE_EQ(sim.getTime(), 5.0);
+}
+
+// 境界の履歴は保存できないので、有効な間はチェックポイントを保存すると例外になる
+TEST(ConservativeSyncTest, RejectsCheckpoint)
+{
+    const std::string path = "sync_rejected.ckpt";
+    Sim sim(0.1, 1000);
+    sim.addGrid(makeCoupledGrids(4, 2));
+    sim.setConservativeSync(0.05);
+    sim.runStep();
+    EXPECT_THROW(sim.saveCheckpoint(path), std::logic_error);
+    std::ifstream ifs(path);
+    EXPECT_FALSE(ifs.good());
+
+    sim.setConservativeSync(0.0);
+    sim.saveCheckpoint(path);
+    EXPECT_TRUE(std::ifstream(path).good());
+    std::remove(path.c_str());
+}
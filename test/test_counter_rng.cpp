@@ -0,0 +1,151 @@
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "counter_rng.hpp"
+#include "seo_array.hpp"
+#include "thread_pool.hpp"
+#include "checker_grid.hpp"
+
+// カウンタ方式の乱数のテスト
+// ・Philox4x32-10が公開されている既知の値と一致すること
+// ・同じシードならスレッド数や構造（SEO / SEOArray）によらず同じトンネルの列になること
+namespace
+{
+struct Tunnel
+{
+    int index;
+    TunnelDirection direction;
+    double wt;
+    bool operator==(const Tunnel &o) const { return index == o.index && direction == o.direction && wt == o.wt; }
+};
+
+// 直列版のステップを回してトンネルの列を記録
+template <typename G, typename F>
+std::vector<Tunnel> runSerial(G &grid, int steps, F tunnel)
+{
+    std::vector<Tunnel> out;
+    for (int s = 0; s < steps; ++s)
+    {
+        for (int k = 0; k < 5; ++k)
+        {
+            grid.updateGridSurVn();
+            grid.updateGridVn();
+        }
+        grid.updateGriddE();
+        double st = 0.1;
+        if (grid.gridminwt(0.1))
+        {
+            out.push_back({grid.getTunnelIndex(), grid.getTunnelDirection(), grid.getMinWT()});
+            tunnel(grid);
+            st = grid.getMinWT();
+        }
+        grid.updateGridQn(st);
+    }
+    return out;
+}
+
+// 行の帯に分けて並列に計算するステップ（wtの計算順がスレッド数で変わる）
+std::vector<Tunnel> runBands(Grid2D<SEO> &grid, int steps, ThreadPool &pool)
+{
+    std::vector<Tunnel> out;
+    for (int s = 0; s < steps; ++s)
+    {
+        for (int k = 0; k < 5; ++k)
+        {
+            grid.updateGridSurVn(pool);
+            grid.updateGridVn(pool);
+        }
+        grid.updateGriddE(pool);
+        double st = 0.1;
+        if (grid.gridminwt(0.1, pool))
+        {
+            out.push_back({grid.getTunnelIndex(), grid.getTunnelDirection(), grid.getMinWT()});
+            grid.getTunnelPlace()->setTunnel(grid.getTunnelDirection());
+            st = grid.getMinWT();
+        }
+        grid.updateGridQn(st, pool);
+    }
+    return out;
+}
+
+void tunnelSEO(Grid2D<SEO> &grid)
+{
+    grid.getTunnelPlace()->setTunnel(grid.getTunnelDirection());
+}
+} // namespace
+
+// Random123の既知の値（カウンタ・鍵が0の場合と円周率の桁の場合）
+TEST(CounterRngTest, PhiloxKnownAnswers)
+{
+    std::uint64_t r0, r1;
+    philox4x32(0, 0, 0, r0, r1);
+    EXPECT_EQ(r0, 0xe169c58d6627e8d5ULL);
+    EXPECT_EQ(r1, 0x9b00dbd8bc57ac4cULL);
+    philox4x32(0x299f31d0a4093822ULL, 0x0370734413198a2eULL, 0x85a308d3243f6a88ULL, r0, r1);
+    EXPECT_EQ(r0, 0x94fdccebd16cfe09ULL);
+    EXPECT_EQ(r1, 0x24126ea15001e420ULL);
+}
+
+// 乱数は(シード, 乱数列, カウンタ)だけで決まり、(0, 1]に入る
+TEST(CounterRngTest, UniformDependsOnlyOnKey)
+{
+    CounterRNG a(7, rngStream(RngDomain::Element, 12)), b(7, rngStream(RngDomain::Element, 12));
+    CounterRNG other(7, rngStream(RngDomain::Element, 13));
+    int same = 0;
+    for (int k = 0; k < 1000; ++k)
+    {
+        double u = a.uniform();
+        EXPECT_EQ(u, b.uniform());
+        EXPECT_EQ(u, counterUniform(7, rngStream(RngDomain::Element, 12), k));
+        EXPECT_GT(u, 0.0);
+        EXPECT_LE(u, 1.0);
+        same += (u == other.uniform());
+    }
+    EXPECT_EQ(same, 0);
+    EXPECT_EQ(a.counter(), 1000u);
+}
+
+// 同じシードなら同じトンネルの列、違うシードなら違う列
+TEST(CounterRngTest, SeedReproducesGridRun)
+{
+    auto g1 = makeCheckerGrid<SEO>(8), g2 = makeCheckerGrid<SEO>(8), g3 = makeCheckerGrid<SEO>(8);
+    g1.setRandomStreams(2024, 0);
+    g2.setRandomStreams(2024, 0);
+    g3.setRandomStreams(2025, 0);
+    auto a = runSerial(g1, 500, tunnelSEO);
+    auto b = runSerial(g2, 500, tunnelSEO);
+    auto c = runSerial(g3, 500, tunnelSEO);
+    ASSERT_FALSE(a.empty());
+    EXPECT_EQ(a, b);
+    EXPECT_NE(a, c);
+}
+
+// 行の帯に分けたスレッド数によらず同じトンネルの列になる
+TEST(CounterRngTest, ThreadCountDoesNotChangeRun)
+{
+    auto ref = makeCheckerGrid<SEO>(8);
+    ref.setRandomStreams(99, 0);
+    auto expected = runSerial(ref, 500, tunnelSEO);
+    for (int threads : {1, 3, 4})
+    {
+        ThreadPool pool(threads);
+        auto grid = makeCheckerGrid<SEO>(8);
+        grid.setRandomStreams(99, 0);
+        EXPECT_EQ(runBands(grid, 500, pool), expected) << threads << " threads";
+    }
+}
+
+// SEOArrayも同じ番号の乱数列を使うので、Grid2D<SEO>と同じトンネルの列になる
+TEST(CounterRngTest, SEOArrayMatchesSEO)
+{
+    auto grid = makeCheckerGrid<SEO>(6);
+    auto soa = Grid2D<SEOArray>::fromGrid(grid);
+    grid.setRandomStreams(5, 100);
+    soa.setRandomStreams(5, 100);
+    soa.getElements().setBatchedSampling(false);
+    auto a = runSerial(grid, 300, tunnelSEO);
+    auto b = runSerial(soa, 300, [](Grid2D<SEOArray> &g) { g.applyTunnel(); });
+    ASSERT_FALSE(a.empty());
+    EXPECT_EQ(a, b);
+}
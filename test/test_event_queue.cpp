@@ -0,0 +1,137 @@
+#include <gtest/gtest.h>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "event_queue.hpp"
+#include "simulation_2d.hpp"
+#include "checker_grid.hpp"
+
+// イベント駆動モード（EventQueue）のテスト
+// ・インデックス付きのヒープの先頭が常に最小のキーで、更新・削除ができること
+// ・EventQueueモードでは差分更新がオンになり、dEが変わった素子だけレートを更新すること
+// ・トンネルの回数と、素子の色（バイアスの符号）・向きごとの内訳が従来のStepモードと統計的に一致すること
+namespace
+{
+// 素子の色（市松模様のバイアスの符号）とトンネルの向き（Qの変化の符号）ごとのトンネルの回数
+using TunnelHistogram = std::array<int, 4>;
+
+// endtimeまで回して、1ステップでQがe/2より大きく変わった回数を色と向きごとに数える
+TunnelHistogram countTunnels(EngineMode mode, bool incremental, std::uint64_t seed, double endtime)
+{
+    Simulation2D<BaseElement> sim(0.1, 1e9);
+    sim.addGrid({makeCheckerGrid(6)});
+    sim.setSeed(seed);
+    sim.setEngineMode(mode);
+    sim.setIncrementalUpdate(incremental);
+    auto &grid = sim.getGrids()[0];
+    int cols = grid.numCols(), n = grid.numRows() * cols;
+    auto chargeOf = [&](int k) { return std::static_pointer_cast<SEO>(grid.getElement(k / cols, k % cols))->getQ(); };
+    std::vector<double> q(n);
+    for (int k = 0; k < n; ++k)
+        q[k] = chargeOf(k);
+    TunnelHistogram counts{};
+    while (sim.getTime() < endtime)
+    {
+        sim.runStep();
+        for (int k = 0; k < n; ++k)
+        {
+            double now = chargeOf(k);
+            if (std::abs(now - q[k]) > e / 2)
+                ++counts[((k / cols + k % cols) % 2) * 2 + (now > q[k])];
+            q[k] = now;
+        }
+    }
+    return counts;
+}
+
+int total(const TunnelHistogram &counts)
+{
+    return counts[0] + counts[1] + counts[2] + counts[3];
+}
+} // namespace
+
+// キーの追加・更新・削除をしても先頭は常に最小のキー
+TEST(IndexedMinHeapTest, TopIsMinimum)
+{
+    IndexedMinHeap heap;
+    heap.resize(6);
+    const double keys[] = {5.0, 3.0, 8.0, 1.0, 4.0, 7.0};
+    for (int id = 0; id < 6; ++id)
+        heap.push(id, keys[id]);
+    EXPECT_EQ(heap.top(), 3);
+    EXPECT_EQ(heap.topKey(), 1.0);
+
+    heap.update(2, 0.5);
+    EXPECT_EQ(heap.top(), 2);
+    heap.update(2, 9.0);
+    EXPECT_EQ(heap.top(), 3);
+    EXPECT_EQ(heap.key(2), 9.0);
+
+    heap.remove(3);
+    EXPECT_FALSE(heap.contains(3));
+    EXPECT_EQ(heap.top(), 1);
+
+    std::vector<int> order;
+    while (!heap.empty())
+    {
+        order.push_back(heap.top());
+        heap.remove(heap.top());
+    }
+    EXPECT_EQ(order, (std::vector<int>{1, 4, 0, 5, 2}));
+}
+
+// EventQueue・RateTreeモードにすると差分更新もオンになり、後からオフにもできる（Stepに戻すとオフ）
+TEST(EventQueueEngineTest, EnablesIncrementalUpdate)
+{
+    Simulation2D<BaseElement> sim(0.1, 1e9);
+    sim.addGrid({makeCheckerGrid(4)});
+    EXPECT_FALSE(sim.isIncrementalUpdate());
+    sim.setEngineMode(EngineMode::EventQueue);
+    EXPECT_TRUE(sim.isIncrementalUpdate());
+    sim.setIncrementalUpdate(false);
+    EXPECT_FALSE(sim.isIncrementalUpdate());
+    // イベント駆動のモードどうしの切り替えでは設定はそのまま
+    sim.setEngineMode(EngineMode::RateTree);
+    EXPECT_FALSE(sim.isIncrementalUpdate());
+    sim.setEngineMode(EngineMode::Step);
+    EXPECT_FALSE(sim.isIncrementalUpdate());
+    sim.setEngineMode(EngineMode::RateTree);
+    EXPECT_TRUE(sim.isIncrementalUpdate());
+    sim.setEngineMode(EngineMode::Step);
+    EXPECT_FALSE(sim.isIncrementalUpdate());
+}
+
+// トンネルの回数と、色・向きごとの内訳がStepモードと統計的に一致する
+// （差分更新あり・なしのどちらでも。内訳の差は独立なポアソン分布の差として5σ以内）
+TEST(EventQueueEngineTest, TunnelStatisticsMatchStepEngine)
+{
+    TunnelHistogram step{}, queue{}, queueFull{};
+    for (std::uint64_t seed : {1, 2, 3})
+    {
+        auto add = [](TunnelHistogram &sum, const TunnelHistogram &counts)
+        {
+            for (int b = 0; b < 4; ++b)
+                sum[b] += counts[b];
+        };
+        add(step, countTunnels(EngineMode::Step, false, seed, 400.0));
+        add(queue, countTunnels(EngineMode::EventQueue, true, seed, 400.0));
+        add(queueFull, countTunnels(EngineMode::EventQueue, false, seed, 400.0));
+    }
+    ASSERT_GT(total(step), 1000);
+    EXPECT_NEAR(total(queue), total(step), 0.03 * total(step));
+    EXPECT_NEAR(total(queueFull), total(step), 0.03 * total(step));
+    for (int b = 0; b < 4; ++b)
+    {
+        double sigma = std::sqrt(static_cast<double>(step[b] + queue[b]));
+        EXPECT_NEAR(queue[b], step[b], 5 * sigma + 1) << "bin " << b;
+        sigma = std::sqrt(static_cast<double>(step[b] + queueFull[b]));
+        EXPECT_NEAR(queueFull[b], step[b], 5 * sigma + 1) << "bin " << b;
+    }
+}
+
+// 同じシードなら同じ結果になる
+TEST(EventQueueEngineTest, SeedReproducesRun)
+{
+    EXPECT_EQ(countTunnels(EngineMode::EventQueue, true, 9, 100.0), countTunnels(EngineMode::EventQueue, true, 9, 100.0));
+}
@@ -0,0 +1,261 @@
+#include <gtest/gtest.h>
+#include <array>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+#include "simulation_2d.hpp"
+
+// 実行プラン（Simulation2D::compile）のテスト
+// ・プランで計算した結果が、JacobiSolverとgridで計算した結果とビット単位で一致すること
+// ・接続の誤りを見つけて例外を投げること、ソルバーやgridを変えるとプランが破棄されること
+// ・素子が持つ係数がパラメータの変更に追従すること
+namespace
+{
+using Sim = Simulation2D<BaseElement>;
+
+// 4近傍で接続
+void connectNeighbors(Grid2D<BaseElement> &grid)
+{
+    int rows = grid.numRows(), cols = grid.numCols();
+    for (int y = 0; y < rows; ++y)
+        for (int x = 0; x < cols; ++x)
+        {
+            std::vector<std::shared_ptr<BaseElement>> conns;
+            if (y > 0)
+                conns.push_back(grid.getElement(y - 1, x));
+            if (x > 0)
+                conns.push_back(grid.getElement(y, x - 1));
+            if (y < rows - 1)
+                conns.push_back(grid.getElement(y + 1, x));
+            if (x < cols - 1)
+                conns.push_back(grid.getElement(y, x + 1));
+            grid.getElement(y, x)->setConnections(conns);
+        }
+}
+
+// 市松模様にバイアスをかけたSEOの格子（右下の素子は接続もバイアスも無い、何も起きない素子）
+Grid2D<BaseElement> makeSEOGrid(int n)
+{
+    Grid2D<BaseElement> grid(n, n, false);
+    for (int y = 0; y < n; ++y)
+        for (int x = 0; x < n; ++x)
+            grid.setElement(y, x, std::make_shared<SEO>(1.0, 0.05, 10.0, 2.0, ((x + y) % 2) ? 0.009 : -0.009, 4));
+    connectNeighbors(grid);
+    grid.setElement(n - 1, n - 1, std::make_shared<SEO>(1.0, 0.05, 10.0, 2.0, 0.0, 4));
+    return grid;
+}
+
+// 多重振動子の格子
+Grid2D<BaseElement> makeMultiGrid(int n)
+{
+    Grid2D<BaseElement> grid(n, n, false);
+    for (int y = 0; y < n; ++y)
+        for (int x = 0; x < n; ++x)
+            grid.setElement(y, x, std::make_shared<MultiSEO>(1.0, 0.05, multi_Cj, 2.0, ((x + y) % 2) ? 0.02 : -0.02, 4, 20));
+    connectNeighbors(grid);
+    return grid;
+}
+
+// 行ごとに一方通行素子を直列につないだ格子（両端はgridの外の素子につなぐ）
+Grid2D<BaseElement> makeOnewayGrid(int rows, int cols)
+{
+    Grid2D<BaseElement> grid(rows, cols, false);
+    std::vector<std::shared_ptr<OnewayUnit>> units;
+    for (int y = 0; y < rows; ++y)
+        for (int x = 0; x < cols; ++x)
+        {
+            std::array<std::shared_ptr<BaseElement>, 4> internal;
+            for (auto &p : internal)
+                p = std::make_shared<SEO>();
+            auto unit = std::make_shared<OnewayUnit>((y % 2) ? "left" : "right");
+            unit->setInternalElements(internal);
+            unit->setOnewaySeoParam(1.0, 0.05, Cj_leg2, Cj_leg3, 2.0, 0.0088);
+            units.push_back(unit);
+            grid.setElement(y, x, unit);
+        }
+    for (int y = 0; y < rows; ++y)
+    {
+        auto leftEnd = std::make_shared<SEO>(1.0, 0.05, Cj_leg4, 2.0, 0.0095, 4);
+        auto rightEnd = std::make_shared<SEO>(1.0, 0.05, Cj_leg4, 2.0, -0.0095, 4);
+        for (int x = 0; x < cols; ++x)
+        {
+            auto left = (x > 0) ? units[y * cols + x - 1]->getInternalElement(3) : std::shared_ptr<BaseElement>(leftEnd);
+            auto right = (x < cols - 1) ? units[y * cols + x + 1]->getInternalElement(0) : std::shared_ptr<BaseElement>(rightEnd);
+            units[y * cols + x]->setOnewayConnections(left, right);
+        }
+    }
+    return grid;
+}
+
+std::unique_ptr<Sim> makeSim(int threads, bool compiled)
+{
+    auto sim = std::make_unique<Sim>(0.1, 1000);
+    sim->addGrid({makeSEOGrid(6), makeMultiGrid(4), makeOnewayGrid(2, 4)});
+    sim->setSeed(17);
+    sim->setThreadCount(threads);
+    sim->setSolverLogging(true);
+    if (compiled)
+        sim->compile();
+    return sim;
+}
+
+std::string readFile(const std::string &path)
+{
+    std::ifstream ifs(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+}
+
+// 2つのシミュレーションの状態（チェックポイント）が一致するか
+void expectSameState(Sim &a, Sim &b, const std::string &name)
+{
+    const std::string pathA = name + "_a.ckpt", pathB = name + "_b.ckpt";
+    a.saveCheckpoint(pathA);
+    b.saveCheckpoint(pathB);
+    std::string stateA = readFile(pathA), stateB = readFile(pathB);
+    ASSERT_FALSE(stateA.empty());
+    EXPECT_TRUE(stateA == stateB) << name;
+    std::remove(pathA.c_str());
+    std::remove(pathB.c_str());
+}
+} // namespace
+
+// SEO・MultiSEO・OnewayUnit（gridの外への接続を含む）を混ぜた回路で、スレッド数によらずビット単位で一致する
+TEST(ExecutionPlanTest, MatchesSolverRunBitForBit)
+{
+    for (int threads : {1, 2})
+    {
+        auto plain = makeSim(threads, false), compiled = makeSim(threads, true);
+        ASSERT_TRUE(compiled->isCompiled());
+        for (int s = 0; s < 500; ++s)
+        {
+            plain->runStep();
+            compiled->runStep();
+        }
+        EXPECT_EQ(plain->getTime(), compiled->getTime()) << threads;
+        expectSameState(*plain, *compiled, "plan_threads" + std::to_string(threads));
+
+        const auto &logA = plain->getSolverLog(), &logB = compiled->getSolverLog();
+        ASSERT_EQ(logA.size(), 500u);
+        ASSERT_EQ(logA.size(), logB.size());
+        for (size_t k = 0; k < logA.size(); ++k)
+        {
+            EXPECT_EQ(logA[k].iterations, logB[k].iterations);
+            EXPECT_EQ(logA[k].residual, logB[k].residual);
+        }
+    }
+}
+
+// 許容値つきのJacobiSolverでも同じsweep回数で打ち切る
+TEST(ExecutionPlanTest, KeepsSolverTolerance)
+{
+    auto plain = makeSim(1, false), compiled = makeSim(1, false);
+    plain->setPotentialSolver(std::make_shared<JacobiSolver<BaseElement>>(20, 1e-6));
+    compiled->setPotentialSolver(std::make_shared<JacobiSolver<BaseElement>>(20, 1e-6));
+    compiled->compile();
+    for (int s = 0; s < 200; ++s)
+    {
+        plain->runStep();
+        compiled->runStep();
+    }
+    expectSameState(*plain, *compiled, "plan_tolerance");
+    for (size_t k = 0; k < plain->getSolverLog().size(); ++k)
+        EXPECT_EQ(plain->getSolverLog()[k].iterations, compiled->getSolverLog()[k].iterations);
+}
+
+// バイアス電圧の変更はプランを作り直さずに反映される（0にした素子は何も起きない素子になる）
+TEST(ExecutionPlanTest, SetViasKeepsPlan)
+{
+    auto plain = makeSim(1, false), compiled = makeSim(1, true);
+    for (int s = 0; s < 200; ++s)
+    {
+        plain->runStep();
+        compiled->runStep();
+    }
+    for (Sim *sim : {plain.get(), compiled.get()})
+    {
+        sim->setVias(0, 2, 3, 0.015);
+        sim->setVias(0, 5, 5, 0.009);
+        sim->setVias(1, 0, 0, 0.0);
+    }
+    EXPECT_TRUE(compiled->isCompiled());
+    for (int s = 0; s < 300; ++s)
+    {
+        plain->runStep();
+        compiled->runStep();
+    }
+    expectSameState(*plain, *compiled, "plan_vias");
+    EXPECT_THROW(compiled->setVias(3, 0, 0, 0.01), std::out_of_range);
+}
+
+// 接続の誤りは例外
+TEST(ExecutionPlanTest, RejectsInvalidTopology)
+{
+    Sim empty(0.1, 10);
+    EXPECT_THROW(empty.compile(), std::invalid_argument);
+
+    // 素子を置いていないセル
+    Sim missing(0.1, 10);
+    Grid2D<BaseElement> hole(2, 2, false);
+    hole.setElement(0, 0, std::make_shared<SEO>(1.0, 0.05, 10.0, 2.0, 0.009, 4));
+    missing.addGrid({hole});
+    EXPECT_THROW(missing.compile(), std::invalid_argument);
+
+    // 同じ素子を2か所に置いた
+    Sim twice(0.1, 10);
+    Grid2D<BaseElement> dup(1, 2, false);
+    auto seo = std::make_shared<SEO>(1.0, 0.05, 10.0, 2.0, 0.009, 4);
+    dup.setElement(0, 0, seo);
+    dup.setElement(0, 1, seo);
+    twice.addGrid({dup});
+    EXPECT_THROW(twice.compile(), std::invalid_argument);
+
+    // nullptrへの接続
+    Sim dangling(0.1, 10);
+    Grid2D<BaseElement> grid = makeSEOGrid(3);
+    grid.getElement(1, 1)->setConnections({grid.getElement(0, 1), nullptr});
+    dangling.addGrid({grid});
+    EXPECT_THROW(dangling.compile(), std::invalid_argument);
+    EXPECT_FALSE(dangling.isCompiled());
+}
+
+// プランはJacobiSolverのsweepを行うので、他のソルバーでは作れず、ソルバーやgridを変えると破棄される
+TEST(ExecutionPlanTest, DiscardedWhenSolverOrGridsChange)
+{
+    Sim sim(0.1, 10);
+    sim.addGrid({makeSEOGrid(4)});
+    sim.setIntraGridParallel(true);
+    EXPECT_THROW(sim.compile(), std::logic_error);
+    sim.setIntraGridParallel(false);
+    sim.compile();
+    EXPECT_TRUE(sim.isCompiled());
+
+    sim.setPotentialSolver(std::make_shared<GaussSeidelSolver<BaseElement>>());
+    EXPECT_FALSE(sim.isCompiled());
+    sim.setPotentialSolver(std::make_shared<JacobiSolver<BaseElement>>());
+    sim.compile();
+    sim.addGrid({makeSEOGrid(4)});
+    EXPECT_FALSE(sim.isCompiled());
+}
+
+// setUpでパラメータを変えると、素子が持つ係数も計算し直される
+TEST(ExecutionPlanTest, CoefficientsFollowSetUp)
+{
+    SEO seo(1.0, 0.05, 10.0, 2.0, 0.009, 4);
+    seo.setUp(1.0, 0.1, 6.0, 3.0, 0.009, 2);
+    seo.setQ(0.2);
+    seo.setVsum(0.05);
+    seo.setPcalc();
+    EXPECT_NEAR(seo.getVn(), (0.2 + 3.0 * 0.05) / (2 * 3.0 + 6.0), 1e-15);
+    seo.setdEcalc();
+    EXPECT_NEAR(seo.getdE().up, -e * (e - 2 * (0.2 + 3.0 * 0.05)) / (2 * (2 * 3.0 + 6.0)), 1e-15);
+
+    MultiSEO multi(1.0, 0.05, multi_Cj, 2.0, 0.02, 4, 20);
+    multi.setUp(1.0, 0.05, 100.0, 1.5, 0.02, 3, 10);
+    multi.setQ(0.1);
+    multi.setVsum(0.02);
+    multi.setPcalc();
+    EXPECT_NEAR(multi.getVn(), 10 * (100.0 * 0.1 + 1.5 * 100.0 * 0.02) / (100.0 * (3 * 10 * 1.5 + 100.0)), 1e-15);
+}
@@ -0,0 +1,207 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <memory>
+#include <vector>
+#include "simulation_2d.hpp"
+
+// 指数関数による電荷の更新のテスト
+// ・V_sumが一定なら、dtの大きさによらず解析解と一致すること（小さいdtではEulerと一致すること）
+// ・timeToThresholdがdEの符号が変わる時刻を当てること
+// ・トンネルが無い間に時間を飛ばしても、孤立した素子のトンネルの回数が変わらないこと
+namespace
+{
+constexpr double r = 1.0, rj = 0.05, cj = 10.0, c = 2.0;
+constexpr int legs = 4;
+
+// 孤立した素子のQの解析解（Q(0) = q0、V_sum = 0）
+double analyticQ(double vd, double q0, double time)
+{
+    double ctotal = legs * c + cj;
+    double qInf = ctotal * vd;
+    return qInf + (q0 - qInf) * std::exp(-time / (r * ctotal));
+}
+
+// Vnを計算してからdtだけ電荷を更新
+template <typename E>
+void advance(E &seo, double dt, bool exponential)
+{
+    seo.setPcalc();
+    if (exponential)
+        seo.setNodeChargeExp(dt);
+    else
+        seo.setNodeCharge(dt);
+}
+
+// 接続のないSEOを並べたgrid（隣とは結合しないので、時間を飛ばしても近似の誤差が無い）
+Grid2D<BaseElement> makeIsolatedGrid(int n)
+{
+    Grid2D<BaseElement> grid(n, n, false);
+    for (int y = 0; y < n; ++y)
+        for (int x = 0; x < n; ++x)
+            grid.setElement(y, x, std::make_shared<SEO>(r, rj, cj, c, ((x + y) % 2) ? 0.009 : -0.009, legs));
+    return grid;
+}
+
+struct RunResult
+{
+    int steps = 0;
+    int tunnels = 0;
+};
+
+// endtimeまで回して、ステップ数とトンネルの回数を数える
+// 充電ではQが平衡値（符号はVdと同じ）に近づくだけなので、逆向きに変わったステップをトンネルとみなす
+RunResult runUntil(Simulation2D<BaseElement> &sim, double endtime)
+{
+    auto &grid = sim.getGrids()[0];
+    int n = grid.numRows() * grid.numCols();
+    auto elementOf = [&](int k) { return grid.getElement(k / grid.numCols(), k % grid.numCols()); };
+    auto chargeOf = [&](int k) { return std::static_pointer_cast<SEO>(elementOf(k))->getQ(); };
+    std::vector<double> q(n);
+    for (int k = 0; k < n; ++k)
+        q[k] = chargeOf(k);
+    RunResult result;
+    while (sim.getTime() < endtime)
+    {
+        sim.runStep();
+        ++result.steps;
+        for (int k = 0; k < n; ++k)
+        {
+            double now = chargeOf(k);
+            if ((now - q[k]) * elementOf(k)->getVd() < 0)
+                ++result.tunnels;
+            q[k] = now;
+        }
+    }
+    return result;
+}
+} // namespace
+
+// 大きなdtでも解析解と一致し、刻みを細かくしても同じ値になる
+TEST(ExponentialChargeTest, MatchesAnalyticSolution)
+{
+    const double vd = 0.009;
+    SEO coarse(r, rj, cj, c, vd, legs), fine(r, rj, cj, c, vd, legs);
+    for (int k = 0; k < 10; ++k)
+        advance(coarse, 5.0, true);
+    for (int k = 0; k < 5000; ++k)
+        advance(fine, 0.01, true);
+    double expected = analyticQ(vd, 0.0, 50.0);
+    EXPECT_NEAR(coarse.getQ(), expected, 1e-12 * expected);
+    EXPECT_NEAR(fine.getQ(), expected, 1e-12 * expected);
+}
+
+// 時定数に比べて小さいdtではEulerと1次の精度で一致する
+TEST(ExponentialChargeTest, EulerConvergesToExponential)
+{
+    const double vd = -0.009;
+    double expected = analyticQ(vd, 0.0, 10.0);
+    double previous = 0.0;
+    for (double dt : {0.1, 0.01, 0.001})
+    {
+        SEO euler(r, rj, cj, c, vd, legs);
+        for (int k = 0; k < static_cast<int>(std::round(10.0 / dt)); ++k)
+            advance(euler, dt, false);
+        double error = std::abs(euler.getQ() - expected);
+        if (previous > 0)
+        {
+            EXPECT_LT(error, 0.2 * previous) << "dt=" << dt;
+        }
+        previous = error;
+    }
+    EXPECT_LT(previous, 1e-4 * std::abs(expected));
+}
+
+// SEO：予測した時刻の直前ではdEが負、直後では正（up・downの両方向）
+TEST(ExponentialChargeTest, SEOPredictsThresholdCrossing)
+{
+    for (double vd : {0.009, -0.009})
+    {
+        SEO seo(r, rj, cj, c, vd, legs);
+        seo.setPcalc();
+        seo.setdEcalc();
+        double h = seo.timeToThreshold();
+        ASSERT_TRUE(std::isfinite(h));
+        ASSERT_GT(h, 0.0);
+
+        SEO before = seo, after = seo;
+        advance(before, h * (1 - 1e-6), true);
+        advance(after, h * (1 + 1e-6), true);
+        before.setPcalc();
+        before.setdEcalc();
+        after.setPcalc();
+        after.setdEcalc();
+        double dEBefore = (vd > 0) ? before.getdE().up : before.getdE().down;
+        double dEAfter = (vd > 0) ? after.getdE().up : after.getdE().down;
+        EXPECT_LT(dEBefore, 0.0) << "vd=" << vd;
+        EXPECT_GT(dEAfter, 0.0) << "vd=" << vd;
+        EXPECT_EQ(after.timeToThreshold(), 0.0);
+    }
+}
+
+// MultiSEO：トンネルした接合の数が違ってもdEの符号が変わる時刻を当てる
+TEST(ExponentialChargeTest, MultiSEOPredictsThresholdCrossing)
+{
+    for (int tunnelled : {0, 3})
+    {
+        MultiSEO seo(r, rj, multi_Cj, c, 0.02, legs, 20);
+        for (int k = 0; k < tunnelled; ++k)
+            seo.setTunnel(TunnelDirection::Down);
+        seo.setPcalc();
+        seo.setdEcalc();
+        double h = seo.timeToThreshold();
+        ASSERT_TRUE(std::isfinite(h));
+        ASSERT_GT(h, 0.0);
+
+        MultiSEO before = seo, after = seo;
+        advance(before, h * (1 - 1e-6), true);
+        advance(after, h * (1 + 1e-6), true);
+        before.setPcalc();
+        before.setdEcalc();
+        after.setPcalc();
+        after.setdEcalc();
+        EXPECT_LT(before.getdE().up, 0.0) << tunnelled;
+        EXPECT_GT(after.getdE().up, 0.0) << tunnelled;
+    }
+}
+
+// 平衡値がしきい値に届かなければ無限大
+TEST(ExponentialChargeTest, NoCrossingBelowThreshold)
+{
+    SEO seo(r, rj, cj, c, 0.001, legs);
+    seo.setPcalc();
+    EXPECT_TRUE(std::isinf(seo.timeToThreshold()));
+}
+
+// 孤立した素子ならトンネルの無い間を飛ばしてもトンネルの頻度は変わらず、ステップ数は大きく減る
+// （dEが正になってからトンネルするまでの間はdtずつ進むので、素子が1つの場合で確かめる）
+TEST(ExponentialChargeTest, IdleJumpKeepsTunnelRate)
+{
+    auto makeSim = [](double jump)
+    {
+        auto sim = std::make_unique<Simulation2D<BaseElement>>(0.1, 1e9);
+        sim->addGrid({makeIsolatedGrid(1)});
+        sim->setSeed(3);
+        sim->setOutputInterval(50.0);
+        sim->setChargeIntegrator(ChargeIntegrator::Exponential);
+        sim->setIdleJump(jump);
+        return sim;
+    };
+    auto stepped = makeSim(0.0), jumped = makeSim(50.0);
+    RunResult a = runUntil(*stepped, 10000.0), b = runUntil(*jumped, 10000.0);
+    ASSERT_GT(a.tunnels, 300);
+    // 1周期の大半は決まった時間の充電なので、トンネルの回数のゆらぎは小さい
+    EXPECT_NEAR(b.tunnels, a.tunnels, 0.05 * a.tunnels);
+    EXPECT_LT(b.steps, a.steps / 2);
+}
+
+// Eulerのままでは時間を飛ばさない
+TEST(ExponentialChargeTest, IdleJumpNeedsExponentialIntegrator)
+{
+    Simulation2D<BaseElement> sim(0.1, 1e9);
+    sim.addGrid({makeIsolatedGrid(2)});
+    sim.setOutputInterval(50.0);
+    sim.setIdleJump(50.0);
+    RunResult result = runUntil(sim, 10.0);
+    EXPECT_GE(result.steps, 99);
+    EXPECT_THROW(sim.setIdleJump(-1.0), std::invalid_argument);
+}
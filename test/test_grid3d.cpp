@@ -0,0 +1,205 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include "grid_3dim.hpp"
+#include "simulation_2d.hpp"
+#include "checker_grid.hpp"
+
+// 3次元グリッド（Grid3D）のテスト
+// ・素子がz→y→xの順に並び、ステンシルどおりに接続されること
+// ・1層のGrid3Dが同じ接続のGrid2Dとビット単位で同じ結果になること
+// ・上下の層でつながった素子も赤黒順序で色が違うこと、層をまたいでシミュレーションできること
+// ・同じ色の素子をつなぐステンシルでは、赤黒順序を使うと例外になること
+namespace
+{
+using Sim = Simulation2D<BaseElement>;
+
+// 市松模様（(x + y + z) % 2）にバイアスをかけたSEOの3次元グリッド（6近傍で接続）
+Grid3D<BaseElement> makeGrid3D(int layers, int rows, int cols)
+{
+    Grid3D<BaseElement> grid(layers, rows, cols, false);
+    for (int z = 0; z < layers; ++z)
+        for (int y = 0; y < rows; ++y)
+            for (int x = 0; x < cols; ++x)
+                grid.setElement(z, y, x, std::make_shared<SEO>(1.0, 0.05, 10.0, 2.0, ((x + y + z) % 2) ? 0.009 : -0.009, 6));
+    grid.connectNeighbors();
+    return grid;
+}
+
+double chargeOf(const std::shared_ptr<BaseElement> &elem)
+{
+    return std::static_pointer_cast<SEO>(elem)->getQ();
+}
+
+// 赤黒順序の1回のsweepの後、後に計算した色の素子のVnが接続先の今のVnから計算し直した値と一致するか確かめる
+void expectRedBlackColoursAcrossLayers(int layers, int rows, int cols)
+{
+    Grid3D<BaseElement> grid(layers, rows, cols, false);
+    for (int z = 0; z < layers; ++z)
+        for (int y = 0; y < rows; ++y)
+            for (int x = 0; x < cols; ++x)
+            {
+                auto seo = std::make_shared<SEO>(1.0, 0.05, 10.0, 2.0, ((x + y + z) % 2) ? 0.009 : -0.009, 6);
+                seo->setQ(0.01 * ((7 * z + 3 * y + x) % 5 + 1));
+                grid.setElement(z, y, x, seo);
+            }
+    grid.connectNeighbors();
+    std::vector<Grid2D<BaseElement>> grids{grid.getFlatGrid()};
+    RedBlackSolver<BaseElement>(1).solve(grids);
+    for (int z = 0; z < layers; ++z)
+        for (int y = 0; y < rows; ++y)
+            for (int x = 0; x < cols; ++x)
+            {
+                if ((x + y + z) % 2 == 0)
+                    continue;
+                auto elem = grid.getElement(z, y, x);
+                double vn = elem->getVn();
+                elem->setSurroundingVoltages();
+                elem->setPcalc();
+                EXPECT_EQ(elem->getVn(), vn) << "rows " << rows << ": " << z << ", " << y << ", " << x;
+            }
+}
+} // namespace
+
+// 素子の並びと6近傍の接続
+TEST(Grid3DTest, LayoutAndStencil)
+{
+    const int layers = 3, rows = 4, cols = 5;
+    Grid3D<BaseElement> grid = makeGrid3D(layers, rows, cols);
+    const Grid2D<BaseElement> &flat = grid.getFlatGrid();
+    ASSERT_EQ(flat.numRows(), layers * rows);
+    ASSERT_EQ(flat.numCols(), cols);
+    for (int z = 0; z < layers; ++z)
+        for (int y = 0; y < rows; ++y)
+            for (int x = 0; x < cols; ++x)
+            {
+                EXPECT_EQ(grid.getElement(z, y, x), flat.getElement(z * rows + y, x));
+                EXPECT_EQ(grid.getPositionOf(grid.getElement(z, y, x)), (Grid3D<BaseElement>::Offset{z, y, x}));
+            }
+
+    // 内側の素子は下の層・上・左・下・右・上の層の順に6本、角の素子は3本
+    const auto &conns = grid.getElement(1, 2, 2)->getConnections();
+    ASSERT_EQ(conns.size(), 6u);
+    EXPECT_EQ(conns[0], grid.getElement(0, 2, 2));
+    EXPECT_EQ(conns[1], grid.getElement(1, 1, 2));
+    EXPECT_EQ(conns[2], grid.getElement(1, 2, 1));
+    EXPECT_EQ(conns[3], grid.getElement(1, 3, 2));
+    EXPECT_EQ(conns[4], grid.getElement(1, 2, 3));
+    EXPECT_EQ(conns[5], grid.getElement(2, 2, 2));
+    EXPECT_EQ(grid.getElement(0, 0, 0)->getConnections().size(), 3u);
+    EXPECT_EQ(grid.getElement(2, 3, 4)->getConnections().size(), 3u);
+
+    // 上下の層だけのステンシル
+    grid.connectNeighbors({{-1, 0, 0}, {1, 0, 0}});
+    EXPECT_EQ(grid.getElement(1, 2, 2)->getConnections().size(), 2u);
+    EXPECT_EQ(grid.getElement(0, 2, 2)->getConnections().size(), 1u);
+
+    EXPECT_THROW(grid.getElement(3, 0, 0), std::out_of_range);
+    EXPECT_THROW(grid.setElement(0, 4, 0, nullptr), std::out_of_range);
+    EXPECT_THROW(grid.connectNeighbors({{0, 0, 1}}), std::invalid_argument);
+    EXPECT_THROW(grid.connectNeighbors({{0, 0, 0}}), std::invalid_argument);
+    EXPECT_THROW(Grid3D<BaseElement>(0, 2, 2), std::invalid_argument);
+    Grid3D<BaseElement> empty(2, 2, 2);
+    EXPECT_THROW(empty.connectNeighbors(), std::invalid_argument);
+}
+
+// 1層のGrid3Dは同じ接続のGrid2Dと乱数列・計算の順番が同じなので、ビット単位で一致する
+TEST(Grid3DTest, SingleLayerMatchesGrid2D)
+{
+    const int n = 6;
+    Grid3D<BaseElement> grid3d(1, n, n, false);
+    for (int y = 0; y < n; ++y)
+        for (int x = 0; x < n; ++x)
+            grid3d.setElement(0, y, x, std::make_shared<SEO>(1.0, 0.05, 10.0, 2.0, ((x + y) % 2) ? 0.009 : -0.009, 4));
+    grid3d.connectNeighbors();
+    Grid2D<BaseElement> grid2d = makeCheckerGrid(n);
+
+    Sim a(0.1, 1000), b(0.1, 1000);
+    a.addGrid3D(grid3d);
+    b.addGrid({grid2d});
+    a.setSeed(21);
+    b.setSeed(21);
+    for (int s = 0; s < 500; ++s)
+    {
+        a.runStep();
+        b.runStep();
+    }
+    EXPECT_EQ(a.getTime(), b.getTime());
+    for (int y = 0; y < n; ++y)
+        for (int x = 0; x < n; ++x)
+            EXPECT_EQ(chargeOf(grid3d.getElement(0, y, x)), chargeOf(grid2d.getElement(y, x))) << y << ", " << x;
+}
+
+// 1層の行数が偶数でも奇数でも上下の層の素子は色が違う（(x + y + z) % 2）ので、赤黒順序の1回のsweepの後、
+// 後に計算した色の素子のVnは、接続先（全て先に計算した色）の今のVnから計算し直した値とビット単位で一致する
+TEST(Grid3DTest, RedBlackColoursAcrossLayers)
+{
+    for (int rows : {3, 4})
+        expectRedBlackColoursAcrossLayers(3, rows, 4);
+}
+
+// 層をまたいでトンネルが起き、実行プランを使っても同じ結果になる
+TEST(Grid3DTest, StackedLayersSimulate)
+{
+    const int layers = 4, rows = 4, cols = 4;
+    Grid3D<BaseElement> plainGrid = makeGrid3D(layers, rows, cols), compiledGrid = makeGrid3D(layers, rows, cols);
+    Sim plain(0.1, 1000), compiled(0.1, 1000);
+    plain.addGrid3D(plainGrid);
+    compiled.addGrid3D(compiledGrid);
+    plain.setSeed(9);
+    compiled.setSeed(9);
+    compiled.compile();
+
+    int tunnels = 0;
+    std::vector<double> q(layers * rows * cols, 0.0);
+    for (int s = 0; s < 300; ++s)
+    {
+        plain.runStep();
+        compiled.runStep();
+        const Grid2D<BaseElement> &flat = plainGrid.getFlatGrid();
+        for (int k = 0; k < layers * rows * cols; ++k)
+        {
+            double now = chargeOf(flat.getElement(k / cols, k % cols));
+            if (std::abs(now - q[k]) > e / 2)
+                ++tunnels;
+            q[k] = now;
+        }
+    }
+    EXPECT_GT(tunnels, 0);
+    for (int z = 0; z < layers; ++z)
+        for (int y = 0; y < rows; ++y)
+            for (int x = 0; x < cols; ++x)
+                EXPECT_EQ(chargeOf(plainGrid.getElement(z, y, x)), chargeOf(compiledGrid.getElement(z, y, x)));
+}
+
+// 同じ色の素子をつなぐステンシルのgridは、赤黒順序では計算できず例外になる（Jacobiなら計算できる）
+TEST(Grid3DTest, RejectsRedBlackWithSameColourStencil)
+{
+    const int layers = 2, rows = 3, cols = 3;
+    Grid3D<BaseElement> grid = makeGrid3D(layers, rows, cols);
+    EXPECT_TRUE(grid.isRedBlackColourable());
+    // 上下の層と、層の中の斜め（dy + dxが偶数なので同じ色）
+    grid.connectNeighbors({{-1, 0, 0}, {0, -1, -1}, {0, 1, 1}, {1, 0, 0}});
+    EXPECT_FALSE(grid.isRedBlackColourable());
+
+    Sim redBlack(0.1, 1000);
+    redBlack.setIntraGridParallel(true);
+    EXPECT_THROW(redBlack.addGrid3D(grid), std::logic_error);
+
+    Sim later(0.1, 1000);
+    later.addGrid3D(grid);
+    later.setIntraGridParallel(true);
+    EXPECT_THROW(later.runStep(), std::logic_error);
+
+    Sim jacobi(0.1, 1000);
+    jacobi.addGrid3D(grid);
+    EXPECT_NO_THROW(jacobi.runStep());
+
+    // 6近傍に戻せば赤黒順序で計算できる
+    grid.connectNeighbors();
+    EXPECT_TRUE(grid.isRedBlackColourable());
+    EXPECT_NO_THROW(redBlack.addGrid3D(grid));
+    EXPECT_NO_THROW(redBlack.runStep());
+}
@@ -0,0 +1,196 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+#include "seo_array.hpp"
+#include "simulation_2d.hpp"
+#include "thread_pool.hpp"
+#include "checker_grid.hpp"
+
+// Grid2D<SEOArray>の素子の並べ方（行優先・タイル・Z順序）のテスト
+// ・並べ方の順番が全てのセルを1回ずつ含み、タイル・Z順序の形になっていること
+// ・(row, col)を指定する関数は並べ方によらず同じ素子を指すこと
+// ・同じシードなら並べ方によらず、直列・赤黒順序の並列のどちらでも同じトンネルの列になること
+// ・Simulation2D<SEOArray>で並べ方を選んでも行優先と同じ結果になること
+namespace
+{
+const GridLayout layouts[] = {GridLayout::RowMajor, GridLayout::Tiled, GridLayout::Morton};
+
+struct Tunnel
+{
+    int index;
+    TunnelDirection direction;
+    double wt;
+    bool operator==(const Tunnel &o) const { return index == o.index && direction == o.direction && wt == o.wt; }
+};
+
+// ステップを回してトンネルの列を記録（poolがあれば赤黒順序で並列に計算する）
+std::vector<Tunnel> run(Grid2D<SEOArray> &grid, int steps, ThreadPool *pool)
+{
+    std::vector<Tunnel> out;
+    for (int s = 0; s < steps; ++s)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            if (pool)
+            {
+                for (int parity : {0, 1})
+                {
+                    grid.updateGridSurVn(*pool, parity);
+                    grid.updateGridVn(*pool, parity);
+                }
+            }
+            else
+            {
+                grid.updateGridSurVn();
+                grid.updateGridVn();
+            }
+        }
+        double st = 0.1;
+        bool tunnel = pool ? (grid.updateGriddE(*pool), grid.gridminwt(0.1, *pool)) : (grid.updateGriddE(), grid.gridminwt(0.1));
+        if (tunnel)
+        {
+            out.push_back({grid.getTunnelIndex(), grid.getTunnelDirection(), grid.getMinWT()});
+            grid.applyTunnel();
+            st = grid.getMinWT();
+        }
+        if (pool)
+            grid.updateGridQn(st, *pool);
+        else
+            grid.updateGridQn(st);
+    }
+    return out;
+}
+} // namespace
+
+// 並べ方の順番は全てのセルを1回ずつ含み、タイル・Z順序の形になる
+TEST(GridLayoutTest, OrderIsPermutation)
+{
+    for (GridLayout layout : layouts)
+    {
+        for (auto [rows, cols] : {std::pair<int, int>{1, 3}, {8, 8}, {10, 13}})
+        {
+            auto order = gridLayoutOrder(rows, cols, layout, 4);
+            std::vector<int> sorted = order, all(rows * cols);
+            std::sort(sorted.begin(), sorted.end());
+            std::iota(all.begin(), all.end(), 0);
+            EXPECT_EQ(sorted, all) << rows << "x" << cols;
+        }
+    }
+    // 8×8を4×4のタイルに分けると、最初の16個は左上のタイル
+    auto tiled = gridLayoutOrder(8, 8, GridLayout::Tiled, 4);
+    EXPECT_EQ(std::vector<int>(tiled.begin(), tiled.begin() + 6), (std::vector<int>{0, 1, 2, 3, 8, 9}));
+    EXPECT_EQ(tiled[16], 4);
+    // Z順序は2×2の塊をZの形にたどる
+    auto morton = gridLayoutOrder(8, 8, GridLayout::Morton, 4);
+    EXPECT_EQ(std::vector<int>(morton.begin(), morton.begin() + 8), (std::vector<int>{0, 1, 8, 9, 2, 3, 10, 11}));
+
+    EXPECT_THROW(gridLayoutOrder(4, 4, GridLayout::Tiled, 0), std::invalid_argument);
+    EXPECT_THROW(Grid2D<SEOArray>(4, 4, false, GridLayout::Tiled, -1), std::invalid_argument);
+}
+
+// (row, col)を指定する関数は並べ方によらず同じ素子を指し、接続も同じ素子を指す
+TEST(GridLayoutTest, AccessIsTransparent)
+{
+    auto source = makeCheckerGrid<SEO>(10, 13);
+    for (int y = 0; y < 10; ++y)
+        for (int x = 0; x < 13; ++x)
+            source.getElement(y, x)->setQ(0.001 * (y * 13 + x));
+    for (GridLayout layout : layouts)
+    {
+        auto grid = Grid2D<SEOArray>::fromGrid(source, layout, 4);
+        EXPECT_EQ(grid.getLayout(), layout);
+        for (int y = 0; y < 10; ++y)
+        {
+            for (int x = 0; x < 13; ++x)
+            {
+                int i = grid.index(y, x);
+                EXPECT_EQ(grid.positionOf(i), std::make_pair(y, x));
+                EXPECT_EQ(grid.getQ(y, x), source.getElement(y, x)->getQ());
+                std::vector<std::pair<int, int>> conns;
+                for (int j : grid.getElements().getConnections(i))
+                    conns.push_back(grid.positionOf(j));
+                std::vector<std::pair<int, int>> expected;
+                for (const auto &c : source.getElement(y, x)->getConnections())
+                {
+                    for (int yy = 0; yy < 10; ++yy)
+                        for (int xx = 0; xx < 13; ++xx)
+                            if (source.getElement(yy, xx) == c)
+                                expected.push_back({yy, xx});
+                }
+                EXPECT_EQ(conns, expected);
+            }
+        }
+        EXPECT_THROW(grid.index(10, 0), std::out_of_range);
+        EXPECT_THROW(grid.positionOf(130), std::out_of_range);
+    }
+}
+
+// 同じシードなら並べ方によらず同じトンネルの列になる（直列と、赤黒順序で行の帯・配列の範囲に分けた並列）
+TEST(GridLayoutTest, SameRunForEveryLayout)
+{
+    auto source = makeCheckerGrid<SEO>(10, 13);
+    ThreadPool pool(3);
+    for (ThreadPool *p : {static_cast<ThreadPool *>(nullptr), &pool})
+    {
+        std::vector<Tunnel> expected;
+        std::vector<double> expectedQ;
+        for (GridLayout layout : layouts)
+        {
+            auto grid = Grid2D<SEOArray>::fromGrid(source, layout, 4);
+            grid.setRandomStreams(21, 0);
+            auto tunnels = run(grid, 300, p);
+            std::vector<double> q;
+            for (int y = 0; y < 10; ++y)
+                for (int x = 0; x < 13; ++x)
+                    q.push_back(grid.getQ(y, x));
+            if (layout == GridLayout::RowMajor)
+            {
+                ASSERT_FALSE(tunnels.empty());
+                expected = tunnels;
+                expectedQ = q;
+                continue;
+            }
+            EXPECT_EQ(tunnels, expected) << static_cast<int>(layout);
+            EXPECT_EQ(q, expectedQ) << static_cast<int>(layout);
+        }
+    }
+}
+
+// Simulation2D<SEOArray>でも並べ方によらず、grid内の並列計算のあり・なしのどちらでも同じ結果になる
+TEST(GridLayoutTest, SimulationMatchesRowMajor)
+{
+    for (bool intraGrid : {false, true})
+    {
+        std::vector<double> expected;
+        for (GridLayout layout : layouts)
+        {
+            Simulation2D<SEOArray> sim(0.1, 1e9);
+            sim.setGridLayout(layout, 4);
+            sim.addGrid(std::vector<Grid2D<SEO>>{makeCheckerGrid<SEO>(10, 13), makeCheckerGrid<SEO>(6, 0.012)});
+            EXPECT_EQ(sim.getGrids()[0].getLayout(), layout);
+            sim.setSeed(17);
+            sim.setThreadCount(3);
+            sim.setIntraGridParallel(intraGrid);
+            for (int s = 0; s < 400; ++s)
+                sim.runStep();
+            std::vector<double> state;
+            for (const auto &grid : sim.getGrids())
+                for (int y = 0; y < grid.numRows(); ++y)
+                    for (int x = 0; x < grid.numCols(); ++x)
+                        state.push_back(grid.getQ(y, x));
+            state.push_back(sim.getTime());
+            if (layout == GridLayout::RowMajor)
+            {
+                ASSERT_GT(sim.getTunnelCount(), 0u);
+                expected = state;
+                continue;
+            }
+            EXPECT_EQ(state, expected) << static_cast<int>(layout) << (intraGrid ? " intra-grid" : "");
+        }
+    }
+    Simulation2D<SEOArray> sim(0.1, 1);
+    EXPECT_THROW(sim.setGridLayout(GridLayout::Tiled, 0), std::invalid_argument);
+}
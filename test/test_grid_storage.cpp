@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include "grid_2dim.hpp"
+#include "seo_class.hpp"
+
+// Grid2Dの素子の置き方のテスト
+// ・行ごとの先頭から引いた素子がgetElementと同じであること
+// ・getPositionOfがsetElementで記録した位置を返し、置き換えや2か所への配置にも追従すること
+namespace
+{
+std::shared_ptr<BaseElement> makeSEO()
+{
+    return std::make_shared<SEO>(1.0, 0.05, 10.0, 2.0, 0.009, 4);
+}
+} // namespace
+
+// rowBegin(row)[col]はgetElement(row, col)と同じ素子で、範囲外のgetElement・setElementは例外
+TEST(GridStorageTest, RowBeginMatchesGetElement)
+{
+    Grid2D<BaseElement> grid(3, 5, false);
+    for (int y = 0; y < 3; ++y)
+        for (int x = 0; x < 5; ++x)
+            grid.setElement(y, x, makeSEO());
+    for (int y = 0; y < 3; ++y)
+        for (int x = 0; x < 5; ++x)
+            EXPECT_EQ(grid.rowBegin(y)[x], grid.getElement(y, x));
+
+    EXPECT_THROW(grid.getElement(3, 0), std::out_of_range);
+    EXPECT_THROW(grid.getElement(0, -1), std::out_of_range);
+    EXPECT_THROW(grid.setElement(0, 5, makeSEO()), std::out_of_range);
+}
+
+// 素子の位置はsetElementで記録され、置き換えた素子はgridから消える
+TEST(GridStorageTest, PositionFollowsSetElement)
+{
+    Grid2D<BaseElement> grid(4, 6, false);
+    std::vector<std::shared_ptr<BaseElement>> placed;
+    for (int y = 0; y < 4; ++y)
+        for (int x = 0; x < 6; ++x)
+        {
+            placed.push_back(makeSEO());
+            grid.setElement(y, x, placed.back());
+        }
+    for (int k = 0; k < 24; ++k)
+        EXPECT_EQ(grid.getPositionOf(placed[k]), std::make_pair(k / 6, k % 6));
+
+    auto replacement = makeSEO();
+    grid.setElement(2, 3, replacement);
+    EXPECT_EQ(grid.getPositionOf(replacement), std::make_pair(2, 3));
+    EXPECT_THROW(grid.getPositionOf(placed[2 * 6 + 3]), std::runtime_error);
+    EXPECT_THROW(grid.getPositionOf(makeSEO()), std::runtime_error);
+}
+
+// 2か所に置いた素子は行優先で先の位置を返し、そこを置き換えると残りの位置を返す
+TEST(GridStorageTest, DuplicatePlacementReportsFirstCell)
+{
+    Grid2D<BaseElement> grid(3, 3, false);
+    for (int y = 0; y < 3; ++y)
+        for (int x = 0; x < 3; ++x)
+            grid.setElement(y, x, makeSEO());
+    auto shared = makeSEO();
+    grid.setElement(2, 1, shared);
+    grid.setElement(0, 2, shared);
+    EXPECT_EQ(grid.getPositionOf(shared), std::make_pair(0, 2));
+    grid.setElement(0, 2, makeSEO());
+    EXPECT_EQ(grid.getPositionOf(shared), std::make_pair(2, 1));
+    grid.setElement(2, 1, nullptr);
+    EXPECT_THROW(grid.getPositionOf(shared), std::runtime_error);
+}
+
+// 全てのセルに同じ素子を置いてから行優先に置き換えていくと、位置は残りのうち先のセルへ移っていく
+TEST(GridStorageTest, RefillingSharedElementFollowsRemainingCells)
+{
+    Grid2D<BaseElement> grid(4, 5, false);
+    auto shared = makeSEO();
+    for (int y = 0; y < 4; ++y)
+        for (int x = 0; x < 5; ++x)
+            grid.setElement(y, x, shared);
+    for (int cell = 0; cell < 4 * 5; ++cell)
+    {
+        EXPECT_EQ(grid.getPositionOf(shared), std::make_pair(cell / 5, cell % 5));
+        grid.setElement(cell / 5, cell % 5, makeSEO());
+    }
+    EXPECT_THROW(grid.getPositionOf(shared), std::runtime_error);
+}
@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include "simulation_2d.hpp"
+#include "checker_grid.hpp"
+
+// 差分更新モードのテスト
+// ・Vnが変わった素子の周りだけを再計算しても、毎ステップ全素子をsweepする従来の計算と
+//   （足し込みの丸め誤差を除いて）同じVn・Qになり、同じ素子が同じ順にトンネルすること
+// ・gridをまたぐ接続（後ろのgridへのδは同じsweep、前のgridへのδは次のsweep）でも一致すること
+namespace
+{
+using Sim = Simulation2D<BaseElement>;
+
+// 2つの格子の境界（前の格子の右端の列と後ろの格子の左端の列）を双方向につなぐ
+std::vector<Grid2D<BaseElement>> makeCoupledGrids()
+{
+    std::vector<Grid2D<BaseElement>> grids = {makeCheckerGrid(6), makeCheckerGrid(6, 4, 0.012)};
+    for (int y = 0; y < 6; ++y)
+    {
+        auto a = grids[0].getElement(y, 5), b = grids[1].getElement(y, 0);
+        auto connsA = a->getConnections(), connsB = b->getConnections();
+        connsA.push_back(b);
+        connsB.push_back(a);
+        a->setConnections(connsA);
+        b->setConnections(connsB);
+    }
+    return grids;
+}
+
+std::vector<std::shared_ptr<BaseElement>> elementsOf(Sim &sim)
+{
+    std::vector<std::shared_ptr<BaseElement>> elems;
+    for (auto &grid : sim.getGrids())
+        for (int y = 0; y < grid.numRows(); ++y)
+            for (int x = 0; x < grid.numCols(); ++x)
+                elems.push_back(grid.getElement(y, x));
+    return elems;
+}
+
+double chargeOf(const std::shared_ptr<BaseElement> &elem)
+{
+    return std::static_pointer_cast<SEO>(elem)->getQ();
+}
+
+// 同じ回路・同じシードで全sweepと差分更新を1ステップずつ進め、毎ステップVnとQを比べる
+void expectMatchesFullSweep(int steps, int resyncInterval)
+{
+    Sim full(0.1, 1e9), incremental(0.1, 1e9);
+    full.addGrid(makeCoupledGrids());
+    incremental.addGrid(makeCoupledGrids());
+    full.setSeed(5);
+    incremental.setSeed(5);
+    incremental.setIncrementalUpdate(true);
+    incremental.setResyncInterval(resyncInterval);
+    auto a = elementsOf(full), b = elementsOf(incremental);
+
+    int tunnels = 0;
+    std::vector<double> before(a.size());
+    for (int s = 0; s < steps; ++s)
+    {
+        for (size_t k = 0; k < a.size(); ++k)
+            before[k] = chargeOf(a[k]);
+        full.runStep();
+        incremental.runStep();
+        ASSERT_DOUBLE_EQ(incremental.getTime(), full.getTime()) << "step " << s;
+        for (size_t k = 0; k < a.size(); ++k)
+        {
+            ASSERT_NEAR(b[k]->getVn(), a[k]->getVn(), 1e-12) << "step " << s << " element " << k;
+            ASSERT_NEAR(chargeOf(b[k]), chargeOf(a[k]), 1e-12) << "step " << s << " element " << k;
+            if (std::abs(chargeOf(a[k]) - before[k]) > e / 2)
+                ++tunnels;
+        }
+    }
+    EXPECT_GT(tunnels, 20);
+}
+} // namespace
+
+// V_sumを取り直さずに差分だけで進めても全sweepと一致する
+TEST(IncrementalUpdateTest, MatchesFullSweep)
+{
+    expectMatchesFullSweep(3000, 1 << 30);
+}
+
+// 途中でV_sumを取り直しても一致する
+TEST(IncrementalUpdateTest, MatchesFullSweepWithResync)
+{
+    expectMatchesFullSweep(3000, 7);
+}
+
+TEST(IncrementalUpdateTest, RejectsInvalidResyncInterval)
+{
+    Sim sim(0.1, 1e9);
+    EXPECT_THROW(sim.setResyncInterval(0), std::invalid_argument);
+}
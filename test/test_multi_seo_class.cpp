@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "multi_seo_class.hpp"
+
+// MultiSEOの待ち時間のテスト
+// 乱数1個で求める待ち時間が、接合ごとに乱数を引いて最小値を取る方法（以前の実装）と同じ分布になること
+namespace
+{
+constexpr int samples = 20000;
+
+// 以前の実装：トンネルできる接合の数だけ待ち時間を引いて最小値を取る
+std::vector<double> loopSamples(double rj, double dE, int junctions, unsigned seed)
+{
+    std::mt19937 mt(seed);
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    std::vector<double> out;
+    for (int s = 0; s < samples; ++s)
+    {
+        double wt = 100;
+        for (int rep = 0; rep < junctions; rep++)
+        {
+            double tmpwt = (e * e * rj / dE) * std::log(1 / dist(mt));
+            wt = std::min(tmpwt, wt);
+        }
+        out.push_back(wt);
+    }
+    return out;
+}
+
+// MultiSEO::calculateTunnelWtで引いた待ち時間
+std::vector<double> elementSamples(MultiSEO &seo, TunnelDirection direction)
+{
+    std::vector<double> out;
+    for (int s = 0; s < samples; ++s)
+    {
+        EXPECT_TRUE(seo.calculateTunnelWt());
+        UpDown wt = seo.getWT();
+        out.push_back(direction == TunnelDirection::Up ? wt.up : wt.down);
+    }
+    return out;
+}
+
+// 2標本コルモゴロフ–スミルノフ統計量
+double ksStatistic(std::vector<double> a, std::vector<double> b)
+{
+    std::sort(a.begin(), a.end());
+    std::sort(b.begin(), b.end());
+    size_t i = 0, j = 0;
+    double d = 0.0;
+    while (i < a.size() && j < b.size())
+    {
+        double x = std::min(a[i], b[j]);
+        while (i < a.size() && a[i] <= x)
+            ++i;
+        while (j < b.size() && b[j] <= x)
+            ++j;
+        d = std::max(d, std::abs(static_cast<double>(i) / a.size() - static_cast<double>(j) / b.size()));
+    }
+    return d;
+}
+
+double mean(const std::vector<double> &v)
+{
+    double sum = 0.0;
+    for (double x : v)
+        sum += x;
+    return sum / v.size();
+}
+
+// 有意水準0.1%の2標本KS検定の棄却限界（標本数が等しい場合）
+const double ksCritical = 1.95 * std::sqrt(2.0 / samples);
+} // namespace
+
+// 20重の振動子でup方向の待ち時間の分布が以前の実装と一致する
+TEST(MultiSEOTest, SingleDrawMatchesLoopUp)
+{
+    const double rj = 0.05, dE = 0.01;
+    MultiSEO seo(1.0, rj, multi_Cj, 2.0, 0.0, 4, 20);
+    seo.setdE(TunnelDirection::Up, dE);
+    seo.setdE(TunnelDirection::Down, -dE);
+    std::vector<double> single = elementSamples(seo, TunnelDirection::Up);
+    std::vector<double> loop = loopSamples(rj, dE, 20, 1);
+
+    EXPECT_LT(ksStatistic(single, loop), ksCritical);
+    // 平均は e^2 Rj / (20 dE)（標準誤差は約0.7%）
+    double expected = e * e * rj / (20 * dE);
+    EXPECT_NEAR(mean(single), expected, 0.03 * expected);
+    EXPECT_NEAR(mean(loop), expected, 0.03 * expected);
+}
+
+// トンネルした分だけ接合が減ったときのdown方向の分布も一致する
+TEST(MultiSEOTest, SingleDrawMatchesLoopDownWithTunnelled)
+{
+    const double rj = 0.05, dE = 0.004;
+    MultiSEO seo(1.0, rj, multi_Cj, 2.0, 0.0, 4, 20);
+    for (int k = 0; k < 7; ++k)
+        seo.setTunnel(TunnelDirection::Down);
+    seo.setdE(TunnelDirection::Up, -dE);
+    seo.setdE(TunnelDirection::Down, dE);
+    std::vector<double> single = elementSamples(seo, TunnelDirection::Down);
+    std::vector<double> loop = loopSamples(rj, dE, 20 - 7, 2);
+
+    EXPECT_LT(ksStatistic(single, loop), ksCritical);
+    double expected = e * e * rj / (13 * dE);
+    EXPECT_NEAR(mean(single), expected, 0.03 * expected);
+    EXPECT_EQ(seo.getTunnelRate().first, TunnelDirection::Down);
+    EXPECT_NEAR(seo.getTunnelRate().second, 1.0 / expected, 1e-9 / expected);
+}
+
+// 接合数が違えば分布も違う（KS検定がずれを検出できることの確認）
+TEST(MultiSEOTest, DetectsWrongJunctionCount)
+{
+    const double rj = 0.05, dE = 0.01;
+    MultiSEO seo(1.0, rj, multi_Cj, 2.0, 0.0, 4, 20);
+    seo.setdE(TunnelDirection::Up, dE);
+    std::vector<double> single = elementSamples(seo, TunnelDirection::Up);
+    std::vector<double> loop = loopSamples(rj, dE, 15, 3);
+
+    EXPECT_GT(ksStatistic(single, loop), ksCritical);
+}
+
+// dEが正でなければトンネルしない
+TEST(MultiSEOTest, NoTunnelWithoutPositivedE)
+{
+    MultiSEO seo(1.0, 0.05, multi_Cj, 2.0, 0.0, 4, 20);
+    seo.setdE(TunnelDirection::Up, -0.01);
+    seo.setdE(TunnelDirection::Down, 0.0);
+    EXPECT_FALSE(seo.calculateTunnelWt());
+    EXPECT_EQ(seo.getWT().up, 0.0);
+    EXPECT_EQ(seo.getWT().down, 0.0);
+}
@@ -0,0 +1,139 @@
+#include <gtest/gtest.h>
+#include <array>
+#include <memory>
+#include <vector>
+#include "grid_2dim.hpp"
+
+// OnewayUnitのテスト
+// Grid2D<BaseElement>は内部素子を展開して直接計算するが、OnewayUnitを通して計算した場合と同じトンネルの列になること
+namespace
+{
+constexpr int rows = 3, cols = 5;
+
+struct Chain
+{
+    std::vector<std::shared_ptr<OnewayUnit>> units;
+    std::vector<std::shared_ptr<BaseElement>> ends; // 両端につなぐ素子
+};
+
+// 行ごとに一方通行素子を直列につないだ回路（奇数行は左向き）
+Chain makeChain()
+{
+    Chain chain;
+    for (int y = 0; y < rows; ++y)
+    {
+        for (int x = 0; x < cols; ++x)
+        {
+            std::array<std::shared_ptr<BaseElement>, 4> internal;
+            for (auto &p : internal)
+                p = std::make_shared<SEO>();
+            auto unit = std::make_shared<OnewayUnit>((y % 2) ? "left" : "right");
+            unit->setInternalElements(internal);
+            unit->setOnewaySeoParam(1.0, 0.05, Cj_leg2, Cj_leg3, 2.0, 0.0088);
+            chain.units.push_back(unit);
+        }
+        chain.ends.push_back(std::make_shared<SEO>(1.0, 0.05, Cj_leg4, 2.0, 0.0095, 4));
+        chain.ends.push_back(std::make_shared<SEO>(1.0, 0.05, Cj_leg4, 2.0, -0.0095, 4));
+    }
+    for (int y = 0; y < rows; ++y)
+    {
+        for (int x = 0; x < cols; ++x)
+        {
+            auto left = (x > 0) ? chain.units[y * cols + x - 1]->getInternalElement(3) : chain.ends[2 * y];
+            auto right = (x < cols - 1) ? chain.units[y * cols + x + 1]->getInternalElement(0) : chain.ends[2 * y + 1];
+            chain.units[y * cols + x]->setOnewayConnections(left, right);
+        }
+    }
+    return chain;
+}
+
+struct Tunnel
+{
+    int index;
+    TunnelDirection direction;
+    double wt;
+    bool operator==(const Tunnel &o) const { return index == o.index && direction == o.direction && wt == o.wt; }
+};
+
+template <typename Element>
+std::vector<Tunnel> run(int steps)
+{
+    Chain chain = makeChain();
+    Grid2D<Element> grid(rows, cols, false);
+    for (int y = 0; y < rows; ++y)
+        for (int x = 0; x < cols; ++x)
+            grid.setElement(y, x, chain.units[y * cols + x]);
+    grid.setRandomStreams(11, 0);
+    std::vector<Tunnel> out;
+    for (int s = 0; s < steps; ++s)
+    {
+        for (int k = 0; k < 5; ++k)
+        {
+            grid.updateGridSurVn();
+            grid.updateGridVn();
+        }
+        grid.updateGriddE();
+        double st = 0.1;
+        if (grid.gridminwt(0.1))
+        {
+            out.push_back({grid.getTunnelIndex(), grid.getTunnelDirection(), grid.getMinWT()});
+            grid.getTunnelPlace()->setTunnel(grid.getTunnelDirection());
+            st = grid.getMinWT();
+        }
+        grid.updateGridQn(st);
+    }
+    return out;
+}
+} // namespace
+
+// 内部素子を展開したgridと、OnewayUnitの関数を通すgridで同じトンネルの列
+TEST(OnewayUnitTest, FlattenedGridMatchesUnitGrid)
+{
+    auto flat = run<BaseElement>(3000);
+    auto unit = run<OnewayUnit>(3000);
+    ASSERT_GT(flat.size(), 100u);
+    EXPECT_EQ(flat, unit);
+}
+
+// 展開したgridでも、トンネルした内部素子をgetTunnelTargetとOnewayUnitの両方から取れる
+TEST(OnewayUnitTest, TunnelTargetIsInternalElement)
+{
+    Chain chain = makeChain();
+    Grid2D<BaseElement> grid(rows, cols, false);
+    for (int y = 0; y < rows; ++y)
+        for (int x = 0; x < cols; ++x)
+            grid.setElement(y, x, chain.units[y * cols + x]);
+    grid.setRandomStreams(3, 0);
+    bool found = false;
+    for (int s = 0; s < 2000 && !found; ++s)
+    {
+        grid.updateGridSurVn();
+        grid.updateGridVn();
+        grid.updateGriddE();
+        found = grid.gridminwt(0.1);
+        grid.updateGridQn(found ? grid.getMinWT() : 0.1);
+    }
+    ASSERT_TRUE(found);
+    auto unit = std::dynamic_pointer_cast<OnewayUnit>(grid.getTunnelPlace());
+    ASSERT_TRUE(unit);
+    const auto &internal = unit->getInternalElements();
+    int part = -1;
+    for (int k = 0; k < 4; ++k)
+        if (internal[k].get() == grid.getTunnelTarget())
+            part = k;
+    ASSERT_GE(part, 0);
+    double q = static_cast<SEO &>(*internal[part]).getQ();
+    unit->setTunnel(grid.getTunnelDirection());
+    EXPECT_NE(static_cast<SEO &>(*internal[part]).getQ(), q);
+}
+
+// 内部素子の型が違えばパラメータの設定で例外
+TEST(OnewayUnitTest, ParamRejectsWrongInternalType)
+{
+    OnewayUnit unit;
+    std::array<std::shared_ptr<BaseElement>, 4> internal;
+    for (auto &p : internal)
+        p = std::make_shared<MultiSEO>();
+    unit.setInternalElements(internal);
+    EXPECT_THROW(unit.setOnewaySeoParam(1.0, 0.05, Cj_leg2, Cj_leg3, 2.0, 0.0088), std::invalid_argument);
+}
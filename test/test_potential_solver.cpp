@@ -0,0 +1,162 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "potential_solver.hpp"
+#include "simulation_2d.hpp"
+#include "checker_grid.hpp"
+
+// Vnを求めるソルバーのテスト
+// ・Gauss-Seidel・SOR・マルチグリッドが、十分に反復したJacobiと同じVnに収束すること
+// ・許容値を下回ったところで反復を打ち切り、許容値が0なら決まった回数だけ反復すること
+// ・Simulation2Dがソルバーの記録を集計し（ステップごとの記録はオンにしたときだけ）、チェックポイントに保存すること
+namespace
+{
+using Sim = Simulation2D<BaseElement>;
+
+// 電荷を少しずつ変えた市松模様の格子（Vnが一様にならないように）
+std::vector<Grid2D<BaseElement>> makeChargedGrids()
+{
+    auto grid = makeCheckerGrid(8);
+    for (int y = 0; y < 8; ++y)
+        for (int x = 0; x < 8; ++x)
+            std::static_pointer_cast<SEO>(grid.getElement(y, x))->setQ(1e-3 * ((x * 7 + y * 3) % 11) - 5e-3);
+    return {grid};
+}
+
+std::vector<double> vnOf(std::vector<Grid2D<BaseElement>> &grids)
+{
+    std::vector<double> vn;
+    for (auto &grid : grids)
+        for (int y = 0; y < grid.numRows(); ++y)
+            for (int x = 0; x < grid.numCols(); ++x)
+                vn.push_back(grid.getElement(y, x)->getVn());
+    return vn;
+}
+} // namespace
+
+// どのソルバーも十分に反復したJacobiと同じVnに収束する
+TEST(PotentialSolverTest, SolversAgreeOnFixedPoint)
+{
+    auto reference = makeChargedGrids();
+    SolverStats stats = JacobiSolver<BaseElement>(5000, 1e-15).solve(reference);
+    ASSERT_LT(stats.residual, 1e-15);
+    auto expected = vnOf(reference);
+
+    std::vector<std::shared_ptr<PotentialSolver<BaseElement>>> solvers = {
+        std::make_shared<GaussSeidelSolver<BaseElement>>(1.0, 1e-13, 1000),
+        std::make_shared<GaussSeidelSolver<BaseElement>>(1.5, 1e-13, 1000),
+        std::make_shared<MultigridSolver<BaseElement>>(1e-13, 100)};
+    for (size_t s = 0; s < solvers.size(); ++s)
+    {
+        auto grids = makeChargedGrids();
+        stats = solvers[s]->solve(grids);
+        EXPECT_GT(stats.iterations, 0) << "solver " << s;
+        EXPECT_LT(stats.residual, 1e-13) << "solver " << s;
+        auto vn = vnOf(grids);
+        for (size_t k = 0; k < vn.size(); ++k)
+            EXPECT_NEAR(vn[k], expected[k], 1e-10) << "solver " << s << " element " << k;
+    }
+}
+
+// 許容値を下回ったら打ち切り、許容値が0なら決まった回数だけ反復する
+TEST(PotentialSolverTest, StopsAtTolerance)
+{
+    auto grids = makeChargedGrids();
+    EXPECT_EQ(JacobiSolver<BaseElement>().solve(grids).iterations, 5);
+
+    JacobiSolver<BaseElement> jacobi(1000, 1e-9);
+    SolverStats stats = jacobi.solve(grids);
+    EXPECT_LT(stats.iterations, 1000);
+    EXPECT_LT(stats.residual, 1e-9);
+    // 収束済みなら1回のsweepで許容値を下回る
+    EXPECT_EQ(jacobi.solve(grids).iterations, 1);
+
+    // Gauss-Seidel・マルチグリッドは反復の前に残差を調べるので、収束済みなら反復しない
+    // （最初のsolveの準備でVnが書き換わるので、2回目のsolveで調べる）
+    GaussSeidelSolver<BaseElement> gaussSeidel(1.0, 1e-9, 1000);
+    stats = gaussSeidel.solve(grids);
+    EXPECT_LT(stats.residual, 1e-9);
+    EXPECT_EQ(gaussSeidel.solve(grids).iterations, 0);
+    MultigridSolver<BaseElement> multigrid(1e-9, 100);
+    stats = multigrid.solve(grids);
+    EXPECT_LT(stats.residual, 1e-9);
+    EXPECT_EQ(multigrid.solve(grids).iterations, 0);
+
+    // 上限に達したら許容値を下回らなくても打ち切る
+    auto fresh = makeChargedGrids();
+    stats = GaussSeidelSolver<BaseElement>(1.0, 0.0, 3).solve(fresh);
+    EXPECT_EQ(stats.iterations, 3);
+    EXPECT_GT(stats.residual, 0.0);
+}
+
+TEST(PotentialSolverTest, RejectsInvalidParameters)
+{
+    EXPECT_THROW(JacobiSolver<BaseElement>(0), std::invalid_argument);
+    EXPECT_THROW(GaussSeidelSolver<BaseElement>(2.0), std::invalid_argument);
+    EXPECT_THROW(GaussSeidelSolver<BaseElement>(1.0, 1e-10, 0), std::invalid_argument);
+    EXPECT_THROW(MultigridSolver<BaseElement>(1e-10, 0), std::invalid_argument);
+}
+
+// 集計は常にとり、ステップごとの記録はオンにしたときだけためる
+TEST(PotentialSolverTest, SimulationSummarizesSolverStats)
+{
+    Sim sim(0.1, 1000);
+    sim.addGrid(makeChargedGrids());
+    sim.setSeed(3);
+    for (int s = 0; s < 50; ++s)
+        sim.runStep();
+    EXPECT_TRUE(sim.getSolverLog().empty());
+    EXPECT_EQ(sim.getSolverSummary().steps, 50u);
+    EXPECT_EQ(sim.getSolverSummary().maxIterations, 5);
+    EXPECT_EQ(sim.getSolverSummary().meanIterations(), 5.0);
+
+    sim.setSolverLogging(true);
+    sim.setPotentialSolver(std::make_shared<GaussSeidelSolver<BaseElement>>(1.0, 1e-12));
+    EXPECT_EQ(sim.getSolverSummary().steps, 0u);
+    int total = 0, most = 0;
+    for (int s = 0; s < 20; ++s)
+        sim.runStep();
+    ASSERT_EQ(sim.getSolverLog().size(), 20u);
+    for (const auto &stats : sim.getSolverLog())
+    {
+        total += stats.iterations;
+        most = std::max(most, stats.iterations);
+    }
+    const SolverSummary &summary = sim.getSolverSummary();
+    EXPECT_EQ(summary.steps, 20u);
+    EXPECT_EQ(summary.iterations, static_cast<std::uint64_t>(total));
+    EXPECT_EQ(summary.maxIterations, most);
+    EXPECT_EQ(summary.last.residual, sim.getSolverLog().back().residual);
+    EXPECT_LT(summary.maxResidual, 1e-12);
+
+    sim.setSolverLogging(false);
+    EXPECT_TRUE(sim.getSolverLog().empty());
+}
+
+// 集計と記録はチェックポイントから戻せる
+TEST(PotentialSolverTest, SummarySurvivesCheckpoint)
+{
+    const std::string path = "solver_summary.ckpt";
+    Sim sim(0.1, 1000), resumed(0.1, 1000);
+    sim.addGrid(makeChargedGrids());
+    resumed.addGrid(makeChargedGrids());
+    sim.setSeed(3);
+    sim.setSolverLogging(true);
+    resumed.setSolverLogging(true);
+    for (int s = 0; s < 30; ++s)
+        sim.runStep();
+    sim.saveCheckpoint(path);
+    ASSERT_TRUE(resumed.loadCheckpoint(path));
+    std::remove(path.c_str());
+
+    EXPECT_EQ(resumed.getSolverSummary().steps, 30u);
+    EXPECT_EQ(resumed.getSolverSummary().iterations, sim.getSolverSummary().iterations);
+    EXPECT_EQ(resumed.getSolverSummary().maxResidual, sim.getSolverSummary().maxResidual);
+    ASSERT_EQ(resumed.getSolverLog().size(), 30u);
+    EXPECT_EQ(resumed.getSolverLog().back().residual, sim.getSolverLog().back().residual);
+}
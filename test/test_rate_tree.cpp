@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <vector>
+#include "event_queue.hpp"
+#include "simulation_2d.hpp"
+#include "checker_grid.hpp"
+
+// BKL法（レートの和の木）のテスト
+// ・和の木の合計と累積和による選択が正しいこと、更新を繰り返しても丸め誤差がたまらないこと
+// ・選ばれる頻度がレートに比例すること
+// ・RateTreeモードのトンネルの頻度が従来のStepモードと一致すること
+namespace
+{
+// endtimeまで回したときのトンネルの回数（1ステップでQがe/2より大きく変わった回数）
+int countTunnels(EngineMode mode, bool incremental, std::uint64_t seed, double endtime)
+{
+    Simulation2D<BaseElement> sim(0.1, 1e9);
+    sim.addGrid({makeCheckerGrid(6)});
+    sim.setSeed(seed);
+    sim.setEngineMode(mode);
+    sim.setIncrementalUpdate(incremental);
+    auto &grid = sim.getGrids()[0];
+    int n = grid.numRows() * grid.numCols();
+    auto chargeOf = [&](int k) { return std::static_pointer_cast<SEO>(grid.getElement(k / grid.numCols(), k % grid.numCols()))->getQ(); };
+    std::vector<double> q(n);
+    for (int k = 0; k < n; ++k)
+        q[k] = chargeOf(k);
+    int tunnels = 0;
+    while (sim.getTime() < endtime)
+    {
+        sim.runStep();
+        for (int k = 0; k < n; ++k)
+        {
+            double now = chargeOf(k);
+            if (std::abs(now - q[k]) > e / 2)
+                ++tunnels;
+            q[k] = now;
+        }
+    }
+    return tunnels;
+}
+} // namespace
+
+// 合計と累積和による選択（要素数が2のべきでない場合、レートが0の要素を含む場合）
+TEST(RateSumTreeTest, TotalAndFind)
+{
+    RateSumTree tree(5);
+    tree.set(1, 2.0);
+    tree.set(3, 1.0);
+    tree.set(4, 3.0);
+    EXPECT_EQ(tree.total(), 6.0);
+    EXPECT_EQ(tree.find(0.0), 1);
+    EXPECT_EQ(tree.find(1.999), 1);
+    EXPECT_EQ(tree.find(2.0), 3);
+    EXPECT_EQ(tree.find(2.999), 3);
+    EXPECT_EQ(tree.find(3.0), 4);
+    EXPECT_EQ(tree.find(5.999), 4);
+    // 丸め誤差で合計を超えても、レートが正の要素を返す
+    EXPECT_EQ(tree.find(6.0), 4);
+
+    tree.set(4, 0.0);
+    EXPECT_EQ(tree.total(), 3.0);
+    EXPECT_EQ(tree.find(2.999), 3);
+    EXPECT_EQ(tree.find(3.0), 3);
+    EXPECT_EQ(tree.rate(1), 2.0);
+
+    EXPECT_THROW(tree.set(5, 1.0), std::out_of_range);
+    EXPECT_THROW(tree.set(0, -1.0), std::invalid_argument);
+    tree.clear();
+    EXPECT_EQ(tree.total(), 0.0);
+    EXPECT_THROW(tree.find(0.0), std::runtime_error);
+
+    RateSumTree single(1);
+    single.set(0, 0.5);
+    EXPECT_EQ(single.find(0.25), 0);
+}
+
+// 更新を何度繰り返しても、同じレートを一度に設定した木と合計がビット単位で一致する
+TEST(RateSumTreeTest, NoDriftAfterManyUpdates)
+{
+    const int n = 1000;
+    std::mt19937_64 mt(11);
+    std::uniform_real_distribution<double> rate(0.0, 1e3);
+    std::uniform_int_distribution<int> pick(0, n - 1);
+    RateSumTree updated(n);
+    std::vector<double> rates(n, 0.0);
+    for (int k = 0; k < 200000; ++k)
+    {
+        int id = pick(mt);
+        rates[id] = (k % 3 == 0) ? 0.0 : rate(mt);
+        updated.set(id, rates[id]);
+    }
+    RateSumTree fresh(n);
+    for (int id = 0; id < n; ++id)
+        fresh.set(id, rates[id]);
+    EXPECT_EQ(updated.total(), fresh.total());
+
+    for (int id = 0; id < n; ++id)
+        updated.set(id, 0.0);
+    EXPECT_EQ(updated.total(), 0.0);
+}
+
+// 一様乱数で選んだ頻度がレートに比例する
+TEST(RateSumTreeTest, SelectionProportionalToRate)
+{
+    const std::vector<double> rates = {0.5, 0.0, 3.0, 1.5, 0.0, 5.0, 0.25};
+    RateSumTree tree(static_cast<int>(rates.size()));
+    for (int id = 0; id < static_cast<int>(rates.size()); ++id)
+        tree.set(id, rates[id]);
+    const int samples = 200000;
+    std::vector<int> hits(rates.size(), 0);
+    CounterRNG rng(3, 0);
+    for (int s = 0; s < samples; ++s)
+        hits[tree.find((1.0 - rng.uniform()) * tree.total())]++;
+    for (size_t id = 0; id < rates.size(); ++id)
+    {
+        double p = rates[id] / tree.total();
+        double sigma = std::sqrt(samples * p * (1 - p));
+        EXPECT_NEAR(hits[id], samples * p, 5 * sigma + 1e-9) << "id " << id;
+    }
+}
+
+// 同じ時間でのトンネルの回数が、素子ごとに待ち時間を引くStepモードと統計的に一致する
+TEST(RateTreeEngineTest, TunnelCountMatchesStepEngine)
+{
+    int step = 0, tree = 0, treeIncremental = 0;
+    for (std::uint64_t seed : {1, 2, 3})
+    {
+        step += countTunnels(EngineMode::Step, false, seed, 400.0);
+        tree += countTunnels(EngineMode::RateTree, false, seed, 400.0);
+        treeIncremental += countTunnels(EngineMode::RateTree, true, seed, 400.0);
+    }
+    ASSERT_GT(step, 1000);
+    EXPECT_NEAR(tree, step, 0.03 * step);
+    EXPECT_NEAR(treeIncremental, step, 0.03 * step);
+}
+
+// 同じシードなら同じ結果、違うシードなら違う結果
+TEST(RateTreeEngineTest, SeedReproducesRun)
+{
+    EXPECT_EQ(countTunnels(EngineMode::RateTree, false, 9, 100.0), countTunnels(EngineMode::RateTree, false, 9, 100.0));
+    std::vector<int> counts;
+    for (std::uint64_t seed : {9, 10, 11, 12})
+        counts.push_back(countTunnels(EngineMode::RateTree, false, seed, 100.0));
+    EXPECT_FALSE(counts[0] == counts[1] && counts[1] == counts[2] && counts[2] == counts[3]);
+}
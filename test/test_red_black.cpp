@@ -0,0 +1,151 @@
+#include <gtest/gtest.h>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include "potential_solver.hpp"
+#include "simulation_2d.hpp"
+#include "checker_grid.hpp"
+
+// 赤黒順序（RedBlackSolver）とgrid内の並列計算のテスト
+// ・行の帯に分けて並列に計算しても、1つずつ色の順に計算した結果とビット単位で一致すること（スレッド数によらない）
+// ・同じ色の素子がgrid内でつながった回路は計算の前に例外になること
+// ・setIntraGridParallelは自分で設定したソルバーだけを元に戻すこと
+namespace
+{
+using Sim = Simulation2D<BaseElement>;
+
+// 電荷を少しずつ変えた市松模様の格子（列数が奇数なので、行ごとに同じ色の素子の数が変わる）
+Grid2D<BaseElement> makeChargedGrid()
+{
+    auto grid = makeCheckerGrid(10, 9);
+    for (int y = 0; y < 10; ++y)
+        for (int x = 0; x < 9; ++x)
+            std::static_pointer_cast<SEO>(grid.getElement(y, x))->setQ(1e-3 * ((x * 7 + y * 3) % 11) - 5e-3);
+    return grid;
+}
+
+std::vector<double> vnOf(const Grid2D<BaseElement> &grid)
+{
+    std::vector<double> vn;
+    for (int y = 0; y < grid.numRows(); ++y)
+        for (int x = 0; x < grid.numCols(); ++x)
+            vn.push_back(grid.getElement(y, x)->getVn());
+    return vn;
+}
+
+// 全素子のQとVn、最後に時刻
+std::vector<double> runIntraGridParallel(int threads, int steps)
+{
+    Sim sim(0.1, 1e9);
+    sim.addGrid({makeCheckerGrid(10, 9), makeCheckerGrid(7, 0.012)});
+    sim.setSeed(29);
+    sim.setThreadCount(threads);
+    sim.setIntraGridParallel(true);
+    for (int s = 0; s < steps; ++s)
+        sim.runStep();
+    std::vector<double> state;
+    for (auto &grid : sim.getGrids())
+        for (int y = 0; y < grid.numRows(); ++y)
+            for (int x = 0; x < grid.numCols(); ++x)
+            {
+                auto elem = grid.getElement(y, x);
+                state.push_back(std::static_pointer_cast<SEO>(elem)->getQ());
+                state.push_back(elem->getVn());
+            }
+    state.push_back(sim.getTime());
+    return state;
+}
+} // namespace
+
+// 行の帯に分けて並列に計算したsweepは、色の順に1つずつ計算したsweepとビット単位で一致する
+TEST(RedBlackTest, BandParallelMatchesSerialOrder)
+{
+    auto reference = makeChargedGrid();
+    for (int sweep = 0; sweep < 3; ++sweep)
+    {
+        for (int parity = 0; parity < 2; ++parity)
+        {
+            for (int y = 0; y < 10; ++y)
+                for (int x = 0; x < 9; ++x)
+                    if ((x + y) % 2 == parity)
+                        reference.getElement(y, x)->setSurroundingVoltages();
+            for (int y = 0; y < 10; ++y)
+                for (int x = 0; x < 9; ++x)
+                    if ((x + y) % 2 == parity)
+                        reference.getElement(y, x)->setPcalc();
+        }
+    }
+    auto expected = vnOf(reference);
+
+    for (int threads : {1, 2, 3, 4})
+    {
+        std::vector<Grid2D<BaseElement>> grids{makeChargedGrid()};
+        RedBlackSolver<BaseElement> solver(3);
+        solver.setThreadPool(std::make_shared<ThreadPool>(threads));
+        EXPECT_EQ(solver.solve(grids).iterations, 3);
+        EXPECT_EQ(vnOf(grids[0]), expected) << threads << " threads";
+    }
+}
+
+// トンネル・電荷の更新も含めて、grid内の並列計算はスレッド数によらずビット単位で同じ結果になる
+TEST(RedBlackTest, IntraGridParallelRunIsIndependentOfThreadCount)
+{
+    auto serial = runIntraGridParallel(1, 500);
+    for (int threads : {2, 4})
+        EXPECT_EQ(runIntraGridParallel(threads, 500), serial) << threads << " threads";
+}
+
+// 斜めの接続で同じ色の素子がつながると、計算の前に例外になる（gridの外の素子への接続は構わない）
+TEST(RedBlackTest, RejectsSameColourConnection)
+{
+    auto grid = makeCheckerGrid(4);
+    auto other = makeCheckerGrid(4);
+    auto a = grid.getElement(0, 0);
+    auto conns = a->getConnections();
+    conns.push_back(other.getElement(2, 2));
+    a->setConnections(conns);
+    std::vector<Grid2D<BaseElement>> grids{grid};
+    EXPECT_NO_THROW(RedBlackSolver<BaseElement>().solve(grids));
+
+    conns.push_back(grid.getElement(1, 1));
+    a->setConnections(conns);
+    EXPECT_THROW(RedBlackSolver<BaseElement>().solve(grids), std::logic_error);
+    EXPECT_THROW(RedBlackSolver<BaseElement>().prepare(grids), std::logic_error);
+
+    Sim sim(0.1, 10);
+    sim.addGrid(grids);
+    sim.setIntraGridParallel(true);
+    EXPECT_THROW(sim.runStep(), std::logic_error);
+}
+
+// setIntraGridParallel(false)は、trueにしたときに切り替えたソルバーだけを元に戻す
+TEST(RedBlackTest, IntraGridParallelRestoresOnlyItsOwnSolver)
+{
+    Sim sim(0.1, 10);
+    sim.addGrid({makeCheckerGrid(4)});
+    auto gaussSeidel = std::make_shared<GaussSeidelSolver<BaseElement>>();
+    sim.setPotentialSolver(gaussSeidel);
+    sim.setIntraGridParallel(true);
+    EXPECT_TRUE(std::dynamic_pointer_cast<RedBlackSolver<BaseElement>>(sim.getPotentialSolver()));
+    sim.runStep();
+    sim.setIntraGridParallel(false);
+    EXPECT_EQ(sim.getPotentialSolver(), gaussSeidel);
+    sim.runStep();
+
+    // 設定してあったRedBlackSolverはそのまま使い、falseにしても変えない
+    auto redBlack = std::make_shared<RedBlackSolver<BaseElement>>(8, 1e-9);
+    sim.setPotentialSolver(redBlack);
+    sim.setIntraGridParallel(true);
+    EXPECT_EQ(sim.getPotentialSolver(), redBlack);
+    sim.setIntraGridParallel(false);
+    EXPECT_EQ(sim.getPotentialSolver(), redBlack);
+
+    // trueの間に設定したソルバーもそのまま
+    sim.setPotentialSolver(gaussSeidel);
+    sim.setIntraGridParallel(true);
+    auto jacobi = std::make_shared<JacobiSolver<BaseElement>>(10);
+    sim.setPotentialSolver(jacobi);
+    sim.setIntraGridParallel(false);
+    EXPECT_EQ(sim.getPotentialSolver(), jacobi);
+    EXPECT_FALSE(sim.isIntraGridParallel());
+}
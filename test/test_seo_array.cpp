@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "seo_array.hpp"
+#include "simulation_2d.hpp"
+#include "checker_grid.hpp"
+
+// SEOArrayを素子の型にしたSimulation2Dのテスト
+// ・Grid2D<SEO>をSimulation2D<SEO>で回した結果と、同じ回路をGrid2D<SEOArray>にしてSimulation2D<SEOArray>で回した結果が
+//   毎ステップビット単位で一致すること（スレッド数やgrid内の並列計算によらず）
+namespace
+{
+std::vector<Grid2D<SEO>> makeGrids()
+{
+    return {makeCheckerGrid<SEO>(8), makeCheckerGrid<SEO>(6, 5, 0.012)};
+}
+
+// 全素子のQとVn
+std::vector<double> stateOf(Simulation2D<SEO> &sim)
+{
+    std::vector<double> state;
+    for (auto &grid : sim.getGrids())
+        for (int y = 0; y < grid.numRows(); ++y)
+            for (int x = 0; x < grid.numCols(); ++x)
+            {
+                state.push_back(grid.getElement(y, x)->getQ());
+                state.push_back(grid.getElement(y, x)->getVn());
+            }
+    return state;
+}
+
+std::vector<double> stateOf(Simulation2D<SEOArray> &sim)
+{
+    std::vector<double> state;
+    for (auto &grid : sim.getGrids())
+        for (int y = 0; y < grid.numRows(); ++y)
+            for (int x = 0; x < grid.numCols(); ++x)
+            {
+                state.push_back(grid.getQ(y, x));
+                state.push_back(grid.getVn(y, x));
+            }
+    return state;
+}
+
+// 同じ回路・同じシードで1ステップずつ進め、毎ステップ時刻・Q・Vnを比べる
+void expectSameRun(int threads, bool intraGrid, int steps)
+{
+    Simulation2D<SEO> reference(0.1, 1e9);
+    Simulation2D<SEOArray> sim(0.1, 1e9);
+    reference.addGrid(makeGrids());
+    sim.addGrid(makeGrids());
+    reference.setSeed(17);
+    sim.setSeed(17);
+    sim.setThreadCount(threads);
+    sim.setIntraGridParallel(intraGrid);
+    // SEOと同じく素子ごとにstd::logで待ち時間を求める
+    for (auto &grid : sim.getGrids())
+        grid.getElements().setBatchedSampling(false);
+
+    std::vector<double> before = stateOf(reference);
+    int changed = 0;
+    for (int s = 0; s < steps; ++s)
+    {
+        reference.runStep();
+        sim.runStep();
+        ASSERT_EQ(sim.getTime(), reference.getTime()) << "step " << s;
+        auto expected = stateOf(reference);
+        ASSERT_EQ(stateOf(sim), expected) << "step " << s;
+        changed += (expected != before);
+        before = expected;
+    }
+    EXPECT_GT(sim.getTunnelCount(), 50u);
+    EXPECT_GT(changed, 0);
+}
+} // namespace
+
+TEST(SEOArraySimulationTest, MatchesSEOSimulation)
+{
+    expectSameRun(1, false, 1000);
+}
+
+// gridごと・grid内の並列計算でも同じ結果になる（Jacobiなので計算の順番によらない）
+TEST(SEOArraySimulationTest, MatchesSEOSimulationInParallel)
+{
+    expectSameRun(3, false, 500);
+    expectSameRun(3, true, 500);
+}
+
+// oyl-video形式の出力もSimulation2D<SEO>と同じ
+TEST(SEOArraySimulationTest, OutputsMatchSEOSimulation)
+{
+    Simulation2D<SEO> reference(0.1, 20);
+    Simulation2D<SEOArray> sim(0.1, 20);
+    auto grids = makeGrids();
+    grids[0].setOutputEnabled(true);
+    grids[1].setOutputEnabled(true);
+    grids[1].setOutputLabel("second");
+    reference.addGrid(grids);
+    sim.addGrid(grids);
+    reference.setSeed(4);
+    sim.setSeed(4);
+    for (auto &grid : sim.getGrids())
+        grid.getElements().setBatchedSampling(false);
+    for (int s = 0; s < 200; ++s)
+    {
+        reference.runStep();
+        sim.runStep();
+    }
+    ASSERT_FALSE(sim.getOutputs().empty());
+    EXPECT_EQ(sim.getOutputs(), reference.getOutputs());
+}
@@ -0,0 +1,165 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+#include <string>
+#include "seo_kernels.hpp"
+#include "seo_class.hpp"
+#include "multi_seo_class.hpp"
+
+// SIMDカーネルのテスト
+// ・AVX2 / AVX-512版がスカラー版とビット単位で一致すること（端数が出るよう素子数は8の倍数にしない）
+// ・スカラー版がSEO・MultiSEOクラスの計算と一致すること
+namespace
+{
+struct KernelInput
+{
+    std::vector<double> Q, V_sum, Cj, C;
+    std::vector<int> legs, multi_num, tunnel_num;
+
+    explicit KernelInput(int n, unsigned seed = 12345)
+    {
+        std::mt19937 mt(seed);
+        std::uniform_real_distribution<double> q(-0.2, 0.2), v(-0.05, 0.05), cj(5.0, 400.0), c(1.0, 3.0);
+        std::uniform_int_distribution<int> l(1, 6), m(1, 20);
+        for (int i = 0; i < n; ++i)
+        {
+            Q.push_back(q(mt));
+            V_sum.push_back(v(mt));
+            Cj.push_back(cj(mt));
+            C.push_back(c(mt));
+            legs.push_back(l(mt));
+            multi_num.push_back(m(mt));
+            tunnel_num.push_back(std::uniform_int_distribution<int>(-(multi_num.back() - 1), multi_num.back() - 1)(mt));
+        }
+    }
+};
+
+struct KernelOutput
+{
+    std::vector<double> seoVn, seoUp, seoDown, multiVn, multiUp, multiDown;
+};
+
+KernelOutput runKernels(const KernelInput &in)
+{
+    int n = static_cast<int>(in.Q.size());
+    KernelOutput out;
+    for (auto *v : {&out.seoVn, &out.seoUp, &out.seoDown, &out.multiVn, &out.multiUp, &out.multiDown})
+        v->assign(n, 0.0);
+    seoPotentialKernel(n, in.Q.data(), in.V_sum.data(), in.Cj.data(), in.C.data(), in.legs.data(), out.seoVn.data());
+    seoEnergyKernel(n, in.Q.data(), in.V_sum.data(), in.Cj.data(), in.C.data(), in.legs.data(), out.seoUp.data(), out.seoDown.data());
+    multiSeoPotentialKernel(n, in.Q.data(), in.V_sum.data(), in.Cj.data(), in.C.data(), in.legs.data(),
+                            in.multi_num.data(), in.tunnel_num.data(), out.multiVn.data());
+    multiSeoEnergyKernel(n, in.Q.data(), in.V_sum.data(), in.Cj.data(), in.C.data(), in.legs.data(),
+                         in.multi_num.data(), in.tunnel_num.data(), out.multiUp.data(), out.multiDown.data());
+    return out;
+}
+
+// 命令セットを一時的に切り替える
+class SimdLevelGuard
+{
+    SimdLevel saved;
+
+public:
+    explicit SimdLevelGuard(SimdLevel level) : saved(getSimdLevel()) { setSimdLevel(level); }
+    ~SimdLevelGuard() { setSimdLevel(saved); }
+};
+} // namespace
+
+// 使える全ての命令セットでスカラー版とビット単位で一致する
+TEST(SeoKernelsTest, VectorKernelsMatchScalarBitForBit)
+{
+    KernelInput in(1003);
+    KernelOutput ref;
+    {
+        SimdLevelGuard guard(SimdLevel::Scalar);
+        ref = runKernels(in);
+    }
+    for (SimdLevel level : {SimdLevel::AVX2, SimdLevel::AVX512})
+    {
+        if (!isSimdLevelSupported(level))
+            continue;
+        SimdLevelGuard guard(level);
+        KernelOutput out = runKernels(in);
+        for (size_t i = 0; i < in.Q.size(); ++i)
+        {
+            SCOPED_TRACE(simdLevelName(level) + " element " + std::to_string(i));
+            EXPECT_EQ(out.seoVn[i], ref.seoVn[i]);
+            EXPECT_EQ(out.seoUp[i], ref.seoUp[i]);
+            EXPECT_EQ(out.seoDown[i], ref.seoDown[i]);
+            EXPECT_EQ(out.multiVn[i], ref.multiVn[i]);
+            EXPECT_EQ(out.multiUp[i], ref.multiUp[i]);
+            EXPECT_EQ(out.multiDown[i], ref.multiDown[i]);
+        }
+    }
+}
+
+// 素子数がベクトル幅より小さいとき・0のときも動く
+TEST(SeoKernelsTest, ShortAndEmptyBlocks)
+{
+    for (int n : {0, 1, 3, 7, 9})
+    {
+        KernelInput in(n, 7);
+        KernelOutput ref;
+        {
+            SimdLevelGuard guard(SimdLevel::Scalar);
+            ref = runKernels(in);
+        }
+        KernelOutput out = runKernels(in);
+        for (int i = 0; i < n; ++i)
+        {
+            EXPECT_EQ(out.seoVn[i], ref.seoVn[i]);
+            EXPECT_EQ(out.multiDown[i], ref.multiDown[i]);
+        }
+    }
+}
+
+// スカラー版がSEOクラスの計算と一致する
+TEST(SeoKernelsTest, ScalarMatchesSEO)
+{
+    SimdLevelGuard guard(SimdLevel::Scalar);
+    KernelInput in(64, 99);
+    KernelOutput out = runKernels(in);
+    for (size_t i = 0; i < in.Q.size(); ++i)
+    {
+        SEO seo(1.0, 0.05, in.Cj[i], in.C[i], 0.0, in.legs[i]);
+        seo.setQ(in.Q[i]);
+        seo.setVsum(in.V_sum[i]);
+        seo.setPcalc();
+        seo.setdEcalc();
+        EXPECT_DOUBLE_EQ(out.seoVn[i], seo.getVn());
+        EXPECT_DOUBLE_EQ(out.seoUp[i], seo.getdE().up);
+        EXPECT_DOUBLE_EQ(out.seoDown[i], seo.getdE().down);
+    }
+}
+
+// スカラー版がMultiSEOクラスの計算と一致する（tunnel_numはsetTunnelで進める）
+TEST(SeoKernelsTest, ScalarMatchesMultiSEO)
+{
+    SimdLevelGuard guard(SimdLevel::Scalar);
+    KernelInput in(64, 2024);
+    KernelOutput out = runKernels(in);
+    for (size_t i = 0; i < in.Q.size(); ++i)
+    {
+        MultiSEO seo(1.0, 0.05, in.Cj[i], in.C[i], 0.0, in.legs[i], in.multi_num[i]);
+        seo.setQ(in.Q[i]);
+        seo.setVsum(in.V_sum[i]);
+        for (int k = 0; k < std::abs(in.tunnel_num[i]); ++k)
+            seo.setTunnel(in.tunnel_num[i] > 0 ? TunnelDirection::Up : TunnelDirection::Down);
+        seo.setPcalc();
+        seo.setdEcalc();
+        EXPECT_DOUBLE_EQ(out.multiVn[i], seo.getVn());
+        EXPECT_DOUBLE_EQ(out.multiUp[i], seo.getdE().up);
+        EXPECT_DOUBLE_EQ(out.multiDown[i], seo.getdE().down);
+    }
+}
+
+// CPUが対応していない命令セットは設定できない
+TEST(SeoKernelsTest, UnsupportedLevelThrows)
+{
+    EXPECT_TRUE(isSimdLevelSupported(SimdLevel::Scalar));
+    EXPECT_TRUE(isSimdLevelSupported(detectSimdLevel()));
+    if (!isSimdLevelSupported(SimdLevel::AVX512))
+    {
+        EXPECT_THROW(setSimdLevel(SimdLevel::AVX512), std::invalid_argument);
+    }
+}
@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+#include <memory>
+#include <type_traits>
+#include <vector>
+#include "grid_2dim.hpp"
+#include "multi_seo_class.hpp"
+#include "seo_class.hpp"
+
+// 素子の型ごとの静的な呼び分けのテスト
+// Grid2D<BaseElement>（SEOとMultiSEOが混ざった格子）とGrid2D<SEO>の計算が、同じ素子をBaseElementの仮想関数で
+// 1つずつ計算した場合とビット単位で同じVn・V_sum・dE・wtになり、同じトンネルの列になること
+namespace
+{
+constexpr int rows = 6, cols = 7;
+constexpr double dt = 0.1;
+
+// 市松模様にバイアスをかけた格子（mixedなら一部をMultiSEOにする）
+template <typename Element>
+Grid2D<Element> makeGrid(bool mixed)
+{
+    Grid2D<Element> grid(rows, cols, false);
+    for (int y = 0; y < rows; ++y)
+        for (int x = 0; x < cols; ++x)
+        {
+            double vd = ((x + y) % 2) ? 0.009 : -0.009;
+            if constexpr (std::is_same<Element, BaseElement>::value)
+            {
+                if (mixed && (x * 3 + y) % 5 == 0)
+                {
+                    grid.setElement(y, x, std::make_shared<MultiSEO>(1.0, 0.05, 10.0, 2.0, vd, 4, 2));
+                    continue;
+                }
+            }
+            grid.setElement(y, x, std::make_shared<SEO>(1.0, 0.05, 10.0, 2.0, vd, 4));
+        }
+    for (int y = 0; y < rows; ++y)
+        for (int x = 0; x < cols; ++x)
+        {
+            std::vector<std::shared_ptr<BaseElement>> conns;
+            if (y > 0)
+                conns.push_back(grid.getElement(y - 1, x));
+            if (x > 0)
+                conns.push_back(grid.getElement(y, x - 1));
+            if (y < rows - 1)
+                conns.push_back(grid.getElement(y + 1, x));
+            if (x < cols - 1)
+                conns.push_back(grid.getElement(y, x + 1));
+            grid.getElement(y, x)->setConnections(conns);
+        }
+    grid.setRandomStreams(31, 0);
+    return grid;
+}
+
+struct Tunnel
+{
+    int index;
+    TunnelDirection direction;
+    double wt;
+    bool operator==(const Tunnel &o) const { return index == o.index && direction == o.direction && wt == o.wt; }
+};
+
+// 全素子のVn・V_sum・wt
+template <typename Element>
+std::vector<double> stateOf(const Grid2D<Element> &grid)
+{
+    std::vector<double> state;
+    for (int y = 0; y < rows; ++y)
+        for (int x = 0; x < cols; ++x)
+        {
+            const BaseElement &elem = *grid.getElement(y, x);
+            state.push_back(elem.getVn());
+            state.push_back(elem.getSurroundingVsum());
+            state.push_back(elem.getWT().up);
+            state.push_back(elem.getWT().down);
+        }
+    return state;
+}
+
+// gridの関数で1ステップ進める
+template <typename Element>
+void stepWithGrid(Grid2D<Element> &grid, std::vector<Tunnel> &tunnels)
+{
+    for (int k = 0; k < 5; ++k)
+    {
+        grid.updateGridSurVn();
+        grid.updateGridVn();
+    }
+    grid.updateGriddE();
+    double st = dt;
+    if (grid.gridminwt(dt))
+    {
+        tunnels.push_back({grid.getTunnelIndex(), grid.getTunnelDirection(), grid.getMinWT()});
+        grid.getTunnelPlace()->setTunnel(grid.getTunnelDirection());
+        st = grid.getMinWT();
+    }
+    grid.updateGridQn(st);
+}
+
+// 同じ手順を、行優先の順に素子をBaseElementの参照で（仮想関数を通して）計算して1ステップ進める
+template <typename Element>
+void stepWithVirtualCalls(Grid2D<Element> &grid, std::vector<Tunnel> &tunnels)
+{
+    auto forEach = [&](auto f)
+    {
+        for (int y = 0; y < rows; ++y)
+            for (int x = 0; x < cols; ++x)
+                f(static_cast<BaseElement &>(*grid.getElement(y, x)), y * cols + x);
+    };
+    for (int k = 0; k < 5; ++k)
+    {
+        forEach([](BaseElement &elem, int) { elem.setSurroundingVoltages(); });
+        forEach([](BaseElement &elem, int) { elem.setPcalc(); });
+    }
+    forEach([](BaseElement &elem, int) { elem.setdEcalc(); });
+    Tunnel best{-1, TunnelDirection::None, dt};
+    forEach([&](BaseElement &elem, int index)
+    {
+        if (!elem.calculateTunnelWt())
+            return;
+        const UpDown w = elem.getWT();
+        double wt = std::max(w.up, w.down);
+        if (wt < best.wt)
+            best = {index, (wt == w.up) ? TunnelDirection::Up : TunnelDirection::Down, wt};
+    });
+    double st = dt;
+    if (best.index >= 0)
+    {
+        tunnels.push_back(best);
+        grid.getElement(best.index / cols, best.index % cols)->setTunnel(best.direction);
+        st = best.wt;
+    }
+    forEach([st](BaseElement &elem, int) { elem.setNodeCharge(st); });
+}
+
+template <typename Element>
+void expectSameAsVirtualCalls(bool mixed, int steps)
+{
+    auto grid = makeGrid<Element>(mixed), reference = makeGrid<Element>(mixed);
+    std::vector<Tunnel> a, b;
+    for (int s = 0; s < steps; ++s)
+    {
+        stepWithGrid(grid, a);
+        stepWithVirtualCalls(reference, b);
+        ASSERT_EQ(stateOf(grid), stateOf(reference)) << "step " << s;
+    }
+    EXPECT_GT(a.size(), 50u);
+    EXPECT_EQ(a, b);
+}
+} // namespace
+
+// SEOとMultiSEOが混ざったGrid2D<BaseElement>は、型の表で呼び分けても仮想関数で計算した結果と同じ
+TEST(StaticDispatchTest, MixedGridMatchesVirtualCalls)
+{
+    expectSameAsVirtualCalls<BaseElement>(true, 1000);
+}
+
+// Grid2D<SEO>は素子の関数を直接呼ぶが、結果は仮想関数で計算した場合と同じ
+TEST(StaticDispatchTest, HomogeneousGridMatchesVirtualCalls)
+{
+    expectSameAsVirtualCalls<SEO>(false, 1000);
+}
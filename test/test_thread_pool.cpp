@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include "simulation_2d.hpp"
+#include "thread_pool.hpp"
+#include "checker_grid.hpp"
+
+// スレッドプールのテスト
+// ・parallelForが全ての番号を1回ずつ実行し、終わるまで待つこと（何回使い回しても）。仕事の例外が呼び出し元に届くこと
+// ・同じシードなら、gridごとの並列計算のスレッド数によらずビット単位で同じ結果になること
+namespace
+{
+using Sim = Simulation2D<BaseElement>;
+
+// 全素子のQとVn
+std::vector<double> stateOf(Sim &sim)
+{
+    std::vector<double> state;
+    for (auto &grid : sim.getGrids())
+        for (int y = 0; y < grid.numRows(); ++y)
+            for (int x = 0; x < grid.numCols(); ++x)
+            {
+                auto elem = grid.getElement(y, x);
+                state.push_back(std::static_pointer_cast<SEO>(elem)->getQ());
+                state.push_back(elem->getVn());
+            }
+    return state;
+}
+
+// 大きさとバイアスの違う4つのgridをthreadsスレッドで回す（coupledなら隣のgridと境界の列でつなぐ）
+std::vector<double> runWithThreads(int threads, bool coupled, int steps)
+{
+    std::vector<Grid2D<BaseElement>> grids = {makeCheckerGrid(6), makeCheckerGrid(6, 5, 0.012), makeCheckerGrid(6, 4),
+                                              makeCheckerGrid(6, 6, 0.015)};
+    if (coupled)
+    {
+        for (size_t g = 0; g + 1 < grids.size(); ++g)
+        {
+            for (int y = 0; y < 6; ++y)
+            {
+                auto a = grids[g].getElement(y, grids[g].numCols() - 1), b = grids[g + 1].getElement(y, 0);
+                auto connsA = a->getConnections(), connsB = b->getConnections();
+                connsA.push_back(b);
+                connsB.push_back(a);
+                a->setConnections(connsA);
+                b->setConnections(connsB);
+            }
+        }
+    }
+    Sim sim(0.1, 1e9);
+    sim.addGrid(grids);
+    sim.setSeed(23);
+    sim.setThreadCount(threads);
+    for (int s = 0; s < steps; ++s)
+        sim.runStep();
+    auto state = stateOf(sim);
+    state.push_back(sim.getTime());
+    return state;
+}
+} // namespace
+
+// 全ての番号を1回ずつ実行する（番号の数がスレッド数より少なくても多くても）
+TEST(ThreadPoolTest, ParallelForRunsEveryIndexOnce)
+{
+    ThreadPool pool(4);
+    EXPECT_EQ(pool.size(), 4);
+    for (int n : {0, 1, 3, 4, 17, 1000})
+    {
+        std::vector<std::atomic<int>> hits(n);
+        for (int round = 0; round < 3; ++round)
+            pool.parallelFor(n, [&](int i) { hits[i]++; });
+        for (int i = 0; i < n; ++i)
+            EXPECT_EQ(hits[i].load(), 3) << "n " << n << " index " << i;
+    }
+    EXPECT_THROW(ThreadPool(0), std::invalid_argument);
+}
+
+// 仕事の中で投げた例外は呼び出し元に届き、その後もプールは使える
+TEST(ThreadPoolTest, RethrowsJobException)
+{
+    ThreadPool pool(3);
+    EXPECT_THROW(pool.parallelFor(10, [](int i)
+                                  {
+                                      if (i == 7)
+                                          throw std::runtime_error("job failed");
+                                  }),
+                 std::runtime_error);
+    std::atomic<int> count{0};
+    pool.parallelFor(10, [&](int) { count++; });
+    EXPECT_EQ(count.load(), 10);
+}
+
+// 独立したgridは、スレッド数によらず直列と同じ結果になる
+TEST(ThreadPoolTest, IndependentGridsMatchSerialRun)
+{
+    auto serial = runWithThreads(1, false, 600);
+    for (int threads : {2, 3, 4})
+        EXPECT_EQ(runWithThreads(threads, false, 600), serial) << threads << " threads";
+}
+
+// gridどうしがつながっていても、並列なら（全gridのV_sumを取ってからVnを計算するので）スレッド数によらず同じ結果になる
+TEST(ThreadPoolTest, CoupledGridsAreDeterministicAcrossThreadCounts)
+{
+    auto twoThreads = runWithThreads(2, true, 600);
+    for (int threads : {3, 4})
+        EXPECT_EQ(runWithThreads(threads, true, 600), twoThreads) << threads << " threads";
+    EXPECT_EQ(runWithThreads(4, true, 600), runWithThreads(4, true, 600));
+}